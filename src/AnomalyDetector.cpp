@@ -0,0 +1,151 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "AnomalyDetector.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace tids {
+
+// Consecutive spike samples after which the channel is considered to have stepped
+#define SPIKE_PERSISTENCE_COUNT 3
+
+// Get anomaly type name
+const char *anomalyTypeName(int type) {
+    switch (type) {
+        case AnomalyEvent::TYPE::SPIKE:
+            return "spike";
+        case AnomalyEvent::TYPE::STEP_UP:
+            return "step_up";
+        case AnomalyEvent::TYPE::STEP_DOWN:
+            return "step_down";
+        default:
+            return "unknown";
+    }
+}
+
+AnomalyDetector::AnomalyDetector(TelemetryRecord::CHANNEL channel, double alpha, double spikeThreshold,
+                                 double cusumSlack, double cusumThreshold, double minimumDeviation) {
+    this->channel = channel;
+    this->alpha = alpha;
+    this->spikeThreshold = spikeThreshold;
+    this->cusumSlack = cusumSlack;
+    this->cusumThreshold = cusumThreshold;
+    this->minimumDeviation = minimumDeviation;
+    // About two time constants of the baseline
+    this->warmupCount = static_cast<uint64_t>(2.0 / alpha);
+
+    this->count = 0;
+    this->mean = 0.0;
+    this->variance = 0.0;
+    this->cusumHigh = 0.0;
+    this->cusumLow = 0.0;
+    this->spikeCount = 0;
+    this->eventCount = 0;
+}
+
+AnomalyDetector::~AnomalyDetector() {}
+
+// Add a sample (returns 1 and fills event if an anomaly was detected, 0 otherwise)
+int AnomalyDetector::update(int64_t timeNS, float value, AnomalyEvent *event) {
+    // Ignore samples that would poison the baseline
+    if (!std::isfinite(value)) {
+        return 0;
+    }
+
+    if (this->count++ == 0) {
+        this->mean = value;
+        return 0;
+    }
+
+    // Score the sample against the baseline before it is included
+    double deviation = std::max(std::sqrt(this->variance), this->minimumDeviation);
+    double score = (value - this->mean) / deviation;
+    bool warm = this->count > this->warmupCount;
+
+    int detected = 0;
+    event->timeNS = timeNS;
+    event->channel = this->channel;
+    event->value = value;
+    event->mean = static_cast<float>(this->mean);
+
+    // Spike: a sample beyond the z-score threshold, kept out of the baseline and CUSUM
+    if (std::fabs(score) > this->spikeThreshold) {
+        this->spikeCount++;
+        if (warm && this->spikeCount == 1) {
+            event->type = AnomalyEvent::TYPE::SPIKE;
+            event->score = static_cast<float>(score);
+            detected = 1;
+        }
+
+        // A spike that persists is a step too large for the CUSUM, so restart the baseline at the new level
+        if (this->spikeCount >= SPIKE_PERSISTENCE_COUNT) {
+            if (warm) {
+                event->type = score > 0.0 ? AnomalyEvent::TYPE::STEP_UP : AnomalyEvent::TYPE::STEP_DOWN;
+                event->score = static_cast<float>(score);
+                detected = 1;
+            }
+            this->restartBaseline(value);
+        }
+    } else {
+        this->spikeCount = 0;
+
+        // Step: cumulative drift beyond the slack in either direction
+        if (warm) {
+            this->cusumHigh = std::max(0.0, this->cusumHigh + score - this->cusumSlack);
+            this->cusumLow = std::max(0.0, this->cusumLow - score - this->cusumSlack);
+        }
+        if (this->cusumHigh > this->cusumThreshold || this->cusumLow > this->cusumThreshold) {
+            bool up = this->cusumHigh > this->cusumThreshold;
+            event->type = up ? AnomalyEvent::TYPE::STEP_UP : AnomalyEvent::TYPE::STEP_DOWN;
+            event->score = static_cast<float>(up ? this->cusumHigh : this->cusumLow);
+            detected = 1;
+            // Restart at the new level so the step is raised once
+            this->restartBaseline(value);
+        } else {
+            // Update the baseline, as a plain average while warming up so it settles quickly
+            double alpha = std::max(this->alpha, 1.0 / this->count);
+            double delta = value - this->mean;
+            double step = alpha * delta;
+            this->mean += step;
+            this->variance = (1.0 - alpha) * (this->variance + delta * step);
+        }
+    }
+
+    if (detected) {
+        this->eventCount++;
+    }
+    return detected;
+}
+
+// Restart CUSUM and the baseline mean at a new level, keeping the variance, and warm up again
+void AnomalyDetector::restartBaseline(float value) {
+    this->count = 1;
+    this->cusumHigh = 0.0;
+    this->cusumLow = 0.0;
+    this->spikeCount = 0;
+    this->mean = value;
+}
+
+// Get number of events raised
+uint64_t AnomalyDetector::getEventCount() {
+    return this->eventCount;
+}
+
+} /* namespace tids */
@@ -0,0 +1,99 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ANOMALYDETECTOR_H
+#define ANOMALYDETECTOR_H
+
+#include <atomic>
+#include <cstdint>
+
+#include "TelemetryRecord.h"
+
+namespace tids {
+
+// Anomaly raised by a detector on a channel
+struct AnomalyEvent {
+    enum TYPE {
+        // Single sample far from the exponentially weighted mean
+        SPIKE = 0,
+        // Sustained upward shift of the mean
+        STEP_UP = 1,
+        // Sustained downward shift of the mean
+        STEP_DOWN = 2,
+    };
+
+    // Time of the sample that raised the event, in nanoseconds (monotonic clock)
+    int64_t timeNS;
+    TelemetryRecord::CHANNEL channel;
+    AnomalyEvent::TYPE type;
+    // Sample value and baseline mean in channel units
+    float value;
+    float mean;
+    // Z-score of a spike, or cumulative sum in standard deviations of a step
+    float score;
+};
+
+// Get anomaly type name
+const char *anomalyTypeName(int type);
+
+// Streaming detector of spikes (EWMA z-score) and steps (two-sided CUSUM) on one channel
+class AnomalyDetector {
+private:
+    TelemetryRecord::CHANNEL channel;
+
+    // Smoothing factor of the baseline mean and variance
+    double alpha;
+    // Z-score above which a sample is a spike
+    double spikeThreshold;
+    // CUSUM allowance and decision threshold, in standard deviations
+    double cusumSlack;
+    double cusumThreshold;
+    // Floor on the standard deviation, in channel units (e.g. the sensor resolution)
+    double minimumDeviation;
+    // Samples used to establish the baseline before events are raised
+    uint64_t warmupCount;
+
+    uint64_t count;
+    double mean;
+    double variance;
+    double cusumHigh;
+    double cusumLow;
+    // Consecutive samples beyond the spike threshold (a spike event is raised on the first)
+    uint64_t spikeCount;
+
+    std::atomic<uint64_t> eventCount;
+
+public:
+    AnomalyDetector(TelemetryRecord::CHANNEL channel, double alpha, double spikeThreshold,
+                    double cusumSlack, double cusumThreshold, double minimumDeviation);
+    virtual ~AnomalyDetector();
+
+    // Add a sample (returns 1 and fills event if an anomaly was detected, 0 otherwise)
+    int update(int64_t timeNS, float value, AnomalyEvent *event);
+
+    // Get number of events raised
+    uint64_t getEventCount();
+
+private:
+    // Restart CUSUM and the baseline mean at a new level, keeping the variance, and warm up again
+    void restartBaseline(float value);
+};
+
+} /* namespace tids */
+
+#endif /* ANOMALYDETECTOR_H */
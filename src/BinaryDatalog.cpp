@@ -0,0 +1,367 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "BinaryDatalog.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "CRC32.h"
+
+namespace tids {
+
+// Bytes read at a time while recovering a torn tail
+#define RECOVERY_WINDOW_SIZE 262144
+
+// Get size of the timestamp and value columns for a block of sampleCount samples, in bytes
+size_t binaryDatalogPayloadSize(uint32_t sampleCount) {
+    size_t valuesSize = (sampleCount * sizeof(float) + 7) & ~static_cast<size_t>(7);
+    return sampleCount * sizeof(int64_t) + valuesSize;
+}
+
+// Get file name of a datalog segment
+std::string binaryDatalogSegmentName(const std::string &filename, uint32_t segmentIndex) {
+    char index[16];
+    snprintf(index, sizeof(index), ".%06u", segmentIndex);
+
+    // Insert the index before the extension of the last path component
+    size_t separator = filename.find_last_of('/');
+    size_t extension = filename.find_last_of('.');
+    if (extension == std::string::npos || (separator != std::string::npos && extension < separator) || extension == separator + 1) {
+        return filename + index;
+    }
+    return filename.substr(0, extension) + index + filename.substr(extension);
+}
+
+// Get size of a complete record in bytes (returns 0 if the record is torn or corrupt)
+static size_t validateRecordBytes(const uint8_t *record, size_t available, size_t trailerSize, bool verifyChecksum) {
+    if (available < sizeof(BinaryDatalogBlock) + trailerSize) {
+        return 0;
+    }
+    BinaryDatalogBlock block;
+    memcpy(&block, record, sizeof(block));
+
+    // Payload size must match the record type
+    if (block.magic == BINARY_DATALOG_BLOCK_MAGIC) {
+        if (block.payloadSize != binaryDatalogPayloadSize(block.sampleCount)) {
+            return 0;
+        }
+    } else if (block.magic == BINARY_DATALOG_SYNC_MAGIC) {
+        if (block.payloadSize != sizeof(BinaryDatalogSync) || block.channel != BINARY_DATALOG_SYNC_CHANNEL) {
+            return 0;
+        }
+    } else {
+        return 0;
+    }
+
+    size_t recordSize = sizeof(BinaryDatalogBlock) + block.payloadSize + trailerSize;
+    if (recordSize > available) {
+        return 0;
+    }
+    if (trailerSize == 0) {
+        return recordSize;
+    }
+
+    BinaryDatalogTrailer trailer;
+    memcpy(&trailer, record + sizeof(BinaryDatalogBlock) + block.payloadSize, sizeof(trailer));
+    if (trailer.recordSize != recordSize) {
+        return 0;
+    }
+    if (verifyChecksum && trailer.crc != crc32(0, record, sizeof(BinaryDatalogBlock) + block.payloadSize)) {
+        return 0;
+    }
+    return recordSize;
+}
+
+// Find the end of the last complete record of a version 2 datalog, scanning back from the end of the file
+// (returns -1 if the file cannot be read)
+int recoverBinaryDatalog(int fileDescriptor, size_t blocksOffset, size_t fileSize, size_t *validSize) {
+    *validSize = blocksOffset;
+    if (fileSize <= blocksOffset) {
+        return 0;
+    }
+    std::vector<uint8_t> buffer;
+
+    // The last record is usually complete, and its trailer gives its start
+    BinaryDatalogTrailer trailer;
+    if (fileSize - blocksOffset >= sizeof(BinaryDatalogBlock) + sizeof(trailer)
+        && pread(fileDescriptor, &trailer, sizeof(trailer), fileSize - sizeof(trailer)) == static_cast<ssize_t>(sizeof(trailer))
+        && trailer.recordSize >= sizeof(BinaryDatalogBlock) + sizeof(trailer)
+        && trailer.recordSize % 8 == 0
+        && trailer.recordSize <= fileSize - blocksOffset
+        && (fileSize - trailer.recordSize - blocksOffset) % 8 == 0) {
+        // The size comes from possibly torn bytes, so its range and alignment are checked before it is used
+        size_t recordOffset = fileSize - trailer.recordSize;
+        buffer.resize(trailer.recordSize);
+        size_t recordSize = 0;
+        if (pread(fileDescriptor, buffer.data(), buffer.size(), recordOffset) == static_cast<ssize_t>(buffer.size())) {
+            recordSize = validateRecordBytes(buffer.data(), buffer.size(), sizeof(BinaryDatalogTrailer), true);
+        }
+        if (recordSize > 0 && recordSize == trailer.recordSize) {
+            *validSize = fileSize;
+            return 0;
+        }
+    }
+
+    // Otherwise scan back over the torn tail for the last complete record, reading each chunk of the file once. A sync
+    // marker is itself a complete record, so the scan goes no further back than the newest intact one
+    std::vector<uint8_t> record;
+    size_t chunkEnd = fileSize;
+    while (chunkEnd > blocksOffset) {
+        size_t chunkOffset = blocksOffset;
+        if (chunkEnd - blocksOffset > RECOVERY_WINDOW_SIZE) {
+            chunkOffset = chunkEnd - RECOVERY_WINDOW_SIZE;
+            chunkOffset -= (chunkOffset - blocksOffset) % 8;
+        }
+        buffer.resize(chunkEnd - chunkOffset);
+        if (pread(fileDescriptor, buffer.data(), buffer.size(), chunkOffset) != static_cast<ssize_t>(buffer.size())) {
+            return -1;
+        }
+
+        // Records start on 8-byte boundaries relative to the first block
+        size_t offset = chunkOffset + ((chunkEnd - 1 - chunkOffset) / 8 + 1) * 8;
+        while (offset > chunkOffset) {
+            offset -= 8;
+            if (fileSize - offset < sizeof(BinaryDatalogBlock) + sizeof(BinaryDatalogTrailer)) {
+                continue;
+            }
+
+            // Only offsets holding a record magic are read in full and validated
+            uint32_t magic;
+            memcpy(&magic, buffer.data() + (offset - chunkOffset), sizeof(magic));
+            if (magic != BINARY_DATALOG_BLOCK_MAGIC && magic != BINARY_DATALOG_SYNC_MAGIC) {
+                continue;
+            }
+            uint8_t header[sizeof(BinaryDatalogBlock)];
+            if (pread(fileDescriptor, header, sizeof(header), offset) != static_cast<ssize_t>(sizeof(header))) {
+                return -1;
+            }
+            size_t bodySize = validateRecordBytes(header, fileSize - offset - sizeof(BinaryDatalogTrailer), 0, false);
+            if (bodySize == 0) {
+                continue;
+            }
+            record.resize(bodySize + sizeof(BinaryDatalogTrailer));
+            if (pread(fileDescriptor, record.data(), record.size(), offset) != static_cast<ssize_t>(record.size())) {
+                return -1;
+            }
+            if (validateRecordBytes(record.data(), record.size(), sizeof(BinaryDatalogTrailer), true) == record.size()) {
+                *validSize = offset + record.size();
+                return 0;
+            }
+        }
+        chunkEnd = chunkOffset;
+    }
+
+    // No complete record in the whole file
+    return 0;
+}
+
+BinaryDatalogReader::BinaryDatalogReader(std::string filename) {
+    this->filename = filename;
+    this->fileDescriptor = -1;
+    this->data = nullptr;
+    this->size = 0;
+    this->header = nullptr;
+    this->channels = nullptr;
+    this->blocksOffset = 0;
+    this->trailerSize = sizeof(BinaryDatalogTrailer);
+    this->verifyChecksums = true;
+    this->corruptCount = 0;
+    this->wallClockOffsetNS = 0;
+}
+
+BinaryDatalogReader::~BinaryDatalogReader() {
+    this->close();
+}
+
+// Map and validate the datalog
+int BinaryDatalogReader::open() {
+    this->fileDescriptor = ::open(this->filename.c_str(), O_RDONLY);
+    if (this->fileDescriptor < 0) {
+        return -1;
+    }
+
+    struct stat fileStat;
+    if (fstat(this->fileDescriptor, &fileStat) < 0 || fileStat.st_size < static_cast<off_t>(sizeof(BinaryDatalogHeader))) {
+        this->close();
+        return -1;
+    }
+    this->size = static_cast<size_t>(fileStat.st_size);
+
+    void *mapping = mmap(nullptr, this->size, PROT_READ, MAP_SHARED, this->fileDescriptor, 0);
+    if (mapping == MAP_FAILED) {
+        this->close();
+        return -1;
+    }
+    this->data = static_cast<const uint8_t *>(mapping);
+
+    // Blocks are usually scanned front to back
+    madvise(mapping, this->size, MADV_SEQUENTIAL);
+
+    // Validate header
+    this->header = reinterpret_cast<const BinaryDatalogHeader *>(this->data);
+    if (memcmp(this->header->magic, BINARY_DATALOG_MAGIC, sizeof(BINARY_DATALOG_MAGIC)) != 0
+        || this->header->version < 1 || this->header->version > BINARY_DATALOG_VERSION
+        || this->header->headerSize != sizeof(BinaryDatalogHeader)
+        || this->header->channelSize != sizeof(BinaryDatalogChannel)) {
+        this->close();
+        return -1;
+    }
+
+    // Validate channel schema
+    this->blocksOffset = sizeof(BinaryDatalogHeader) + this->header->channelCount * sizeof(BinaryDatalogChannel);
+    if (this->blocksOffset > this->size) {
+        this->close();
+        return -1;
+    }
+    this->channels = reinterpret_cast<const BinaryDatalogChannel *>(this->data + sizeof(BinaryDatalogHeader));
+
+    this->wallClockOffsetNS = this->header->wallClockOffsetNS;
+
+    // Version 1 records have no trailer
+    this->trailerSize = this->header->version >= 2 ? sizeof(BinaryDatalogTrailer) : 0;
+    return 0;
+}
+
+// Unmap the datalog
+void BinaryDatalogReader::close() {
+    if (this->data != nullptr) {
+        munmap(const_cast<uint8_t *>(this->data), this->size);
+        this->data = nullptr;
+    }
+    if (this->fileDescriptor >= 0) {
+        ::close(this->fileDescriptor);
+        this->fileDescriptor = -1;
+    }
+    this->header = nullptr;
+    this->channels = nullptr;
+}
+
+// Get file header
+const BinaryDatalogHeader *BinaryDatalogReader::getHeader() {
+    return this->header;
+}
+
+// Get channel schema by index (returns nullptr if out of range)
+const BinaryDatalogChannel *BinaryDatalogReader::getChannel(int index) {
+    if (this->header == nullptr || index < 0 || index >= this->header->channelCount) {
+        return nullptr;
+    }
+    return &this->channels[index];
+}
+
+// Get channel schema index by name (returns -1 if not found)
+int BinaryDatalogReader::findChannel(const std::string &name) {
+    if (this->header == nullptr) {
+        return -1;
+    }
+    for (int index = 0; index < this->header->channelCount; index++) {
+        if (strncmp(this->channels[index].name, name.c_str(), sizeof(this->channels[index].name)) == 0) {
+            return index;
+        }
+    }
+    return -1;
+}
+
+// Set if record checksums are verified while reading (on by default, off avoids touching columns)
+void BinaryDatalogReader::setVerifyChecksums(bool verifyChecksums) {
+    this->verifyChecksums = verifyChecksums;
+}
+
+// Get the first block at or after offset, advancing offset past it (returns -1 at end of data)
+// Sync markers are skipped, and a corrupt record is skipped up to the next sync marker
+int BinaryDatalogReader::nextBlock(size_t *offset, Block *block) {
+    if (this->data == nullptr) {
+        return -1;
+    }
+
+    while (*offset < this->size) {
+        size_t recordSize = this->validateRecord(*offset, this->verifyChecksums);
+
+        // Resume at the next sync marker after a corrupt record (version 1 datalogs end at the first one)
+        if (recordSize == 0) {
+            if (this->trailerSize == 0) {
+                return -1;
+            }
+            size_t syncOffset = *offset + 8;
+            while (syncOffset + sizeof(BinaryDatalogBlock) <= this->size) {
+                const BinaryDatalogBlock *candidate = reinterpret_cast<const BinaryDatalogBlock *>(this->data + syncOffset);
+                if (candidate->magic == BINARY_DATALOG_SYNC_MAGIC && this->validateRecord(syncOffset, true) > 0) {
+                    break;
+                }
+                syncOffset += 8;
+            }
+            if (syncOffset + sizeof(BinaryDatalogBlock) > this->size) {
+                // A torn final record is not corruption
+                *offset = this->size;
+                return -1;
+            }
+            this->corruptCount++;
+            *offset = syncOffset;
+            continue;
+        }
+
+        const BinaryDatalogBlock *header = reinterpret_cast<const BinaryDatalogBlock *>(this->data + *offset);
+        const uint8_t *payload = this->data + *offset + sizeof(BinaryDatalogBlock);
+        *offset += recordSize;
+        if (header->magic == BINARY_DATALOG_SYNC_MAGIC) {
+            // Follow the wall clock mapping recorded with the marker
+            BinaryDatalogSync sync;
+            memcpy(&sync, payload, sizeof(sync));
+            this->wallClockOffsetNS = sync.wallClockOffsetNS;
+            continue;
+        }
+
+        block->header = header;
+        block->timeNS = reinterpret_cast<const int64_t *>(payload);
+        block->value = reinterpret_cast<const float *>(payload + header->sampleCount * sizeof(int64_t));
+        return 0;
+    }
+    return -1;
+}
+
+// Get offset of the first block
+size_t BinaryDatalogReader::getBlocksOffset() {
+    return this->blocksOffset;
+}
+
+// Get number of corrupt regions skipped
+uint64_t BinaryDatalogReader::getCorruptCount() {
+    return this->corruptCount;
+}
+
+// Get wall clock minus monotonic time for the block last returned by nextBlock, in nanoseconds
+int64_t BinaryDatalogReader::getWallClockOffsetNS() {
+    return this->wallClockOffsetNS;
+}
+
+// Get size of a complete record at offset (returns 0 if the record is torn or corrupt)
+size_t BinaryDatalogReader::validateRecord(size_t offset, bool verifyChecksum) {
+    if (offset >= this->size) {
+        return 0;
+    }
+    return validateRecordBytes(this->data + offset, this->size - offset, this->trailerSize, verifyChecksum);
+}
+
+} /* namespace tids */
@@ -0,0 +1,200 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BINARYDATALOG_H
+#define BINARYDATALOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace tids {
+
+// Binary datalog layout (all fields little-endian, every section 8-byte aligned):
+//   BinaryDatalogHeader
+//   BinaryDatalogChannel[header.channelCount]
+//   repeated records of:
+//     BinaryDatalogBlock
+//     payload of block.payloadSize bytes, either
+//       int64_t timeNS[block.sampleCount] and float value[block.sampleCount], zero padded to a multiple of 8 bytes
+//       or BinaryDatalogSync (sync marker)
+//     BinaryDatalogTrailer (version 2 and later)
+//
+// Every record ends with the CRC-32 of its header and payload and its total size, so the last complete
+// record can be found from the end of the file. Sync markers written at intervals let readers resume
+// after a corrupt record, bound how far recovery scans back, and record the wall clock mapping in effect.
+//
+// Datalogs are split into segments of bounded size named by inserting a six digit index before the
+// extension (datalog.tlog is written as datalog.000000.tlog, datalog.000001.tlog, ...).
+
+#define BINARY_DATALOG_MAGIC "TIDSLOG"
+#define BINARY_DATALOG_VERSION 2
+#define BINARY_DATALOG_BLOCK_MAGIC 0x4B4C4254 // "TBLK"
+#define BINARY_DATALOG_SYNC_MAGIC 0x434E5954 // "TYNC"
+
+// Channel of sync marker records
+#define BINARY_DATALOG_SYNC_CHANNEL 0xFFFF
+
+#define BINARY_DATALOG_VALUE_TYPE_FLOAT32 0
+
+struct BinaryDatalogHeader {
+    char magic[8];
+    uint16_t version;
+    uint16_t headerSize;
+    uint16_t channelSize;
+    uint16_t channelCount;
+    // Wall clock time minus monotonic time when the datalog was created, in nanoseconds
+    int64_t wallClockOffsetNS;
+    // Monotonic time when the datalog was created, in nanoseconds
+    int64_t createdTimeNS;
+    // Index of this segment
+    uint32_t segmentIndex;
+    uint32_t reserved0;
+    uint8_t reserved[24];
+};
+
+struct BinaryDatalogChannel {
+    uint16_t id;
+    uint16_t valueType;
+    uint32_t reserved;
+    char name[32];
+    char units[24];
+};
+
+struct BinaryDatalogBlock {
+    uint32_t magic;
+    uint16_t channel;
+    uint16_t reserved;
+    uint32_t sampleCount;
+    // Size of the payload following this block header, in bytes
+    uint32_t payloadSize;
+    // Range of timestamps in this block (monotonic), in nanoseconds
+    int64_t firstTimeNS;
+    int64_t lastTimeNS;
+};
+
+struct BinaryDatalogSync {
+    // Offset of the sync marker record in the file, in bytes
+    uint64_t recordOffset;
+    // Number of sync markers written before this one in the segment
+    uint64_t sequence;
+    // Wall clock time minus monotonic time when the marker was written, in nanoseconds
+    int64_t wallClockOffsetNS;
+    uint64_t reserved;
+};
+
+struct BinaryDatalogTrailer {
+    // CRC-32 of the block header and payload
+    uint32_t crc;
+    // Size of the record including block header, payload and trailer, in bytes
+    uint32_t recordSize;
+};
+
+static_assert(sizeof(BinaryDatalogHeader) == 64, "BinaryDatalogHeader must be 64 bytes");
+static_assert(sizeof(BinaryDatalogChannel) == 64, "BinaryDatalogChannel must be 64 bytes");
+static_assert(sizeof(BinaryDatalogBlock) == 32, "BinaryDatalogBlock must be 32 bytes");
+static_assert(sizeof(BinaryDatalogSync) == 32, "BinaryDatalogSync must be 32 bytes");
+static_assert(sizeof(BinaryDatalogTrailer) == 8, "BinaryDatalogTrailer must be 8 bytes");
+
+// Get size of the timestamp and value columns for a block of sampleCount samples, in bytes
+size_t binaryDatalogPayloadSize(uint32_t sampleCount);
+
+// Get file name of a datalog segment
+std::string binaryDatalogSegmentName(const std::string &filename, uint32_t segmentIndex);
+
+// Find the end of the last complete record of a version 2 datalog, scanning back from the end of the file
+// (returns -1 if the file cannot be read)
+int recoverBinaryDatalog(int fileDescriptor, size_t blocksOffset, size_t fileSize, size_t *validSize);
+
+// Zero-copy reader over a memory-mapped binary datalog
+class BinaryDatalogReader {
+public:
+    // View of one block with columns pointing into the mapped file
+    struct Block {
+        const BinaryDatalogBlock *header;
+        const int64_t *timeNS;
+        const float *value;
+    };
+
+private:
+    std::string filename;
+    int fileDescriptor;
+    const uint8_t *data;
+    size_t size;
+
+    const BinaryDatalogHeader *header;
+    const BinaryDatalogChannel *channels;
+
+    // Offset of the first block in the file
+    size_t blocksOffset;
+
+    // Size of the record trailer (0 for version 1 datalogs)
+    size_t trailerSize;
+
+    // If record checksums are verified while reading
+    bool verifyChecksums;
+
+    // Number of corrupt regions skipped
+    uint64_t corruptCount;
+
+    // Wall clock offset of the latest sync marker passed (of the header before the first)
+    int64_t wallClockOffsetNS;
+
+public:
+    BinaryDatalogReader(std::string filename);
+    virtual ~BinaryDatalogReader();
+
+    // Map and validate the datalog
+    int open();
+
+    // Unmap the datalog
+    void close();
+
+    // Get file header
+    const BinaryDatalogHeader *getHeader();
+
+    // Get channel schema by index (returns nullptr if out of range)
+    const BinaryDatalogChannel *getChannel(int index);
+
+    // Get channel schema index by name (returns -1 if not found)
+    int findChannel(const std::string &name);
+
+    // Set if record checksums are verified while reading (on by default, off avoids touching columns)
+    void setVerifyChecksums(bool verifyChecksums);
+
+    // Get the first block at or after offset, advancing offset past it (returns -1 at end of data)
+    // Sync markers are skipped, and a corrupt record is skipped up to the next sync marker
+    int nextBlock(size_t *offset, Block *block);
+
+    // Get offset of the first block
+    size_t getBlocksOffset();
+
+    // Get number of corrupt regions skipped
+    uint64_t getCorruptCount();
+
+    // Get wall clock minus monotonic time for the block last returned by nextBlock, in nanoseconds
+    int64_t getWallClockOffsetNS();
+
+private:
+    // Get size of a complete record at offset (returns 0 if the record is torn or corrupt)
+    size_t validateRecord(size_t offset, bool verifyChecksum);
+};
+
+} /* namespace tids */
+
+#endif /* BINARYDATALOG_H */
@@ -0,0 +1,52 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "CRC32.h"
+
+namespace tids {
+
+// Reflected polynomial of CRC-32
+#define CRC32_POLYNOMIAL 0xEDB88320u
+
+// Byte-at-a-time lookup table, built on first use
+struct CRC32Table {
+    uint32_t entries[256];
+
+    CRC32Table() {
+        for (uint32_t byte = 0; byte < 256; byte++) {
+            uint32_t crc = byte;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc & 0x1) ? (crc >> 1) ^ CRC32_POLYNOMIAL : crc >> 1;
+            }
+            this->entries[byte] = crc;
+        }
+    }
+};
+
+// Update a CRC-32 (IEEE 802.3, as used by zlib) with length bytes (start with crc 0)
+uint32_t crc32(uint32_t crc, const void *bytes, size_t length) {
+    static const CRC32Table table;
+    const uint8_t *input = static_cast<const uint8_t *>(bytes);
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc = table.entries[(crc ^ input[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+} /* namespace tids */
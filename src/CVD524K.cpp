@@ -25,18 +25,30 @@
 
 namespace tids {
 
+// ALM and TIM are photocoupler outputs pulled up at the input: ALM turns off on an alarm, TIM turns on at each timing step
+#define CVD524K_ALARM_ACTIVE_VALUE bbbkit::GPIO::VALUE::HIGH
+#define CVD524K_TIMING_ACTIVE_VALUE bbbkit::GPIO::VALUE::LOW
+
+// Timing outputs per revolution (once every 7.2 degrees)
+#define CVD524K_TIMING_OUTPUTS_PER_REVOLUTION 50
+
 CVD524K::CVD524K(bbbkit::GPIO::PIN pinPLS, bbbkit::GPIO::PIN pinCW, bbbkit::GPIO::PIN pinAWO,
                 bbbkit::GPIO::PIN pinCS, bbbkit::GPIO::PIN pinALM, bbbkit::GPIO::PIN pinTIM,
                 bbbkit::StepperMotor::DIRECTION direction,
                 int stepsPerRevolution, float revolutionsPerMinute, int stepFactor)
                 : bbbkit::StepperMotor(pinPLS, pinCW, pinAWO, direction, stepsPerRevolution, revolutionsPerMinute, stepFactor) {
 
-    this->gpioCS = new bbbkit::GPIO(pinCS, bbbkit::GPIO::DIRECTION::INPUT);
+    // CS is a driver input, ALM and TIM are driver outputs
+    this->gpioCS = new bbbkit::GPIO(pinCS, bbbkit::GPIO::DIRECTION::OUTPUT);
     // Set gpioCS LOW to use step angle on controller box
     this->gpioCS->setValue(bbbkit::GPIO::VALUE::LOW);
 
-    this->gpioALM = new bbbkit::GPIO(pinALM, bbbkit::GPIO::DIRECTION::OUTPUT);
-    this->gpioTIM = new bbbkit::GPIO(pinTIM, bbbkit::GPIO::DIRECTION::OUTPUT);
+    this->gpioALM = new bbbkit::GPIO(pinALM, bbbkit::GPIO::DIRECTION::INPUT);
+    this->gpioTIM = new bbbkit::GPIO(pinTIM, bbbkit::GPIO::DIRECTION::INPUT);
+
+    this->pinPLS = pinPLS;
+    this->stepsPerRevolution = stepsPerRevolution;
+    this->stepFactor = stepFactor;
 }
 
 CVD524K::~CVD524K() {
@@ -53,4 +65,29 @@ bbbkit::GPIO::VALUE CVD524K::getTimer() {
     return this->gpioTIM->getValue();
 }
 
+// If the driver reports an alarm (overcurrent, overheat, or similar; the motor is de-energized)
+bool CVD524K::isAlarmActive() {
+    return this->getAlarm() == CVD524K_ALARM_ACTIVE_VALUE;
+}
+
+// If the timing output is on (the excitation sequence is at its initial step)
+bool CVD524K::isTimingOutputOn() {
+    return this->getTimer() == CVD524K_TIMING_ACTIVE_VALUE;
+}
+
+// Get pulses between timing outputs (every 7.2 degrees)
+int CVD524K::getTimingPeriodSteps() {
+    return this->getStepsPerRevolution() / CVD524K_TIMING_OUTPUTS_PER_REVOLUTION;
+}
+
+// Get GPIO pin for step pulses
+bbbkit::GPIO::PIN CVD524K::getPulsePin() {
+    return this->pinPLS;
+}
+
+// Get pulses per revolution (steps times step factor)
+int CVD524K::getStepsPerRevolution() {
+    return this->stepsPerRevolution * this->stepFactor;
+}
+
 } /* namespace tids */
@@ -36,6 +36,10 @@ private:
     bbbkit::GPIO *gpioALM;
     // GPIO pin for position timing output
     bbbkit::GPIO *gpioTIM;
+    // GPIO pin for step pulses (driven by bbbkit::StepperMotor or a StepPulseGenerator)
+    bbbkit::GPIO::PIN pinPLS;
+    int stepsPerRevolution;
+    int stepFactor;
 public:
     CVD524K(bbbkit::GPIO::PIN pinPLS, bbbkit::GPIO::PIN pinCW, bbbkit::GPIO::PIN pinAWO,
             bbbkit::GPIO::PIN pinCS, bbbkit::GPIO::PIN pinALM, bbbkit::GPIO::PIN pinTIM,
@@ -45,6 +49,21 @@ public:
 
     bbbkit::GPIO::VALUE getAlarm();
     bbbkit::GPIO::VALUE getTimer();
+
+    // If the driver reports an alarm (overcurrent, overheat, or similar; the motor is de-energized)
+    bool isAlarmActive();
+
+    // If the timing output is on (the excitation sequence is at its initial step)
+    bool isTimingOutputOn();
+
+    // Get pulses between timing outputs (every 7.2 degrees)
+    int getTimingPeriodSteps();
+
+    // Get GPIO pin for step pulses
+    bbbkit::GPIO::PIN getPulsePin();
+
+    // Get pulses per revolution (steps times step factor)
+    int getStepsPerRevolution();
 };
 
 } /* namespace tids */
@@ -0,0 +1,95 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Clock.h"
+
+#include <ctime>
+
+#include "Seqlock.h"
+
+namespace tids {
+
+// Attempts to read the wall clock between two close monotonic readings
+#define MAPPING_ATTEMPTS 5
+
+// Latest mapping, published to every thread
+static Seqlock<ClockMapping> &mappingSeqlock() {
+    static Seqlock<ClockMapping> mapping;
+    return mapping;
+}
+
+// Read a clock in nanoseconds
+static int64_t readClockNS(clockid_t clockId) {
+    struct timespec now;
+    clock_gettime(clockId, &now);
+    return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+// Read both clocks, keeping the attempt with the narrowest monotonic bracket around the wall clock reading
+static ClockMapping measureMapping() {
+    ClockMapping best;
+    best.uncertaintyNS = INT64_MAX;
+    for (int attempt = 0; attempt < MAPPING_ATTEMPTS; attempt++) {
+        int64_t beforeNS = readClockNS(CLOCK_MONOTONIC);
+        int64_t wallClockNS = readClockNS(CLOCK_REALTIME);
+        int64_t afterNS = readClockNS(CLOCK_MONOTONIC);
+        if (afterNS - beforeNS < best.uncertaintyNS) {
+            best.monotonicNS = beforeNS + (afterNS - beforeNS) / 2;
+            best.wallClockNS = wallClockNS;
+            best.uncertaintyNS = afterNS - beforeNS;
+        }
+    }
+    return best;
+}
+
+// Get monotonic time in nanoseconds
+int64_t Clock::monotonicNS() {
+    return readClockNS(CLOCK_MONOTONIC);
+}
+
+// Get wall clock time in nanoseconds since the Unix epoch
+int64_t Clock::wallClockNS() {
+    return readClockNS(CLOCK_REALTIME);
+}
+
+// Record a new monotonic to wall clock mapping (must only be called from a single thread)
+void Clock::updateMapping() {
+    mappingSeqlock().write(measureMapping());
+}
+
+// Get latest monotonic to wall clock mapping (recorded now if none has been)
+void Clock::getMapping(ClockMapping *mapping) {
+    // Measure without publishing so the mapping keeps a single writer
+    if (mappingSeqlock().read(mapping) == 0) {
+        *mapping = measureMapping();
+    }
+}
+
+// Get wall clock minus monotonic time as of the latest mapping, in nanoseconds
+int64_t Clock::getWallClockOffsetNS() {
+    ClockMapping mapping;
+    Clock::getMapping(&mapping);
+    return mapping.wallClockNS - mapping.monotonicNS;
+}
+
+// Convert monotonic time to wall clock time with the latest mapping
+int64_t Clock::toWallClockNS(int64_t monotonicNS) {
+    return monotonicNS + Clock::getWallClockOffsetNS();
+}
+
+} /* namespace tids */
@@ -0,0 +1,62 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <cstdint>
+
+namespace tids {
+
+// Monotonic to wall clock mapping recorded at one instant
+struct ClockMapping {
+    // Monotonic time in nanoseconds (CLOCK_MONOTONIC)
+    int64_t monotonicNS;
+    // Wall clock time in nanoseconds since the Unix epoch (CLOCK_REALTIME)
+    int64_t wallClockNS;
+    // Uncertainty of the mapping (time taken to read both clocks), in nanoseconds
+    int64_t uncertaintyNS;
+};
+
+// Time source for every sample, event and log record
+// Samples are stamped with monotonic nanoseconds, which never jump; wall clock time is derived only
+// for people and external systems through a mapping recorded periodically
+class Clock {
+public:
+    // Get monotonic time in nanoseconds
+    static int64_t monotonicNS();
+
+    // Get wall clock time in nanoseconds since the Unix epoch
+    static int64_t wallClockNS();
+
+    // Record a new monotonic to wall clock mapping (must only be called from a single thread)
+    static void updateMapping();
+
+    // Get latest monotonic to wall clock mapping (recorded now if none has been)
+    static void getMapping(ClockMapping *mapping);
+
+    // Get wall clock minus monotonic time as of the latest mapping, in nanoseconds
+    static int64_t getWallClockOffsetNS();
+
+    // Convert monotonic time to wall clock time with the latest mapping
+    static int64_t toWallClockNS(int64_t monotonicNS);
+};
+
+} /* namespace tids */
+
+#endif /* CLOCK_H */
@@ -21,7 +21,10 @@
 
 #include "DS3218.h"
 
+#include <chrono>
 #include <cmath>
+#include <cstdlib>
+#include <thread>
 
 namespace tids {
 
@@ -29,6 +32,13 @@ namespace tids {
 #define DS3218_DUTY_CYCLE_MIN_NS 500000
 #define DS3218_DUTY_CYCLE_MAX_NS 2500000
 
+// Travel time at 5 V, and time to settle at the new angle
+#define DS3218_MS_PER_60_DEG 160
+#define DS3218_SETTLE_MS 50
+
+// Period of cancellation checks while waiting out travel
+#define DS3218_WAIT_PERIOD_MS 10
+
 DS3218::DS3218(bbbkit::PWM::PIN pin, int controlAngleDEG, int startAngleDEG) : bbbkit::ServoMotor(pin) {
     // Set control angle
     this->controlAngleDEG = controlAngleDEG;
@@ -78,6 +88,27 @@ int DS3218::move(int angleDEG) {
     return this->setAngle(this->getAngle() + angleDEG);
 }
 
+// Set current angle in degrees, with a handle that completes once the servo has had time to travel there
+MotionHandle DS3218::setAngleAsync(int angleDEG) {
+    // Refuse while a previous move is still traveling, so its angle is not overridden
+    if (this->motionWorker.isBusy()) {
+        return MotionHandle();
+    }
+    int previousAngleDEG = this->getAngle();
+    if (this->setAngle(angleDEG) < 0) {
+        return MotionHandle();
+    }
+    int travelMS = std::abs(this->getAngle() - previousAngleDEG) * DS3218_MS_PER_60_DEG / 60 + DS3218_SETTLE_MS;
+
+    // The servo has no position feedback, so wait out its rated travel time
+    return this->motionWorker.start([travelMS](const std::atomic<bool> *cancelled) {
+        for (int waitedMS = 0; waitedMS < travelMS && !*cancelled; waitedMS += DS3218_WAIT_PERIOD_MS) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(DS3218_WAIT_PERIOD_MS));
+        }
+        return 0;
+    });
+}
+
 // Get current angle as a percent, where the midpoint is 50%
 float DS3218::getAngleAsPercent() {
     return this->percentForAngle(this->getAngle());
@@ -24,6 +24,8 @@
 
 #include <libbbbkit/ServoMotor.h>
 
+#include "MotionHandle.h"
+
 namespace tids {
 
 class DS3218: public bbbkit::ServoMotor {
@@ -36,6 +38,9 @@ private:
     // the 180-degree variant can rotate from -90 to +90 degrees
     int angleDEG;
 
+    // Background thread waiting out servo travel for asynchronous moves
+    MotionWorker motionWorker;
+
 public:
     DS3218(bbbkit::PWM::PIN pin, int controlAngleDEG=270, int startAngleDEG=0);
     virtual ~DS3218();
@@ -49,6 +54,9 @@ public:
     // Move current angle by amount in degrees
     int move(int angleDEG);
 
+    // Set current angle in degrees, with a handle that completes once the servo has had time to travel there
+    MotionHandle setAngleAsync(int angleDEG);
+
     // Get current angle as a percent, where the midpoint is 50%
     float getAngleAsPercent();
 
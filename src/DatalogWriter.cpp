@@ -0,0 +1,591 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "DatalogWriter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "CRC32.h"
+#include "Clock.h"
+
+namespace tids {
+
+// Number of records popped from a producer at a time
+#define DRAIN_BATCH_SIZE 256
+
+// Size of the formatted output buffer, in bytes
+#define OUTPUT_BUFFER_SIZE 65536
+
+// Maximum length of a formatted record, in bytes
+#define RECORD_MAX_LENGTH 128
+
+// Number of samples per columnar block (binary format)
+#define BLOCK_SAMPLE_COUNT 1024
+
+// Bytes written between sync markers (bounds how far recovery scans back)
+#define SYNC_MARKER_INTERVAL 1048576
+
+// Longest time between sync markers, which also record the wall clock mapping
+#define SYNC_MARKER_PERIOD_MS 60000
+
+#define SEGMENT_SIZE_DEFAULT 67108864
+
+#define FLUSH_INTERVAL_DEFAULT_MS 1000
+#define SYNC_INTERVAL_DEFAULT_MS 10000
+#define DRAIN_INTERVAL_DEFAULT_MS 10
+
+DatalogWriter::DatalogWriter(std::string filename, DatalogWriter::FORMAT format) {
+    this->filename = filename;
+    this->fileDescriptor = -1;
+    this->format = format;
+
+    this->segmentIndex = 0;
+    this->fileOffset = 0;
+    this->segmentSize = SEGMENT_SIZE_DEFAULT;
+    this->lastSyncMarkerOffset = 0;
+    this->lastSyncMarkerTimeNS = 0;
+    this->syncMarkerCount = 0;
+
+    this->outputBuffer.resize(OUTPUT_BUFFER_SIZE);
+    this->outputBufferLength = 0;
+    for (int channel = 0; channel < TelemetryRecord::CHANNEL::CHANNEL_COUNT; channel++) {
+        this->blockTimeNS[channel].reserve(BLOCK_SAMPLE_COUNT);
+        this->blockValue[channel].reserve(BLOCK_SAMPLE_COUNT);
+    }
+
+    this->flushIntervalMS = FLUSH_INTERVAL_DEFAULT_MS;
+    this->syncIntervalMS = SYNC_INTERVAL_DEFAULT_MS;
+    this->echoIntervalMS = -1;
+    this->drainIntervalMS = DRAIN_INTERVAL_DEFAULT_MS;
+
+    this->lastFlushTimeNS = 0;
+    this->lastSyncTimeNS = 0;
+    for (int channel = 0; channel < TelemetryRecord::CHANNEL::CHANNEL_COUNT; channel++) {
+        this->lastEchoTimeNS[channel] = 0;
+    }
+    this->wallClockOffsetNS = 0;
+    this->lastWallTimeS = 0;
+    this->wallTimeString[0] = '\0';
+
+    this->recordsWritten = 0;
+    this->writeErrors = 0;
+
+    this->writerThreadShouldCancel = true;
+}
+
+DatalogWriter::~DatalogWriter() {
+    this->stop();
+    for (SPSCRingBuffer<TelemetryRecord> *producer : this->producers) {
+        delete producer;
+    }
+    for (SPSCRingBuffer<AnomalyEvent> *anomalyProducer : this->anomalyProducers) {
+        delete anomalyProducer;
+    }
+}
+
+// Create a ring buffer for a producer thread (only before start)
+SPSCRingBuffer<TelemetryRecord> *DatalogWriter::createProducer(size_t capacity) {
+    // Producers cannot be added while the writer thread iterates over them
+    if (!this->writerThreadShouldCancel) {
+        return nullptr;
+    }
+    SPSCRingBuffer<TelemetryRecord> *producer = new SPSCRingBuffer<TelemetryRecord>(capacity);
+    this->producers.push_back(producer);
+    return producer;
+}
+
+// Create an anomaly event ring buffer for a producer thread (only before start)
+SPSCRingBuffer<AnomalyEvent> *DatalogWriter::createAnomalyProducer(size_t capacity) {
+    // Producers cannot be added while the writer thread iterates over them
+    if (!this->writerThreadShouldCancel) {
+        return nullptr;
+    }
+    SPSCRingBuffer<AnomalyEvent> *anomalyProducer = new SPSCRingBuffer<AnomalyEvent>(capacity);
+    this->anomalyProducers.push_back(anomalyProducer);
+    return anomalyProducer;
+}
+
+// Set maximum time formatted output is held before being written
+int DatalogWriter::setFlushInterval(int flushIntervalMS) {
+    if (flushIntervalMS < 0) {
+        return -1;
+    }
+    this->flushIntervalMS = flushIntervalMS;
+    return 0;
+}
+
+// Set time between fsync calls (0 syncs on every write, negative never syncs)
+int DatalogWriter::setSyncInterval(int syncIntervalMS) {
+    this->syncIntervalMS = syncIntervalMS;
+    return 0;
+}
+
+// Set time between console echoes of each channel (negative disables echo)
+int DatalogWriter::setEchoInterval(int echoIntervalMS) {
+    this->echoIntervalMS = echoIntervalMS;
+    return 0;
+}
+
+// Set size after which a new segment is started (binary format, 0 never rotates)
+int DatalogWriter::setSegmentSize(uint64_t segmentSize) {
+    // Segments cannot be resized while the writer thread fills them
+    if (!this->writerThreadShouldCancel) {
+        return -1;
+    }
+    this->segmentSize = segmentSize;
+    return 0;
+}
+
+// Open datalog and start writer thread
+int DatalogWriter::start() {
+    // Return if the writer thread already exists
+    if (!this->writerThreadShouldCancel) {
+        return -1;
+    }
+
+    // Monotonic to wall clock offset for formatting timestamps, refreshed at every flush
+    this->wallClockOffsetNS = Clock::getWallClockOffsetNS();
+
+    if (this->format == DatalogWriter::FORMAT::BINARY) {
+        // Binary datalogs are written to a new segment after recovering the last one
+        if (this->openBinaryDatalog() < 0) {
+            return -1;
+        }
+    } else {
+        // Open datalog file
+        this->fileDescriptor = open(this->filename.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (this->fileDescriptor < 0) {
+            std::cout << "DatalogWriter: Error opening " << this->filename << "." << std::endl;
+            return -1;
+        }
+    }
+    this->lastFlushTimeNS = Clock::monotonicNS();
+    this->lastSyncTimeNS = this->lastFlushTimeNS;
+
+    // Reset cancellation token
+    this->writerThreadShouldCancel = false;
+    // Start draining on new thread
+    this->writerThread = std::thread(&DatalogWriter::drain, this);
+    return 0;
+}
+
+// Drain remaining records, stop writer thread and close datalog
+int DatalogWriter::stop() {
+    // Cancel and join writer thread
+    this->writerThreadShouldCancel = true;
+    if (this->writerThread.joinable()) {
+        this->writerThread.join();
+    }
+
+    // Close datalog file
+    if (this->fileDescriptor >= 0) {
+        close(this->fileDescriptor);
+        this->fileDescriptor = -1;
+    }
+    return 0;
+}
+
+// Get number of records dropped because a producer ring buffer was full
+uint64_t DatalogWriter::getOverflowCount() {
+    uint64_t overflowCount = 0;
+    for (SPSCRingBuffer<TelemetryRecord> *producer : this->producers) {
+        overflowCount += producer->getOverflowCount();
+    }
+    return overflowCount;
+}
+
+// Get number of records written to the datalog
+uint64_t DatalogWriter::getRecordsWritten() {
+    return this->recordsWritten;
+}
+
+// Get number of failed writes or syncs
+uint64_t DatalogWriter::getWriteErrors() {
+    return this->writeErrors;
+}
+
+// Continuously drain producers until cancellation token
+void DatalogWriter::drain() {
+    while (!this->writerThreadShouldCancel) {
+        size_t drained = this->drainProducers();
+        this->flush(false);
+
+        // Sleep only when producers have been emptied
+        if (drained == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(this->drainIntervalMS));
+        }
+    }
+
+    // Drain anything pushed before cancellation and persist it
+    while (this->drainProducers() > 0) {}
+    this->flush(true);
+}
+
+// Drain each producer once (returns number of records and anomaly events drained)
+size_t DatalogWriter::drainProducers() {
+    TelemetryRecord batch[DRAIN_BATCH_SIZE];
+    size_t drained = 0;
+    for (SPSCRingBuffer<TelemetryRecord> *producer : this->producers) {
+        size_t count = producer->pop(batch, DRAIN_BATCH_SIZE);
+        for (size_t i = 0; i < count; i++) {
+            if (this->format == DatalogWriter::FORMAT::BINARY) {
+                this->appendRecordToBlock(batch[i]);
+            } else {
+                this->formatRecord(batch[i]);
+            }
+            this->echoRecord(batch[i]);
+        }
+        drained += count;
+    }
+    this->recordsWritten += drained;
+
+    // Console output is slow, so anomalies are printed here rather than on the sampling thread
+    AnomalyEvent events[DRAIN_BATCH_SIZE];
+    for (SPSCRingBuffer<AnomalyEvent> *anomalyProducer : this->anomalyProducers) {
+        size_t count = anomalyProducer->pop(events, DRAIN_BATCH_SIZE);
+        for (size_t i = 0; i < count; i++) {
+            this->printAnomaly(events[i]);
+        }
+        drained += count;
+    }
+    return drained;
+}
+
+// Truncate the latest existing segment to its last complete record and open a new segment after it
+int DatalogWriter::openBinaryDatalog() {
+    // Find the latest segment
+    uint32_t segmentCount = 0;
+    struct stat segmentStat;
+    while (stat(binaryDatalogSegmentName(this->filename, segmentCount).c_str(), &segmentStat) == 0) {
+        segmentCount++;
+    }
+
+    // Only the latest segment can end in a torn record
+    if (segmentCount > 0) {
+        this->recoverSegment(binaryDatalogSegmentName(this->filename, segmentCount - 1));
+    }
+
+    // Each run starts a segment, since monotonic time (and the wall clock offset) restarts with the system
+    this->segmentIndex = segmentCount;
+    return this->openSegment();
+}
+
+// Truncate a segment from an earlier run to its last complete record (returns -1 if it is not a compatible segment)
+int DatalogWriter::recoverSegment(const std::string &segmentFilename) {
+    int segmentFileDescriptor = open(segmentFilename.c_str(), O_RDWR);
+    if (segmentFileDescriptor < 0) {
+        std::cout << "DatalogWriter: Error opening " << segmentFilename << "." << std::endl;
+        return -1;
+    }
+
+    struct stat segmentStat;
+    BinaryDatalogHeader header;
+    if (fstat(segmentFileDescriptor, &segmentStat) < 0
+        || pread(segmentFileDescriptor, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))
+        || memcmp(header.magic, BINARY_DATALOG_MAGIC, sizeof(BINARY_DATALOG_MAGIC)) != 0
+        || header.version != BINARY_DATALOG_VERSION
+        || header.headerSize != sizeof(BinaryDatalogHeader)
+        || header.channelSize != sizeof(BinaryDatalogChannel)) {
+        // Leave anything unrecognized untouched
+        close(segmentFileDescriptor);
+        return -1;
+    }
+
+    size_t fileSize = static_cast<size_t>(segmentStat.st_size);
+    size_t blocksOffset = sizeof(BinaryDatalogHeader) + header.channelCount * sizeof(BinaryDatalogChannel);
+    size_t validSize;
+    if (recoverBinaryDatalog(segmentFileDescriptor, blocksOffset, fileSize, &validSize) < 0) {
+        std::cout << "DatalogWriter: Error recovering " << segmentFilename << "." << std::endl;
+        close(segmentFileDescriptor);
+        return -1;
+    }
+
+    // Drop the torn tail so the segment ends in a complete record
+    if (validSize < fileSize) {
+        if (ftruncate(segmentFileDescriptor, static_cast<off_t>(validSize)) < 0 || fsync(segmentFileDescriptor) < 0) {
+            std::cout << "DatalogWriter: Error truncating " << segmentFilename << "." << std::endl;
+            close(segmentFileDescriptor);
+            return -1;
+        }
+        std::cout << "DatalogWriter: Recovered " << segmentFilename << ", truncated " << (fileSize - validSize) << " bytes." << std::endl;
+    }
+    close(segmentFileDescriptor);
+    return 0;
+}
+
+// Create the current segment and write the binary header and channel schema
+int DatalogWriter::openSegment() {
+    std::string segmentFilename = binaryDatalogSegmentName(this->filename, this->segmentIndex);
+    this->fileDescriptor = open(segmentFilename.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_APPEND, 0644);
+    if (this->fileDescriptor < 0) {
+        std::cout << "DatalogWriter: Error creating " << segmentFilename << "." << std::endl;
+        return -1;
+    }
+    this->fileOffset = 0;
+
+    BinaryDatalogHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BINARY_DATALOG_MAGIC, sizeof(BINARY_DATALOG_MAGIC));
+    header.version = BINARY_DATALOG_VERSION;
+    header.headerSize = sizeof(BinaryDatalogHeader);
+    header.channelSize = sizeof(BinaryDatalogChannel);
+    header.channelCount = TelemetryRecord::CHANNEL::CHANNEL_COUNT;
+    header.wallClockOffsetNS = this->wallClockOffsetNS;
+    header.createdTimeNS = Clock::monotonicNS();
+    header.segmentIndex = this->segmentIndex;
+    this->appendOutput(&header, sizeof(header));
+
+    for (int channel = 0; channel < TelemetryRecord::CHANNEL::CHANNEL_COUNT; channel++) {
+        BinaryDatalogChannel channelSchema;
+        memset(&channelSchema, 0, sizeof(channelSchema));
+        channelSchema.id = static_cast<uint16_t>(channel);
+        channelSchema.valueType = BINARY_DATALOG_VALUE_TYPE_FLOAT32;
+        strncpy(channelSchema.name, telemetryChannelName(channel), sizeof(channelSchema.name) - 1);
+        strncpy(channelSchema.units, telemetryChannelUnits(channel), sizeof(channelSchema.units) - 1);
+        this->appendOutput(&channelSchema, sizeof(channelSchema));
+    }
+    this->lastSyncMarkerOffset = this->fileOffset;
+    this->lastSyncMarkerTimeNS = header.createdTimeNS;
+    this->syncMarkerCount = 0;
+
+    this->writeOutput();
+    return 0;
+}
+
+// Write out and sync the current segment, then start the next one
+void DatalogWriter::rotateSegment() {
+    this->writeOutput();
+    if (fdatasync(this->fileDescriptor) < 0) {
+        this->writeErrors++;
+    }
+    close(this->fileDescriptor);
+
+    this->segmentIndex++;
+    if (this->openSegment() < 0) {
+        this->writeErrors++;
+    }
+}
+
+// Encode a sync marker into the output buffer
+void DatalogWriter::appendSyncMarker() {
+    BinaryDatalogBlock block;
+    memset(&block, 0, sizeof(block));
+    block.magic = BINARY_DATALOG_SYNC_MAGIC;
+    block.channel = BINARY_DATALOG_SYNC_CHANNEL;
+    block.payloadSize = sizeof(BinaryDatalogSync);
+    block.firstTimeNS = Clock::monotonicNS();
+    block.lastTimeNS = block.firstTimeNS;
+
+    BinaryDatalogSync sync;
+    memset(&sync, 0, sizeof(sync));
+    sync.recordOffset = this->fileOffset;
+    sync.sequence = this->syncMarkerCount++;
+    sync.wallClockOffsetNS = this->wallClockOffsetNS;
+
+    BinaryDatalogTrailer trailer;
+    trailer.crc = crc32(crc32(0, &block, sizeof(block)), &sync, sizeof(sync));
+    trailer.recordSize = sizeof(block) + sizeof(sync) + sizeof(trailer);
+
+    this->lastSyncMarkerOffset = this->fileOffset;
+    this->lastSyncMarkerTimeNS = block.firstTimeNS;
+    this->appendOutput(&block, sizeof(block));
+    this->appendOutput(&sync, sizeof(sync));
+    this->appendOutput(&trailer, sizeof(trailer));
+}
+
+// Format a record into the output buffer as text
+void DatalogWriter::formatRecord(const TelemetryRecord &record) {
+    // Make room in the output buffer if necessary
+    if (this->outputBufferLength + RECORD_MAX_LENGTH > this->outputBuffer.size()) {
+        this->writeOutput();
+    }
+
+    int64_t wallTimeNS = record.timeNS + this->wallClockOffsetNS;
+    std::time_t wallTimeS = static_cast<std::time_t>(wallTimeNS / 1000000000);
+    int milliseconds = static_cast<int>((wallTimeNS / 1000000) % 1000);
+
+    // Convert to local time only when the second changes
+    if (wallTimeS != this->lastWallTimeS) {
+        struct tm localTime;
+        localtime_r(&wallTimeS, &localTime);
+        strftime(this->wallTimeString, sizeof(this->wallTimeString), "%F %T", &localTime);
+        this->lastWallTimeS = wallTimeS;
+    }
+
+    char *output = &this->outputBuffer[this->outputBufferLength];
+    int length = snprintf(output, RECORD_MAX_LENGTH, "%s.%03d, %s, %g %s,\n",
+                          this->wallTimeString, milliseconds,
+                          telemetryChannelName(record.channel), record.value, telemetryChannelUnits(record.channel));
+    if (length > 0) {
+        this->outputBufferLength += std::min(static_cast<size_t>(length), static_cast<size_t>(RECORD_MAX_LENGTH - 1));
+    }
+}
+
+// Append a record to its channel's open block, sealing the block when full
+void DatalogWriter::appendRecordToBlock(const TelemetryRecord &record) {
+    if (record.channel >= TelemetryRecord::CHANNEL::CHANNEL_COUNT) {
+        return;
+    }
+    this->blockTimeNS[record.channel].push_back(record.timeNS);
+    this->blockValue[record.channel].push_back(record.value);
+    if (this->blockTimeNS[record.channel].size() >= BLOCK_SAMPLE_COUNT) {
+        this->sealBlock(record.channel);
+    }
+}
+
+// Encode a channel's open block into the output buffer
+void DatalogWriter::sealBlock(int channel) {
+    std::vector<int64_t> &timeNS = this->blockTimeNS[channel];
+    std::vector<float> &value = this->blockValue[channel];
+    if (timeNS.empty()) {
+        return;
+    }
+
+    uint32_t sampleCount = static_cast<uint32_t>(timeNS.size());
+    BinaryDatalogBlock block;
+    memset(&block, 0, sizeof(block));
+    block.magic = BINARY_DATALOG_BLOCK_MAGIC;
+    block.channel = static_cast<uint16_t>(channel);
+    block.sampleCount = sampleCount;
+    block.payloadSize = static_cast<uint32_t>(binaryDatalogPayloadSize(sampleCount));
+    block.firstTimeNS = timeNS.front();
+    block.lastTimeNS = timeNS.back();
+
+    // Header, timestamp column, value column, padding to 8 bytes, trailer
+    size_t paddingLength = block.payloadSize - sampleCount * (sizeof(int64_t) + sizeof(float));
+    const char padding[8] = {0};
+    BinaryDatalogTrailer trailer;
+    trailer.crc = crc32(0, &block, sizeof(block));
+    trailer.crc = crc32(trailer.crc, timeNS.data(), sampleCount * sizeof(int64_t));
+    trailer.crc = crc32(trailer.crc, value.data(), sampleCount * sizeof(float));
+    trailer.crc = crc32(trailer.crc, padding, paddingLength);
+    trailer.recordSize = static_cast<uint32_t>(sizeof(block) + block.payloadSize + sizeof(trailer));
+
+    this->appendOutput(&block, sizeof(block));
+    this->appendOutput(timeNS.data(), sampleCount * sizeof(int64_t));
+    this->appendOutput(value.data(), sampleCount * sizeof(float));
+    this->appendOutput(padding, paddingLength);
+    this->appendOutput(&trailer, sizeof(trailer));
+
+    timeNS.clear();
+    value.clear();
+
+    // Bound segment size
+    if (this->segmentSize > 0 && this->fileOffset >= this->segmentSize) {
+        this->rotateSegment();
+    }
+}
+
+// Copy bytes into the output buffer, writing it out when full
+void DatalogWriter::appendOutput(const void *bytes, size_t length) {
+    const char *input = static_cast<const char *>(bytes);
+    while (length > 0) {
+        if (this->outputBufferLength == this->outputBuffer.size()) {
+            this->writeOutput();
+        }
+        size_t copyLength = std::min(length, this->outputBuffer.size() - this->outputBufferLength);
+        memcpy(&this->outputBuffer[this->outputBufferLength], input, copyLength);
+        this->outputBufferLength += copyLength;
+        this->fileOffset += copyLength;
+        input += copyLength;
+        length -= copyLength;
+    }
+}
+
+// Write the output buffer to the datalog
+void DatalogWriter::writeOutput() {
+    size_t written = 0;
+    while (written < this->outputBufferLength) {
+        ssize_t result = write(this->fileDescriptor, &this->outputBuffer[written], this->outputBufferLength - written);
+        if (result < 0) {
+            this->writeErrors++;
+            break;
+        }
+        written += static_cast<size_t>(result);
+    }
+    this->outputBufferLength = 0;
+}
+
+// Print a record to the console if its echo interval has elapsed
+void DatalogWriter::echoRecord(const TelemetryRecord &record) {
+    if (this->echoIntervalMS < 0 || record.channel >= TelemetryRecord::CHANNEL::CHANNEL_COUNT) {
+        return;
+    }
+    if (record.timeNS - this->lastEchoTimeNS[record.channel] < static_cast<int64_t>(this->echoIntervalMS) * 1000000) {
+        return;
+    }
+    this->lastEchoTimeNS[record.channel] = record.timeNS;
+    std::cout << telemetryChannelName(record.channel) << ": " << record.value << " " << telemetryChannelUnits(record.channel) << std::endl;
+}
+
+// Print an anomaly event to the console
+void DatalogWriter::printAnomaly(const AnomalyEvent &event) {
+    std::cout << "TelemetrySystem: Anomaly " << anomalyTypeName(event.type) << " on " << telemetryChannelName(event.channel)
+              << ": " << event.value << " " << telemetryChannelUnits(event.channel)
+              << " (mean " << event.mean << ", score " << event.score << ")" << std::endl;
+}
+
+// Write buffered output (sealing open blocks) and sync according to policy
+void DatalogWriter::flush(bool force) {
+    int64_t nowNS = Clock::monotonicNS();
+
+    // Hold output until the flush interval elapses unless forced
+    bool flushDue = (nowNS - this->lastFlushTimeNS) >= static_cast<int64_t>(this->flushIntervalMS) * 1000000;
+    if (!force && !flushDue) {
+        return;
+    }
+
+    // Follow updates of the wall clock mapping
+    this->wallClockOffsetNS = Clock::getWallClockOffsetNS();
+
+    // Partial blocks are sealed so no sample is held longer than the flush interval
+    if (this->format == DatalogWriter::FORMAT::BINARY) {
+        for (int channel = 0; channel < TelemetryRecord::CHANNEL::CHANNEL_COUNT; channel++) {
+            this->sealBlock(channel);
+        }
+        bool syncMarkerDue = this->fileOffset - this->lastSyncMarkerOffset >= SYNC_MARKER_INTERVAL
+                             || nowNS - this->lastSyncMarkerTimeNS >= static_cast<int64_t>(SYNC_MARKER_PERIOD_MS) * 1000000;
+        if (syncMarkerDue) {
+            this->appendSyncMarker();
+        }
+    }
+
+    if (this->outputBufferLength > 0) {
+        this->writeOutput();
+        this->lastFlushTimeNS = nowNS;
+
+        // Sync to flash according to policy
+        bool syncDue = this->syncIntervalMS >= 0 && (nowNS - this->lastSyncTimeNS) >= static_cast<int64_t>(this->syncIntervalMS) * 1000000;
+        if (syncDue) {
+            if (fdatasync(this->fileDescriptor) < 0) {
+                this->writeErrors++;
+            }
+            this->lastSyncTimeNS = nowNS;
+        }
+    }
+}
+
+} /* namespace tids */
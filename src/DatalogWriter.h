@@ -0,0 +1,186 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DATALOGWRITER_H
+#define DATALOGWRITER_H
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AnomalyDetector.h"
+#include "BinaryDatalog.h"
+#include "SPSCRingBuffer.h"
+#include "TelemetryRecord.h"
+
+namespace tids {
+
+// Drains telemetry records from per-producer ring buffers and persists them on a writer thread
+class DatalogWriter {
+public:
+    enum FORMAT {
+        // Human-readable lines of time, channel and value
+        TEXT = 0,
+        // Columnar blocks per channel in CRC-framed records and bounded segments (see BinaryDatalog.h)
+        BINARY = 1,
+    };
+private:
+    std::string filename;
+    int fileDescriptor;
+    DatalogWriter::FORMAT format;
+
+    // Current segment (binary format) and offset of the next byte written to it
+    uint32_t segmentIndex;
+    uint64_t fileOffset;
+    // Size after which a new segment is started, in bytes (0 never rotates)
+    uint64_t segmentSize;
+
+    // Offset, time and number of sync markers in the current segment
+    uint64_t lastSyncMarkerOffset;
+    int64_t lastSyncMarkerTimeNS;
+    uint64_t syncMarkerCount;
+
+    // One ring buffer per producer thread
+    std::vector<SPSCRingBuffer<TelemetryRecord> *> producers;
+    // One anomaly event ring buffer per producer thread, printed by the writer thread
+    std::vector<SPSCRingBuffer<AnomalyEvent> *> anomalyProducers;
+
+    // Formatted output waiting to be written
+    std::vector<char> outputBuffer;
+    size_t outputBufferLength;
+
+    // Open columnar block per channel (binary format)
+    std::vector<int64_t> blockTimeNS[TelemetryRecord::CHANNEL::CHANNEL_COUNT];
+    std::vector<float> blockValue[TelemetryRecord::CHANNEL::CHANNEL_COUNT];
+
+    // Maximum time formatted output is held before being written, in milliseconds
+    int flushIntervalMS;
+    // Time between fsync calls in milliseconds (0 syncs on every write, negative never syncs)
+    int syncIntervalMS;
+    // Time between console echoes of each channel in milliseconds (negative disables echo)
+    int echoIntervalMS;
+    // Time the writer sleeps when all producers are empty, in milliseconds
+    int drainIntervalMS;
+
+    int64_t lastFlushTimeNS;
+    int64_t lastSyncTimeNS;
+    int64_t lastEchoTimeNS[TelemetryRecord::CHANNEL::CHANNEL_COUNT];
+
+    // Offset from monotonic to wall clock time as of the last flush
+    int64_t wallClockOffsetNS;
+
+    // Local time string for the last formatted second
+    std::time_t lastWallTimeS;
+    char wallTimeString[32];
+
+    std::atomic<uint64_t> recordsWritten;
+    std::atomic<uint64_t> writeErrors;
+
+    std::thread writerThread;
+    std::atomic<bool> writerThreadShouldCancel;
+
+public:
+    DatalogWriter(std::string filename, DatalogWriter::FORMAT format=DatalogWriter::FORMAT::TEXT);
+    virtual ~DatalogWriter();
+
+    // Create a ring buffer for a producer thread (only before start)
+    SPSCRingBuffer<TelemetryRecord> *createProducer(size_t capacity);
+
+    // Create an anomaly event ring buffer for a producer thread (only before start)
+    SPSCRingBuffer<AnomalyEvent> *createAnomalyProducer(size_t capacity);
+
+    // Set maximum time formatted output is held before being written
+    int setFlushInterval(int flushIntervalMS);
+
+    // Set time between fsync calls (0 syncs on every write, negative never syncs)
+    int setSyncInterval(int syncIntervalMS);
+
+    // Set time between console echoes of each channel (negative disables echo)
+    int setEchoInterval(int echoIntervalMS);
+
+    // Set size after which a new segment is started (binary format, 0 never rotates)
+    int setSegmentSize(uint64_t segmentSize);
+
+    // Open datalog and start writer thread
+    int start();
+
+    // Drain remaining records, stop writer thread and close datalog
+    int stop();
+
+    // Get number of records dropped because a producer ring buffer was full
+    uint64_t getOverflowCount();
+
+    // Get number of records written to the datalog
+    uint64_t getRecordsWritten();
+
+    // Get number of failed writes or syncs
+    uint64_t getWriteErrors();
+
+private:
+    // Continuously drain producers until cancellation token
+    void drain();
+
+    // Drain each producer once (returns number of records and anomaly events drained)
+    size_t drainProducers();
+
+    // Truncate the latest existing segment to its last complete record and open a new segment after it
+    int openBinaryDatalog();
+
+    // Truncate a segment from an earlier run to its last complete record (returns -1 if it is not a compatible segment)
+    int recoverSegment(const std::string &segmentFilename);
+
+    // Create the current segment and write the binary header and channel schema
+    int openSegment();
+
+    // Write out and sync the current segment, then start the next one
+    void rotateSegment();
+
+    // Encode a sync marker into the output buffer
+    void appendSyncMarker();
+
+    // Format a record into the output buffer as text
+    void formatRecord(const TelemetryRecord &record);
+
+    // Append a record to its channel's open block, sealing the block when full
+    void appendRecordToBlock(const TelemetryRecord &record);
+
+    // Encode a channel's open block into the output buffer
+    void sealBlock(int channel);
+
+    // Copy bytes into the output buffer, writing it out when full
+    void appendOutput(const void *bytes, size_t length);
+
+    // Write the output buffer to the datalog
+    void writeOutput();
+
+    // Print a record to the console if its echo interval has elapsed
+    void echoRecord(const TelemetryRecord &record);
+
+    // Print an anomaly event to the console
+    void printAnomaly(const AnomalyEvent &event);
+
+    // Write buffered output (sealing open blocks) and sync according to policy
+    void flush(bool force);
+};
+
+} /* namespace tids */
+
+#endif /* DATALOGWRITER_H */
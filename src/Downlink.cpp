@@ -0,0 +1,294 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Downlink.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <iostream>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "Clock.h"
+
+namespace tids {
+
+// Interval between collecting new samples and sending packets
+#define DOWNLINK_INTERVAL_MS 100
+
+// Largest packet, kept below the radio link MTU
+#define DOWNLINK_MAX_PACKET_SIZE 512
+
+// IPv4 and UDP header bytes charged against the budget for every packet
+#define DOWNLINK_PACKET_OVERHEAD 28
+
+// Longest time samples are held to fill a packet, in milliseconds
+#define DOWNLINK_MAX_LATENCY_MS 1000
+
+// Longest burst the budget may accumulate, in milliseconds
+#define DOWNLINK_BURST_MS 1000
+
+// Extra history read beyond the new sample count, for samples published while reading
+#define DOWNLINK_HISTORY_MARGIN 64
+
+// Samples held per channel while waiting for budget (older samples are dropped first)
+#define DOWNLINK_PENDING_CAPACITY 4096
+
+Downlink::Downlink(std::string address, int port, int bytesPerSecond) {
+    this->address = address;
+    this->port = port;
+    this->socketDescriptor = -1;
+
+    this->bytesPerSecond = bytesPerSecond;
+    this->tokens = 0.0;
+    this->lastRefillTimeNS = 0;
+
+    this->packet.resize(DOWNLINK_MAX_PACKET_SIZE);
+
+    this->packetsSent = 0;
+    this->bytesSent = 0;
+    this->samplesDropped = 0;
+    this->sendErrors = 0;
+
+    this->downlinkThreadShouldCancel = true;
+}
+
+Downlink::~Downlink() {
+    this->stop();
+    for (Stream *stream : this->streams) {
+        delete stream;
+    }
+}
+
+// Add a channel to the downlink (only before start)
+int Downlink::addChannel(TelemetryChannel *channel, int priority, int decimation, float resolution) {
+    // Streams cannot be added while the downlink thread iterates over them
+    if (!this->downlinkThreadShouldCancel || channel == nullptr || decimation < 1 || !(resolution > 0.0f)) {
+        return -1;
+    }
+
+    Stream *stream = new Stream();
+    stream->channel = channel;
+    stream->apid = static_cast<uint16_t>(DOWNLINK_APID_BASE + channel->getChannel());
+    stream->priority = priority;
+    stream->decimation = decimation;
+    stream->resolution = resolution;
+    stream->lastCount = 0;
+    stream->lastTimeNS = 0;
+    stream->decimationCount = 0;
+    stream->sequenceCount = 0;
+    stream->history.resize(channel->getHistoryCapacity());
+
+    // Keep streams in priority order, preserving insertion order among equals
+    std::vector<Stream *>::iterator position = std::upper_bound(this->streams.begin(), this->streams.end(), stream,
+        [](const Stream *a, const Stream *b) { return a->priority < b->priority; });
+    this->streams.insert(position, stream);
+    return 0;
+}
+
+// Set bandwidth budget in bytes per second
+int Downlink::setBudget(int bytesPerSecond) {
+    if (bytesPerSecond <= 0) {
+        return -1;
+    }
+    this->bytesPerSecond = bytesPerSecond;
+    return 0;
+}
+
+// Open socket and start downlink thread
+int Downlink::start() {
+    // Return if the downlink thread already exists
+    if (!this->downlinkThreadShouldCancel) {
+        return -1;
+    }
+
+    // Open UDP socket to the ground station
+    this->socketDescriptor = socket(AF_INET, SOCK_DGRAM, 0);
+    if (this->socketDescriptor < 0) {
+        std::cout << "Downlink: Error opening socket." << std::endl;
+        return -1;
+    }
+    struct sockaddr_in destination = {};
+    destination.sin_family = AF_INET;
+    destination.sin_port = htons(static_cast<uint16_t>(this->port));
+    if (inet_pton(AF_INET, this->address.c_str(), &destination.sin_addr) != 1
+        || connect(this->socketDescriptor, reinterpret_cast<struct sockaddr *>(&destination), sizeof(destination)) < 0) {
+        std::cout << "Downlink: Error connecting to " << this->address << ":" << this->port << "." << std::endl;
+        close(this->socketDescriptor);
+        this->socketDescriptor = -1;
+        return -1;
+    }
+
+    // Only downlink samples published from now on
+    for (Stream *stream : this->streams) {
+        stream->lastCount = stream->channel->getCount();
+        Sample sample;
+        stream->lastTimeNS = stream->channel->getLatest(&sample) == 0 ? sample.timeNS : 0;
+        stream->pending.clear();
+    }
+    this->tokens = 0.0;
+    this->lastRefillTimeNS = Clock::monotonicNS();
+
+    // Reset cancellation token
+    this->downlinkThreadShouldCancel = false;
+    // Start downlink on new thread
+    this->downlinkThread = std::thread(&Downlink::run, this);
+    return 0;
+}
+
+// Stop downlink thread and close socket
+int Downlink::stop() {
+    // Cancel and join downlink thread
+    this->downlinkThreadShouldCancel = true;
+    if (this->downlinkThread.joinable()) {
+        this->downlinkThread.join();
+    }
+
+    if (this->socketDescriptor >= 0) {
+        close(this->socketDescriptor);
+        this->socketDescriptor = -1;
+    }
+    return 0;
+}
+
+// Get number of packets sent
+uint64_t Downlink::getPacketsSent() {
+    return this->packetsSent;
+}
+
+// Get number of bytes sent (including IP and UDP headers)
+uint64_t Downlink::getBytesSent() {
+    return this->bytesSent;
+}
+
+// Get number of samples dropped because the budget could not keep up
+uint64_t Downlink::getSamplesDropped() {
+    return this->samplesDropped;
+}
+
+// Get number of failed sends
+uint64_t Downlink::getSendErrors() {
+    return this->sendErrors;
+}
+
+// Continuously collect and send samples until cancellation token
+void Downlink::run() {
+    while (!this->downlinkThreadShouldCancel) {
+        for (Stream *stream : this->streams) {
+            this->collect(stream);
+        }
+        this->send();
+        std::this_thread::sleep_for(std::chrono::milliseconds(DOWNLINK_INTERVAL_MS));
+    }
+}
+
+// Move new, decimated samples from a channel's history into its pending queue
+void Downlink::collect(Stream *stream) {
+    uint64_t count = stream->channel->getCount();
+    uint64_t newCount = count - stream->lastCount;
+    if (newCount == 0) {
+        return;
+    }
+    stream->lastCount = count;
+
+    // Samples overwritten in the history before they could be read are lost
+    size_t historyCount = stream->history.size() - 1;
+    if (newCount > historyCount) {
+        this->samplesDropped += newCount - historyCount;
+    }
+
+    // Read a little more than needed, then keep only samples newer than the last one taken
+    size_t readCount = static_cast<size_t>(std::min<uint64_t>(newCount + DOWNLINK_HISTORY_MARGIN, historyCount));
+    size_t copied = stream->channel->getHistory(stream->history.data(), readCount);
+    for (size_t i = 0; i < copied; i++) {
+        const Sample &sample = stream->history[i];
+        if (sample.timeNS <= stream->lastTimeNS) {
+            continue;
+        }
+        stream->lastTimeNS = sample.timeNS;
+        if (stream->decimationCount++ % stream->decimation != 0) {
+            continue;
+        }
+        stream->pending.push_back(sample);
+    }
+
+    // Bound the queue of a starved stream by dropping its oldest samples
+    if (stream->pending.size() > DOWNLINK_PENDING_CAPACITY) {
+        size_t excess = stream->pending.size() - DOWNLINK_PENDING_CAPACITY;
+        stream->pending.erase(stream->pending.begin(), stream->pending.begin() + excess);
+        this->samplesDropped += excess;
+    }
+}
+
+// Send pending samples of every stream in priority order while the budget allows
+void Downlink::send() {
+    // Refill budget, capped at the longest burst but always enough for one full packet
+    int64_t timeNS = Clock::monotonicNS();
+    double burst = std::max(static_cast<double>(this->bytesPerSecond) * DOWNLINK_BURST_MS / 1000,
+                            static_cast<double>(DOWNLINK_MAX_PACKET_SIZE + DOWNLINK_PACKET_OVERHEAD));
+    this->tokens += static_cast<double>(this->bytesPerSecond) * (timeNS - this->lastRefillTimeNS) / 1e9;
+    this->tokens = std::min(this->tokens, burst);
+    this->lastRefillTimeNS = timeNS;
+
+    // Stamp packets with the latest wall clock mapping
+    int64_t wallClockOffsetNS = Clock::getWallClockOffsetNS();
+
+    for (Stream *stream : this->streams) {
+        size_t sent = 0;
+        bool budgetExhausted = false;
+        while (sent < stream->pending.size()) {
+            size_t encodedCount = 0;
+            size_t length = encodeDownlinkPacket(this->packet.data(), this->packet.size(), stream->apid, stream->sequenceCount,
+                                                 wallClockOffsetNS, stream->resolution,
+                                                 stream->pending.data() + sent, stream->pending.size() - sent, &encodedCount);
+            if (length == 0) {
+                break;
+            }
+
+            // Hold a partly filled packet so header overhead is amortized, unless its oldest sample is due
+            bool partial = encodedCount == stream->pending.size() - sent;
+            if (partial && stream->pending[sent].timeNS > timeNS - static_cast<int64_t>(DOWNLINK_MAX_LATENCY_MS) * 1000000) {
+                break;
+            }
+
+            // Lower priority streams wait until higher priority streams are drained
+            if (length + DOWNLINK_PACKET_OVERHEAD > this->tokens) {
+                budgetExhausted = true;
+                break;
+            }
+
+            if (::send(this->socketDescriptor, this->packet.data(), length, 0) < 0) {
+                this->sendErrors++;
+            } else {
+                this->packetsSent++;
+                this->bytesSent += length + DOWNLINK_PACKET_OVERHEAD;
+            }
+            this->tokens -= length + DOWNLINK_PACKET_OVERHEAD;
+            stream->sequenceCount = (stream->sequenceCount + 1) & DOWNLINK_SEQUENCE_COUNT_MAX;
+            sent += encodedCount;
+        }
+        stream->pending.erase(stream->pending.begin(), stream->pending.begin() + sent);
+        if (budgetExhausted) {
+            break;
+        }
+    }
+}
+
+} /* namespace tids */
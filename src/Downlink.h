@@ -0,0 +1,122 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DOWNLINK_H
+#define DOWNLINK_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DownlinkPacket.h"
+#include "SampleSlot.h"
+#include "TelemetryChannel.h"
+
+namespace tids {
+
+// Streams channel history to the ground station as delta-encoded packets within a bandwidth budget
+class Downlink {
+private:
+    // Downlink state of one channel
+    struct Stream {
+        TelemetryChannel *channel;
+        uint16_t apid;
+        // Lower values are sent first when the budget is short
+        int priority;
+        // Only every decimation-th sample is sent
+        int decimation;
+        // Channel units per quantum
+        float resolution;
+
+        uint64_t lastCount;
+        int64_t lastTimeNS;
+        uint64_t decimationCount;
+        uint16_t sequenceCount;
+
+        // Samples waiting for budget, and scratch space for reading history
+        std::vector<Sample> pending;
+        std::vector<Sample> history;
+    };
+
+    std::string address;
+    int port;
+    int socketDescriptor;
+
+    // Bandwidth budget in bytes per second (including IP and UDP headers)
+    int bytesPerSecond;
+    double tokens;
+    int64_t lastRefillTimeNS;
+
+    // Streams in priority order
+    std::vector<Stream *> streams;
+
+    std::vector<uint8_t> packet;
+
+    std::atomic<uint64_t> packetsSent;
+    std::atomic<uint64_t> bytesSent;
+    std::atomic<uint64_t> samplesDropped;
+    std::atomic<uint64_t> sendErrors;
+
+    std::thread downlinkThread;
+    std::atomic<bool> downlinkThreadShouldCancel;
+
+public:
+    Downlink(std::string address, int port, int bytesPerSecond);
+    virtual ~Downlink();
+
+    // Add a channel to the downlink (only before start)
+    int addChannel(TelemetryChannel *channel, int priority, int decimation, float resolution);
+
+    // Set bandwidth budget in bytes per second
+    int setBudget(int bytesPerSecond);
+
+    // Open socket and start downlink thread
+    int start();
+
+    // Stop downlink thread and close socket
+    int stop();
+
+    // Get number of packets sent
+    uint64_t getPacketsSent();
+
+    // Get number of bytes sent (including IP and UDP headers)
+    uint64_t getBytesSent();
+
+    // Get number of samples dropped because the budget could not keep up
+    uint64_t getSamplesDropped();
+
+    // Get number of failed sends
+    uint64_t getSendErrors();
+
+private:
+    // Continuously collect and send samples until cancellation token
+    void run();
+
+    // Move new, decimated samples from a channel's history into its pending queue
+    void collect(Stream *stream);
+
+    // Send pending samples of every stream in priority order while the budget allows
+    void send();
+};
+
+} /* namespace tids */
+
+#endif /* DOWNLINK_H */
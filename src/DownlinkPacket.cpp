@@ -0,0 +1,219 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "DownlinkPacket.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace tids {
+
+// Largest encoded size of one sample (two 64-bit varints)
+#define SAMPLE_MAX_ENCODED_SIZE 20
+
+// Largest encoded size of the sample count
+#define SAMPLE_COUNT_MAX_ENCODED_SIZE 10
+
+// Largest magnitude of a quantized value, kept well inside int64 so deltas cannot overflow
+#define QUANTIZED_VALUE_LIMIT 4611686018427387903LL
+
+// Map a signed integer to an unsigned integer with small magnitudes near zero
+static uint64_t zigzagEncode(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+static int64_t zigzagDecode(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 0x1);
+}
+
+// Append an unsigned LEB128 varint (returns number of bytes written)
+static size_t writeVarint(uint8_t *bytes, uint64_t value) {
+    size_t length = 0;
+    while (value >= 0x80) {
+        bytes[length++] = static_cast<uint8_t>(value | 0x80);
+        value >>= 7;
+    }
+    bytes[length++] = static_cast<uint8_t>(value);
+    return length;
+}
+
+// Read an unsigned LEB128 varint (returns number of bytes read, or 0 if truncated or too long)
+static size_t readVarint(const uint8_t *bytes, size_t length, uint64_t *value) {
+    uint64_t result = 0;
+    for (size_t i = 0; i < length && i < 10; i++) {
+        result |= static_cast<uint64_t>(bytes[i] & 0x7F) << (7 * i);
+        if ((bytes[i] & 0x80) == 0) {
+            *value = result;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+static void writeBigEndian(uint8_t *bytes, uint64_t value, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        bytes[i] = static_cast<uint8_t>(value >> (8 * (length - 1 - i)));
+    }
+}
+
+static uint64_t readBigEndian(const uint8_t *bytes, size_t length) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < length; i++) {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+// Quantize a value to a whole number of resolution steps (non-finite values become zero)
+static int64_t quantize(float value, float resolution) {
+    double quanta = std::round(static_cast<double>(value) / resolution);
+    if (!std::isfinite(quanta)) {
+        return 0;
+    }
+    if (quanta > QUANTIZED_VALUE_LIMIT) {
+        return QUANTIZED_VALUE_LIMIT;
+    }
+    if (quanta < -QUANTIZED_VALUE_LIMIT) {
+        return -QUANTIZED_VALUE_LIMIT;
+    }
+    return static_cast<int64_t>(quanta);
+}
+
+// Encode as many samples as fit in maxSize bytes into a packet (returns packet length, or 0 on error)
+// Sample times are converted to wall clock time with wallClockOffsetNS, and the number of samples encoded is returned in encodedCount
+size_t encodeDownlinkPacket(uint8_t *packet, size_t maxSize, uint16_t apid, uint16_t sequenceCount,
+                            int64_t wallClockOffsetNS, float resolution,
+                            const Sample *samples, size_t sampleCount, size_t *encodedCount) {
+    *encodedCount = 0;
+    size_t headerSize = DOWNLINK_PRIMARY_HEADER_SIZE + DOWNLINK_SECONDARY_HEADER_SIZE;
+    if (sampleCount == 0 || apid > DOWNLINK_APID_MAX || !(resolution > 0.0f)
+        || maxSize < headerSize + SAMPLE_COUNT_MAX_ENCODED_SIZE + SAMPLE_MAX_ENCODED_SIZE
+        || maxSize > headerSize + 0x10000) {
+        return 0;
+    }
+
+    // Encode samples first, leaving room for the sample count
+    uint8_t *sampleBytes = packet + headerSize + SAMPLE_COUNT_MAX_ENCODED_SIZE;
+    size_t sampleLength = 0;
+    size_t sampleCapacity = maxSize - headerSize - SAMPLE_COUNT_MAX_ENCODED_SIZE;
+    int64_t firstTimeNS = samples[0].timeNS;
+    int64_t previousOffsetUS = 0;
+    int64_t previousQuanta = 0;
+    size_t count = 0;
+    while (count < sampleCount && sampleLength + SAMPLE_MAX_ENCODED_SIZE <= sampleCapacity) {
+        // Offsets from the first sample do not accumulate rounding error
+        int64_t offsetUS = (samples[count].timeNS - firstTimeNS) / 1000;
+        int64_t quanta = quantize(samples[count].value, resolution);
+        sampleLength += writeVarint(sampleBytes + sampleLength, zigzagEncode(offsetUS - previousOffsetUS));
+        sampleLength += writeVarint(sampleBytes + sampleLength, zigzagEncode(quanta - previousQuanta));
+        previousOffsetUS = offsetUS;
+        previousQuanta = quanta;
+        count++;
+    }
+
+    // Move samples up against the sample count
+    uint8_t countBytes[SAMPLE_COUNT_MAX_ENCODED_SIZE];
+    size_t countLength = writeVarint(countBytes, count);
+    memcpy(packet + headerSize, countBytes, countLength);
+    memmove(packet + headerSize + countLength, sampleBytes, sampleLength);
+    size_t dataLength = DOWNLINK_SECONDARY_HEADER_SIZE + countLength + sampleLength;
+
+    // Primary header
+    writeBigEndian(packet, (0x1 << 11) | apid, 2);
+    writeBigEndian(packet + 2, (0x3 << 14) | (sequenceCount & DOWNLINK_SEQUENCE_COUNT_MAX), 2);
+    writeBigEndian(packet + 4, dataLength - 1, 2);
+
+    // Secondary header
+    uint32_t resolutionBits;
+    memcpy(&resolutionBits, &resolution, sizeof(resolutionBits));
+    writeBigEndian(packet + DOWNLINK_PRIMARY_HEADER_SIZE, static_cast<uint64_t>(firstTimeNS + wallClockOffsetNS), 8);
+    writeBigEndian(packet + DOWNLINK_PRIMARY_HEADER_SIZE + 8, resolutionBits, 4);
+
+    *encodedCount = count;
+    return DOWNLINK_PRIMARY_HEADER_SIZE + dataLength;
+}
+
+// Decode a packet into its header and samples stamped with wall clock time (returns -1 if malformed)
+int decodeDownlinkPacket(const uint8_t *packet, size_t length, DownlinkPacketHeader *header, std::vector<Sample> *samples) {
+    samples->clear();
+    if (length < DOWNLINK_PRIMARY_HEADER_SIZE + DOWNLINK_SECONDARY_HEADER_SIZE) {
+        return -1;
+    }
+
+    // Primary header
+    uint16_t identification = static_cast<uint16_t>(readBigEndian(packet, 2));
+    uint16_t sequence = static_cast<uint16_t>(readBigEndian(packet + 2, 2));
+    size_t dataLength = static_cast<size_t>(readBigEndian(packet + 4, 2)) + 1;
+    if ((identification >> 13) != 0 || ((identification >> 12) & 0x1) != 0 || ((identification >> 11) & 0x1) != 1) {
+        return -1;
+    }
+    if (DOWNLINK_PRIMARY_HEADER_SIZE + dataLength != length) {
+        return -1;
+    }
+    header->apid = identification & DOWNLINK_APID_MAX;
+    header->sequenceCount = sequence & DOWNLINK_SEQUENCE_COUNT_MAX;
+
+    // Secondary header
+    uint32_t resolutionBits = static_cast<uint32_t>(readBigEndian(packet + DOWNLINK_PRIMARY_HEADER_SIZE + 8, 4));
+    header->timeNS = static_cast<int64_t>(readBigEndian(packet + DOWNLINK_PRIMARY_HEADER_SIZE, 8));
+    memcpy(&header->resolution, &resolutionBits, sizeof(header->resolution));
+
+    // User data
+    const uint8_t *bytes = packet + DOWNLINK_PRIMARY_HEADER_SIZE + DOWNLINK_SECONDARY_HEADER_SIZE;
+    size_t remaining = length - DOWNLINK_PRIMARY_HEADER_SIZE - DOWNLINK_SECONDARY_HEADER_SIZE;
+    uint64_t count;
+    size_t used = readVarint(bytes, remaining, &count);
+    if (used == 0 || count > remaining) {
+        return -1;
+    }
+    bytes += used;
+    remaining -= used;
+
+    samples->reserve(static_cast<size_t>(count));
+    int64_t offsetUS = 0;
+    int64_t quanta = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t offsetDelta;
+        uint64_t quantaDelta;
+        used = readVarint(bytes, remaining, &offsetDelta);
+        if (used == 0) {
+            return -1;
+        }
+        bytes += used;
+        remaining -= used;
+        used = readVarint(bytes, remaining, &quantaDelta);
+        if (used == 0) {
+            return -1;
+        }
+        bytes += used;
+        remaining -= used;
+
+        offsetUS += zigzagDecode(offsetDelta);
+        quanta += zigzagDecode(quantaDelta);
+        Sample sample;
+        sample.timeNS = header->timeNS + offsetUS * 1000;
+        sample.value = static_cast<float>(quanta * static_cast<double>(header->resolution));
+        samples->push_back(sample);
+    }
+    if (remaining != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+} /* namespace tids */
@@ -0,0 +1,75 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DOWNLINKPACKET_H
+#define DOWNLINKPACKET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "SampleSlot.h"
+
+namespace tids {
+
+// Downlink packets follow the CCSDS space packet structure, with one channel per application process
+//
+//   Primary header (6 bytes, big-endian, CCSDS 133.0-B)
+//     version (3 bits, 0) | type (1 bit, 0 = telemetry) | secondary header flag (1 bit, 1) | APID (11 bits)
+//     sequence flags (2 bits, 3 = unsegmented) | sequence count (14 bits, per APID)
+//     packet data length (16 bits, data field length minus one)
+//   Secondary header (12 bytes, big-endian)
+//     first sample time (int64, nanoseconds since the Unix epoch)
+//     value resolution (float32, channel units per quantum)
+//   User data
+//     sample count (varint)
+//     per sample: time offset from the first sample in microseconds, delta from the previous sample (zigzag varint)
+//                 value in quanta, delta from the previous sample starting from zero (zigzag varint)
+
+#define DOWNLINK_PRIMARY_HEADER_SIZE 6
+#define DOWNLINK_SECONDARY_HEADER_SIZE 12
+
+// Application process identifier of channel 0 (channel n uses DOWNLINK_APID_BASE + n)
+#define DOWNLINK_APID_BASE 0x100
+
+// Largest APID and sequence count representable in the primary header
+#define DOWNLINK_APID_MAX 0x7FF
+#define DOWNLINK_SEQUENCE_COUNT_MAX 0x3FFF
+
+// Decoded primary and secondary header fields
+struct DownlinkPacketHeader {
+    uint16_t apid;
+    uint16_t sequenceCount;
+    // Time of the first sample in nanoseconds since the Unix epoch
+    int64_t timeNS;
+    // Channel units per quantum
+    float resolution;
+};
+
+// Encode as many samples as fit in maxSize bytes into a packet (returns packet length, or 0 on error)
+// Sample times are converted to wall clock time with wallClockOffsetNS, and the number of samples encoded is returned in encodedCount
+size_t encodeDownlinkPacket(uint8_t *packet, size_t maxSize, uint16_t apid, uint16_t sequenceCount,
+                            int64_t wallClockOffsetNS, float resolution,
+                            const Sample *samples, size_t sampleCount, size_t *encodedCount);
+
+// Decode a packet into its header and samples stamped with wall clock time (returns -1 if malformed)
+int decodeDownlinkPacket(const uint8_t *packet, size_t length, DownlinkPacketHeader *header, std::vector<Sample> *samples);
+
+} /* namespace tids */
+
+#endif /* DOWNLINKPACKET_H */
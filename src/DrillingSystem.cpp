@@ -19,11 +19,68 @@
 #include "DrillingSystem.h"
 
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#include "Clock.h"
 
 namespace tids {
 
-#define ENCODER_COUNTS_PER_REVOLUTION 1024.0
-#define ENCODER_PULSES_PER_REVOLUTION (ENCODER_COUNTS_PER_REVOLUTION / 4)
+#define ENCODER_COUNTS_PER_REVOLUTION 1024
+
+// Speed estimation window, growing from the minimum at low speed until it holds enough edges
+#define SPEED_WINDOW_MIN_MS 10
+#define SPEED_WINDOW_MAX_MS 500
+#define SPEED_WINDOW_MIN_EDGES 16
+
+// Encoder edge timestamp uncertainty with kernel timestamps and with timestamps taken after waking
+#define ENCODER_KERNEL_TIMESTAMP_JITTER_US 5
+#define ENCODER_WAKE_TIMESTAMP_JITTER_US 100
+
+// Edges moved from the decoder to the speed estimator at once
+#define SPEED_EDGE_BATCH_SIZE 256
+
+// Nominal drill motor model until calibrated
+#define DRILL_MOTOR_RESISTANCE_OHM 1.0f
+#define DRILL_MOTOR_BACK_EMF_CONSTANT 0.45f
+#define DRILL_MOTOR_NO_LOAD_CURRENT_A 0.5f
+#define DRILL_MOTOR_VISCOUS_CURRENT_A_PER_RAD_S 0.0f
+
+// Motor model calibration sweep: speed steps, time to settle at each, and time averaged at each
+#define CALIBRATION_STEP_COUNT 10
+#define CALIBRATION_SETTLE_MS 2000
+#define CALIBRATION_AVERAGE_MS 1000
+#define CALIBRATION_SAMPLE_INTERVAL_MS 10
+
+// Longest rotation to the encoder index
+#define ROTATE_TO_INDEX_TIMEOUT_MS 10000
+
+// Index alignment: seek speed, counts over which speed ramps down to the minimum, counts between speed updates,
+// and shortest distance to the target index
+#define INDEX_SEEK_SPEED_PERCENT 15.0f
+#define INDEX_APPROACH_COUNTS 256
+#define INDEX_RAMP_STEP_COUNTS 16
+#define INDEX_MIN_LEAD_COUNTS 32
+
+// Counts turned at the start to learn the encoder direction
+#define INDEX_DIRECTION_COUNTS 4
+
+// Alignment tolerance (about one degree), and smoothing factor of the learned coast after a stop
+#define INDEX_TOLERANCE_COUNTS 3
+#define INDEX_COAST_ALPHA 0.5f
+
+// Drill is settled once the position holds this long
+#define INDEX_SETTLE_MS 100
+
+// Undershoot trim pulses at minimum speed
+#define INDEX_TRIM_PULSE_MS 50
+#define INDEX_TRIM_MAX_PULSES 5
 
 #define DRILL_VOLTAGE 90.0f
 
@@ -34,86 +91,421 @@ namespace tids {
 #define TORQUE_MIN_NM 8.0f    
 #define TORQUE_MAX_NM 10.0f
 
-const double PI = 3.14159265358979323846;
+// Drill current and speed sampling period and deadline
+#define SENSOR_PERIOD_MS 10
+#define SENSOR_DEADLINE_MS 5
+
+// Speed regulation period and deadline
+#define REGULATE_SPEED_PERIOD_MS 100
+#define REGULATE_SPEED_DEADLINE_MS 50
+
+// PID torque control rate, and torque setpoint in the middle of the legacy band
+#define CONTROL_RATE_HZ 1000
+#define TORQUE_SETPOINT_NM 9.0f
+
+// Stall trip limits: immediate current and torque limits, current slope and deceleration extrapolated over the horizon
+// while the bit is loaded (the 400 W motor draws about 4.4 A at rated load)
+#define STALL_CURRENT_A 9.0f
+#define STALL_TORQUE_NM 14.0f
+#define STALL_CURRENT_SLOPE_A_PER_S 40.0f
+#define STALL_PREDICTION_HORIZON_MS 50
+#define STALL_DECELERATION_RPM_PER_S 2000.0f
+#define STALL_WEIGHT_ON_BIT_KG 1.0f
+
+// Trips are ignored while the drill accelerates after a start
+#define STALL_START_BLANKING_MS 500
+
+// Samples kept before and recorded after each trip
+#define STALL_HISTORY_CAPACITY 1024
+#define STALL_POST_TRIGGER_COUNT 256
+
+// Commanded speed fed forward to the PID controller output
+#define COMMANDED_SPEED_PERCENT 25.0f
 
-DrillingSystem::DrillingSystem(bbbkit::DCMotor *motor, MMPEU *encoder, LTS6NP *currentSensor) {
+// Default PID torque controller gains (output in speed percent, error in Nm), replaceable at runtime
+#define TORQUE_CONTROL_KP 2.0f
+#define TORQUE_CONTROL_KI 10.0f
+#define TORQUE_CONTROL_KD 0.02f
+#define TORQUE_CONTROL_DERIVATIVE_FILTER_S 0.01f
+#define TORQUE_CONTROL_KFF 1.0f
+#define TORQUE_CONTROL_RATE_LIMIT_PERCENT_PER_S 200.0f
+
+const float PI = 3.14159265358979323846f;
+
+DrillingSystem::DrillingSystem(bbbkit::DCMotor *motor, MMPEU *encoder, LTS6NP *currentSensor, TelemetrySystem *telemetrySystem) {
     this->motor = motor;
     this->encoder = encoder;
     this->currentSensor = currentSensor;
-    this->regulateSpeedThreadShouldCancel = true;
-
-    // Reset encoder trigger time and speed
+    this->telemetrySystem = telemetrySystem;
+    this->regulateSpeedTaskId = -1;
+    this->controlMode = CONTROL_MODE::PID;
+    this->controlRateHz = CONTROL_RATE_HZ;
+    this->torqueSetpointNM = TORQUE_SETPOINT_NM;
+    this->commandedSpeedPercent = COMMANDED_SPEED_PERCENT;
+    this->controlThreadShouldCancel = true;
+    this->controlOverrunCount = 0;
+
+    PIDGains gains;
+    gains.kp = TORQUE_CONTROL_KP;
+    gains.ki = TORQUE_CONTROL_KI;
+    gains.kd = TORQUE_CONTROL_KD;
+    gains.derivativeFilterS = TORQUE_CONTROL_DERIVATIVE_FILTER_S;
+    gains.kff = TORQUE_CONTROL_KFF;
+    gains.outputMin = SPEED_MIN_PERCENT;
+    gains.outputMax = SPEED_MAX_PERCENT;
+    gains.outputRateLimit = TORQUE_CONTROL_RATE_LIMIT_PERCENT_PER_S;
+    this->torqueController = new PIDController(gains);
+
+    StallThresholds thresholds;
+    thresholds.currentA = STALL_CURRENT_A;
+    thresholds.torqueNM = STALL_TORQUE_NM;
+    thresholds.currentSlopeAPerS = STALL_CURRENT_SLOPE_A_PER_S;
+    thresholds.predictionHorizonS = STALL_PREDICTION_HORIZON_MS / 1000.0f;
+    thresholds.decelerationRPMPerS = STALL_DECELERATION_RPM_PER_S;
+    thresholds.weightOnBitKg = STALL_WEIGHT_ON_BIT_KG;
+    this->stallDetector = new StallDetector(thresholds, STALL_HISTORY_CAPACITY, STALL_POST_TRIGGER_COUNT);
+
+    // Track encoder position for as long as the drilling system exists
+    this->decoder = new QuadratureDecoder(encoder, ENCODER_COUNTS_PER_REVOLUTION);
+    this->decoder->start();
+    this->speedEstimator = new SpeedEstimator(ENCODER_COUNTS_PER_REVOLUTION,
+                                              static_cast<int64_t>(SPEED_WINDOW_MIN_MS) * 1000000,
+                                              static_cast<int64_t>(SPEED_WINDOW_MAX_MS) * 1000000,
+                                              SPEED_WINDOW_MIN_EDGES);
+    int64_t jitterUS = this->decoder->hasKernelTimestamps() ? ENCODER_KERNEL_TIMESTAMP_JITTER_US : ENCODER_WAKE_TIMESTAMP_JITTER_US;
+    this->speedEstimator->setTimestampJitterNS(jitterUS * 1000);
     this->resetSpeed();
+
+    MotorModel model;
+    model.resistanceOhm = DRILL_MOTOR_RESISTANCE_OHM;
+    model.backEMFConstant = DRILL_MOTOR_BACK_EMF_CONSTANT;
+    model.noLoadCurrentA = DRILL_MOTOR_NO_LOAD_CURRENT_A;
+    model.viscousCurrentAPerRadS = DRILL_MOTOR_VISCOUS_CURRENT_A_PER_RAD_S;
+    this->torqueEstimator = new TorqueEstimator(model, DRILL_VOLTAGE);
+    this->lastTorqueUpdateNS = 0;
+
+    this->indexCoastCounts = 0.0f;
+    this->indexAlignment = IndexAlignment();
+
+    // Sample drill current and speed on the telemetry scheduler
+    this->telemetrySystem->registerChannel(TelemetryRecord::CHANNEL::DRILL_CURRENT,
+                                           static_cast<int64_t>(SENSOR_PERIOD_MS) * 1000000,
+                                           static_cast<int64_t>(SENSOR_DEADLINE_MS) * 1000000,
+                                           [currentSensor]() { return currentSensor->getCurrent(); });
+    this->telemetrySystem->registerChannel(TelemetryRecord::CHANNEL::DRILL_SPEED,
+                                           static_cast<int64_t>(SENSOR_PERIOD_MS) * 1000000,
+                                           static_cast<int64_t>(SENSOR_DEADLINE_MS) * 1000000,
+                                           [this]() { return this->updateSpeed(); });
 }
 
 DrillingSystem::~DrillingSystem() {
     this->stop();
+    delete this->decoder;
+    delete this->speedEstimator;
+    delete this->torqueController;
+    delete this->torqueEstimator;
+    delete this->stallDetector;
 }
 
 // Start drill and automatically adjust speed based on torque
 int DrillingSystem::start() {
-    // Return if the speed regulation thread already exists
-    if (!this->regulateSpeedThreadShouldCancel) {
+    // Return if speed regulation is already running
+    if (this->regulateSpeedTaskId >= 0 || !this->controlThreadShouldCancel) {
         return -1;
     }
 
-    // Start encoder trigger thread to calculate speed
-    this->encoder->getGPIOA()->setEdgeType(bbbkit::GPIO::EDGE::RISING);
-    this->encoder->getGPIOA()->waitForEdgeThread((bbbkit::CallbackFunction_t)&DrillingSystem::updateSpeed);
-
     // Start drill at minimum speed
     this->motor->setSpeedPercent(SPEED_MIN_PERCENT);
     this->motor->start();
 
-    // Reset cancellation token
-    this->regulateSpeedThreadShouldCancel = false;
-    // Start speed regulation on new thread
-    this->regulateSpeedThread = std::thread(&DrillingSystem::regulateSpeed, this);
+    if (this->controlMode == CONTROL_MODE::LEGACY) {
+        // Start speed regulation on the telemetry scheduler
+        this->regulateSpeedTaskId = this->telemetrySystem->getScheduler()->addTask("regulate_speed",
+                                        static_cast<int64_t>(REGULATE_SPEED_PERIOD_MS) * 1000000,
+                                        static_cast<int64_t>(REGULATE_SPEED_DEADLINE_MS) * 1000000,
+                                        [this](int64_t releaseTimeNS) { (void)releaseTimeNS; this->regulateSpeed(); });
+    } else {
+        // Regulate torque from the current speed
+        this->torqueController->reset(SPEED_MIN_PERCENT);
+    }
+
+    // Watch for stalls (and regulate torque in PID mode) on new thread
+    this->stallDetector->rearm(Clock::monotonicNS(), static_cast<int64_t>(STALL_START_BLANKING_MS) * 1000000);
+    this->controlThreadShouldCancel = false;
+    this->controlThread = std::thread(&DrillingSystem::control, this);
 
     return 0;
 }
 
 // Stop drill
 int DrillingSystem::stop() {
-    // Cancel and join speed regulation thread
-    this->regulateSpeedThreadShouldCancel = true;
-    this->regulateSpeedThread.join();
+    // Remove speed regulation task
+    if (this->regulateSpeedTaskId >= 0) {
+        this->telemetrySystem->getScheduler()->removeTask(this->regulateSpeedTaskId);
+        this->regulateSpeedTaskId = -1;
+    }
 
-    // Stop encoder trigger thread
-    this->encoder->getGPIOA()->stopWaitForEdgeThread();
+    // Join torque control thread
+    this->controlThreadShouldCancel = true;
+    if (this->controlThread.joinable()) {
+        this->controlThread.join();
+    }
 
     // Stop drill
     this->motor->stop();
 
-    // Reset encoder trigger time and speed
+    // Reset speed
     this->resetSpeed();
 
     return 0;
 }
 
-// Rotate drill until index location on encoder
+// Rotate drill until index location on encoder, ramping down on approach (returns -1 on timeout or if not within tolerance)
 int DrillingSystem::rotateToIndex() {
-    // Start dtill at minimum speed
-    this->motor->setSpeedPercent(SPEED_MIN_PERCENT);
+    // Return if the drill is running
+    if (this->regulateSpeedTaskId >= 0 || !this->controlThreadShouldCancel) {
+        return -1;
+    }
+
+    IndexAlignment alignment = IndexAlignment();
+    int64_t startNS = Clock::monotonicNS();
+    int64_t deadlineNS = startNS + static_cast<int64_t>(ROTATE_TO_INDEX_TIMEOUT_MS) * 1000000;
+    const int64_t countsPerRevolution = this->decoder->getCountsPerRevolution();
+
+    // Start drill at seek speed
+    this->motor->setSpeedPercent(INDEX_SEEK_SPEED_PERCENT);
     this->motor->start();
 
-    // Run until encoder notifies index location
-    while (!encoder->isAtIndex()) {}
+    // Learn the direction the encoder counts in from the first few counts (the wait also returns on an index pulse, which
+    // can come before any count when the bit starts parked on the index, so wait again until the counts are there)
+    int64_t startPosition = this->decoder->getPosition();
+    while (std::llabs(this->decoder->getPosition() - startPosition) < INDEX_DIRECTION_COUNTS) {
+        int64_t remainingNS = deadlineNS - Clock::monotonicNS();
+        if (remainingNS <= 0 ||
+            this->decoder->waitForPosition(startPosition - INDEX_DIRECTION_COUNTS, startPosition + INDEX_DIRECTION_COUNTS, remainingNS) < 0) {
+            this->motor->stop();
+            std::cout << "DrillingSystem: Error timed out rotating to index, drill not turning" << std::endl;
+            return -1;
+        }
+    }
+    int64_t direction = (this->decoder->getPosition() >= startPosition) ? 1 : -1;
+
+    // Find the index if it has not been seen yet (woken only by the index pulse)
+    int64_t indexPosition;
+    while (this->decoder->getIndexPosition(&indexPosition) < 0) {
+        int64_t remainingNS = deadlineNS - Clock::monotonicNS();
+        if (remainingNS <= 0) {
+            this->motor->stop();
+            std::cout << "DrillingSystem: Error timed out rotating to index, no index pulse" << std::endl;
+            return -1;
+        }
+        this->decoder->waitForPosition(std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max(), remainingNS);
+    }
+
+    // Target the first index position far enough ahead to coast to it
+    int32_t coastCounts = static_cast<int32_t>(std::lround(this->indexCoastCounts.load()));
+    int64_t position = this->decoder->getPosition();
+    int64_t ahead = direction * (position - indexPosition) + coastCounts + INDEX_MIN_LEAD_COUNTS;
+    int64_t targetPosition = indexPosition + direction * ((ahead + countsPerRevolution - 1) / countsPerRevolution) * countsPerRevolution;
+    int64_t stopPosition = targetPosition - direction * coastCounts;
+
+    // Ramp speed down over the approach, re-evaluating at each step of counts, until the stop position or (without a
+    // learned coast) the index pulse itself
+    uint64_t startIndexCount = this->decoder->getIndexCount();
+    while (true) {
+        position = this->decoder->getPosition();
+        int64_t remainingCounts = direction * (stopPosition - position);
+        bool indexReached = coastCounts == 0 && this->decoder->getIndexCount() != startIndexCount &&
+                            this->decoder->getIndexPosition(&indexPosition) == 0 &&
+                            std::llabs(indexPosition - targetPosition) <= INDEX_TOLERANCE_COUNTS;
+        if (remainingCounts <= 0 || indexReached) {
+            break;
+        }
 
-    // Stop drill
+        float ramp = std::min(static_cast<float>(remainingCounts) / INDEX_APPROACH_COUNTS, 1.0f);
+        this->motor->setSpeedPercent(SPEED_MIN_PERCENT + (INDEX_SEEK_SPEED_PERCENT - SPEED_MIN_PERCENT) * ramp);
+
+        int64_t stepCounts = std::min<int64_t>(remainingCounts, INDEX_RAMP_STEP_COUNTS);
+        int64_t nextPosition = position + direction * stepCounts;
+        int64_t remainingNS = deadlineNS - Clock::monotonicNS();
+        int64_t lowPosition = (direction > 0) ? std::numeric_limits<int64_t>::min() : nextPosition;
+        int64_t highPosition = (direction > 0) ? nextPosition : std::numeric_limits<int64_t>::max();
+        if (remainingNS <= 0 || this->decoder->waitForPosition(lowPosition, highPosition, remainingNS) < 0) {
+            this->motor->stop();
+            std::cout << "DrillingSystem: Error timed out approaching index" << std::endl;
+            return -1;
+        }
+    }
     this->motor->stop();
 
+    // Learn how far the drill coasts after the stop, for the next alignment
+    position = this->waitForSettle();
+    float coast = static_cast<float>(direction * (position - stopPosition));
+    if (coast >= 0.0f) {
+        this->indexCoastCounts = this->indexCoastCounts + INDEX_COAST_ALPHA * (coast - this->indexCoastCounts);
+    }
+
+    // Trim an undershoot with short pulses at minimum speed (the drill motor only turns one way, so an overshoot stays)
+    this->decoder->getIndexPosition(&indexPosition);
+    alignment.errorCounts = static_cast<int32_t>(this->getIndexError(position, indexPosition, direction));
+    while (alignment.errorCounts < -INDEX_TOLERANCE_COUNTS && alignment.trimPulseCount < INDEX_TRIM_MAX_PULSES) {
+        int64_t trimTargetPosition = position - direction * alignment.errorCounts;
+        this->motor->setSpeedPercent(SPEED_MIN_PERCENT);
+        this->motor->start();
+        int64_t lowPosition = (direction > 0) ? std::numeric_limits<int64_t>::min() : trimTargetPosition;
+        int64_t highPosition = (direction > 0) ? trimTargetPosition : std::numeric_limits<int64_t>::max();
+        this->decoder->waitForPosition(lowPosition, highPosition, static_cast<int64_t>(INDEX_TRIM_PULSE_MS) * 1000000);
+        this->motor->stop();
+        alignment.trimPulseCount++;
+
+        position = this->waitForSettle();
+        this->decoder->getIndexPosition(&indexPosition);
+        alignment.errorCounts = static_cast<int32_t>(this->getIndexError(position, indexPosition, direction));
+    }
+
+    // Report alignment
+    alignment.errorDegrees = alignment.errorCounts * 360.0f / countsPerRevolution;
+    alignment.durationNS = Clock::monotonicNS() - startNS;
+    alignment.coastCounts = static_cast<int32_t>(coast);
+    alignment.aligned = std::abs(alignment.errorCounts) <= INDEX_TOLERANCE_COUNTS;
+    this->indexAlignment = alignment;
+    std::cout << "DrillingSystem: Index alignment error " << alignment.errorCounts << " counts (" << alignment.errorDegrees
+              << " degrees) in " << alignment.durationNS / 1000000 << " ms, coasted " << alignment.coastCounts
+              << " counts, " << alignment.trimPulseCount << " trim pulses" << std::endl;
+
+    return alignment.aligned ? 0 : -1;
+}
+
+// Get result of the latest index alignment (returns -1 if none has completed)
+int DrillingSystem::getIndexAlignment(IndexAlignment *alignment) {
+    if (this->indexAlignment.durationNS == 0) {
+        return -1;
+    }
+    *alignment = this->indexAlignment;
+    return 0;
+}
+
+// Set torque control mode (only while stopped)
+int DrillingSystem::setControlMode(CONTROL_MODE controlMode) {
+    if (this->regulateSpeedTaskId >= 0 || !this->controlThreadShouldCancel) {
+        return -1;
+    }
+    this->controlMode = controlMode;
+    return 0;
+}
+
+// Get torque control mode
+DrillingSystem::CONTROL_MODE DrillingSystem::getControlMode() {
+    return this->controlMode;
+}
+
+// Set control rate in hertz (only while stopped)
+int DrillingSystem::setControlRate(int controlRateHz) {
+    if (controlRateHz <= 0 || !this->controlThreadShouldCancel) {
+        return -1;
+    }
+    this->controlRateHz = controlRateHz;
     return 0;
 }
 
+// Set torque the PID controller regulates to in Nm
+void DrillingSystem::setTorqueSetpoint(float torqueNM) {
+    this->torqueSetpointNM = torqueNM;
+}
+
+// Set commanded speed in percent, fed forward to the PID controller output
+void DrillingSystem::setCommandedSpeed(float speedPercent) {
+    this->commandedSpeedPercent = speedPercent;
+}
+
+// Get PID torque controller, e.g. to load gains
+PIDController *DrillingSystem::getTorqueController() {
+    return this->torqueController;
+}
+
+// Get control thread wake-up latency
+LatencyHistogram *DrillingSystem::getControlLatency() {
+    return &this->controlLatency;
+}
+
+// Get number of control releases missed because an update overran
+uint64_t DrillingSystem::getControlOverrunCount() {
+    return this->controlOverrunCount;
+}
+
+// Set handler for stall trips, e.g. to retract the z-axis (only while stopped)
+int DrillingSystem::setStallHandler(StallHandler stallHandler) {
+    if (!this->controlThreadShouldCancel) {
+        return -1;
+    }
+    this->stallHandler = stallHandler;
+    return 0;
+}
+
+// If the drill has been tripped by a predicted stall since it was started
+bool DrillingSystem::isStalled() {
+    return this->stallDetector->isTripped();
+}
+
+// Get stall detector, e.g. to set thresholds
+StallDetector *DrillingSystem::getStallDetector() {
+    return this->stallDetector;
+}
+
+// Write the samples around the latest trip as CSV once they have been captured (returns -1 if none or on error)
+int DrillingSystem::writeStallTrip(std::string path) {
+    StallEvent event;
+    std::vector<StallSample> samples;
+    if (this->stallDetector->getTrip(&event, &samples) < 0) {
+        return -1;
+    }
+    std::cout << "DrillingSystem: Stall trip on " << stallReasonName(event.reason) << " at " << event.sample.currentA << " A, "
+              << event.sample.speedRPM << " RPM, " << event.sample.torqueNM << " Nm (" << event.timeToStallS * 1000.0f
+              << " ms to stall), written to " << path << std::endl;
+    return this->stallDetector->writeTrip(path);
+}
+
 // Get drill rotation speed from encoder in RPM
 float DrillingSystem::getSpeed() {
     return this->speedRPM;
 }
 
+// Get drill angular acceleration from encoder in RPM per second
+float DrillingSystem::getAcceleration() {
+    SpeedEstimate estimate;
+    if (this->speedEstimator->getEstimate(&estimate) < 0) {
+        return 0.0f;
+    }
+    return estimate.accelerationRPMPerS;
+}
+
+// Get confidence in the drill speed from 0 (unknown or stopped) to 1
+float DrillingSystem::getSpeedQuality() {
+    SpeedEstimate estimate;
+    if (this->speedEstimator->getEstimate(&estimate) < 0) {
+        return 0.0f;
+    }
+    return estimate.quality;
+}
+
+// Get drill angle from the encoder index in degrees
+float DrillingSystem::getAngle() {
+    return this->decoder->getAngleDegrees();
+}
+
+// Get encoder decoder
+QuadratureDecoder *DrillingSystem::getDecoder() {
+    return this->decoder;
+}
+
 // Get drill current from current sensor in amps
 float DrillingSystem::getCurrent() {
-    return this->currentSensor->getCurrent();
+    // Use the latest scheduled sample, reading the sensor only before the first one
+    Sample sample;
+    if (this->telemetrySystem->getChannel(TelemetryRecord::CHANNEL::DRILL_CURRENT)->getLatest(&sample) < 0) {
+        return this->currentSensor->getCurrent();
+    }
+    return sample.value;
 }
 
 // Get drill power from in watts
@@ -121,67 +513,220 @@ float DrillingSystem::getPower() {
     return DRILL_VOLTAGE * this->getCurrent();
 }
 
-// Get drill torque for speed and current in Nm
+// Get drill load torque for speed and current in Nm
 float DrillingSystem::getTorque() {
-    float speedRPM = this->getSpeed();
-    float powerW = this->getPower();
+    // Use speed and current from the same snapshot so they were sampled together
+    float speedRPM;
+    float currentA;
+    TelemetrySnapshot snapshot;
+    const uint32_t requiredChannels = (0x1 << TelemetryRecord::CHANNEL::DRILL_SPEED) | (0x1 << TelemetryRecord::CHANNEL::DRILL_CURRENT);
+    if (this->telemetrySystem->getSnapshot(&snapshot) == 0 && (snapshot.validChannels & requiredChannels) == requiredChannels) {
+        speedRPM = snapshot.value[TelemetryRecord::CHANNEL::DRILL_SPEED];
+        currentA = snapshot.value[TelemetryRecord::CHANNEL::DRILL_CURRENT];
+    } else {
+        speedRPM = this->getSpeed();
+        currentA = this->getCurrent();
+    }
+
+    // The motor model stays finite at zero speed, unlike power over speed
+    return this->torqueEstimator->estimate(currentA, speedRPM);
+}
 
-    float torqueNM = powerW / (speedRPM * PI / 30.0);
-    return torqueNM;
+// Get drill torque estimator
+TorqueEstimator *DrillingSystem::getTorqueEstimator() {
+    return this->torqueEstimator;
 }
 
-// Reset drill speed and encoder trigger
+// Fit the drill motor model by sweeping speed with the drill unloaded, saving it to path if not empty (only while stopped)
+int DrillingSystem::calibrateTorqueModel(std::string path) {
+    if (this->regulateSpeedTaskId >= 0 || !this->controlThreadShouldCancel) {
+        return -1;
+    }
+
+    // Hold each speed until current and speed settle, then average both
+    std::vector<MotorCalibrationPoint> points;
+    this->motor->setSpeedPercent(SPEED_MIN_PERCENT);
+    this->motor->start();
+    for (int step = 0; step < CALIBRATION_STEP_COUNT; step++) {
+        float speedPercent = SPEED_MIN_PERCENT + (SPEED_MAX_PERCENT - SPEED_MIN_PERCENT) * step / (CALIBRATION_STEP_COUNT - 1);
+        this->motor->setSpeedPercent(speedPercent);
+        std::this_thread::sleep_for(std::chrono::milliseconds(CALIBRATION_SETTLE_MS));
+
+        double currentSum = 0.0;
+        double speedSum = 0.0;
+        int sampleCount = 0;
+        for (int elapsedMS = 0; elapsedMS < CALIBRATION_AVERAGE_MS; elapsedMS += CALIBRATION_SAMPLE_INTERVAL_MS) {
+            currentSum += this->getCurrent();
+            speedSum += this->getSpeed();
+            sampleCount++;
+            std::this_thread::sleep_for(std::chrono::milliseconds(CALIBRATION_SAMPLE_INTERVAL_MS));
+        }
+
+        MotorCalibrationPoint point;
+        point.voltageV = DRILL_VOLTAGE * speedPercent / 100.0f;
+        point.currentA = static_cast<float>(currentSum / sampleCount);
+        point.speedRadS = static_cast<float>(speedSum / sampleCount) * PI / 30.0f;
+        points.push_back(point);
+        std::cout << "DrillingSystem: Calibration " << speedPercent << "% " << point.voltageV << " V "
+                  << point.currentA << " A " << point.speedRadS << " rad/s" << std::endl;
+    }
+    this->motor->stop();
+
+    MotorModel model;
+    if (TorqueEstimator::fitModel(points, &model) < 0) {
+        std::cout << "DrillingSystem: Error fitting motor model, keeping previous model" << std::endl;
+        return -1;
+    }
+    std::cout << "DrillingSystem: Motor model " << model.resistanceOhm << " ohm, " << model.backEMFConstant << " V s/rad, "
+              << model.noLoadCurrentA << " A + " << model.viscousCurrentAPerRadS << " A s/rad" << std::endl;
+    this->torqueEstimator->setModel(model);
+
+    if (!path.empty()) {
+        return this->torqueEstimator->saveModel(path);
+    }
+    return 0;
+}
+
+// Reset drill speed
 void DrillingSystem::resetSpeed() {
-    this->lastEncoderTriggerTimeS = std::chrono::high_resolution_clock::time_point::min();
     this->speedRPM = 0.0f;
 }
 
-// Continuously update drill speed for encoder trigger
-void DrillingSystem::updateSpeed() {
-    std::chrono::high_resolution_clock::time_point encoderTriggerTimeS = std::chrono::high_resolution_clock::now();
-
-    // Update speed if there is a recorded last trigger time
-    bool firstSpeedUpdate = (this->lastEncoderTriggerTimeS == std::chrono::high_resolution_clock::time_point::min());
-    if (!firstSpeedUpdate) {
-        // Calculate time difference between pulses
-        //double pulseTimeDifferenceS = std::chrono::duration_cast<std::chrono::duration::seconds>(encoderTriggerTimeS - lastEncoderTriggerTimeS);
-	std::chrono::duration<double> difference = encoderTriggerTimeS - lastEncoderTriggerTimeS;
-	double pulseTimeDifferenceS = difference.count();
-        // Calculate seconds per revolution based on encoder pulses per revolution
-        double secondsPerRevolution = pulseTimeDifferenceS * ENCODER_PULSES_PER_REVOLUTION;
-        // Convert to revolutions per minute
-        double revolutionsPerMinute = 1.0 / (secondsPerRevolution) * 60.0;
-        // Update speed
-        this->speedRPM = revolutionsPerMinute;
+// Estimate drill speed from the encoder edges decoded since the previous estimate (runs periodically on the telemetry scheduler)
+float DrillingSystem::updateSpeed() {
+    EncoderEdge edges[SPEED_EDGE_BATCH_SIZE];
+    size_t count;
+    while ((count = this->decoder->readEdges(edges, SPEED_EDGE_BATCH_SIZE)) > 0) {
+        for (size_t i = 0; i < count; i++) {
+            this->speedEstimator->addEdge(edges[i]);
+        }
     }
 
-    // Set current trigger time as last trigger time
-    this->lastEncoderTriggerTimeS = encoderTriggerTimeS;
+    const SpeedEstimate &estimate = this->speedEstimator->update(Clock::monotonicNS());
+    this->speedRPM = estimate.speedRPM;
+    this->updateTorque(estimate.timeNS, estimate.quality);
+    return this->speedRPM;
 }
 
-// Continuously regulate drill speed to control torque
+// Update the torque observer with the latest current and speed (runs periodically on the telemetry scheduler)
+void DrillingSystem::updateTorque(int64_t timeNS, float speedQuality) {
+    // Current is sampled just before speed on the same scheduler pass
+    Sample current;
+    if (this->telemetrySystem->getChannel(TelemetryRecord::CHANNEL::DRILL_CURRENT)->getLatest(&current) < 0) {
+        return;
+    }
+    float dtS = (this->lastTorqueUpdateNS > 0) ? (timeNS - this->lastTorqueUpdateNS) / 1e9f : 0.0f;
+    this->lastTorqueUpdateNS = timeNS;
+    this->torqueEstimator->update(current.value, this->speedRPM, speedQuality, this->motor->getSpeedPercent(), dtS);
+}
+
+// Regulate drill speed to control torque (runs periodically on the telemetry scheduler)
 void DrillingSystem::regulateSpeed() {
-    // Run until cancellation token
-    while (!this->regulateSpeedThreadShouldCancel) {
-        // Get current torque
-        float torqueNM = this->getTorque();
-        
-        // Get current speed percentage
-        float newSpeedPercent = this->motor->getSpeedPercent();
-
-        // Increase or decrease speed as necessary (within min and max)
-        if (torqueNM < TORQUE_MIN_NM) {
-            newSpeedPercent = std::min(newSpeedPercent + SPEED_DELTA_PERCENT, SPEED_MAX_PERCENT);
-        } else if (torqueNM > TORQUE_MAX_NM) {
-            newSpeedPercent = std::max(newSpeedPercent - SPEED_DELTA_PERCENT, SPEED_MIN_PERCENT);
-        }
+    // Leave the drill off once tripped
+    if (this->isStalled()) {
+        return;
+    }
+
+    // Get current torque
+    float torqueNM = this->getTorque();
 
-        // Set new speed percentage
-        this->motor->setSpeedPercent(newSpeedPercent);
+    // Get current speed percentage
+    float newSpeedPercent = this->motor->getSpeedPercent();
 
-        // Repeat every 0.1 seconds
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    // Increase or decrease speed as necessary (within min and max)
+    if (torqueNM < TORQUE_MIN_NM) {
+        newSpeedPercent = std::min(newSpeedPercent + SPEED_DELTA_PERCENT, SPEED_MAX_PERCENT);
+    } else if (torqueNM > TORQUE_MAX_NM) {
+        newSpeedPercent = std::max(newSpeedPercent - SPEED_DELTA_PERCENT, SPEED_MIN_PERCENT);
     }
+
+    // Set new speed percentage
+    this->motor->setSpeedPercent(newSpeedPercent);
+}
+
+// Wait until the drill position holds for the settle time (returns the settled position)
+int64_t DrillingSystem::waitForSettle() {
+    int64_t position = this->decoder->getPosition();
+    int64_t deadlineNS = Clock::monotonicNS() + static_cast<int64_t>(ROTATE_TO_INDEX_TIMEOUT_MS) * 1000000;
+    while (this->decoder->waitForPosition(position - 1, position + 1, static_cast<int64_t>(INDEX_SETTLE_MS) * 1000000) == 0 &&
+           Clock::monotonicNS() < deadlineNS) {
+        position = this->decoder->getPosition();
+    }
+    return this->decoder->getPosition();
+}
+
+// Get signed counts from the nearest index position, positive past it in the direction of rotation
+int64_t DrillingSystem::getIndexError(int64_t position, int64_t indexPosition, int64_t direction) {
+    int64_t countsPerRevolution = this->decoder->getCountsPerRevolution();
+    int64_t error = (direction * (position - indexPosition)) % countsPerRevolution;
+    if (error < 0) {
+        error += countsPerRevolution;
+    }
+    if (error >= countsPerRevolution / 2) {
+        error -= countsPerRevolution;
+    }
+    return error;
+}
+
+// Run stall detection and the PID torque controller at the control rate until cancellation token
+void DrillingSystem::control() {
+    int64_t periodNS = 1000000000 / this->controlRateHz;
+    int64_t releaseTimeNS = Clock::monotonicNS() + periodNS;
+    int64_t previousReleaseTimeNS = releaseTimeNS - periodNS;
+    while (!this->controlThreadShouldCancel) {
+        // Sleep until the absolute release time so the rate never drifts
+        struct timespec release;
+        release.tv_sec = releaseTimeNS / 1000000000;
+        release.tv_nsec = releaseTimeNS % 1000000000;
+        if (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &release, nullptr) != 0) {
+            continue;
+        }
+        this->controlLatency.record(Clock::monotonicNS() - releaseTimeNS);
+
+        // Update for the time since the previous release that ran
+        this->updateControl(releaseTimeNS, (releaseTimeNS - previousReleaseTimeNS) / 1e9f);
+        previousReleaseTimeNS = releaseTimeNS;
+
+        // Advance by whole periods, skipping releases that have already passed
+        releaseTimeNS += periodNS;
+        int64_t completionTimeNS = Clock::monotonicNS();
+        if (releaseTimeNS <= completionTimeNS) {
+            int64_t skipped = (completionTimeNS - releaseTimeNS) / periodNS + 1;
+            releaseTimeNS += skipped * periodNS;
+            this->controlOverrunCount += static_cast<uint64_t>(skipped);
+        }
+    }
+}
+
+// Check for a stall and regulate torque from a fresh current reading (control thread only)
+void DrillingSystem::updateControl(int64_t timeNS, float dtS) {
+    // Read current every update for fast stall detection and torque rejection (speed is estimated on the telemetry scheduler)
+    StallSample sample;
+    sample.timeNS = timeNS;
+    sample.currentA = this->currentSensor->getCurrent();
+    sample.speedRPM = this->getSpeed();
+    sample.accelerationRPMPerS = this->getAcceleration();
+    sample.weightOnBitKg = this->telemetrySystem->getWeightOnBit();
+    sample.torqueNM = this->torqueEstimator->estimate(sample.currentA, sample.speedRPM);
+
+    // Cut the drill as soon as a stall is predicted, then let the application retract (samples are still recorded for the capture)
+    StallEvent event;
+    bool wasStalled = this->stallDetector->isTripped();
+    if (this->stallDetector->update(&sample, &event) == 1) {
+        this->motor->setSpeedPercent(0.0f);
+        this->motor->stop();
+        if (this->stallHandler) {
+            this->stallHandler(event);
+        }
+        return;
+    }
+    if (wasStalled || this->controlMode != CONTROL_MODE::PID) {
+        return;
+    }
+
+    // Raise speed when torque is below the setpoint and lower it when above
+    float speedPercent = this->torqueController->update(this->torqueSetpointNM, sample.torqueNM, this->commandedSpeedPercent, dtS);
+    this->motor->setSpeedPercent(speedPercent);
 }
 
 } /* namespace tids */
@@ -22,27 +22,96 @@
 #include <libbbbkit/DCMotor.h>
 
 #include <atomic>
-#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
 #include <thread>
 
 #include "MMPEU.h"
+#include "LatencyHistogram.h"
 #include "LTS6NP.h"
+#include "PIDController.h"
+#include "QuadratureDecoder.h"
+#include "SpeedEstimator.h"
+#include "StallDetector.h"
+#include "TelemetrySystem.h"
+#include "TorqueEstimator.h"
 
 namespace tids {
 
+// Result of rotating the drill to the encoder index
+struct IndexAlignment {
+    // Final distance from the index, positive past it in the direction of rotation
+    int32_t errorCounts;
+    float errorDegrees;
+    // Time from start to settled alignment in nanoseconds
+    int64_t durationNS;
+    // Counts the drill coasted after the motor was stopped
+    int32_t coastCounts;
+    // Short pulses used to trim an undershoot
+    int32_t trimPulseCount;
+    // If the error is within tolerance
+    bool aligned;
+};
+
 class DrillingSystem {
+public:
+    // Called on the control thread right after the drill is tripped, must not block
+    typedef std::function<void(const StallEvent &)> StallHandler;
+
+    enum CONTROL_MODE {
+        // Step speed by a fixed amount whenever torque leaves its band (on the telemetry scheduler)
+        LEGACY = 0,
+        // Regulate torque with a PID controller on a dedicated fixed-rate thread
+        PID = 1,
+    };
+
 private:
     bbbkit::DCMotor *motor;
     MMPEU *encoder;
     LTS6NP *currentSensor;
-
-    std::chrono::high_resolution_clock::time_point lastEncoderTriggerTimeS;
-    float speedRPM;
-
-    std::thread regulateSpeedThread;
-    std::atomic<bool> regulateSpeedThreadShouldCancel;
+    TelemetrySystem *telemetrySystem;
+
+    // Encoder position, revolutions and angle from both edges of both channels
+    QuadratureDecoder *decoder;
+
+    // Speed from encoder edges over an adaptive window (updated on the telemetry scheduler)
+    SpeedEstimator *speedEstimator;
+    // Signed speed, written by the telemetry scheduler
+    std::atomic<float> speedRPM;
+
+    // Torque from a motor model, with an observer updated on the telemetry scheduler
+    TorqueEstimator *torqueEstimator;
+    int64_t lastTorqueUpdateNS;
+
+    // Counts the drill coasts after the motor stops near the index (learned), and latest alignment result
+    std::atomic<float> indexCoastCounts;
+    IndexAlignment indexAlignment;
+
+    // Speed regulation task on the telemetry scheduler (-1 when not running)
+    int regulateSpeedTaskId;
+
+    // Torque control mode and rate
+    CONTROL_MODE controlMode;
+    int controlRateHz;
+
+    // Torque controller, with commanded speed (percent) as feed-forward
+    PIDController *torqueController;
+    std::atomic<float> torqueSetpointNM;
+    std::atomic<float> commandedSpeedPercent;
+
+    // Stall prediction on every control update, and the application handler for trips
+    StallDetector *stallDetector;
+    StallHandler stallHandler;
+
+    // Fixed-rate control thread (stall detection in every mode, torque regulation in PID mode)
+    std::thread controlThread;
+    std::atomic<bool> controlThreadShouldCancel;
+    // Control thread wake-up latency after each release, and releases missed because an update overran
+    LatencyHistogram controlLatency;
+    std::atomic<uint64_t> controlOverrunCount;
 public:
-    DrillingSystem(bbbkit::DCMotor *motor, MMPEU *encoder, LTS6NP *currentSensor);
+    DrillingSystem(bbbkit::DCMotor *motor, MMPEU *encoder, LTS6NP *currentSensor, TelemetrySystem *telemetrySystem);
     virtual ~DrillingSystem();
 
     // Start drill and automatically adjust speed based on torque
@@ -51,30 +120,102 @@ public:
     // Stop drill
     int stop();
 
-    // Rotate drill until index location on encoder
+    // Rotate drill until index location on encoder, ramping down on approach (returns -1 on timeout or if not within tolerance)
     int rotateToIndex();
 
-    // Get drill rotation speed from encoder in RPM
+    // Get result of the latest index alignment (returns -1 if none has completed)
+    int getIndexAlignment(IndexAlignment *alignment);
+
+    // Set torque control mode (only while stopped)
+    int setControlMode(CONTROL_MODE controlMode);
+
+    // Get torque control mode
+    CONTROL_MODE getControlMode();
+
+    // Set control rate in hertz (only while stopped)
+    int setControlRate(int controlRateHz);
+
+    // Set torque the PID controller regulates to in Nm
+    void setTorqueSetpoint(float torqueNM);
+
+    // Set commanded speed in percent, fed forward to the PID controller output
+    void setCommandedSpeed(float speedPercent);
+
+    // Get PID torque controller, e.g. to load gains
+    PIDController *getTorqueController();
+
+    // Get control thread wake-up latency
+    LatencyHistogram *getControlLatency();
+
+    // Get number of control releases missed because an update overran
+    uint64_t getControlOverrunCount();
+
+    // Set handler for stall trips, e.g. to retract the z-axis (only while stopped)
+    int setStallHandler(StallHandler stallHandler);
+
+    // If the drill has been tripped by a predicted stall since it was started
+    bool isStalled();
+
+    // Get stall detector, e.g. to set thresholds
+    StallDetector *getStallDetector();
+
+    // Write the samples around the latest trip as CSV once they have been captured (returns -1 if none or on error)
+    int writeStallTrip(std::string path);
+
+    // Get drill rotation speed from encoder in RPM (negative when reversing)
     float getSpeed();
 
+    // Get drill angular acceleration from encoder in RPM per second
+    float getAcceleration();
+
+    // Get confidence in the drill speed from 0 (unknown or stopped) to 1
+    float getSpeedQuality();
+
+    // Get drill angle from the encoder index in degrees
+    float getAngle();
+
+    // Get encoder decoder
+    QuadratureDecoder *getDecoder();
+
     // Get drill current from current sensor in amps
     float getCurrent();
 
     // Get drill power from in watts
     float getPower();
 
-    // Get drill torque for speed and current in Nm
+    // Get drill load torque for speed and current in Nm
     float getTorque();
 
-    // Continuously update drill speed for encoder trigger
-    void updateSpeed();
+    // Get drill torque estimator
+    TorqueEstimator *getTorqueEstimator();
+
+    // Fit the drill motor model by sweeping speed with the drill unloaded, saving it to path if not empty (only while stopped)
+    int calibrateTorqueModel(std::string path);
 
 private:
-    // Reset drill speed and encoder trigger
+    // Reset drill speed
     void resetSpeed();
 
-    // Continuously regulate drill speed to control torque
+    // Estimate drill speed from the encoder edges decoded since the previous estimate (runs periodically on the telemetry scheduler)
+    float updateSpeed();
+
+    // Update the torque observer with the latest current and speed (runs periodically on the telemetry scheduler)
+    void updateTorque(int64_t timeNS, float speedQuality);
+
+    // Regulate drill speed to control torque (runs periodically on the telemetry scheduler)
     void regulateSpeed();
+
+    // Wait until the drill position holds for the settle time (returns the settled position)
+    int64_t waitForSettle();
+
+    // Get signed counts from the nearest index position, positive past it in the direction of rotation
+    int64_t getIndexError(int64_t position, int64_t indexPosition, int64_t direction);
+
+    // Run stall detection and the PID torque controller at the control rate until cancellation token
+    void control();
+
+    // Check for a stall and regulate torque from a fresh current reading (control thread only)
+    void updateControl(int64_t timeNS, float dtS);
 };
 
 } /* namespace tids */
@@ -0,0 +1,93 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "FastGPIO.h"
+
+namespace tids {
+
+FastGPIO::FastGPIO(bbbkit::GPIO::PIN pin, bbbkit::GPIO::DIRECTION direction, bbbkit::GPIO::VALUE value, GPIOMemoryMap *gpioMemoryMap) {
+    this->gpio = new bbbkit::GPIO(pin, direction, value);
+
+    this->dataIn = nullptr;
+    this->valueRegister = nullptr;
+    this->setDataOut = nullptr;
+    this->clearDataOut = nullptr;
+    this->mask = GPIOMemoryMap::getMask(pin);
+
+    // Use the registers only once every one of them is mapped
+    if (gpioMemoryMap != nullptr && gpioMemoryMap->isOpen()) {
+        this->dataIn = gpioMemoryMap->getRegister(pin, GPIOMemoryMap::REGISTER::DATAIN);
+        this->valueRegister = direction == bbbkit::GPIO::DIRECTION::OUTPUT ? gpioMemoryMap->getRegister(pin, GPIOMemoryMap::REGISTER::DATAOUT) : this->dataIn;
+        this->setDataOut = gpioMemoryMap->getRegister(pin, GPIOMemoryMap::REGISTER::SETDATAOUT);
+        this->clearDataOut = gpioMemoryMap->getRegister(pin, GPIOMemoryMap::REGISTER::CLEARDATAOUT);
+        if (this->dataIn == nullptr || this->valueRegister == nullptr || this->setDataOut == nullptr || this->clearDataOut == nullptr) {
+            this->dataIn = nullptr;
+            this->valueRegister = nullptr;
+            this->setDataOut = nullptr;
+            this->clearDataOut = nullptr;
+        }
+    }
+}
+
+FastGPIO::~FastGPIO() {
+    delete this->gpio;
+}
+
+// Get value
+bbbkit::GPIO::VALUE FastGPIO::getValue() {
+    if (this->valueRegister == nullptr) {
+        return this->gpio->getValue();
+    }
+    return (*this->valueRegister & this->mask) != 0 ? bbbkit::GPIO::VALUE::HIGH : bbbkit::GPIO::VALUE::LOW;
+}
+
+// Set value
+int FastGPIO::setValue(bbbkit::GPIO::VALUE value) {
+    if (this->setDataOut == nullptr) {
+        return this->gpio->setValue(value);
+    }
+    // Set and clear registers change only the pin bit, so no read-modify-write is needed
+    if (value == bbbkit::GPIO::VALUE::HIGH) {
+        *this->setDataOut = this->mask;
+    } else {
+        *this->clearDataOut = this->mask;
+    }
+    return 0;
+}
+
+// If the pin is accessed through memory-mapped registers
+bool FastGPIO::isMapped() {
+    return this->dataIn != nullptr;
+}
+
+// Get data in register of the pin bank, to read several pins of a bank at once (null if not memory mapped)
+volatile uint32_t *FastGPIO::getDataInRegister() {
+    return this->dataIn;
+}
+
+// Get bit of the pin within its bank registers
+uint32_t FastGPIO::getMask() {
+    return this->mask;
+}
+
+// Get sysfs GPIO (for edge configuration and waits)
+bbbkit::GPIO *FastGPIO::getGPIO() {
+    return this->gpio;
+}
+
+} /* namespace tids */
@@ -0,0 +1,70 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FASTGPIO_H
+#define FASTGPIO_H
+
+#include <libbbbkit/GPIO.h>
+
+#include <cstdint>
+
+#include "GPIOMemoryMap.h"
+
+namespace tids {
+
+// GPIO pin read and written with single register loads and stores when its bank is memory mapped,
+// or through bbbkit::GPIO sysfs files otherwise
+// The pin is always exported and its direction set through bbbkit::GPIO, which also enables the bank clock
+class FastGPIO {
+private:
+    bbbkit::GPIO *gpio;
+
+    // Bank registers (null if not memory mapped)
+    volatile uint32_t *dataIn;
+    // Data in for inputs, data out for outputs so the commanded value is read back
+    volatile uint32_t *valueRegister;
+    volatile uint32_t *setDataOut;
+    volatile uint32_t *clearDataOut;
+    uint32_t mask;
+
+public:
+    FastGPIO(bbbkit::GPIO::PIN pin, bbbkit::GPIO::DIRECTION direction, bbbkit::GPIO::VALUE value=bbbkit::GPIO::VALUE::LOW, GPIOMemoryMap *gpioMemoryMap=nullptr);
+    virtual ~FastGPIO();
+
+    // Get value
+    bbbkit::GPIO::VALUE getValue();
+
+    // Set value
+    int setValue(bbbkit::GPIO::VALUE value);
+
+    // If the pin is accessed through memory-mapped registers
+    bool isMapped();
+
+    // Get data in register of the pin bank, to read several pins of a bank at once (null if not memory mapped)
+    volatile uint32_t *getDataInRegister();
+
+    // Get bit of the pin within its bank registers
+    uint32_t getMask();
+
+    // Get sysfs GPIO (for edge configuration and waits)
+    bbbkit::GPIO *getGPIO();
+};
+
+} /* namespace tids */
+
+#endif /* FASTGPIO_H */
@@ -0,0 +1,115 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "GPIOEdge.h"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <iostream>
+#include <poll.h>
+#include <string>
+#include <time.h>
+#include <unistd.h>
+
+// Path of sysfs GPIO directories
+#define GPIOEDGE_SYSFS_PATH "/sys/class/gpio/gpio"
+
+namespace tids {
+
+GPIOEdge::GPIOEdge(int number) {
+    this->number = number;
+    this->valueFileDescriptor = -1;
+}
+
+GPIOEdge::~GPIOEdge() {
+    this->close();
+}
+
+// Open the pin value file
+int GPIOEdge::open() {
+    if (this->isOpen()) {
+        return 0;
+    }
+
+    std::string path = GPIOEDGE_SYSFS_PATH + std::to_string(this->number) + "/value";
+    this->valueFileDescriptor = ::open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (this->valueFileDescriptor < 0) {
+        std::cout << "GPIOEdge: Error opening " << path << std::endl;
+        return -1;
+    }
+
+    // Acknowledge the edge reported for every newly opened value file
+    this->readValue();
+    return 0;
+}
+
+// Close the pin value file
+void GPIOEdge::close() {
+    if (this->valueFileDescriptor >= 0) {
+        ::close(this->valueFileDescriptor);
+        this->valueFileDescriptor = -1;
+    }
+}
+
+// If the pin value file is open
+bool GPIOEdge::isOpen() {
+    return this->valueFileDescriptor >= 0;
+}
+
+// Get the pin value file descriptor, to wait on several pins at once (-1 if not open)
+int GPIOEdge::getFileDescriptor() {
+    return this->valueFileDescriptor;
+}
+
+// Read the pin value and acknowledge any pending edge (returns 0 or 1, or -1 on error)
+int GPIOEdge::readValue() {
+    char value;
+    if (::pread(this->valueFileDescriptor, &value, 1, 0) != 1) {
+        return -1;
+    }
+    return value == '0' ? 0 : 1;
+}
+
+// Wait for the next edge for up to timeoutNS nanoseconds (returns 1 on edge, 0 on timeout, or -1 on error)
+int GPIOEdge::wait(int64_t timeoutNS) {
+    struct pollfd pollFileDescriptor;
+    pollFileDescriptor.fd = this->valueFileDescriptor;
+    pollFileDescriptor.events = POLLPRI | POLLERR;
+    pollFileDescriptor.revents = 0;
+
+    struct timespec timeout;
+    timeout.tv_sec = timeoutNS / 1000000000LL;
+    timeout.tv_nsec = timeoutNS % 1000000000LL;
+
+    int result = ::ppoll(&pollFileDescriptor, 1, &timeout, nullptr);
+    if (result < 0) {
+        // Signals are treated as a spurious timeout
+        return errno == EINTR ? 0 : -1;
+    }
+    if (result == 0) {
+        return 0;
+    }
+
+    // Acknowledge so the next wait blocks until a new edge
+    if (this->readValue() < 0) {
+        return -1;
+    }
+    return 1;
+}
+
+} /* namespace tids */
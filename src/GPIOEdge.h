@@ -0,0 +1,58 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GPIOEDGE_H
+#define GPIOEDGE_H
+
+#include <cstdint>
+
+namespace tids {
+
+// Waits for interrupts on a sysfs GPIO with a timeout
+// The edge type must already be set on the pin (for example with bbbkit::GPIO::setEdgeType)
+class GPIOEdge {
+private:
+    int number;
+    int valueFileDescriptor;
+
+public:
+    GPIOEdge(int number);
+    virtual ~GPIOEdge();
+
+    // Open the pin value file
+    int open();
+
+    // Close the pin value file
+    void close();
+
+    // If the pin value file is open
+    bool isOpen();
+
+    // Get the pin value file descriptor, to wait on several pins at once (-1 if not open)
+    int getFileDescriptor();
+
+    // Read the pin value and acknowledge any pending edge (returns 0 or 1, or -1 on error)
+    int readValue();
+
+    // Wait for the next edge for up to timeoutNS nanoseconds (returns 1 on edge, 0 on timeout, or -1 on error)
+    int wait(int64_t timeoutNS);
+};
+
+} /* namespace tids */
+
+#endif /* GPIOEDGE_H */
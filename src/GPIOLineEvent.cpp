@@ -0,0 +1,139 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "GPIOLineEvent.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/gpio.h>
+#include <string>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "Clock.h"
+
+// Path of GPIO character devices, one per 32-line bank on the AM335x
+#define GPIOLINEEVENT_CHIP_PATH "/dev/gpiochip"
+#define GPIOLINEEVENT_LINES_PER_CHIP 32
+
+// Most events read from the kernel at once
+#define GPIOLINEEVENT_READ_BATCH_SIZE 16
+
+#define GPIOLINEEVENT_CONSUMER_LABEL "tids"
+
+namespace tids {
+
+GPIOLineEvent::GPIOLineEvent(int number) {
+    this->number = number;
+    this->fileDescriptor = -1;
+}
+
+GPIOLineEvent::~GPIOLineEvent() {
+    this->close();
+}
+
+// Request edge events for the line
+int GPIOLineEvent::open(EDGE edge) {
+    if (this->isOpen()) {
+        return 0;
+    }
+
+    std::string path = GPIOLINEEVENT_CHIP_PATH + std::to_string(this->number / GPIOLINEEVENT_LINES_PER_CHIP);
+    int chipFileDescriptor = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (chipFileDescriptor < 0) {
+        return -1;
+    }
+
+    struct gpioevent_request request;
+    memset(&request, 0, sizeof(request));
+    request.lineoffset = this->number % GPIOLINEEVENT_LINES_PER_CHIP;
+    request.handleflags = GPIOHANDLE_REQUEST_INPUT;
+    request.eventflags = 0;
+    if (edge & EDGE::RISING) {
+        request.eventflags |= GPIOEVENT_REQUEST_RISING_EDGE;
+    }
+    if (edge & EDGE::FALLING) {
+        request.eventflags |= GPIOEVENT_REQUEST_FALLING_EDGE;
+    }
+    strncpy(request.consumer_label, GPIOLINEEVENT_CONSUMER_LABEL, sizeof(request.consumer_label) - 1);
+
+    int result = ::ioctl(chipFileDescriptor, GPIO_GET_LINEEVENT_IOCTL, &request);
+    ::close(chipFileDescriptor);
+    if (result < 0) {
+        return -1;
+    }
+
+    // Reads must not block so a batch can be drained after a wait
+    int flags = ::fcntl(request.fd, F_GETFL);
+    ::fcntl(request.fd, F_SETFL, flags | O_NONBLOCK);
+    this->fileDescriptor = request.fd;
+    return 0;
+}
+
+// Release the line
+void GPIOLineEvent::close() {
+    if (this->fileDescriptor >= 0) {
+        ::close(this->fileDescriptor);
+        this->fileDescriptor = -1;
+    }
+}
+
+// If events are requested
+bool GPIOLineEvent::isOpen() {
+    return this->fileDescriptor >= 0;
+}
+
+// Get the event file descriptor, to wait on several lines at once (-1 if not open)
+int GPIOLineEvent::getFileDescriptor() {
+    return this->fileDescriptor;
+}
+
+// Read pending events without blocking (returns number read, or -1 on error)
+int GPIOLineEvent::read(GPIOLineEventData *events, int maxCount) {
+    struct gpioevent_data data[GPIOLINEEVENT_READ_BATCH_SIZE];
+    if (maxCount > GPIOLINEEVENT_READ_BATCH_SIZE) {
+        maxCount = GPIOLINEEVENT_READ_BATCH_SIZE;
+    }
+
+    ssize_t length = ::read(this->fileDescriptor, data, maxCount * sizeof(struct gpioevent_data));
+    if (length < 0) {
+        return errno == EAGAIN ? 0 : -1;
+    }
+    int count = static_cast<int>(length / sizeof(struct gpioevent_data));
+    if (count == 0) {
+        return 0;
+    }
+
+    // Kernels before 5.7 stamp events with the wall clock, later ones with the monotonic clock
+    int64_t monotonicNS = Clock::monotonicNS();
+    int64_t wallClockNS = Clock::wallClockNS();
+    int64_t firstTimestampNS = static_cast<int64_t>(data[0].timestamp);
+    bool wallClockTimestamps = std::llabs(firstTimestampNS - wallClockNS) < std::llabs(firstTimestampNS - monotonicNS);
+    int64_t wallClockOffsetNS = wallClockNS - monotonicNS;
+
+    for (int i = 0; i < count; i++) {
+        int64_t timestampNS = static_cast<int64_t>(data[i].timestamp);
+        events[i].timeNS = wallClockTimestamps ? timestampNS - wallClockOffsetNS : timestampNS;
+        events[i].rising = data[i].id == GPIOEVENT_EVENT_RISING_EDGE;
+    }
+    return count;
+}
+
+} /* namespace tids */
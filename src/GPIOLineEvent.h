@@ -0,0 +1,70 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GPIOLINEEVENT_H
+#define GPIOLINEEVENT_H
+
+#include <cstdint>
+
+namespace tids {
+
+// Edge reported by the kernel with the time it was detected
+struct GPIOLineEventData {
+    // Kernel timestamp of the edge in nanoseconds (monotonic clock)
+    int64_t timeNS;
+    // If the edge was rising (falling otherwise)
+    bool rising;
+};
+
+// Edge events of one GPIO line through the GPIO character device, timestamped by the kernel
+// The line must not be exported through sysfs at the same time (the request fails as busy)
+class GPIOLineEvent {
+public:
+    enum EDGE {
+        RISING = 1,
+        FALLING = 2,
+        BOTH = 3,
+    };
+
+private:
+    int number;
+    int fileDescriptor;
+
+public:
+    GPIOLineEvent(int number);
+    virtual ~GPIOLineEvent();
+
+    // Request edge events for the line
+    int open(EDGE edge);
+
+    // Release the line
+    void close();
+
+    // If events are requested
+    bool isOpen();
+
+    // Get the event file descriptor, to wait on several lines at once (-1 if not open)
+    int getFileDescriptor();
+
+    // Read pending events without blocking (returns number read, or -1 on error)
+    int read(GPIOLineEventData *events, int maxCount);
+};
+
+} /* namespace tids */
+
+#endif /* GPIOLINEEVENT_H */
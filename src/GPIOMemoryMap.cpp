@@ -0,0 +1,120 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "GPIOMemoryMap.h"
+
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Size of the register window of each bank
+#define GPIO_MEMORY_MAP_BANK_SIZE 0x1000
+
+// AM335x physical addresses of GPIO banks 0 to 3
+#define GPIO_MEMORY_MAP_AM335X_GPIO0 0x44E07000
+#define GPIO_MEMORY_MAP_AM335X_GPIO1 0x4804C000
+#define GPIO_MEMORY_MAP_AM335X_GPIO2 0x481AC000
+#define GPIO_MEMORY_MAP_AM335X_GPIO3 0x481AE000
+
+namespace tids {
+
+GPIOMemoryMap::GPIOMemoryMap(std::string path, const off_t *bankOffsets) {
+    static const off_t am335xBankOffsets[BANK_COUNT] = {
+        GPIO_MEMORY_MAP_AM335X_GPIO0,
+        GPIO_MEMORY_MAP_AM335X_GPIO1,
+        GPIO_MEMORY_MAP_AM335X_GPIO2,
+        GPIO_MEMORY_MAP_AM335X_GPIO3,
+    };
+
+    this->path = path;
+    for (int i = 0; i < BANK_COUNT; i++) {
+        this->bankOffsets[i] = bankOffsets != nullptr ? bankOffsets[i] : am335xBankOffsets[i];
+        this->banks[i] = nullptr;
+    }
+    this->fileDescriptor = -1;
+}
+
+GPIOMemoryMap::~GPIOMemoryMap() {
+    this->close();
+}
+
+// Map the register window of every bank
+int GPIOMemoryMap::open() {
+    if (this->isOpen()) {
+        return 0;
+    }
+
+    // Registers must not be cached by the page cache or reordered
+    this->fileDescriptor = ::open(this->path.c_str(), O_RDWR | O_SYNC | O_CLOEXEC);
+    if (this->fileDescriptor < 0) {
+        std::cout << "GPIOMemoryMap: Error opening " << this->path << std::endl;
+        return -1;
+    }
+
+    for (int i = 0; i < BANK_COUNT; i++) {
+        void *bank = ::mmap(nullptr, GPIO_MEMORY_MAP_BANK_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, this->fileDescriptor, this->bankOffsets[i]);
+        if (bank == MAP_FAILED) {
+            std::cout << "GPIOMemoryMap: Error mapping bank " << i << " of " << this->path << std::endl;
+            this->close();
+            return -1;
+        }
+        this->banks[i] = static_cast<uint8_t *>(bank);
+    }
+    return 0;
+}
+
+// Unmap every bank
+void GPIOMemoryMap::close() {
+    for (int i = 0; i < BANK_COUNT; i++) {
+        if (this->banks[i] != nullptr) {
+            ::munmap(this->banks[i], GPIO_MEMORY_MAP_BANK_SIZE);
+            this->banks[i] = nullptr;
+        }
+    }
+    if (this->fileDescriptor >= 0) {
+        ::close(this->fileDescriptor);
+        this->fileDescriptor = -1;
+    }
+}
+
+// If the banks are mapped
+bool GPIOMemoryMap::isOpen() {
+    return this->banks[BANK_COUNT - 1] != nullptr;
+}
+
+// Get a register of the bank holding a GPIO number (null if not mapped)
+volatile uint32_t *GPIOMemoryMap::getRegister(int number, REGISTER reg) {
+    int bank = getBank(number);
+    if (bank < 0 || bank >= BANK_COUNT || this->banks[bank] == nullptr) {
+        return nullptr;
+    }
+    return reinterpret_cast<volatile uint32_t *>(this->banks[bank] + reg);
+}
+
+// Get the bit of a GPIO number within its bank registers
+uint32_t GPIOMemoryMap::getMask(int number) {
+    return static_cast<uint32_t>(1) << (number % PINS_PER_BANK);
+}
+
+// Get the bank holding a GPIO number
+int GPIOMemoryMap::getBank(int number) {
+    return number / PINS_PER_BANK;
+}
+
+} /* namespace tids */
@@ -0,0 +1,79 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GPIOMEMORYMAP_H
+#define GPIOMEMORYMAP_H
+
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+
+namespace tids {
+
+// Path of physical memory, whose AM335x GPIO bank registers are mapped by default
+#define GPIO_MEMORY_MAP_PATH "/dev/mem"
+
+// Register windows of the four AM335x GPIO banks mapped from a file
+// The file is /dev/mem on the BeagleBone, or any mmap-able file (such as a plain file in tests)
+class GPIOMemoryMap {
+public:
+    static const int BANK_COUNT = 4;
+    static const int PINS_PER_BANK = 32;
+
+    // Register byte offsets within a bank
+    enum REGISTER {
+        OE = 0x134,
+        DATAIN = 0x138,
+        DATAOUT = 0x13C,
+        CLEARDATAOUT = 0x190,
+        SETDATAOUT = 0x194,
+    };
+
+private:
+    std::string path;
+    off_t bankOffsets[BANK_COUNT];
+    int fileDescriptor;
+    uint8_t *banks[BANK_COUNT];
+
+public:
+    // Bank offsets within the file default to the AM335x physical bank addresses
+    GPIOMemoryMap(std::string path=GPIO_MEMORY_MAP_PATH, const off_t *bankOffsets=nullptr);
+    virtual ~GPIOMemoryMap();
+
+    // Map the register window of every bank
+    int open();
+
+    // Unmap every bank
+    void close();
+
+    // If the banks are mapped
+    bool isOpen();
+
+    // Get a register of the bank holding a GPIO number (null if not mapped)
+    volatile uint32_t *getRegister(int number, REGISTER reg);
+
+    // Get the bit of a GPIO number within its bank registers
+    static uint32_t getMask(int number);
+
+    // Get the bank holding a GPIO number
+    static int getBank(int number);
+};
+
+} /* namespace tids */
+
+#endif /* GPIOMEMORYMAP_H */
@@ -21,19 +21,53 @@
 
 #include "HX711.h"
 
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
 #include <thread>
 #include <iostream>
 
+#include "Clock.h"
+
 // Length of HX711 data to read, in bits
 #define HX711_DATA_LENGTH 24
 
+// Interval between data ready checks when DOUT edges are unavailable, well below the 12.5 ms conversion period at 80 SPS
+#define HX711_READY_POLL_INTERVAL_US 500
+
+// Data ready wait timeout, in conversion periods (also covers the 400 ms settling time after power up at 10 SPS)
+#define HX711_READY_TIMEOUT_PERIODS 5
+
+// Longest median filter
+#define HX711_MEDIAN_LENGTH_MAX 15
+
 namespace tids {
 
-HX711::HX711(bbbkit::GPIO::PIN pinDOUT, bbbkit::GPIO::PIN pinPD_SCK, float scale, long offset, GAIN gain) {
-    this->gpioDOUT = new bbbkit::GPIO(pinDOUT, bbbkit::GPIO::DIRECTION::INPUT);
-    this->gpioPD_SCK = new bbbkit::GPIO(pinPD_SCK, bbbkit::GPIO::DIRECTION::OUTPUT);
+HX711::HX711(bbbkit::GPIO::PIN pinDOUT, bbbkit::GPIO::PIN pinPD_SCK, float scale, long offset, GAIN gain, RATE rate, GPIOMemoryMap *gpioMemoryMap) {
+    // Registers are used for bit-banging when the GPIO banks are memory mapped
+    this->gpioDOUT = new FastGPIO(pinDOUT, bbbkit::GPIO::DIRECTION::INPUT, bbbkit::GPIO::VALUE::LOW, gpioMemoryMap);
+    this->gpioPD_SCK = new FastGPIO(pinPD_SCK, bbbkit::GPIO::DIRECTION::OUTPUT, bbbkit::GPIO::VALUE::LOW, gpioMemoryMap);
+
+    // DOUT falls when a conversion is ready
+    this->edgeDOUT = new GPIOEdge(pinDOUT);
+    if (this->gpioDOUT->getGPIO()->setEdgeType(bbbkit::GPIO::EDGE::FALLING) < 0 || this->edgeDOUT->open() < 0) {
+        std::cout << "HX711: Error enabling DOUT edge interrupts, polling instead" << std::endl;
+        delete this->edgeDOUT;
+        this->edgeDOUT = nullptr;
+    }
+    this->setRate(rate);
+
+    this->acquisitionThreadShouldCancel = true;
+    this->samples = nullptr;
+    this->latestRaw = 0;
+    this->medianLength = 1;
+    this->filteredCount = 0;
+    this->iirAlpha = 1.0f;
+    this->iirValue = 0.0;
+    this->missedConversionCount = 0;
+    this->readyTimeoutCount = 0;
+    this->lastReadyTimeNS = 0;
+    this->measureLatency = false;
 
     this->setScale(scale);
     this->setOffset(offset);
@@ -41,6 +75,9 @@ HX711::HX711(bbbkit::GPIO::PIN pinDOUT, bbbkit::GPIO::PIN pinPD_SCK, float scale
 }
 
 HX711::~HX711() {
+    this->stopAcquisition();
+    delete this->samples;
+    delete this->edgeDOUT;
     delete this->gpioDOUT;
     delete this->gpioPD_SCK;
 }
@@ -52,61 +89,48 @@ bool HX711::isReady() {
 
 // Get gain factor
 HX711::GAIN HX711::getGain() {
-    return this->gain;
+    return static_cast<HX711::GAIN>(this->gain.load());
 }
 
 // Set new gain factor after the next read
 int HX711::setGain(GAIN gain) {
     this->gain = gain;
-    
+
+    // The acquisition thread selects the new gain with its next conversion
+    if (this->isAcquiring()) {
+        return 0;
+    }
+
     // Perform a read in order to set the new gain factor
     this->gpioPD_SCK->setValue(bbbkit::GPIO::VALUE::LOW);
     this->readRaw();
     return 0;
 }
 
-// Read raw data value
+// Read raw data value (latest filtered value without blocking in acquisition mode)
 long HX711::readRaw() {
-    // Wait until chip is ready
-    this->gpioPD_SCK->setValue(bbbkit::GPIO::VALUE::LOW);
-    while (!this->isReady()) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-    }
-
-    uint32_t data = 0;
-    for (int bitIndex = 0; bitIndex < HX711_DATA_LENGTH; bitIndex++) {
-        // Read data bit by switching clock pin
-        this->gpioPD_SCK->setValue(bbbkit::GPIO::VALUE::HIGH);
-	std::this_thread::sleep_for(std::chrono::microseconds(20));
-        uint32_t bit = static_cast<uint32_t>(this->gpioDOUT->getValue());
-        this->gpioPD_SCK->setValue(bbbkit::GPIO::VALUE::LOW);
-	std::cout << "Bit #" << bitIndex << ": " << bit << std::endl;
-
-        // Construct 24-bit data
-        data |= (bit << (HX711_DATA_LENGTH - 1 - bitIndex));
+    if (this->isAcquiring()) {
+        return this->latestRaw;
     }
 
-    // Write the gain by switching clock pin
-    int gainWriteClockTicks = static_cast<int>(this->gain);
-    for (int gainIndex = 0; gainIndex < gainWriteClockTicks; gainIndex++) {
-        this->gpioPD_SCK->setValue(bbbkit::GPIO::VALUE::HIGH);
-        this->gpioPD_SCK->setValue(bbbkit::GPIO::VALUE::LOW);
-    }
-
-    // Pad 32-bits for signed data
-    if (data & (0x1 << (HX711_DATA_LENGTH - 1))) {
-        data |= ((uint32_t)0xFF << HX711_DATA_LENGTH);
+    // Wait until chip is ready
+    this->gpioPD_SCK->setValue(bbbkit::GPIO::VALUE::LOW);
+    int64_t readyTimeNS;
+    while (this->waitReady(HX711_READY_TIMEOUT_PERIODS * this->conversionPeriodNS, &readyTimeNS) == 0) {
+        this->readyTimeoutCount++;
+        std::cout << "HX711: Error timed out waiting for data ready" << std::endl;
     }
-
-    // Cast from uint32 to int32 to long in order to preserve signed value for any size of long
-    return static_cast<long>(static_cast<int32_t>(data));
+    return this->readConversion();
 }
 
-// Read raw data value (averaged over count)
+// Read raw data value (averaged over count, latest filtered value without blocking in acquisition mode)
 long HX711::readRaw(int count) {
     if (count < 1) {
         return 0;
     }
+    if (this->isAcquiring()) {
+        return this->latestRaw;
+    }
 
     // Sum raw data
     long long readSum = 0;
@@ -119,7 +143,7 @@ long HX711::readRaw(int count) {
     return static_cast<long>(readSum / count);
 }
 
-// Read weight value for the specified offset and scale (averaged over count)
+// Read weight value for the specified offset and scale (averaged over count, latest filtered value without blocking in acquisition mode)
 float HX711::readWeight(int count) {
     return static_cast<float>(this->readRaw(count) - this->offset) / this->getScale();
 }
@@ -152,6 +176,20 @@ int HX711::tare(int count) {
     return this->setOffset(rawAvg);
 }
 
+// Get output data rate
+HX711::RATE HX711::getRate() {
+    return static_cast<HX711::RATE>(1000000000LL / this->conversionPeriodNS);
+}
+
+// Set output data rate the RATE pin is wired for (used to detect missed conversions)
+int HX711::setRate(RATE rate) {
+    if (this->isAcquiring()) {
+        return -1;
+    }
+    this->conversionPeriodNS = 1000000000LL / rate;
+    return 0;
+}
+
 // Power down HX711
 void HX711::powerDown() {
     // Hold clock pin high
@@ -165,4 +203,254 @@ void HX711::powerUp() {
     this->gpioPD_SCK->setValue(bbbkit::GPIO::VALUE::LOW);
 }
 
+// Set median length and IIR smoothing factor of acquisition mode (only before acquisition starts)
+int HX711::setFilter(int medianLength, float iirAlpha) {
+    if (this->isAcquiring() || medianLength < 1 || medianLength > HX711_MEDIAN_LENGTH_MAX || !(iirAlpha > 0.0f && iirAlpha <= 1.0f)) {
+        return -1;
+    }
+    this->medianLength = medianLength;
+    this->iirAlpha = iirAlpha;
+    return 0;
+}
+
+// Start clocking out every conversion on a background thread into a ring buffer of capacity samples
+int HX711::startAcquisition(size_t capacity) {
+    // Return if the acquisition thread already exists
+    if (this->isAcquiring()) {
+        return -1;
+    }
+
+    delete this->samples;
+    this->samples = new SPSCRingBuffer<Sample>(capacity);
+    this->medianWindow.assign(this->medianLength, 0);
+    this->filteredCount = 0;
+    this->lastReadyTimeNS = 0;
+
+    // Wake up so conversions start
+    this->gpioPD_SCK->setValue(bbbkit::GPIO::VALUE::LOW);
+
+    // Reset cancellation token
+    this->acquisitionThreadShouldCancel = false;
+    // Start acquisition on new thread
+    this->acquisitionThread = std::thread(&HX711::acquire, this);
+    return 0;
+}
+
+// Stop background acquisition
+int HX711::stopAcquisition() {
+    // Cancel and join acquisition thread
+    this->acquisitionThreadShouldCancel = true;
+    if (this->acquisitionThread.joinable()) {
+        this->acquisitionThread.join();
+    }
+    return 0;
+}
+
+// If background acquisition is running
+bool HX711::isAcquiring() {
+    return !this->acquisitionThreadShouldCancel;
+}
+
+// Get latest filtered weight sample (returns -1 if none has been acquired)
+int HX711::getLatestSample(Sample *sample) {
+    return this->latestWeight.read(sample);
+}
+
+// Pop up to maxCount acquired samples, oldest first (single consumer only, returns number popped)
+size_t HX711::readSamples(Sample *samples, size_t maxCount) {
+    if (this->samples == nullptr) {
+        return 0;
+    }
+    return this->samples->pop(samples, maxCount);
+}
+
+// Get number of acquired samples dropped because the consumer fell behind
+uint64_t HX711::getOverflowCount() {
+    if (this->samples == nullptr) {
+        return 0;
+    }
+    return this->samples->getOverflowCount();
+}
+
+// Get number of conversions overwritten before they were read in acquisition mode
+uint64_t HX711::getMissedConversionCount() {
+    return this->missedConversionCount;
+}
+
+// Get number of data ready waits that timed out
+uint64_t HX711::getReadyTimeoutCount() {
+    return this->readyTimeoutCount;
+}
+
+// Enable or disable ready-to-read latency measurement (only before acquisition starts)
+int HX711::setLatencyMeasurement(bool enabled) {
+    if (this->isAcquiring()) {
+        return -1;
+    }
+    this->measureLatency = enabled;
+    if (enabled) {
+        this->readLatency.reset();
+    }
+    return 0;
+}
+
+// Get ready-to-read latency distribution of acquired conversions
+LatencyHistogram *HX711::getReadLatency() {
+    return &this->readLatency;
+}
+
+// Wait for data ready for up to timeoutNS nanoseconds (returns 1 when ready, 0 on timeout, or -1 on error)
+int HX711::waitReady(int64_t timeoutNS, int64_t *readyTimeNS) {
+    int64_t deadlineNS = Clock::monotonicNS() + timeoutNS;
+    while (true) {
+        // Check the level first, since DOUT may have fallen before the wait began
+        int64_t timeNS = Clock::monotonicNS();
+        bool ready = this->edgeDOUT != nullptr && !this->gpioDOUT->isMapped() ? this->edgeDOUT->readValue() == 0 : this->isReady();
+        if (ready) {
+            *readyTimeNS = timeNS;
+            return 1;
+        }
+
+        int64_t remainingNS = deadlineNS - timeNS;
+        if (remainingNS <= 0) {
+            return 0;
+        }
+
+        if (this->edgeDOUT != nullptr) {
+            // Edges from data bits clocked out of the previous conversion are rejected by the level check
+            if (this->edgeDOUT->wait(remainingNS) < 0) {
+                std::cout << "HX711: Error waiting for DOUT edge, polling instead" << std::endl;
+                delete this->edgeDOUT;
+                this->edgeDOUT = nullptr;
+            }
+        } else {
+            int64_t sleepNS = std::min<int64_t>(remainingNS, HX711_READY_POLL_INTERVAL_US * 1000LL);
+            std::this_thread::sleep_for(std::chrono::nanoseconds(sleepNS));
+        }
+    }
+}
+
+// Clock out a conversion that is ready and select the gain of the next one
+long HX711::readConversion() {
+    // PD_SCK must not stay high for more than 60 us, or the HX711 powers down
+    bool mapped = this->gpioDOUT->isMapped();
+    uint32_t data = 0;
+    for (int bitIndex = 0; bitIndex < HX711_DATA_LENGTH; bitIndex++) {
+        // Read data bit by switching clock pin
+        this->gpioPD_SCK->setValue(bbbkit::GPIO::VALUE::HIGH);
+        if (mapped) {
+            // Register reads take a few hundred ns, so a discarded read covers the 0.1 us data valid time
+            this->gpioDOUT->getValue();
+        }
+        uint32_t bit = static_cast<uint32_t>(this->gpioDOUT->getValue());
+        this->gpioPD_SCK->setValue(bbbkit::GPIO::VALUE::LOW);
+        if (mapped) {
+            // Likewise covers the 0.2 us minimum low time before the next rising edge
+            this->gpioDOUT->getValue();
+        }
+
+        // Construct 24-bit data
+        data |= (bit << (HX711_DATA_LENGTH - 1 - bitIndex));
+    }
+
+    // Write the gain by switching clock pin
+    int gainWriteClockTicks = this->gain;
+    for (int gainIndex = 0; gainIndex < gainWriteClockTicks; gainIndex++) {
+        // Back-to-back register stores can be far shorter than the 0.2 us minimum high and low times
+        this->gpioPD_SCK->setValue(bbbkit::GPIO::VALUE::HIGH);
+        if (mapped) {
+            this->gpioDOUT->getValue();
+        }
+        this->gpioPD_SCK->setValue(bbbkit::GPIO::VALUE::LOW);
+        if (mapped) {
+            this->gpioDOUT->getValue();
+        }
+    }
+
+    // Pad 32-bits for signed data
+    if (data & (0x1 << (HX711_DATA_LENGTH - 1))) {
+        data |= ((uint32_t)0xFF << HX711_DATA_LENGTH);
+    }
+
+    // Cast from uint32 to int32 to long in order to preserve signed value for any size of long
+    return static_cast<long>(static_cast<int32_t>(data));
+}
+
+// Continuously acquire conversions until cancellation token
+void HX711::acquire() {
+    int waitedPeriods = 0;
+    while (!this->acquisitionThreadShouldCancel) {
+        // Wait one period at a time so cancellation is noticed promptly
+        int64_t timeNS;
+        int result = this->waitReady(this->conversionPeriodNS, &timeNS);
+        if (result < 0) {
+            continue;
+        }
+        if (result == 0) {
+            waitedPeriods++;
+            if (waitedPeriods == HX711_READY_TIMEOUT_PERIODS) {
+                this->readyTimeoutCount++;
+                std::cout << "HX711: Error timed out waiting for data ready" << std::endl;
+                // The gap is a stall rather than missed conversions
+                this->lastReadyTimeNS = 0;
+                waitedPeriods = 0;
+            }
+            continue;
+        }
+        waitedPeriods = 0;
+
+        // Conversions arriving more than half a period late were overwritten by the next one
+        if (this->lastReadyTimeNS != 0) {
+            int64_t periods = (timeNS - this->lastReadyTimeNS + this->conversionPeriodNS / 2) / this->conversionPeriodNS;
+            if (periods > 1) {
+                this->missedConversionCount += periods - 1;
+            }
+        }
+        this->lastReadyTimeNS = timeNS;
+
+        // Stamp with the time the conversion was found ready
+        long raw = this->filter(this->readConversion());
+        this->latestRaw = raw;
+        if (this->measureLatency) {
+            this->readLatency.record(Clock::monotonicNS() - timeNS);
+        }
+
+        float weight = static_cast<float>(raw - this->offset) / this->getScale();
+        this->latestWeight.publish(timeNS, weight);
+        Sample sample;
+        sample.timeNS = timeNS;
+        sample.value = weight;
+        // Dropped samples are counted by the ring buffer
+        this->samples->push(sample);
+    }
+}
+
+// Apply median and IIR filters to a raw value
+long HX711::filter(long raw) {
+    long value = raw;
+
+    // Median of the last medianLength values (fewer until the window fills)
+    if (this->medianLength > 1) {
+        this->medianWindow[this->filteredCount % this->medianLength] = raw;
+        size_t count = static_cast<size_t>(std::min<uint64_t>(this->filteredCount + 1, this->medianLength));
+        long sorted[HX711_MEDIAN_LENGTH_MAX];
+        std::copy(this->medianWindow.begin(), this->medianWindow.begin() + count, sorted);
+        std::nth_element(sorted, sorted + count / 2, sorted + count);
+        value = sorted[count / 2];
+    }
+
+    // First-order low-pass, starting from the first value
+    if (this->iirAlpha < 1.0f) {
+        if (this->filteredCount == 0) {
+            this->iirValue = value;
+        } else {
+            this->iirValue += this->iirAlpha * (value - this->iirValue);
+        }
+        value = static_cast<long>(this->iirValue + (this->iirValue >= 0.0 ? 0.5 : -0.5));
+    }
+
+    this->filteredCount++;
+    return value;
+}
+
 } /* namespace tids */
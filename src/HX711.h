@@ -24,6 +24,19 @@
 
 #include <libbbbkit/GPIO.h>
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "FastGPIO.h"
+#include "GPIOEdge.h"
+#include "GPIOMemoryMap.h"
+#include "LatencyHistogram.h"
+#include "SampleSlot.h"
+#include "SPSCRingBuffer.h"
+
 namespace tids {
 
 class HX711 {
@@ -33,14 +46,52 @@ public:
         B_32 = 2,
         A_64 = 3,
     };
+    // Output data rate selected by the RATE pin, in samples per second
+    enum RATE {
+        SPS_10 = 10,
+        SPS_80 = 80,
+    };
 private:
-    bbbkit::GPIO *gpioDOUT;
-    bbbkit::GPIO *gpioPD_SCK;
-    HX711::GAIN gain;
-    long offset;
-    float scale;
+    FastGPIO *gpioDOUT;
+    FastGPIO *gpioPD_SCK;
+
+    // Interrupt on DOUT falling when a conversion is ready (null if unavailable, then DOUT is polled)
+    GPIOEdge *edgeDOUT;
+    int64_t conversionPeriodNS;
+    std::atomic<int> gain;
+    std::atomic<long> offset;
+    std::atomic<float> scale;
+
+    // Acquisition mode: conversions clocked out by a background thread as soon as DOUT falls
+    std::thread acquisitionThread;
+    std::atomic<bool> acquisitionThreadShouldCancel;
+
+    // Timestamped filtered weights in kg, for a single consumer
+    SPSCRingBuffer<Sample> *samples;
+
+    // Latest filtered raw value and weight
+    std::atomic<long> latestRaw;
+    SampleSlot latestWeight;
+
+    // Median filter over the last medianLength raw values (1 disables)
+    int medianLength;
+    std::vector<long> medianWindow;
+    uint64_t filteredCount;
+    // IIR low-pass smoothing factor applied after the median (1 disables)
+    float iirAlpha;
+    double iirValue;
+
+    // Conversions overwritten before they were read, and waits that timed out with no conversion
+    std::atomic<uint64_t> missedConversionCount;
+    std::atomic<uint64_t> readyTimeoutCount;
+    int64_t lastReadyTimeNS;
+
+    // Measurement mode: latency from data ready to conversion read, per acquired conversion
+    bool measureLatency;
+    LatencyHistogram readLatency;
+
 public:
-    HX711(bbbkit::GPIO::PIN pinDOUT, bbbkit::GPIO::PIN pinPD_SCK, float scale=1.0f, long offset=0, GAIN gain=A_128);
+    HX711(bbbkit::GPIO::PIN pinDOUT, bbbkit::GPIO::PIN pinPD_SCK, float scale=1.0f, long offset=0, GAIN gain=A_128, RATE rate=SPS_10, GPIOMemoryMap *gpioMemoryMap=nullptr);
     virtual ~HX711();
 
     // Check if HX711 has data ready to read
@@ -52,13 +103,13 @@ public:
     // Set new gain factor after the next read
     int setGain(GAIN gain);
 
-    // Read raw data value
+    // Read raw data value (latest filtered value without blocking in acquisition mode)
     long readRaw();
 
-    // Read raw data value (averaged over count)
+    // Read raw data value (averaged over count, latest filtered value without blocking in acquisition mode)
     long readRaw(int count);
 
-    // Read weight value for the specified offset and scale (averaged over count)
+    // Read weight value for the specified offset and scale (averaged over count, latest filtered value without blocking in acquisition mode)
     float readWeight(int count=1);
 
     // Get offset
@@ -76,11 +127,63 @@ public:
     // Zero HX711 by setting the current weight as the offset (averaged over count)
     int tare(int count=1);
 
+    // Get output data rate
+    RATE getRate();
+
+    // Set output data rate the RATE pin is wired for (used to detect missed conversions)
+    int setRate(RATE rate);
+
     // Power down HX711
     void powerDown();
 
     // Wake up HX711
     void powerUp();
+
+    // Set median length and IIR smoothing factor of acquisition mode (only before acquisition starts)
+    int setFilter(int medianLength, float iirAlpha);
+
+    // Start clocking out every conversion on a background thread into a ring buffer of capacity samples
+    int startAcquisition(size_t capacity);
+
+    // Stop background acquisition
+    int stopAcquisition();
+
+    // If background acquisition is running
+    bool isAcquiring();
+
+    // Get latest filtered weight sample (returns -1 if none has been acquired)
+    int getLatestSample(Sample *sample);
+
+    // Pop up to maxCount acquired samples, oldest first (single consumer only, returns number popped)
+    size_t readSamples(Sample *samples, size_t maxCount);
+
+    // Get number of acquired samples dropped because the consumer fell behind
+    uint64_t getOverflowCount();
+
+    // Get number of conversions overwritten before they were read in acquisition mode
+    uint64_t getMissedConversionCount();
+
+    // Get number of data ready waits that timed out
+    uint64_t getReadyTimeoutCount();
+
+    // Enable or disable ready-to-read latency measurement (only before acquisition starts)
+    int setLatencyMeasurement(bool enabled);
+
+    // Get ready-to-read latency distribution of acquired conversions
+    LatencyHistogram *getReadLatency();
+
+private:
+    // Wait for data ready for up to timeoutNS nanoseconds (returns 1 when ready, 0 on timeout, or -1 on error)
+    int waitReady(int64_t timeoutNS, int64_t *readyTimeNS);
+
+    // Clock out a conversion that is ready and select the gain of the next one
+    long readConversion();
+
+    // Continuously acquire conversions until cancellation token
+    void acquire();
+
+    // Apply median and IIR filters to a raw value
+    long filter(long raw);
 };
 
 } /* namespace tids */
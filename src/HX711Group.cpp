@@ -0,0 +1,450 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "HX711Group.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#include "Clock.h"
+
+// Length of HX711 data to read, in bits
+#define HX711GROUP_DATA_LENGTH 24
+
+// Interval between data ready checks when DOUT edges are unavailable
+#define HX711GROUP_READY_POLL_INTERVAL_US 500
+
+// Data ready wait timeout, in conversion periods
+#define HX711GROUP_READY_TIMEOUT_PERIODS 5
+
+// Conversions discarded after a gain change or power up (output settles in 4 conversions)
+#define HX711GROUP_SETTLING_CONVERSIONS 4
+
+// Conversions read at each gain before moving to the next when channels use different gains
+#define HX711GROUP_GAIN_DWELL_CONVERSIONS 16
+
+namespace tids {
+
+HX711Group::HX711Group(bbbkit::GPIO::PIN pinPD_SCK, HX711::RATE rate, GPIOMemoryMap *gpioMemoryMap) {
+    this->gpioMemoryMap = gpioMemoryMap;
+    this->gpioPD_SCK = new FastGPIO(pinPD_SCK, bbbkit::GPIO::DIRECTION::OUTPUT, bbbkit::GPIO::VALUE::LOW, gpioMemoryMap);
+
+    this->gainScheduleIndex = 0;
+    this->gainPassCount = 0;
+    // Gain left by a previous user is unknown, so the first conversions are discarded
+    this->settlingCount = HX711GROUP_SETTLING_CONVERSIONS;
+    this->convertingGain = HX711::GAIN::A_128;
+    this->conversionPeriodNS = 1000000000LL / rate;
+
+    this->acquisitionThreadShouldCancel = true;
+    this->readyTimeoutCount = 0;
+}
+
+HX711Group::~HX711Group() {
+    this->stopAcquisition();
+    for (Channel *channel : this->channels) {
+        delete channel;
+    }
+    for (Device &device : this->devices) {
+        delete device.edgeDOUT;
+        delete device.gpioDOUT;
+    }
+    delete this->gpioPD_SCK;
+}
+
+// Add a channel for the device on pinDOUT (devices are added on first use, returns channel index, or -1 on error)
+int HX711Group::addChannel(bbbkit::GPIO::PIN pinDOUT, HX711::GAIN gain, float scale, long offset) {
+    if (this->isAcquiring()) {
+        return -1;
+    }
+
+    // Find or add the device
+    int deviceIndex = -1;
+    for (size_t i = 0; i < this->devices.size(); i++) {
+        if (this->devices[i].pin == pinDOUT) {
+            deviceIndex = static_cast<int>(i);
+        }
+    }
+    if (deviceIndex < 0) {
+        Device device;
+        device.pin = pinDOUT;
+        device.gpioDOUT = new FastGPIO(pinDOUT, bbbkit::GPIO::DIRECTION::INPUT, bbbkit::GPIO::VALUE::LOW, this->gpioMemoryMap);
+        device.bank = 0;
+        device.edgeDOUT = new GPIOEdge(pinDOUT);
+        if (device.gpioDOUT->getGPIO()->setEdgeType(bbbkit::GPIO::EDGE::FALLING) < 0 || device.edgeDOUT->open() < 0) {
+            std::cout << "HX711Group: Error enabling DOUT edge interrupts, polling instead" << std::endl;
+            delete device.edgeDOUT;
+            device.edgeDOUT = nullptr;
+        }
+        deviceIndex = static_cast<int>(this->devices.size());
+        this->devices.push_back(device);
+        this->passValues.resize(this->devices.size());
+        this->updateBankRegisters();
+    }
+
+    Channel *channel = new Channel();
+    channel->device = deviceIndex;
+    channel->gain = gain;
+    channel->offset = offset;
+    channel->scale = scale;
+    channel->latestRaw = 0;
+    channel->count = 0;
+    this->channels.push_back(channel);
+
+    if (std::find(this->gainSchedule.begin(), this->gainSchedule.end(), gain) == this->gainSchedule.end()) {
+        this->gainSchedule.push_back(gain);
+    }
+    return static_cast<int>(this->channels.size()) - 1;
+}
+
+// Get number of channels
+int HX711Group::getChannelCount() {
+    return static_cast<int>(this->channels.size());
+}
+
+// Check if every device has data ready to read
+bool HX711Group::isReady() {
+    for (Device &device : this->devices) {
+        if (this->readDOUT(&device) != bbbkit::GPIO::VALUE::LOW) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Wait for every device and read one conversion from each (returns -1 on timeout)
+int HX711Group::read() {
+    if (this->channels.empty()) {
+        return -1;
+    }
+    if (this->readConversion(HX711GROUP_READY_TIMEOUT_PERIODS * this->conversionPeriodNS) == 0) {
+        this->readyTimeoutCount++;
+        std::cout << "HX711Group: Error timed out waiting for data ready" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+// Read raw data value of a channel (averaged over count, latest value without blocking in acquisition mode)
+long HX711Group::readRaw(int channel, int count) {
+    if (channel < 0 || channel >= this->getChannelCount() || count < 1) {
+        return 0;
+    }
+    Channel *entry = this->channels[channel];
+    if (this->isAcquiring()) {
+        return entry->latestRaw;
+    }
+
+    // Read passes until the channel has count new values
+    long long readSum = 0;
+    int readCount = 0;
+    while (readCount < count) {
+        uint64_t previousCount = entry->count;
+        this->read();
+        if (entry->count != previousCount) {
+            readSum += entry->latestRaw;
+            readCount++;
+        }
+    }
+
+    // Average over count
+    return static_cast<long>(readSum / count);
+}
+
+// Read weight value of a channel for its offset and scale (averaged over count, latest value without blocking in acquisition mode)
+float HX711Group::readWeight(int channel, int count) {
+    return static_cast<float>(this->readRaw(channel, count) - this->getOffset(channel)) / this->getScale(channel);
+}
+
+// Get latest weight sample of a channel (returns -1 if none has been read)
+int HX711Group::getLatestSample(int channel, Sample *sample) {
+    if (channel < 0 || channel >= this->getChannelCount()) {
+        return -1;
+    }
+    return this->channels[channel]->latestWeight.read(sample);
+}
+
+// Get offset of a channel
+long HX711Group::getOffset(int channel) {
+    if (channel < 0 || channel >= this->getChannelCount()) {
+        return 0;
+    }
+    return this->channels[channel]->offset;
+}
+
+// Set offset of a channel
+int HX711Group::setOffset(int channel, long offset) {
+    if (channel < 0 || channel >= this->getChannelCount()) {
+        return -1;
+    }
+    this->channels[channel]->offset = offset;
+    return 0;
+}
+
+// Get scale of a channel
+float HX711Group::getScale(int channel) {
+    if (channel < 0 || channel >= this->getChannelCount()) {
+        return 1.0f;
+    }
+    return this->channels[channel]->scale;
+}
+
+// Set scale of a channel
+int HX711Group::setScale(int channel, float scale) {
+    if (channel < 0 || channel >= this->getChannelCount()) {
+        return -1;
+    }
+    this->channels[channel]->scale = scale;
+    return 0;
+}
+
+// Zero a channel by setting its current weight as the offset (averaged over count)
+int HX711Group::tare(int channel, int count) {
+    long rawAvg = this->readRaw(channel, count);
+    return this->setOffset(channel, rawAvg);
+}
+
+// Power down every device
+void HX711Group::powerDown() {
+    // Hold clock pin high
+    this->gpioPD_SCK->setValue(bbbkit::GPIO::VALUE::LOW);
+    this->gpioPD_SCK->setValue(bbbkit::GPIO::VALUE::HIGH);
+}
+
+// Wake up every device
+void HX711Group::powerUp() {
+    // Reset clock pin low, devices restart at gain A_128 and need to settle
+    this->gpioPD_SCK->setValue(bbbkit::GPIO::VALUE::LOW);
+    this->convertingGain = HX711::GAIN::A_128;
+    this->settlingCount = HX711GROUP_SETTLING_CONVERSIONS;
+}
+
+// Start reading every conversion on a background thread (channels cannot be added while acquiring)
+int HX711Group::startAcquisition() {
+    // Return if the acquisition thread already exists or there is nothing to read
+    if (this->isAcquiring() || this->channels.empty()) {
+        return -1;
+    }
+
+    // Reset cancellation token
+    this->acquisitionThreadShouldCancel = false;
+    // Start acquisition on new thread
+    this->acquisitionThread = std::thread(&HX711Group::acquire, this);
+    return 0;
+}
+
+// Stop background acquisition
+int HX711Group::stopAcquisition() {
+    // Cancel and join acquisition thread
+    this->acquisitionThreadShouldCancel = true;
+    if (this->acquisitionThread.joinable()) {
+        this->acquisitionThread.join();
+    }
+    return 0;
+}
+
+// If background acquisition is running
+bool HX711Group::isAcquiring() {
+    return !this->acquisitionThreadShouldCancel;
+}
+
+// Get number of data ready waits that timed out
+uint64_t HX711Group::getReadyTimeoutCount() {
+    return this->readyTimeoutCount;
+}
+
+// Read the DOUT level of a device
+int HX711Group::readDOUT(Device *device) {
+    if (device->edgeDOUT != nullptr && !device->gpioDOUT->isMapped()) {
+        return device->edgeDOUT->readValue();
+    }
+    return device->gpioDOUT->getValue();
+}
+
+// Collect the data in registers read on each clock pulse if every device is memory mapped
+void HX711Group::updateBankRegisters() {
+    this->bankRegisters.clear();
+    for (Device &device : this->devices) {
+        if (!device.gpioDOUT->isMapped()) {
+            this->bankRegisters.clear();
+            break;
+        }
+
+        // Devices in the same bank share one register read
+        volatile uint32_t *dataIn = device.gpioDOUT->getDataInRegister();
+        device.bank = std::find(this->bankRegisters.begin(), this->bankRegisters.end(), dataIn) - this->bankRegisters.begin();
+        if (device.bank == this->bankRegisters.size()) {
+            this->bankRegisters.push_back(dataIn);
+        }
+    }
+    this->bankValues.resize(this->bankRegisters.size());
+}
+
+// Wait for every device to have data ready for up to timeoutNS nanoseconds (returns 1 when ready, 0 on timeout)
+int HX711Group::waitReady(int64_t timeoutNS) {
+    int64_t deadlineNS = Clock::monotonicNS() + timeoutNS;
+    // A device stays ready until it is read, so devices can be waited for one after another
+    for (Device &device : this->devices) {
+        while (this->readDOUT(&device) != bbbkit::GPIO::VALUE::LOW) {
+            int64_t remainingNS = deadlineNS - Clock::monotonicNS();
+            if (remainingNS <= 0) {
+                return 0;
+            }
+
+            if (device.edgeDOUT != nullptr) {
+                if (device.edgeDOUT->wait(remainingNS) < 0) {
+                    std::cout << "HX711Group: Error waiting for DOUT edge, polling instead" << std::endl;
+                    delete device.edgeDOUT;
+                    device.edgeDOUT = nullptr;
+                }
+            } else {
+                int64_t sleepNS = std::min<int64_t>(remainingNS, HX711GROUP_READY_POLL_INTERVAL_US * 1000LL);
+                std::this_thread::sleep_for(std::chrono::nanoseconds(sleepNS));
+            }
+        }
+    }
+    return 1;
+}
+
+// Wait for up to timeoutNS nanoseconds and read one conversion from every device into the channels (returns 1 when read, 0 on timeout)
+int HX711Group::readConversion(int64_t timeoutNS) {
+    if (this->waitReady(timeoutNS) == 0) {
+        return 0;
+    }
+
+    // Stamp with the time the last device was found ready
+    int64_t timeNS = Clock::monotonicNS();
+    HX711::GAIN gain = this->convertingGain;
+    HX711::GAIN nextGain;
+    bool settled = this->advanceGainSchedule(&nextGain);
+    this->readPass(this->passValues.data(), nextGain);
+    this->convertingGain = nextGain;
+
+    if (!settled) {
+        return 1;
+    }
+    for (Channel *channel : this->channels) {
+        if (channel->gain != gain) {
+            continue;
+        }
+        long raw = this->passValues[channel->device];
+        channel->latestRaw = raw;
+        channel->latestWeight.publish(timeNS, static_cast<float>(raw - channel->offset) / channel->scale);
+        channel->count++;
+    }
+    return 1;
+}
+
+// Clock out one conversion from every device into values and select the gain of the next conversion
+void HX711Group::readPass(long *values, HX711::GAIN nextGain) {
+    size_t deviceCount = this->devices.size();
+    for (size_t i = 0; i < deviceCount; i++) {
+        values[i] = 0;
+    }
+
+    // PD_SCK must not stay high for more than 60 us, or the devices power down
+    for (int bitIndex = 0; bitIndex < HX711GROUP_DATA_LENGTH; bitIndex++) {
+        // Sample every data line on the same clock pulse
+        this->gpioPD_SCK->setValue(bbbkit::GPIO::VALUE::HIGH);
+        if (!this->bankRegisters.empty()) {
+            // Register reads take a few hundred ns, so a discarded read covers the 0.1 us data valid time
+            (void) *this->bankRegisters[0];
+            for (size_t b = 0; b < this->bankRegisters.size(); b++) {
+                this->bankValues[b] = *this->bankRegisters[b];
+            }
+            this->gpioPD_SCK->setValue(bbbkit::GPIO::VALUE::LOW);
+            // Likewise covers the 0.2 us minimum low time before the next rising edge
+            (void) *this->bankRegisters[0];
+
+            for (size_t i = 0; i < deviceCount; i++) {
+                long bit = (this->bankValues[this->devices[i].bank] & this->devices[i].gpioDOUT->getMask()) != 0 ? 1 : 0;
+                values[i] |= bit << (HX711GROUP_DATA_LENGTH - 1 - bitIndex);
+            }
+        } else {
+            for (size_t i = 0; i < deviceCount; i++) {
+                long bit = this->readDOUT(&this->devices[i]) == bbbkit::GPIO::VALUE::HIGH ? 1 : 0;
+                values[i] |= bit << (HX711GROUP_DATA_LENGTH - 1 - bitIndex);
+            }
+            this->gpioPD_SCK->setValue(bbbkit::GPIO::VALUE::LOW);
+        }
+    }
+
+    // Write the gain by switching clock pin
+    for (int gainIndex = 0; gainIndex < nextGain; gainIndex++) {
+        // Back-to-back register stores can be far shorter than the 0.2 us minimum high and low times
+        this->gpioPD_SCK->setValue(bbbkit::GPIO::VALUE::HIGH);
+        if (!this->bankRegisters.empty()) {
+            (void) *this->bankRegisters[0];
+        }
+        this->gpioPD_SCK->setValue(bbbkit::GPIO::VALUE::LOW);
+        if (!this->bankRegisters.empty()) {
+            (void) *this->bankRegisters[0];
+        }
+    }
+
+    // Sign extend 24-bit two's complement data
+    for (size_t i = 0; i < deviceCount; i++) {
+        if (values[i] & (1L << (HX711GROUP_DATA_LENGTH - 1))) {
+            values[i] -= 1L << HX711GROUP_DATA_LENGTH;
+        }
+    }
+}
+
+// Choose the gain of the next conversion (returns if the conversion being read has settled)
+bool HX711Group::advanceGainSchedule(HX711::GAIN *nextGain) {
+    bool settled = this->settlingCount == 0;
+    if (!settled) {
+        this->settlingCount--;
+    }
+
+    // Move to the next gain after dwelling on this one
+    this->gainPassCount++;
+    if (this->gainSchedule.size() > 1 && this->gainPassCount >= HX711GROUP_GAIN_DWELL_CONVERSIONS) {
+        this->gainScheduleIndex = (this->gainScheduleIndex + 1) % this->gainSchedule.size();
+        this->gainPassCount = 0;
+    }
+    *nextGain = this->gainSchedule[this->gainScheduleIndex];
+
+    // The first conversions at a new gain are not valid
+    if (*nextGain != this->convertingGain) {
+        this->settlingCount = HX711GROUP_SETTLING_CONVERSIONS;
+        this->gainPassCount = 0;
+    }
+    return settled;
+}
+
+// Continuously read conversions until cancellation token
+void HX711Group::acquire() {
+    int waitedPeriods = 0;
+    while (!this->acquisitionThreadShouldCancel) {
+        // Wait one period at a time so cancellation is noticed promptly
+        if (this->readConversion(this->conversionPeriodNS) == 1) {
+            waitedPeriods = 0;
+            continue;
+        }
+        waitedPeriods++;
+        if (waitedPeriods == HX711GROUP_READY_TIMEOUT_PERIODS) {
+            this->readyTimeoutCount++;
+            std::cout << "HX711Group: Error timed out waiting for data ready" << std::endl;
+            waitedPeriods = 0;
+        }
+    }
+}
+
+} /* namespace tids */
@@ -0,0 +1,174 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef HX711GROUP_H
+#define HX711GROUP_H
+
+#include <libbbbkit/GPIO.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "FastGPIO.h"
+#include "GPIOEdge.h"
+#include "GPIOMemoryMap.h"
+#include "HX711.h"
+#include "SampleSlot.h"
+
+namespace tids {
+
+// Reads several HX711 devices sharing one PD_SCK line, sampling every DOUT line on each clock edge
+// so all devices are clocked out in a single pass of 25 to 27 clock pulses
+// When the GPIO banks are memory mapped, each clock pulse reads every DOUT line with one load per bank
+// A channel is one device input at one gain; all devices receive the same gain pulses, so channels
+// with different gains are read in turns and conversions are discarded while the new gain settles
+class HX711Group {
+private:
+    struct Device {
+        int pin;
+        FastGPIO *gpioDOUT;
+        // Index into bankRegisters when every device is memory mapped
+        size_t bank;
+        // Fast value reads and data ready interrupts (null if unavailable)
+        GPIOEdge *edgeDOUT;
+    };
+
+    struct Channel {
+        int device;
+        HX711::GAIN gain;
+        std::atomic<long> offset;
+        std::atomic<float> scale;
+        // Latest raw value and number of values read
+        std::atomic<long> latestRaw;
+        std::atomic<uint64_t> count;
+        SampleSlot latestWeight;
+    };
+
+    GPIOMemoryMap *gpioMemoryMap;
+    FastGPIO *gpioPD_SCK;
+    std::vector<Device> devices;
+
+    // Data in registers of the banks holding DOUT lines (empty unless every device is memory mapped)
+    std::vector<volatile uint32_t *> bankRegisters;
+    std::vector<uint32_t> bankValues;
+    std::vector<Channel *> channels;
+    // Values of the latest pass, one per device
+    std::vector<long> passValues;
+
+    // Distinct channel gains, read in turns
+    std::vector<HX711::GAIN> gainSchedule;
+    size_t gainScheduleIndex;
+    int gainPassCount;
+    // Conversions still to discard before the converting gain has settled
+    int settlingCount;
+    // Gain of the conversion the next pass reads
+    HX711::GAIN convertingGain;
+    int64_t conversionPeriodNS;
+
+    // Acquisition mode: passes run by a background thread as soon as every device is ready
+    std::thread acquisitionThread;
+    std::atomic<bool> acquisitionThreadShouldCancel;
+    std::atomic<uint64_t> readyTimeoutCount;
+
+public:
+    HX711Group(bbbkit::GPIO::PIN pinPD_SCK, HX711::RATE rate=HX711::RATE::SPS_10, GPIOMemoryMap *gpioMemoryMap=nullptr);
+    virtual ~HX711Group();
+
+    // Add a channel for the device on pinDOUT (devices are added on first use, returns channel index, or -1 on error)
+    int addChannel(bbbkit::GPIO::PIN pinDOUT, HX711::GAIN gain=HX711::GAIN::A_128, float scale=1.0f, long offset=0);
+
+    // Get number of channels
+    int getChannelCount();
+
+    // Check if every device has data ready to read
+    bool isReady();
+
+    // Wait for every device and read one conversion from each (returns -1 on timeout)
+    int read();
+
+    // Read raw data value of a channel (averaged over count, latest value without blocking in acquisition mode)
+    long readRaw(int channel, int count=1);
+
+    // Read weight value of a channel for its offset and scale (averaged over count, latest value without blocking in acquisition mode)
+    float readWeight(int channel, int count=1);
+
+    // Get latest weight sample of a channel (returns -1 if none has been read)
+    int getLatestSample(int channel, Sample *sample);
+
+    // Get offset of a channel
+    long getOffset(int channel);
+
+    // Set offset of a channel
+    int setOffset(int channel, long offset);
+
+    // Get scale of a channel
+    float getScale(int channel);
+
+    // Set scale of a channel
+    int setScale(int channel, float scale);
+
+    // Zero a channel by setting its current weight as the offset (averaged over count)
+    int tare(int channel, int count=1);
+
+    // Power down every device
+    void powerDown();
+
+    // Wake up every device
+    void powerUp();
+
+    // Start reading every conversion on a background thread (channels cannot be added while acquiring)
+    int startAcquisition();
+
+    // Stop background acquisition
+    int stopAcquisition();
+
+    // If background acquisition is running
+    bool isAcquiring();
+
+    // Get number of data ready waits that timed out
+    uint64_t getReadyTimeoutCount();
+
+private:
+    // Read the DOUT level of a device
+    int readDOUT(Device *device);
+
+    // Collect the data in registers read on each clock pulse if every device is memory mapped
+    void updateBankRegisters();
+
+    // Wait for every device to have data ready for up to timeoutNS nanoseconds (returns 1 when ready, 0 on timeout)
+    int waitReady(int64_t timeoutNS);
+
+    // Wait for up to timeoutNS nanoseconds and read one conversion from every device into the channels (returns 1 when read, 0 on timeout)
+    int readConversion(int64_t timeoutNS);
+
+    // Clock out one conversion from every device into values and select the gain of the next conversion
+    void readPass(long *values, HX711::GAIN nextGain);
+
+    // Choose the gain of the next conversion (returns if the conversion being read has settled)
+    bool advanceGainSchedule(HX711::GAIN *nextGain);
+
+    // Continuously read conversions until cancellation token
+    void acquire();
+};
+
+} /* namespace tids */
+
+#endif /* HX711GROUP_H */
@@ -23,8 +23,8 @@
 
 namespace tids {
 
-LJ12A34ZBY::LJ12A34ZBY(bbbkit::GPIO::PIN pin) {
-    this->gpio = new bbbkit::GPIO(pin, bbbkit::GPIO::DIRECTION::INPUT);
+LJ12A34ZBY::LJ12A34ZBY(bbbkit::GPIO::PIN pin, GPIOMemoryMap *gpioMemoryMap) {
+    this->gpio = new FastGPIO(pin, bbbkit::GPIO::DIRECTION::INPUT, bbbkit::GPIO::VALUE::LOW, gpioMemoryMap);
 }
 
 LJ12A34ZBY::~LJ12A34ZBY() {
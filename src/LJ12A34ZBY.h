@@ -24,13 +24,17 @@
 
 #include <libbbbkit/GPIO.h>
 
+#include "FastGPIO.h"
+#include "GPIOMemoryMap.h"
+
 namespace tids {
 
 class LJ12A34ZBY {
 private:
-    bbbkit::GPIO *gpio;
+    // Read with a single register load when mapped, so it can be polled at every motor step
+    FastGPIO *gpio;
 public:
-    LJ12A34ZBY(bbbkit::GPIO::PIN pin);
+    LJ12A34ZBY(bbbkit::GPIO::PIN pin, GPIOMemoryMap *gpioMemoryMap=nullptr);
     virtual ~LJ12A34ZBY();
 
     bool isTriggered();
@@ -0,0 +1,136 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "LatencyHistogram.h"
+
+#include <iomanip>
+
+namespace tids {
+
+LatencyHistogram::LatencyHistogram() {
+    this->reset();
+}
+
+LatencyHistogram::~LatencyHistogram() {}
+
+// Record a latency (must only be called from a single writer thread)
+void LatencyHistogram::record(int64_t latencyNS) {
+    // Bucket is the bit length of the latency
+    int bucket = 0;
+    for (uint64_t value = latencyNS > 0 ? static_cast<uint64_t>(latencyNS) : 0; value != 0; value >>= 1) {
+        bucket++;
+    }
+    if (bucket >= BUCKET_COUNT) {
+        bucket = BUCKET_COUNT - 1;
+    }
+
+    // Single writer, so relaxed read-modify-write sequences are sufficient
+    this->buckets[bucket].store(this->buckets[bucket].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (this->count.load(std::memory_order_relaxed) == 0 || latencyNS < this->minNS.load(std::memory_order_relaxed)) {
+        this->minNS.store(latencyNS, std::memory_order_relaxed);
+    }
+    if (this->count.load(std::memory_order_relaxed) == 0 || latencyNS > this->maxNS.load(std::memory_order_relaxed)) {
+        this->maxNS.store(latencyNS, std::memory_order_relaxed);
+    }
+    this->sumNS.store(this->sumNS.load(std::memory_order_relaxed) + latencyNS, std::memory_order_relaxed);
+    this->count.store(this->count.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+// Clear every bucket (not concurrently with record)
+void LatencyHistogram::reset() {
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        this->buckets[i] = 0;
+    }
+    this->count = 0;
+    this->sumNS = 0;
+    this->minNS = 0;
+    this->maxNS = 0;
+}
+
+// Get number of latencies recorded
+uint64_t LatencyHistogram::getCount() {
+    return this->count.load(std::memory_order_acquire);
+}
+
+// Get smallest latency recorded in nanoseconds (0 if none)
+int64_t LatencyHistogram::getMinNS() {
+    return this->minNS.load(std::memory_order_relaxed);
+}
+
+// Get largest latency recorded in nanoseconds (0 if none)
+int64_t LatencyHistogram::getMaxNS() {
+    return this->maxNS.load(std::memory_order_relaxed);
+}
+
+// Get mean latency in nanoseconds (0 if none)
+int64_t LatencyHistogram::getMeanNS() {
+    uint64_t count = this->getCount();
+    if (count == 0) {
+        return 0;
+    }
+    return this->sumNS.load(std::memory_order_relaxed) / static_cast<int64_t>(count);
+}
+
+// Get upper bound of the bucket holding the given quantile (0 to 1) in nanoseconds (0 if none)
+int64_t LatencyHistogram::getQuantileNS(double quantile) {
+    uint64_t total = 0;
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        total += this->buckets[i].load(std::memory_order_relaxed);
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    // Rank of the quantile, counted from 1
+    uint64_t rank = static_cast<uint64_t>(quantile * total);
+    if (rank < 1) {
+        rank = 1;
+    } else if (rank > total) {
+        rank = total;
+    }
+
+    uint64_t cumulative = 0;
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        cumulative += this->buckets[i].load(std::memory_order_relaxed);
+        if (cumulative >= rank) {
+            return static_cast<int64_t>(1) << i;
+        }
+    }
+    return this->getMaxNS();
+}
+
+// Print a summary and every non-empty bucket
+void LatencyHistogram::print(std::ostream &stream, std::string name) {
+    stream << name << ": " << this->getCount() << " samples"
+           << ", min " << this->getMinNS() / 1000.0 << " us"
+           << ", mean " << this->getMeanNS() / 1000.0 << " us"
+           << ", p50 < " << this->getQuantileNS(0.5) / 1000.0 << " us"
+           << ", p99 < " << this->getQuantileNS(0.99) / 1000.0 << " us"
+           << ", max " << this->getMaxNS() / 1000.0 << " us" << std::endl;
+
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        uint64_t bucketCount = this->buckets[i].load(std::memory_order_relaxed);
+        if (bucketCount == 0) {
+            continue;
+        }
+        int64_t upperNS = static_cast<int64_t>(1) << i;
+        stream << "  < " << std::setw(12) << upperNS / 1000.0 << " us: " << bucketCount << std::endl;
+    }
+}
+
+} /* namespace tids */
@@ -0,0 +1,73 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace tids {
+
+// Distribution of latencies in power-of-two nanosecond buckets, with one writer and lock-free readers
+class LatencyHistogram {
+public:
+    // Bucket i counts latencies below 2^i ns (bucket 0 also counts zero and negative latencies)
+    static const int BUCKET_COUNT = 32;
+
+private:
+    std::atomic<uint64_t> buckets[BUCKET_COUNT];
+    std::atomic<uint64_t> count;
+    std::atomic<int64_t> sumNS;
+    std::atomic<int64_t> minNS;
+    std::atomic<int64_t> maxNS;
+
+public:
+    LatencyHistogram();
+    virtual ~LatencyHistogram();
+
+    // Record a latency (must only be called from a single writer thread)
+    void record(int64_t latencyNS);
+
+    // Clear every bucket (not concurrently with record)
+    void reset();
+
+    // Get number of latencies recorded
+    uint64_t getCount();
+
+    // Get smallest latency recorded in nanoseconds (0 if none)
+    int64_t getMinNS();
+
+    // Get largest latency recorded in nanoseconds (0 if none)
+    int64_t getMaxNS();
+
+    // Get mean latency in nanoseconds (0 if none)
+    int64_t getMeanNS();
+
+    // Get upper bound of the bucket holding the given quantile (0 to 1) in nanoseconds (0 if none)
+    int64_t getQuantileNS(double quantile);
+
+    // Print a summary and every non-empty bucket
+    void print(std::ostream &stream, std::string name);
+};
+
+} /* namespace tids */
+
+#endif /* LATENCYHISTOGRAM_H */
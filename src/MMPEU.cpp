@@ -23,10 +23,14 @@
 
 namespace tids {
 
-MMPEU::MMPEU(bbbkit::GPIO::PIN pinA, bbbkit::GPIO::PIN pinB, bbbkit::GPIO::PIN pinIndex) {
-    this->gpioA = new bbbkit::GPIO(pinA, bbbkit::GPIO::DIRECTION::INPUT);
-    this->gpioB = new bbbkit::GPIO(pinB, bbbkit::GPIO::DIRECTION::INPUT);
-    this->gpioIndex = new bbbkit::GPIO(pinIndex, bbbkit::GPIO::DIRECTION::INPUT);
+MMPEU::MMPEU(bbbkit::GPIO::PIN pinA, bbbkit::GPIO::PIN pinB, bbbkit::GPIO::PIN pinIndex, GPIOMemoryMap *gpioMemoryMap) {
+    this->pinA = pinA;
+    this->pinB = pinB;
+    this->pinIndex = pinIndex;
+
+    this->gpioA = new FastGPIO(pinA, bbbkit::GPIO::DIRECTION::INPUT, bbbkit::GPIO::VALUE::LOW, gpioMemoryMap);
+    this->gpioB = new FastGPIO(pinB, bbbkit::GPIO::DIRECTION::INPUT, bbbkit::GPIO::VALUE::LOW, gpioMemoryMap);
+    this->gpioIndex = new FastGPIO(pinIndex, bbbkit::GPIO::DIRECTION::INPUT, bbbkit::GPIO::VALUE::LOW, gpioMemoryMap);
 }
 
 MMPEU::~MMPEU() {
@@ -36,6 +40,19 @@ MMPEU::~MMPEU() {
 }
 
 MMPEU::STATE MMPEU::getState() {
+    // Sample both channels with one register read when they share a memory-mapped bank
+    volatile uint32_t *dataIn = this->gpioA->getDataInRegister();
+    if (dataIn != nullptr && dataIn == this->gpioB->getDataInRegister()) {
+        uint32_t value = *dataIn;
+        bool a = (value & this->gpioA->getMask()) != 0;
+        bool b = (value & this->gpioB->getMask()) != 0;
+        if (!a) {
+            return b ? STATE::D : STATE::A; // 01 : 00
+        } else {
+            return b ? STATE::C : STATE::B; // 11 : 10
+        }
+    }
+
     if (this->gpioA->getValue() == bbbkit::GPIO::VALUE::LOW) {
         if (this->gpioB->getValue() == bbbkit::GPIO::VALUE::LOW) {
             return STATE::A; // 00
@@ -56,15 +73,27 @@ bool MMPEU::isAtIndex() {
 }
 
 bbbkit::GPIO *MMPEU::getGPIOA() {
-    return this->gpioA;
+    return this->gpioA->getGPIO();
 }
 
 bbbkit::GPIO *MMPEU::getGPIOB() {
-    return this->gpioB;
+    return this->gpioB->getGPIO();
 }
 
 bbbkit::GPIO *MMPEU::getGPIOIndex() {
-    return this->gpioIndex;
+    return this->gpioIndex->getGPIO();
+}
+
+bbbkit::GPIO::PIN MMPEU::getPinA() {
+    return this->pinA;
+}
+
+bbbkit::GPIO::PIN MMPEU::getPinB() {
+    return this->pinB;
+}
+
+bbbkit::GPIO::PIN MMPEU::getPinIndex() {
+    return this->pinIndex;
 }
 
 } /* namespace tids */
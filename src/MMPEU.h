@@ -24,6 +24,9 @@
 
 #include <libbbbkit/GPIO.h>
 
+#include "FastGPIO.h"
+#include "GPIOMemoryMap.h"
+
 namespace tids {
 
 class MMPEU {
@@ -35,14 +38,18 @@ public:
         D = 3,
     };
 private:
+    bbbkit::GPIO::PIN pinA;
+    bbbkit::GPIO::PIN pinB;
+    bbbkit::GPIO::PIN pinIndex;
+
     // GPIO for channel A
-    bbbkit::GPIO *gpioA;
+    FastGPIO *gpioA;
     // GPIO for channel B
-    bbbkit::GPIO *gpioB;
+    FastGPIO *gpioB;
     // GPIO for revolution index
-    bbbkit::GPIO *gpioIndex;
+    FastGPIO *gpioIndex;
 public:
-    MMPEU(bbbkit::GPIO::PIN pinA, bbbkit::GPIO::PIN pinB, bbbkit::GPIO::PIN pinIndex);
+    MMPEU(bbbkit::GPIO::PIN pinA, bbbkit::GPIO::PIN pinB, bbbkit::GPIO::PIN pinIndex, GPIOMemoryMap *gpioMemoryMap=nullptr);
     virtual ~MMPEU();
 
     MMPEU::STATE getState();
@@ -51,6 +58,10 @@ public:
     bbbkit::GPIO *getGPIOA();
     bbbkit::GPIO *getGPIOB();
     bbbkit::GPIO *getGPIOIndex();
+
+    bbbkit::GPIO::PIN getPinA();
+    bbbkit::GPIO::PIN getPinB();
+    bbbkit::GPIO::PIN getPinIndex();
 };
 
 } /* namespace tids */
@@ -19,6 +19,7 @@
 #include "MeltingSystem.h"
 
 #include <chrono>
+#include <thread>
 
 namespace tids {
 
@@ -28,11 +29,31 @@ namespace tids {
 #define TEMPERATURE_MIN_C 110
 #define TEMPERATURE_MAX_C 120
 
-MeltingSystem::MeltingSystem(PowerController* powerController, DS3218 *capMotor, MLX90614 *thermometer) {
+// Thermometer sampling periods and deadline
+#define OBJECT_TEMPERATURE_PERIOD_MS 1000
+#define AMBIENT_TEMPERATURE_PERIOD_MS 5000
+#define TEMPERATURE_DEADLINE_MS 100
+
+// Temperature regulation period and deadline
+#define REGULATE_TEMPERATURE_PERIOD_MS 1000
+#define REGULATE_TEMPERATURE_DEADLINE_MS 500
+
+MeltingSystem::MeltingSystem(PowerController* powerController, DS3218 *capMotor, MLX90614 *thermometer, TelemetrySystem *telemetrySystem) {
     this->powerController = powerController;
     this->capMotor = capMotor;
     this->thermometer = thermometer;
-    this->regulateTemperatureThreadShouldCancel = true;
+    this->telemetrySystem = telemetrySystem;
+    this->regulateTemperatureTaskId = -1;
+
+    // Sample thermometer on the telemetry scheduler
+    this->telemetrySystem->registerChannel(TelemetryRecord::CHANNEL::HEATER_OBJECT_TEMPERATURE,
+                                           static_cast<int64_t>(OBJECT_TEMPERATURE_PERIOD_MS) * 1000000,
+                                           static_cast<int64_t>(TEMPERATURE_DEADLINE_MS) * 1000000,
+                                           [thermometer]() { return thermometer->getObjectTemperature(); });
+    this->telemetrySystem->registerChannel(TelemetryRecord::CHANNEL::HEATER_AMBIENT_TEMPERATURE,
+                                           static_cast<int64_t>(AMBIENT_TEMPERATURE_PERIOD_MS) * 1000000,
+                                           static_cast<int64_t>(TEMPERATURE_DEADLINE_MS) * 1000000,
+                                           [thermometer]() { return thermometer->getAmbientTemperature(); });
 }
 
 MeltingSystem::~MeltingSystem() {
@@ -49,10 +70,20 @@ int MeltingSystem::closeCap() {
     return this->capMotor->setAngle(CAP_MOTOR_ANGLE_CLOSED);
 }
 
+// Start opening melting chamber cap, with a handle that completes once it is open
+MotionHandle MeltingSystem::openCapAsync() {
+    return this->capMotor->setAngleAsync(CAP_MOTOR_ANGLE_OPEN);
+}
+
+// Start closing melting chamber cap, with a handle that completes once it is closed
+MotionHandle MeltingSystem::closeCapAsync() {
+    return this->capMotor->setAngleAsync(CAP_MOTOR_ANGLE_CLOSED);
+}
+
 // Start heater and chiller and adjust based on thermometer
 int MeltingSystem::start() {
-    // Return if the temperature regulation thread already exists
-    if (!this->regulateTemperatureThreadShouldCancel) {
+    // Return if temperature regulation is already running
+    if (this->regulateTemperatureTaskId >= 0) {
         return -1;
     }
 
@@ -63,18 +94,21 @@ int MeltingSystem::start() {
     // Turn on heater
     this->powerController->setHeaterRelayState(PowerController::STATE::ON);
 
-    // Reset cancellation token
-    this->regulateTemperatureThreadShouldCancel = false;
-    // Start temperature regulation on new thread
-    this->regulateTemperatureThread = std::thread(&MeltingSystem::regulateTemperature, this);
+    // Start temperature regulation on the telemetry scheduler
+    this->regulateTemperatureTaskId = this->telemetrySystem->getScheduler()->addTask("regulate_temperature",
+                                          static_cast<int64_t>(REGULATE_TEMPERATURE_PERIOD_MS) * 1000000,
+                                          static_cast<int64_t>(REGULATE_TEMPERATURE_DEADLINE_MS) * 1000000,
+                                          [this](int64_t releaseTimeNS) { (void)releaseTimeNS; this->regulateTemperature(); });
     return 0;
 }
 
 // Stop heater and chiller
 int MeltingSystem::stop() {
-    // Cancel and join temperature regulation thread
-    this->regulateTemperatureThreadShouldCancel = true;
-    this->regulateTemperatureThread.join();
+    // Remove temperature regulation task
+    if (this->regulateTemperatureTaskId >= 0) {
+        this->telemetrySystem->getScheduler()->removeTask(this->regulateTemperatureTaskId);
+        this->regulateTemperatureTaskId = -1;
+    }
 
     // Turn off heater and chiller
     this->powerController->setChillerRelayState(PowerController::STATE::OFF);
@@ -82,25 +116,23 @@ int MeltingSystem::stop() {
     return 0;
 }
 
-// Continuously turn the heater on/off to regulate evaporation temperature
+// Turn the heater on/off to regulate evaporation temperature (runs periodically on the telemetry scheduler)
 void MeltingSystem::regulateTemperature() {
-    // Run until cancellation token
-    while (!this->regulateTemperatureThreadShouldCancel) {
-        // Get temperature of induction chamber
-        float temperature = this->thermometer->getObjectTemperature();
-
-        // If temperature is below the minimum, turn the heater on
-        if (temperature < TEMPERATURE_MIN_C) {
-            this->powerController->setHeaterRelayState(PowerController::STATE::OFF);
-        }
-
-        // If temperature is above the maximum, turn the heater off
-        else if (temperature > TEMPERATURE_MAX_C) {
-            this->powerController->setHeaterRelayState(PowerController::STATE::ON);
-        }
-
-        // Repeat every second
-        std::this_thread::sleep_for(std::chrono::seconds(1));
+    // Get latest temperature of induction chamber
+    Sample sample;
+    if (this->telemetrySystem->getChannel(TelemetryRecord::CHANNEL::HEATER_OBJECT_TEMPERATURE)->getLatest(&sample) < 0) {
+        return;
+    }
+    float temperature = sample.value;
+
+    // If temperature is below the minimum, turn the heater on
+    if (temperature < TEMPERATURE_MIN_C) {
+        this->powerController->setHeaterRelayState(PowerController::STATE::OFF);
+    }
+
+    // If temperature is above the maximum, turn the heater off
+    else if (temperature > TEMPERATURE_MAX_C) {
+        this->powerController->setHeaterRelayState(PowerController::STATE::ON);
     }
 }
 
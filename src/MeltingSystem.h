@@ -19,12 +19,10 @@
 #ifndef MELTINGSYSTEM_H
 #define MELTINGSYSTEM_H
 
-#include <atomic>
-#include <thread>
-
 #include "DS3218.h"
 #include "MLX90614.h"
 #include "PowerController.h"
+#include "TelemetrySystem.h"
 
 namespace tids {
 
@@ -33,11 +31,12 @@ private:
     PowerController *powerController;
     DS3218 *capMotor;
     MLX90614 *thermometer;
+    TelemetrySystem *telemetrySystem;
 
-    std::thread regulateTemperatureThread;
-    std::atomic<bool> regulateTemperatureThreadShouldCancel;
+    // Temperature regulation task on the telemetry scheduler (-1 when not running)
+    int regulateTemperatureTaskId;
 public:
-    MeltingSystem(PowerController* powerController, DS3218 *capMotor, MLX90614 *thermometer);
+    MeltingSystem(PowerController* powerController, DS3218 *capMotor, MLX90614 *thermometer, TelemetrySystem *telemetrySystem);
     virtual ~MeltingSystem();
 
     // Open melting chamber cap
@@ -46,6 +45,12 @@ public:
     // Close melting chamber cap
     int closeCap();
 
+    // Start opening melting chamber cap, with a handle that completes once it is open
+    MotionHandle openCapAsync();
+
+    // Start closing melting chamber cap, with a handle that completes once it is closed
+    MotionHandle closeCapAsync();
+
     // Start heater and chiller and adjust based on thermometer
     int start();
 
@@ -53,7 +58,7 @@ public:
     int stop();
 
 private:
-    // Continuously turn the heater on/off to regulate evaporation temperature
+    // Turn the heater on/off to regulate evaporation temperature (runs periodically on the telemetry scheduler)
     void regulateTemperature();
 };
 
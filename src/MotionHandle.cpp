@@ -0,0 +1,147 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "MotionHandle.h"
+
+#include <chrono>
+
+#include "Clock.h"
+
+namespace tids {
+
+MotionHandle::MotionHandle() {
+    this->state = std::make_shared<State>();
+    this->state->status = STATUS::FAILED;
+    this->state->result = -1;
+    this->state->cancelRequested = false;
+}
+
+MotionHandle::MotionHandle(std::shared_ptr<State> state) {
+    this->state = state;
+}
+
+MotionHandle::~MotionHandle() {}
+
+// Wait until the motion ends or timeoutNS nanoseconds pass, forever if negative (returns -1 on timeout)
+int MotionHandle::wait(int64_t timeoutNS) {
+    std::unique_lock<std::mutex> lock(this->state->mutex);
+    auto isEnded = [this] { return this->state->status != STATUS::PENDING; };
+    if (timeoutNS < 0) {
+        this->state->condition.wait(lock, isEnded);
+        return 0;
+    }
+    return this->state->condition.wait_for(lock, std::chrono::nanoseconds(timeoutNS), isEnded) ? 0 : -1;
+}
+
+// Request the motion to stop as soon as possible, without waiting for it
+void MotionHandle::cancel() {
+    this->state->cancelRequested = true;
+    if (this->state->cancelAction && !this->isDone()) {
+        this->state->cancelAction();
+    }
+}
+
+// If the motion has ended (done, cancelled or failed)
+bool MotionHandle::isDone() {
+    return this->getStatus() != STATUS::PENDING;
+}
+
+// Get status
+MotionHandle::STATUS MotionHandle::getStatus() {
+    std::lock_guard<std::mutex> lock(this->state->mutex);
+    return this->state->status;
+}
+
+// Get result returned by the motion (-1 if it failed to start)
+int MotionHandle::getResult() {
+    std::lock_guard<std::mutex> lock(this->state->mutex);
+    return this->state->result;
+}
+
+// Wait until every motion ends or timeoutNS nanoseconds pass, forever if negative (returns -1 on timeout)
+int MotionHandle::waitAll(std::vector<MotionHandle> handles, int64_t timeoutNS) {
+    int64_t deadlineNS = Clock::monotonicNS() + timeoutNS;
+    for (MotionHandle &handle : handles) {
+        int64_t remainingNS = -1;
+        if (timeoutNS >= 0) {
+            remainingNS = deadlineNS - Clock::monotonicNS();
+            if (remainingNS < 0) {
+                remainingNS = 0;
+            }
+        }
+        if (handle.wait(remainingNS) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+MotionWorker::MotionWorker() {}
+
+MotionWorker::~MotionWorker() {
+    this->cancel();
+}
+
+// Start motion on the background thread (the handle is FAILED if a previous motion is still running)
+MotionHandle MotionWorker::start(Motion motion, std::function<void()> cancelAction) {
+    if (this->isBusy()) {
+        return MotionHandle();
+    }
+    if (this->motionThread.joinable()) {
+        this->motionThread.join();
+    }
+
+    std::shared_ptr<MotionHandle::State> state = std::make_shared<MotionHandle::State>();
+    state->status = MotionHandle::STATUS::PENDING;
+    state->result = -1;
+    state->cancelRequested = false;
+    state->cancelAction = cancelAction;
+    this->current = state;
+
+    this->motionThread = std::thread([state, motion]() {
+        int result = motion(&state->cancelRequested);
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->result = result;
+        if (state->cancelRequested) {
+            state->status = MotionHandle::STATUS::CANCELLED;
+        } else if (result < 0) {
+            state->status = MotionHandle::STATUS::FAILED;
+        } else {
+            state->status = MotionHandle::STATUS::DONE;
+        }
+        state->condition.notify_all();
+    });
+    return MotionHandle(state);
+}
+
+// If a motion is running
+bool MotionWorker::isBusy() {
+    return this->current && !MotionHandle(this->current).isDone();
+}
+
+// Cancel a running motion and wait for it to end
+void MotionWorker::cancel() {
+    if (this->current) {
+        MotionHandle(this->current).cancel();
+    }
+    if (this->motionThread.joinable()) {
+        this->motionThread.join();
+    }
+}
+
+} /* namespace tids */
@@ -0,0 +1,108 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MOTIONHANDLE_H
+#define MOTIONHANDLE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tids {
+
+// Completion handle for a motion running in the background, shared by copies
+class MotionHandle {
+public:
+    enum STATUS {
+        PENDING = 0,
+        DONE = 1,
+        CANCELLED = 2,
+        FAILED = 3,
+    };
+
+    // State shared by every copy of a handle and the thread running the motion
+    struct State {
+        std::mutex mutex;
+        std::condition_variable condition;
+        STATUS status;
+        int result;
+        std::atomic<bool> cancelRequested;
+        // Called on cancel to interrupt a motion blocked in a driver (may be empty)
+        std::function<void()> cancelAction;
+    };
+
+private:
+    std::shared_ptr<State> state;
+
+public:
+    // Handle of a motion that never started (status FAILED)
+    MotionHandle();
+    MotionHandle(std::shared_ptr<State> state);
+    virtual ~MotionHandle();
+
+    // Wait until the motion ends or timeoutNS nanoseconds pass, forever if negative (returns -1 on timeout)
+    int wait(int64_t timeoutNS=-1);
+
+    // Request the motion to stop as soon as possible, without waiting for it
+    void cancel();
+
+    // If the motion has ended (done, cancelled or failed)
+    bool isDone();
+
+    // Get status
+    STATUS getStatus();
+
+    // Get result returned by the motion (-1 if it failed to start)
+    int getResult();
+
+    // Wait until every motion ends or timeoutNS nanoseconds pass, forever if negative (returns -1 on timeout)
+    static int waitAll(std::vector<MotionHandle> handles, int64_t timeoutNS=-1);
+};
+
+// Runs one motion at a time on a background thread, handing out a completion handle for each
+class MotionWorker {
+public:
+    // Motion body, returns 0 on success or -1 on error, and should return soon after *cancelled is set
+    typedef std::function<int(const std::atomic<bool> *cancelled)> Motion;
+
+private:
+    std::thread motionThread;
+    std::shared_ptr<MotionHandle::State> current;
+
+public:
+    MotionWorker();
+    virtual ~MotionWorker();
+
+    // Start motion on the background thread (the handle is FAILED if a previous motion is still running)
+    MotionHandle start(Motion motion, std::function<void()> cancelAction=nullptr);
+
+    // If a motion is running
+    bool isBusy();
+
+    // Cancel a running motion and wait for it to end
+    void cancel();
+};
+
+} /* namespace tids */
+
+#endif /* MOTIONHANDLE_H */
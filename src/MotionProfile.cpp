@@ -0,0 +1,216 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "MotionProfile.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Bisection iterations for the peak rate of a move too short to reach the limit
+#define MOTIONPROFILE_PEAK_ITERATIONS 48
+
+// Newton iterations for the time of each ramp step
+#define MOTIONPROFILE_NEWTON_ITERATIONS 8
+
+// Longest step interval, so intervals fit 32 bits (about 4.29 s)
+#define MOTIONPROFILE_MAX_INTERVAL_NS 4000000000.0
+
+namespace tids {
+
+// Phase of constant jerk in a ramp
+struct RampPhase {
+    double durationS;
+    double jerk;
+};
+
+MotionProfile::MotionProfile() {
+    this->stepCount = 0;
+    this->rampStepCount = 0;
+    this->cruiseIntervalNS = 0;
+    this->peakVelocity = 0.0f;
+    this->durationNS = 0;
+}
+
+MotionProfile::~MotionProfile() {}
+
+// Plan a move of stepCount steps within limits (returns -1 if the limits are invalid)
+// A start rate at or above the cruise rate gives a constant-rate move with no ramps
+int MotionProfile::plan(int64_t stepCount, MotionLimits limits) {
+    // Acceleration is only needed when the move ramps up from its start rate
+    bool ramped = limits.startVelocity < limits.maxVelocity;
+    if (stepCount < 0 || !(limits.maxVelocity > 0.0f) || (ramped && !(limits.maxAcceleration > 0.0f)) ||
+        limits.maxJerk < 0.0f || limits.startVelocity < 0.0f) {
+        return -1;
+    }
+    double startVelocity = std::min(limits.startVelocity, limits.maxVelocity);
+    double peakVelocity = limits.maxVelocity;
+
+    // Lower the peak until both ramps fit within the move
+    if (2.0 * getRampDistance(startVelocity, peakVelocity, limits) > stepCount) {
+        double low = startVelocity;
+        double high = peakVelocity;
+        for (int i = 0; i < MOTIONPROFILE_PEAK_ITERATIONS; i++) {
+            double middle = 0.5 * (low + high);
+            if (2.0 * getRampDistance(startVelocity, middle, limits) > stepCount) {
+                high = middle;
+            } else {
+                low = middle;
+            }
+        }
+        peakVelocity = low;
+    }
+    // A move too short for even the start rate is stepped at the start rate
+    peakVelocity = std::max(peakVelocity, std::max(startVelocity, 1.0e9 / MOTIONPROFILE_MAX_INTERVAL_NS));
+
+    this->stepCount = stepCount;
+    this->peakVelocity = static_cast<float>(peakVelocity);
+    this->cruiseIntervalNS = static_cast<uint32_t>(std::lround(std::min(1.0e9 / peakVelocity, MOTIONPROFILE_MAX_INTERVAL_NS)));
+    this->planRamp(startVelocity, peakVelocity, limits);
+    this->rampStepCount = std::min<int64_t>(static_cast<int64_t>(this->rampIntervalsNS.size()), stepCount / 2);
+
+    this->durationNS = 0;
+    for (int64_t step = 0; step < stepCount; step++) {
+        if (step >= this->rampStepCount && step < stepCount - this->rampStepCount) {
+            // Cruise steps all take the same interval
+            this->durationNS += static_cast<int64_t>(this->cruiseIntervalNS) * (stepCount - 2 * this->rampStepCount);
+            step = stepCount - this->rampStepCount - 1;
+            continue;
+        }
+        this->durationNS += this->getIntervalNS(step);
+    }
+    return 0;
+}
+
+// Get interval before a step (0 is the first step) in nanoseconds, without floating point
+uint32_t MotionProfile::getIntervalNS(int64_t step) const {
+    if (step < this->rampStepCount) {
+        return this->rampIntervalsNS[step];
+    }
+    // Deceleration replays the acceleration ramp backward
+    int64_t stepsFromEnd = this->stepCount - 1 - step;
+    if (stepsFromEnd < this->rampStepCount) {
+        return this->rampIntervalsNS[stepsFromEnd];
+    }
+    return this->cruiseIntervalNS;
+}
+
+// Get number of steps in the move
+int64_t MotionProfile::getStepCount() const {
+    return this->stepCount;
+}
+
+// Get number of steps in each of the acceleration and deceleration ramps
+int64_t MotionProfile::getRampStepCount() const {
+    return this->rampStepCount;
+}
+
+// Get highest rate reached in steps per second (below the limit when the move is too short to reach it)
+float MotionProfile::getPeakVelocity() const {
+    return this->peakVelocity;
+}
+
+// Get duration of the move in nanoseconds
+int64_t MotionProfile::getDurationNS() const {
+    return this->durationNS;
+}
+
+// Get distance in steps to ramp from startVelocity to peakVelocity within limits
+double MotionProfile::getRampDistance(double startVelocity, double peakVelocity, const MotionLimits &limits) {
+    double deltaVelocity = peakVelocity - startVelocity;
+    if (deltaVelocity <= 0.0) {
+        return 0.0;
+    }
+
+    // Every ramp is symmetric in acceleration, so its mean rate is the mean of its end rates
+    double durationS;
+    double acceleration = limits.maxAcceleration;
+    if (limits.maxJerk <= 0.0f) {
+        durationS = deltaVelocity / acceleration;
+    } else if (deltaVelocity >= acceleration * acceleration / limits.maxJerk) {
+        durationS = deltaVelocity / acceleration + acceleration / limits.maxJerk;
+    } else {
+        durationS = 2.0 * std::sqrt(deltaVelocity / limits.maxJerk);
+    }
+    return 0.5 * (startVelocity + peakVelocity) * durationS;
+}
+
+// Fill the ramp table from startVelocity to peakVelocity
+void MotionProfile::planRamp(double startVelocity, double peakVelocity, const MotionLimits &limits) {
+    this->rampIntervalsNS.clear();
+    double deltaVelocity = peakVelocity - startVelocity;
+    if (deltaVelocity <= 0.0) {
+        return;
+    }
+
+    // Phases of constant jerk (a trapezoidal ramp is one phase of constant acceleration)
+    std::vector<RampPhase> phases;
+    double acceleration = limits.maxAcceleration;
+    double jerk = limits.maxJerk;
+    double initialAcceleration = 0.0;
+    if (jerk <= 0.0) {
+        initialAcceleration = acceleration;
+        phases.push_back({deltaVelocity / acceleration, 0.0});
+    } else if (deltaVelocity >= acceleration * acceleration / jerk) {
+        phases.push_back({acceleration / jerk, jerk});
+        phases.push_back({deltaVelocity / acceleration - acceleration / jerk, 0.0});
+        phases.push_back({acceleration / jerk, -jerk});
+    } else {
+        double peakAcceleration = std::sqrt(deltaVelocity * jerk);
+        phases.push_back({peakAcceleration / jerk, jerk});
+        phases.push_back({peakAcceleration / jerk, -jerk});
+    }
+
+    // Time each whole step by solving position(t) = step within its phase
+    double phaseStartS = 0.0;
+    double phasePosition = 0.0;
+    double phaseVelocity = startVelocity;
+    double phaseAcceleration = initialAcceleration;
+    double previousStepS = 0.0;
+    int64_t step = 1;
+    for (const RampPhase &phase : phases) {
+        double phaseEndPosition = phasePosition + phaseVelocity * phase.durationS + phaseAcceleration * phase.durationS * phase.durationS / 2.0 +
+                                  phase.jerk * phase.durationS * phase.durationS * phase.durationS / 6.0;
+        double t = 0.0;
+        while (step <= phaseEndPosition) {
+            // Position is increasing within the phase, so Newton from the previous step converges
+            double target = step - phasePosition;
+            for (int i = 0; i < MOTIONPROFILE_NEWTON_ITERATIONS; i++) {
+                double position = phaseVelocity * t + phaseAcceleration * t * t / 2.0 + phase.jerk * t * t * t / 6.0;
+                double velocity = phaseVelocity + phaseAcceleration * t + phase.jerk * t * t / 2.0;
+                if (velocity <= 0.0) {
+                    // Starting from rest: the first step is reached with the initial acceleration or jerk alone
+                    t = (phase.jerk > 0.0) ? std::cbrt(6.0 * target / phase.jerk) : std::sqrt(2.0 * target / phaseAcceleration);
+                    continue;
+                }
+                t = std::min(std::max(t - (position - target) / velocity, 0.0), phase.durationS);
+            }
+            double stepS = phaseStartS + t;
+            this->rampIntervalsNS.push_back(static_cast<uint32_t>(std::lround(std::min((stepS - previousStepS) * 1e9, MOTIONPROFILE_MAX_INTERVAL_NS))));
+            previousStepS = stepS;
+            step++;
+        }
+
+        // Advance to the start of the next phase
+        phasePosition = phaseEndPosition;
+        phaseVelocity += phaseAcceleration * phase.durationS + phase.jerk * phase.durationS * phase.durationS / 2.0;
+        phaseAcceleration += phase.jerk * phase.durationS;
+        phaseStartS += phase.durationS;
+    }
+}
+
+} /* namespace tids */
@@ -0,0 +1,89 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MOTIONPROFILE_H
+#define MOTIONPROFILE_H
+
+#include <cstdint>
+#include <vector>
+
+namespace tids {
+
+// Kinematic limits of a move, in steps
+struct MotionLimits {
+    // Cruise rate in steps per second
+    float maxVelocity;
+    // Acceleration in steps per second squared
+    float maxAcceleration;
+    // Jerk in steps per second cubed (0 for a trapezoidal profile)
+    float maxJerk;
+    // Rate the motor can start and stop at without a ramp, in steps per second
+    float startVelocity;
+};
+
+// Step timing for a move with acceleration, cruise and deceleration phases, trapezoidal or jerk-limited (S-curve)
+// The acceleration ramp is computed once as a table of integer step intervals and replayed in reverse to decelerate,
+// so a pulse loop only indexes the table
+class MotionProfile {
+private:
+    int64_t stepCount;
+
+    // Intervals before each step of the acceleration ramp, in nanoseconds
+    std::vector<uint32_t> rampIntervalsNS;
+    int64_t rampStepCount;
+
+    // Interval between cruise steps, in nanoseconds
+    uint32_t cruiseIntervalNS;
+
+    float peakVelocity;
+    int64_t durationNS;
+
+public:
+    MotionProfile();
+    virtual ~MotionProfile();
+
+    // Plan a move of stepCount steps within limits (returns -1 if the limits are invalid)
+    // A start rate at or above the cruise rate gives a constant-rate move with no ramps
+    int plan(int64_t stepCount, MotionLimits limits);
+
+    // Get interval before a step (0 is the first step) in nanoseconds, without floating point
+    uint32_t getIntervalNS(int64_t step) const;
+
+    // Get number of steps in the move
+    int64_t getStepCount() const;
+
+    // Get number of steps in each of the acceleration and deceleration ramps
+    int64_t getRampStepCount() const;
+
+    // Get highest rate reached in steps per second (below the limit when the move is too short to reach it)
+    float getPeakVelocity() const;
+
+    // Get duration of the move in nanoseconds
+    int64_t getDurationNS() const;
+
+private:
+    // Get distance in steps to ramp from startVelocity to peakVelocity within limits
+    static double getRampDistance(double startVelocity, double peakVelocity, const MotionLimits &limits);
+
+    // Fill the ramp table from startVelocity to peakVelocity
+    void planRamp(double startVelocity, double peakVelocity, const MotionLimits &limits);
+};
+
+} /* namespace tids */
+
+#endif /* MOTIONPROFILE_H */
@@ -0,0 +1,140 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "P2Quantile.h"
+
+#include <algorithm>
+
+namespace tids {
+
+P2Quantile::P2Quantile(double quantile) {
+    this->quantile = quantile;
+    this->reset();
+}
+
+P2Quantile::~P2Quantile() {}
+
+// Add an observation
+void P2Quantile::add(double value) {
+    // Collect the first five observations as the initial markers
+    if (this->count < 5) {
+        this->height[this->count++] = value;
+        if (this->count == 5) {
+            std::sort(this->height, this->height + 5);
+        }
+        return;
+    }
+    this->count++;
+
+    // Find the cell containing the observation, extending the extreme markers if necessary
+    int cell;
+    if (value < this->height[0]) {
+        this->height[0] = value;
+        cell = 0;
+    } else if (value >= this->height[4]) {
+        this->height[4] = std::max(this->height[4], value);
+        cell = 3;
+    } else {
+        cell = 0;
+        while (value >= this->height[cell + 1]) {
+            cell++;
+        }
+    }
+
+    // Shift positions of markers above the observation and advance desired positions
+    for (int marker = cell + 1; marker < 5; marker++) {
+        this->position[marker] += 1.0;
+    }
+    for (int marker = 0; marker < 5; marker++) {
+        this->desiredPosition[marker] += this->increment[marker];
+    }
+
+    // Adjust the middle markers that have drifted at least one position from where they should be
+    for (int marker = 1; marker < 4; marker++) {
+        double offset = this->desiredPosition[marker] - this->position[marker];
+        if ((offset >= 1.0 && this->position[marker + 1] - this->position[marker] > 1.0)
+            || (offset <= -1.0 && this->position[marker - 1] - this->position[marker] < -1.0)) {
+            double direction = offset > 0.0 ? 1.0 : -1.0;
+            double height = this->parabolic(marker, direction);
+            // Fall back to linear prediction if the parabola would break marker ordering
+            if (!(this->height[marker - 1] < height && height < this->height[marker + 1])) {
+                height = this->linear(marker, direction);
+            }
+            this->height[marker] = height;
+            this->position[marker] += direction;
+        }
+    }
+}
+
+// Get current estimate (exact while fewer than five observations have been added, 0 if none)
+double P2Quantile::getEstimate() {
+    if (this->count == 0) {
+        return 0.0;
+    }
+    if (this->count < 5) {
+        double sorted[5];
+        std::copy(this->height, this->height + this->count, sorted);
+        std::sort(sorted, sorted + this->count);
+        size_t index = static_cast<size_t>(this->quantile * (this->count - 1) + 0.5);
+        return sorted[index];
+    }
+    return this->height[2];
+}
+
+// Get number of observations added
+uint64_t P2Quantile::getCount() {
+    return this->count;
+}
+
+// Discard all observations
+void P2Quantile::reset() {
+    this->count = 0;
+    for (int marker = 0; marker < 5; marker++) {
+        this->height[marker] = 0.0;
+        this->position[marker] = marker + 1;
+    }
+    this->desiredPosition[0] = 1.0;
+    this->desiredPosition[1] = 1.0 + 2.0 * this->quantile;
+    this->desiredPosition[2] = 1.0 + 4.0 * this->quantile;
+    this->desiredPosition[3] = 3.0 + 2.0 * this->quantile;
+    this->desiredPosition[4] = 5.0;
+    this->increment[0] = 0.0;
+    this->increment[1] = this->quantile / 2.0;
+    this->increment[2] = this->quantile;
+    this->increment[3] = (1.0 + this->quantile) / 2.0;
+    this->increment[4] = 1.0;
+}
+
+// Piecewise-parabolic prediction of marker height after moving it by direction
+double P2Quantile::parabolic(int marker, double direction) {
+    double below = this->position[marker] - this->position[marker - 1];
+    double above = this->position[marker + 1] - this->position[marker];
+    double span = this->position[marker + 1] - this->position[marker - 1];
+    return this->height[marker] + direction / span
+        * ((below + direction) * (this->height[marker + 1] - this->height[marker]) / above
+           + (above - direction) * (this->height[marker] - this->height[marker - 1]) / below);
+}
+
+// Linear prediction of marker height after moving it by direction
+double P2Quantile::linear(int marker, double direction) {
+    int neighbor = marker + static_cast<int>(direction);
+    return this->height[marker] + direction * (this->height[neighbor] - this->height[marker])
+        / (this->position[neighbor] - this->position[marker]);
+}
+
+} /* namespace tids */
@@ -0,0 +1,66 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef P2QUANTILE_H
+#define P2QUANTILE_H
+
+#include <cstdint>
+
+namespace tids {
+
+// Constant-space streaming quantile estimate (Jain and Chlamtac P-square algorithm)
+class P2Quantile {
+private:
+    // Quantile being estimated, between 0 and 1
+    double quantile;
+
+    // Marker heights, actual positions, desired positions and desired position increments
+    double height[5];
+    double position[5];
+    double desiredPosition[5];
+    double increment[5];
+
+    uint64_t count;
+
+public:
+    P2Quantile(double quantile);
+    virtual ~P2Quantile();
+
+    // Add an observation
+    void add(double value);
+
+    // Get current estimate (exact while fewer than five observations have been added, 0 if none)
+    double getEstimate();
+
+    // Get number of observations added
+    uint64_t getCount();
+
+    // Discard all observations
+    void reset();
+
+private:
+    // Piecewise-parabolic prediction of marker height after moving it by direction
+    double parabolic(int marker, double direction);
+
+    // Linear prediction of marker height after moving it by direction
+    double linear(int marker, double direction);
+};
+
+} /* namespace tids */
+
+#endif /* P2QUANTILE_H */
@@ -0,0 +1,180 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "PIDController.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace tids {
+
+PIDController::PIDController(PIDGains gains) {
+    if (this->setGains(gains) < 0) {
+        std::cout << "PIDController: Error invalid gains, controller output held at zero" << std::endl;
+        PIDGains zeroGains = {};
+        this->gains.write(zeroGains);
+    }
+    this->reset(0.0f);
+}
+
+PIDController::~PIDController() {}
+
+// Replace gains from any thread (returns -1 if the limits or filter are invalid)
+int PIDController::setGains(PIDGains gains) {
+    if (gains.outputMin > gains.outputMax || gains.derivativeFilterS < 0.0f || gains.outputRateLimit < 0.0f) {
+        return -1;
+    }
+    std::lock_guard<std::mutex> lock(this->gainsMutex);
+    this->gains.write(gains);
+    return 0;
+}
+
+// Get current gains
+PIDGains PIDController::getGains() {
+    PIDGains gains;
+    this->gains.read(&gains);
+    return gains;
+}
+
+// Replace gains from a file of "name value" lines, keeping gains it does not name (returns -1 on error)
+int PIDController::loadGains(std::string path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cout << "PIDController: Error opening gains file " << path << std::endl;
+        return -1;
+    }
+
+    PIDGains gains = this->getGains();
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+
+        // Skip blank lines and comments
+        line = line.substr(0, line.find('#'));
+        std::istringstream stream(line);
+        std::string name;
+        if (!(stream >> name)) {
+            continue;
+        }
+
+        float value;
+        if (!(stream >> value)) {
+            std::cout << "PIDController: Error reading value on line " << lineNumber << " of " << path << std::endl;
+            return -1;
+        }
+
+        if (name == "kp") {
+            gains.kp = value;
+        } else if (name == "ki") {
+            gains.ki = value;
+        } else if (name == "kd") {
+            gains.kd = value;
+        } else if (name == "derivative_filter_s") {
+            gains.derivativeFilterS = value;
+        } else if (name == "kff") {
+            gains.kff = value;
+        } else if (name == "output_min") {
+            gains.outputMin = value;
+        } else if (name == "output_max") {
+            gains.outputMax = value;
+        } else if (name == "output_rate_limit") {
+            gains.outputRateLimit = value;
+        } else {
+            std::cout << "PIDController: Error unknown gain " << name << " on line " << lineNumber << " of " << path << std::endl;
+            return -1;
+        }
+    }
+
+    if (this->setGains(gains) < 0) {
+        std::cout << "PIDController: Error invalid gains in " << path << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+// Restart from an output, e.g. the actuator command when control is handed over (control thread only)
+void PIDController::reset(float output) {
+    this->integral = 0.0f;
+    this->derivative = 0.0f;
+    this->previousMeasurement = 0.0f;
+    this->output = output;
+    this->initialized = false;
+}
+
+// Compute the output for a setpoint, measurement and feed-forward input dtS seconds after the previous update (control thread only)
+float PIDController::update(float setpoint, float measurement, float feedForward, float dtS) {
+    PIDGains gains;
+    this->gains.read(&gains);
+
+    float error = setpoint - measurement;
+    float proportional = gains.kp * error;
+    float feedForwardTerm = gains.kff * feedForward;
+
+    // Seed the integral on the first update so the output continues from the reset output
+    if (!this->initialized) {
+        this->previousMeasurement = measurement;
+        this->derivative = 0.0f;
+        this->integral = this->output - proportional - feedForwardTerm;
+        this->initialized = true;
+    }
+    if (dtS <= 0.0f) {
+        return this->output;
+    }
+
+    // Derivative on the measurement (no kick on setpoint changes), low-pass filtered against encoder and ADC noise
+    float rawDerivative = -(measurement - this->previousMeasurement) / dtS;
+    this->previousMeasurement = measurement;
+    this->derivative += dtS / (gains.derivativeFilterS + dtS) * (rawDerivative - this->derivative);
+    float derivativeTerm = gains.kd * this->derivative;
+
+    // Output limits for this update, from the range and the rate limit
+    float lower = gains.outputMin;
+    float upper = gains.outputMax;
+    if (gains.outputRateLimit > 0.0f) {
+        lower = std::max(lower, this->output - gains.outputRateLimit * dtS);
+        upper = std::min(upper, this->output + gains.outputRateLimit * dtS);
+        // After a range change the output moves straight into the new range
+        if (lower > upper) {
+            lower = upper = std::min(std::max(this->output.load(), gains.outputMin), gains.outputMax);
+        }
+    }
+
+    // The integral is kept as an output contribution, so gain changes do not step the output
+    // Integrate only when the output is within its limits or the error drives it back inside them
+    float integral = this->integral + gains.ki * error * dtS;
+    float unlimited = feedForwardTerm + proportional + integral + derivativeTerm;
+    bool windingUp = (unlimited > upper && error > 0.0f) || (unlimited < lower && error < 0.0f);
+    if (!windingUp) {
+        this->integral = integral;
+    }
+    this->integral = std::min(std::max(this->integral, gains.outputMin - feedForwardTerm), gains.outputMax - feedForwardTerm);
+
+    unlimited = feedForwardTerm + proportional + this->integral + derivativeTerm;
+    this->output = std::min(std::max(unlimited, lower), upper);
+    return this->output;
+}
+
+// Get latest output
+float PIDController::getOutput() {
+    return this->output;
+}
+
+} /* namespace tids */
@@ -0,0 +1,90 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PIDCONTROLLER_H
+#define PIDCONTROLLER_H
+
+#include <atomic>
+#include <mutex>
+#include <string>
+
+#include "Seqlock.h"
+
+namespace tids {
+
+// Gains and output limits of a PID controller
+struct PIDGains {
+    // Proportional, integral (per second) and derivative (seconds) gains
+    float kp;
+    float ki;
+    float kd;
+    // Time constant of the first-order filter on the derivative, in seconds
+    float derivativeFilterS;
+    // Gain on the feed-forward input
+    float kff;
+    // Output range
+    float outputMin;
+    float outputMax;
+    // Largest output change per second (0 for no limit)
+    float outputRateLimit;
+};
+
+// Discrete PID controller with feed-forward, a filtered derivative on the measurement, output range and
+// rate limits, and conditional integration so the integral never winds up against a limit
+// Gains may be replaced from any thread and take effect at the next update without an output step
+class PIDController {
+private:
+    // Gains published to the control thread (writers are serialized by gainsMutex)
+    Seqlock<PIDGains> gains;
+    std::mutex gainsMutex;
+
+    // Controller state (control thread only)
+    float integral;
+    float derivative;
+    float previousMeasurement;
+    bool initialized;
+
+    // Latest output, readable from any thread
+    std::atomic<float> output;
+
+public:
+    PIDController(PIDGains gains);
+    virtual ~PIDController();
+
+    // Replace gains from any thread (returns -1 if the limits or filter are invalid)
+    int setGains(PIDGains gains);
+
+    // Get current gains
+    PIDGains getGains();
+
+    // Replace gains from a file of "name value" lines, keeping gains it does not name (returns -1 on error)
+    int loadGains(std::string path);
+
+    // Restart from an output, e.g. the actuator command when control is handed over (control thread only)
+    void reset(float output);
+
+    // Compute the output for a setpoint, measurement and feed-forward input dtS seconds after the previous update (control thread only)
+    float update(float setpoint, float measurement, float feedForward, float dtS);
+
+    // Get latest output
+    float getOutput();
+};
+
+} /* namespace tids */
+
+#endif /* PIDCONTROLLER_H */
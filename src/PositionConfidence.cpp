@@ -0,0 +1,193 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "PositionConfidence.h"
+
+#include <cmath>
+#include <iostream>
+
+namespace tids {
+
+PositionConfidence::PositionConfidence(float distanceBudgetMM, float driftToleranceMM, int64_t timingPeriodSteps) {
+    this->distanceBudgetMM = distanceBudgetMM;
+    this->driftToleranceMM = driftToleranceMM;
+    this->timingPeriodSteps = timingPeriodSteps;
+    this->reason = REASON::NEVER_HOMED;
+    this->travelSinceHomeMM = 0.0;
+    this->timingPhase = -1;
+    this->driftCheckCount = 0;
+    this->lastDriftMM = 0.0f;
+}
+
+PositionConfidence::~PositionConfidence() {}
+
+// Set distance the axis may travel after homing before it must home again, in millimeters
+int PositionConfidence::setDistanceBudget(float distanceBudgetMM) {
+    if (!(distanceBudgetMM > 0.0f)) {
+        return -1;
+    }
+    std::lock_guard<std::mutex> lock(this->confidenceMutex);
+    this->distanceBudgetMM = distanceBudgetMM;
+    return 0;
+}
+
+// Get distance budget in millimeters
+float PositionConfidence::getDistanceBudget() {
+    std::lock_guard<std::mutex> lock(this->confidenceMutex);
+    return this->distanceBudgetMM;
+}
+
+// Set largest position error at the home sensor that keeps the position trusted, in millimeters
+int PositionConfidence::setDriftTolerance(float driftToleranceMM) {
+    if (!(driftToleranceMM > 0.0f)) {
+        return -1;
+    }
+    std::lock_guard<std::mutex> lock(this->confidenceMutex);
+    this->driftToleranceMM = driftToleranceMM;
+    return 0;
+}
+
+// Trust the position after homing
+void PositionConfidence::markHomed() {
+    std::lock_guard<std::mutex> lock(this->confidenceMutex);
+    this->reason = REASON::NONE;
+    this->travelSinceHomeMM = 0.0;
+    // Steps may have been lost before homing, so relearn the timing phase
+    this->timingPhase = -1;
+}
+
+// Add distance travelled in millimeters
+void PositionConfidence::addTravel(float distanceMM) {
+    std::lock_guard<std::mutex> lock(this->confidenceMutex);
+    this->travelSinceHomeMM += std::fabs(distanceMM);
+    if (this->travelSinceHomeMM >= this->distanceBudgetMM) {
+        this->lose(REASON::DISTANCE_BUDGET);
+    }
+}
+
+// Check the driver alarm output
+void PositionConfidence::checkAlarm(bool alarm) {
+    if (alarm) {
+        std::lock_guard<std::mutex> lock(this->confidenceMutex);
+        this->lose(REASON::ALARM);
+    }
+}
+
+// Check the driver timing output at rest against the commanded step position
+void PositionConfidence::checkTimingOutput(int64_t stepPosition, bool timingOutput) {
+    std::lock_guard<std::mutex> lock(this->confidenceMutex);
+    if (this->timingPeriodSteps <= 0 || this->reason != REASON::NONE) {
+        return;
+    }
+    int64_t phase = stepPosition % this->timingPeriodSteps;
+    if (phase < 0) {
+        phase += this->timingPeriodSteps;
+    }
+
+    // Learn the phase the first time the output is seen on
+    if (this->timingPhase < 0) {
+        if (timingOutput) {
+            this->timingPhase = phase;
+        }
+        return;
+    }
+    if (timingOutput != (phase == this->timingPhase)) {
+        this->lose(REASON::TIMING_OUTPUT);
+    }
+}
+
+// Check the dead-reckoned position where the home sensor edge was found (0 if there is no drift), in millimeters
+void PositionConfidence::checkDrift(float driftMM) {
+    std::lock_guard<std::mutex> lock(this->confidenceMutex);
+    this->driftCheckCount++;
+    this->lastDriftMM = driftMM;
+    if (std::fabs(driftMM) > this->driftToleranceMM) {
+        this->lose(REASON::DRIFT);
+    }
+}
+
+// If the position is no longer trusted and the axis must home
+bool PositionConfidence::isHomingRequired() {
+    std::lock_guard<std::mutex> lock(this->confidenceMutex);
+    return this->reason != REASON::NONE;
+}
+
+// Get reason homing is required (NONE if it is not)
+PositionConfidence::REASON PositionConfidence::getReason() {
+    std::lock_guard<std::mutex> lock(this->confidenceMutex);
+    return this->reason;
+}
+
+// Get confidence from 1 (just homed) to 0 (homing required), from the distance budget left
+float PositionConfidence::getConfidence() {
+    std::lock_guard<std::mutex> lock(this->confidenceMutex);
+    if (this->reason != REASON::NONE) {
+        return 0.0f;
+    }
+    double confidence = 1.0 - this->travelSinceHomeMM / this->distanceBudgetMM;
+    return static_cast<float>(confidence > 0.0 ? confidence : 0.0);
+}
+
+// Get distance travelled since homing in millimeters
+float PositionConfidence::getTravelSinceHome() {
+    std::lock_guard<std::mutex> lock(this->confidenceMutex);
+    return static_cast<float>(this->travelSinceHomeMM);
+}
+
+// Get number of drift checks at the home sensor
+uint32_t PositionConfidence::getDriftCheckCount() {
+    std::lock_guard<std::mutex> lock(this->confidenceMutex);
+    return this->driftCheckCount;
+}
+
+// Get drift found at the latest check in millimeters
+float PositionConfidence::getLastDrift() {
+    std::lock_guard<std::mutex> lock(this->confidenceMutex);
+    return this->lastDriftMM;
+}
+
+// Require homing for reason, keeping the first reason until homed (confidenceMutex must be held)
+void PositionConfidence::lose(REASON reason) {
+    if (this->reason != REASON::NONE) {
+        return;
+    }
+    this->reason = reason;
+    std::cout << "PositionConfidence: Position no longer trusted (" << positionLossReasonName(reason) << "), homing required" << std::endl;
+}
+
+// Get reason name
+const char *positionLossReasonName(int reason) {
+    switch (reason) {
+        case PositionConfidence::REASON::NONE:
+            return "none";
+        case PositionConfidence::REASON::NEVER_HOMED:
+            return "never homed";
+        case PositionConfidence::REASON::ALARM:
+            return "driver alarm";
+        case PositionConfidence::REASON::TIMING_OUTPUT:
+            return "timing output mismatch";
+        case PositionConfidence::REASON::DRIFT:
+            return "drift at home sensor";
+        case PositionConfidence::REASON::DISTANCE_BUDGET:
+            return "distance budget used";
+        default:
+            return "unknown";
+    }
+}
+
+} /* namespace tids */
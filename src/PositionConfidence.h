@@ -0,0 +1,116 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef POSITIONCONFIDENCE_H
+#define POSITIONCONFIDENCE_H
+
+#include <cstdint>
+#include <mutex>
+
+namespace tids {
+
+// Tracks whether a dead-reckoned stepper axis position can still be trusted without homing
+// Trust is lost on a driver alarm, on a timing output that disagrees with the commanded step count, on drift
+// found when passing the home sensor, or once the axis has travelled its distance budget since homing
+class PositionConfidence {
+public:
+    enum REASON {
+        NONE = 0,
+        NEVER_HOMED = 1,
+        ALARM = 2,
+        TIMING_OUTPUT = 3,
+        DRIFT = 4,
+        DISTANCE_BUDGET = 5,
+    };
+
+private:
+    std::mutex confidenceMutex;
+
+    float distanceBudgetMM;
+    float driftToleranceMM;
+    // Steps between timing output pulses (0 if not monitored)
+    int64_t timingPeriodSteps;
+
+    // Reason homing is required (NONE while trusted)
+    REASON reason;
+    double travelSinceHomeMM;
+
+    // Step position modulo timingPeriodSteps at which the timing output is on (-1 until seen after homing)
+    int64_t timingPhase;
+
+    // Drift checks at the home sensor since startup
+    uint32_t driftCheckCount;
+    float lastDriftMM;
+
+public:
+    PositionConfidence(float distanceBudgetMM, float driftToleranceMM, int64_t timingPeriodSteps=0);
+    virtual ~PositionConfidence();
+
+    // Set distance the axis may travel after homing before it must home again, in millimeters
+    int setDistanceBudget(float distanceBudgetMM);
+
+    // Get distance budget in millimeters
+    float getDistanceBudget();
+
+    // Set largest position error at the home sensor that keeps the position trusted, in millimeters
+    int setDriftTolerance(float driftToleranceMM);
+
+    // Trust the position after homing
+    void markHomed();
+
+    // Add distance travelled in millimeters
+    void addTravel(float distanceMM);
+
+    // Check the driver alarm output
+    void checkAlarm(bool alarm);
+
+    // Check the driver timing output at rest against the commanded step position
+    void checkTimingOutput(int64_t stepPosition, bool timingOutput);
+
+    // Check the dead-reckoned position where the home sensor edge was found (0 if there is no drift), in millimeters
+    void checkDrift(float driftMM);
+
+    // If the position is no longer trusted and the axis must home
+    bool isHomingRequired();
+
+    // Get reason homing is required (NONE if it is not)
+    REASON getReason();
+
+    // Get confidence from 1 (just homed) to 0 (homing required), from the distance budget left
+    float getConfidence();
+
+    // Get distance travelled since homing in millimeters
+    float getTravelSinceHome();
+
+    // Get number of drift checks at the home sensor
+    uint32_t getDriftCheckCount();
+
+    // Get drift found at the latest check in millimeters
+    float getLastDrift();
+
+private:
+    // Require homing for reason, keeping the first reason until homed (confidenceMutex must be held)
+    void lose(REASON reason);
+};
+
+// Get reason name
+const char *positionLossReasonName(int reason);
+
+} /* namespace tids */
+
+#endif /* POSITIONCONFIDENCE_H */
@@ -25,16 +25,16 @@
 
 namespace tids {
 
-PowerController::PowerController(bbbkit::GPIO::PIN pinRelayChiller, bbbkit::GPIO::PIN pinRelayDrillMotor, bbbkit::GPIO::PIN pinRelayHeater1, bbbkit::GPIO::PIN pinRelayHeater2, bbbkit::GPIO::PIN pinRelayProximitySensors, bbbkit::GPIO::PIN pinRelayMotorX, bbbkit::GPIO::PIN pinRelayMotorZ, bbbkit::GPIO::PIN pinRelay24V); {
+PowerController::PowerController(bbbkit::GPIO::PIN pinRelayChiller, bbbkit::GPIO::PIN pinRelayDrillMotor, bbbkit::GPIO::PIN pinRelayHeater1, bbbkit::GPIO::PIN pinRelayHeater2, bbbkit::GPIO::PIN pinRelayProximitySensors, bbbkit::GPIO::PIN pinRelayMotorX, bbbkit::GPIO::PIN pinRelayMotorZ, bbbkit::GPIO::PIN pinRelay24V, GPIOMemoryMap *gpioMemoryMap) {
     // Initialize relay GPIOs
-    this->gpioRelayChiller = new bbbkit::GPIO(pinRelayChiller, bbbkit::GPIO::DIRECTION::OUTPUT, bbbkit::GPIO::VALUE::LOW);
-    this->gpioRelayDrillMotor = new bbbkit::GPIO(pinRelayDrillMotor, bbbkit::GPIO::DIRECTION::OUTPUT, bbbkit::GPIO::VALUE::LOW);
-    this->gpioRelayHeater1 = new bbbkit::GPIO(pinRelayHeater1, bbbkit::GPIO::DIRECTION::OUTPUT, bbbkit::GPIO::VALUE::LOW);
-    this->gpioRelayHeater2 = new bbbkit::GPIO(pinRelayHeater2, bbbkit::GPIO::DIRECTION::OUTPUT, bbbkit::GPIO::VALUE::LOW);
-    this->gpioRelayProximitySensors = new bbbkit::GPIO(pinRelayProximitySensors, bbbkit::GPIO::DIRECTION::OUTPUT, bbbkit::GPIO::VALUE::LOW);
-    this->gpioRelayMotorX = new bbbkit::GPIO(pinRelayMotorX, bbbkit::GPIO::DIRECTION::OUTPUT, bbbkit::GPIO::VALUE::LOW);
-    this->gpioRelayMotorZ = new bbbkit::GPIO(pinRelayMotorZ, bbbkit::GPIO::DIRECTION::OUTPUT, bbbkit::GPIO::VALUE::LOW);
-    this->gpioRelay24V = new bbbkit::GPIO(pinRelay24V, bbbkit::GPIO::DIRECTION::OUTPUT, bbbkit::GPIO::VALUE::LOW);
+    this->gpioRelayChiller = new FastGPIO(pinRelayChiller, bbbkit::GPIO::DIRECTION::OUTPUT, bbbkit::GPIO::VALUE::LOW, gpioMemoryMap);
+    this->gpioRelayDrillMotor = new FastGPIO(pinRelayDrillMotor, bbbkit::GPIO::DIRECTION::OUTPUT, bbbkit::GPIO::VALUE::LOW, gpioMemoryMap);
+    this->gpioRelayHeater1 = new FastGPIO(pinRelayHeater1, bbbkit::GPIO::DIRECTION::OUTPUT, bbbkit::GPIO::VALUE::LOW, gpioMemoryMap);
+    this->gpioRelayHeater2 = new FastGPIO(pinRelayHeater2, bbbkit::GPIO::DIRECTION::OUTPUT, bbbkit::GPIO::VALUE::LOW, gpioMemoryMap);
+    this->gpioRelayProximitySensors = new FastGPIO(pinRelayProximitySensors, bbbkit::GPIO::DIRECTION::OUTPUT, bbbkit::GPIO::VALUE::LOW, gpioMemoryMap);
+    this->gpioRelayMotorX = new FastGPIO(pinRelayMotorX, bbbkit::GPIO::DIRECTION::OUTPUT, bbbkit::GPIO::VALUE::LOW, gpioMemoryMap);
+    this->gpioRelayMotorZ = new FastGPIO(pinRelayMotorZ, bbbkit::GPIO::DIRECTION::OUTPUT, bbbkit::GPIO::VALUE::LOW, gpioMemoryMap);
+    this->gpioRelay24V = new FastGPIO(pinRelay24V, bbbkit::GPIO::DIRECTION::OUTPUT, bbbkit::GPIO::VALUE::LOW, gpioMemoryMap);
 
     // Ensure all relays are off
     this->turnOffAllRelays();
@@ -141,7 +141,7 @@ int PowerController::turnOffAllRelays() {
     return 0;
 }
 
-PowerController::STATE PowerController::getRelayState(bbbkit::GPIO *gpioRelay) {
+PowerController::STATE PowerController::getRelayState(FastGPIO *gpioRelay) {
     // Get GPIO value
     if (gpioRelay->getValue() == bbbkit::GPIO::VALUE::HIGH) {
         return PowerController::STATE::ON;
@@ -150,7 +150,7 @@ PowerController::STATE PowerController::getRelayState(bbbkit::GPIO *gpioRelay) {
     }
 }
 
-int PowerController::setRelayState(bbbkit::GPIO *gpioRelay, PowerController::STATE state) {
+int PowerController::setRelayState(FastGPIO *gpioRelay, PowerController::STATE state) {
     // Determine GPIO value for power state
     bbbkit::GPIO::VALUE value = bbbkit::GPIO::VALUE::LOW;
     if (state == PowerController::STATE::ON) {
@@ -24,6 +24,9 @@
 
 #include <libbbbkit/GPIO.h>
 
+#include "FastGPIO.h"
+#include "GPIOMemoryMap.h"
+
 namespace tids {
 
 class PowerController {
@@ -34,30 +37,30 @@ public:
     };
 private:
     // Relay controlling power to chiller (120V AC)
-    bbbkit::GPIO *gpioRelayChiller;
+    FastGPIO *gpioRelayChiller;
     
     // Relay controlling power to drill motor (90V DC)
-    bbbkit::GPIO *gpioRelayDrillMotor;
+    FastGPIO *gpioRelayDrillMotor;
     
     // Relays controlling power to proximity sensors (30V DC)
     // Divided into two relays to keep current per relay below max
-    bbbkit::GPIO *gpioRelayHeater1;
-    bbbkit::GPIO *gpioRelayHeater2;
+    FastGPIO *gpioRelayHeater1;
+    FastGPIO *gpioRelayHeater2;
 
     // Relay controlling power to proximity sensors (12V DC)
-    bbbkit::GPIO *gpioRelayProximitySensors;
+    FastGPIO *gpioRelayProximitySensors;
 
     // Relay controlling power to x-axis motor (24V DC)
-    bbbkit::GPIO *gpioRelayMotorX;
+    FastGPIO *gpioRelayMotorX;
     
     // Relay controlling power to z-axis motor (24V DC)
-    bbbkit::GPIO *gpioRelayMotorZ;
+    FastGPIO *gpioRelayMotorZ;
 
     // Relay controlling power to 24V buck convertor that supplies power to x-axis and z-axis motors
-    bbbkit::GPIO *gpioRelay24V;
+    FastGPIO *gpioRelay24V;
     
 public:
-    PowerController(bbbkit::GPIO::PIN pinRelayChiller, bbbkit::GPIO::PIN pinRelayDrillMotor, bbbkit::GPIO::PIN pinRelayHeater1, bbbkit::GPIO::PIN pinRelayHeater2, bbbkit::GPIO::PIN pinRelayProximitySensors, bbbkit::GPIO::PIN pinRelayMotorX, bbbkit::GPIO::PIN pinRelayMotorZ, bbbkit::GPIO::PIN pinRelay24V);
+    PowerController(bbbkit::GPIO::PIN pinRelayChiller, bbbkit::GPIO::PIN pinRelayDrillMotor, bbbkit::GPIO::PIN pinRelayHeater1, bbbkit::GPIO::PIN pinRelayHeater2, bbbkit::GPIO::PIN pinRelayProximitySensors, bbbkit::GPIO::PIN pinRelayMotorX, bbbkit::GPIO::PIN pinRelayMotorZ, bbbkit::GPIO::PIN pinRelay24V, GPIOMemoryMap *gpioMemoryMap=nullptr);
     virtual ~PowerController();
 
     PowerController::STATE getChillerRelayState();
@@ -84,8 +87,8 @@ public:
     int turnOffAllRelays();
 
 private:
-    PowerController::STATE getRelayState(bbbkit::GPIO *gpioRelay);
-    int setRelayState(bbbkit::GPIO *gpioRelay, PowerController::STATE state);
+    PowerController::STATE getRelayState(FastGPIO *gpioRelay);
+    int setRelayState(FastGPIO *gpioRelay, PowerController::STATE state);
 };
 
 } /* namespace tids */
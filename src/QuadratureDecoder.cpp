@@ -0,0 +1,438 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "QuadratureDecoder.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <poll.h>
+#include <time.h>
+
+#include "Clock.h"
+
+// Longest wait for edges before checking the cancellation token
+#define QUADRATURE_DECODER_WAIT_TIMEOUT_MS 100
+
+// Most kernel events read from each line per wake
+#define QUADRATURE_DECODER_EVENT_BATCH_SIZE 16
+
+// Counts an index pulse may be off a whole revolution (or a reversal) before it is an error
+#define QUADRATURE_DECODER_INDEX_TOLERANCE_COUNTS 2
+
+namespace tids {
+
+QuadratureDecoder::QuadratureDecoder(MMPEU *encoder, int countsPerRevolution, size_t edgeCapacity) {
+    this->encoder = encoder;
+    this->countsPerRevolution = countsPerRevolution;
+
+    this->eventsA = new GPIOLineEvent(encoder->getPinA());
+    this->eventsB = new GPIOLineEvent(encoder->getPinB());
+    this->eventsIndex = new GPIOLineEvent(encoder->getPinIndex());
+    this->kernelTimestamps = false;
+
+    this->edgeA = new GPIOEdge(encoder->getPinA());
+    this->edgeB = new GPIOEdge(encoder->getPinB());
+    this->edgeIndex = new GPIOEdge(encoder->getPinIndex());
+
+    this->edges = new SPSCRingBuffer<EncoderEdge>(edgeCapacity);
+
+    this->decoderThreadShouldCancel = true;
+    this->lastState = MMPEU::STATE::A;
+    this->lastIndexPosition = 0;
+    this->indexed = false;
+    this->position = 0;
+    this->revolutions = 0;
+    this->illegalTransitionCount = 0;
+    this->indexErrorCount = 0;
+    this->indexCount = 0;
+    this->indexPosition = 0;
+    this->waitLowPosition = std::numeric_limits<int64_t>::min();
+    this->waitHighPosition = std::numeric_limits<int64_t>::max();
+}
+
+QuadratureDecoder::~QuadratureDecoder() {
+    this->stop();
+    delete this->edges;
+    delete this->eventsA;
+    delete this->eventsB;
+    delete this->eventsIndex;
+    delete this->edgeA;
+    delete this->edgeB;
+    delete this->edgeIndex;
+}
+
+// Start decoding encoder edges
+int QuadratureDecoder::start() {
+    // Return if the decoder thread already exists
+    if (this->isRunning()) {
+        return -1;
+    }
+
+    // Both edges of both channels are decoded, index pulses only as they start
+    this->kernelTimestamps = this->eventsA->open(GPIOLineEvent::EDGE::BOTH) == 0 && this->eventsB->open(GPIOLineEvent::EDGE::BOTH) == 0;
+    if (this->kernelTimestamps) {
+        if (this->eventsIndex->open(GPIOLineEvent::EDGE::RISING) < 0) {
+            std::cout << "QuadratureDecoder: Error requesting index events, angle is relative to start" << std::endl;
+        }
+    } else {
+        // Lines exported through sysfs cannot be requested, so use sysfs edge interrupts instead
+        this->eventsA->close();
+        this->eventsB->close();
+        if (this->encoder->getGPIOA()->setEdgeType(bbbkit::GPIO::EDGE::BOTH) < 0 ||
+            this->encoder->getGPIOB()->setEdgeType(bbbkit::GPIO::EDGE::BOTH) < 0 ||
+            this->edgeA->open() < 0 || this->edgeB->open() < 0) {
+            std::cout << "QuadratureDecoder: Error enabling channel edge interrupts" << std::endl;
+            return -1;
+        }
+        if (this->encoder->getGPIOIndex()->setEdgeType(bbbkit::GPIO::EDGE::RISING) < 0 || this->edgeIndex->open() < 0) {
+            std::cout << "QuadratureDecoder: Error enabling index edge interrupts, angle is relative to start" << std::endl;
+        }
+    }
+
+    this->lastState = this->encoder->getState();
+
+    // Reset cancellation token
+    this->decoderThreadShouldCancel = false;
+    // Start decoding on new thread
+    if (this->kernelTimestamps) {
+        this->decoderThread = std::thread(&QuadratureDecoder::runLineEvents, this);
+    } else {
+        this->decoderThread = std::thread(&QuadratureDecoder::runEdges, this);
+    }
+    return 0;
+}
+
+// Stop decoding encoder edges
+int QuadratureDecoder::stop() {
+    // Cancel and join decoder thread
+    this->decoderThreadShouldCancel = true;
+    if (this->decoderThread.joinable()) {
+        this->decoderThread.join();
+    }
+    this->eventsA->close();
+    this->eventsB->close();
+    this->eventsIndex->close();
+    this->edgeA->close();
+    this->edgeB->close();
+    this->edgeIndex->close();
+    return 0;
+}
+
+// If the decoder is running
+bool QuadratureDecoder::isRunning() {
+    return !this->decoderThreadShouldCancel;
+}
+
+// Get signed count of quadrature transitions since the decoder started
+int64_t QuadratureDecoder::getPosition() {
+    return this->position.load(std::memory_order_relaxed);
+}
+
+// Get signed count of index pulses passed
+int64_t QuadratureDecoder::getRevolutions() {
+    return this->revolutions.load(std::memory_order_relaxed);
+}
+
+// Get position, revolutions and angle at the latest edge (returns -1 if no edge has been decoded)
+int QuadratureDecoder::getState(QuadratureState *state) {
+    if (this->state.read(state) == 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// Get angle since the latest index pulse in degrees (from the start position before the first index)
+float QuadratureDecoder::getAngleDegrees() {
+    QuadratureState state;
+    if (this->getState(&state) < 0) {
+        return 0.0f;
+    }
+    return 360.0f * state.angleCount / this->countsPerRevolution;
+}
+
+// Get counts per revolution
+int QuadratureDecoder::getCountsPerRevolution() {
+    return this->countsPerRevolution;
+}
+
+// Get number of transitions that skipped a state, so their direction is unknown
+uint64_t QuadratureDecoder::getIllegalTransitionCount() {
+    return this->illegalTransitionCount;
+}
+
+// Get number of index pulses not a whole revolution from the previous one
+uint64_t QuadratureDecoder::getIndexErrorCount() {
+    return this->indexErrorCount;
+}
+
+// Pop up to maxCount transitions, oldest first (single consumer only, returns number popped)
+size_t QuadratureDecoder::readEdges(EncoderEdge *edges, size_t maxCount) {
+    return this->edges->pop(edges, maxCount);
+}
+
+// Get number of transitions dropped because the consumer fell behind
+uint64_t QuadratureDecoder::getEdgeOverflowCount() {
+    return this->edges->getOverflowCount();
+}
+
+// Get number of index pulses seen
+uint64_t QuadratureDecoder::getIndexCount() {
+    return this->indexCount;
+}
+
+// Get position at the latest index pulse (returns -1 if no index pulse has been seen)
+int QuadratureDecoder::getIndexPosition(int64_t *position) {
+    // Position is stored before the count is incremented
+    if (this->indexCount.load(std::memory_order_acquire) == 0) {
+        return -1;
+    }
+    *position = this->indexPosition.load(std::memory_order_relaxed);
+    return 0;
+}
+
+// Wait until the position leaves (lowPosition, highPosition) or an index pulse passes (returns 0 when either happens, -1 on timeout; one waiter at a time)
+int QuadratureDecoder::waitForPosition(int64_t lowPosition, int64_t highPosition, int64_t timeoutNS) {
+    uint64_t startIndexCount = this->indexCount;
+    std::unique_lock<std::mutex> lock(this->waitMutex);
+    this->waitLowPosition = lowPosition;
+    this->waitHighPosition = highPosition;
+
+    // The decoder notifies under the mutex, so a crossing after this check cannot be missed, and the band stores and
+    // this load are sequentially consistent with the decoder, so either it sees the new band or this sees its position
+    bool woken = this->waitCondition.wait_for(lock, std::chrono::nanoseconds(timeoutNS), [this, lowPosition, highPosition, startIndexCount]() {
+        int64_t position = this->position.load(std::memory_order_seq_cst);
+        return position <= lowPosition || position >= highPosition || this->indexCount != startIndexCount;
+    });
+
+    // Stop notifications until the next wait
+    this->waitLowPosition = std::numeric_limits<int64_t>::min();
+    this->waitHighPosition = std::numeric_limits<int64_t>::max();
+    return woken ? 0 : -1;
+}
+
+// If edges are timestamped by the kernel rather than when the decoder thread wakes
+bool QuadratureDecoder::hasKernelTimestamps() {
+    return this->kernelTimestamps;
+}
+
+// Decode a new channel state and record the transition at timeNS (decoder thread only)
+void QuadratureDecoder::decode(MMPEU::STATE state, int64_t timeNS) {
+    // States A, B, C, D are consecutive in the forward direction, so the step is their difference modulo 4
+    int step = (static_cast<int>(state) - static_cast<int>(this->lastState) + 4) % 4;
+    this->lastState = state;
+    int64_t position = this->position.load(std::memory_order_relaxed);
+    if (step == 1) {
+        position++;
+    } else if (step == 3) {
+        position--;
+    } else {
+        if (step == 2) {
+            // Both channels changed between samples, so a transition was missed
+            this->illegalTransitionCount++;
+        }
+        return;
+    }
+    // Sequentially consistent with the waiter's band stores and position check, so a new band is never missed
+    this->position.store(position, std::memory_order_seq_cst);
+
+    // Only a crossing of the waiter's band takes the lock
+    if (position <= this->waitLowPosition.load(std::memory_order_seq_cst) || position >= this->waitHighPosition.load(std::memory_order_seq_cst)) {
+        this->notifyWaiter();
+    }
+
+    // Dropped edges are counted by the ring buffer
+    EncoderEdge edge;
+    edge.timeNS = timeNS;
+    edge.position = position;
+    this->edges->push(edge);
+}
+
+// Re-zero the angle at an index pulse (decoder thread only)
+void QuadratureDecoder::index(int64_t timeNS) {
+    int64_t position = this->position.load(std::memory_order_relaxed);
+    int64_t counts = position - this->lastIndexPosition;
+    if (this->indexed) {
+        // Pulses either a revolution apart or at the same place after a reversal are consistent
+        int64_t distance = std::llabs(counts);
+        if (distance > QUADRATURE_DECODER_INDEX_TOLERANCE_COUNTS &&
+            std::llabs(distance - this->countsPerRevolution) > QUADRATURE_DECODER_INDEX_TOLERANCE_COUNTS) {
+            this->indexErrorCount++;
+        }
+        if (distance > QUADRATURE_DECODER_INDEX_TOLERANCE_COUNTS) {
+            int64_t revolutions = this->revolutions.load(std::memory_order_relaxed) + (counts > 0 ? 1 : -1);
+            this->revolutions.store(revolutions, std::memory_order_relaxed);
+        }
+    }
+    this->lastIndexPosition = position;
+    this->indexed = true;
+    this->indexPosition.store(position, std::memory_order_relaxed);
+    this->indexCount.fetch_add(1, std::memory_order_release);
+    this->publish(timeNS);
+    this->notifyWaiter();
+}
+
+// Publish the latest position (decoder thread only)
+void QuadratureDecoder::publish(int64_t timeNS) {
+    int64_t position = this->position.load(std::memory_order_relaxed);
+    int32_t angleCount = static_cast<int32_t>((position - this->lastIndexPosition) % this->countsPerRevolution);
+    if (angleCount < 0) {
+        angleCount += this->countsPerRevolution;
+    }
+
+    QuadratureState state;
+    state.edgeTimeNS = timeNS;
+    state.position = position;
+    state.revolutions = this->revolutions.load(std::memory_order_relaxed);
+    state.angleCount = angleCount;
+    state.indexed = this->indexed;
+    this->state.write(state);
+}
+
+// Wake the waiter (decoder thread only)
+void QuadratureDecoder::notifyWaiter() {
+    std::lock_guard<std::mutex> lock(this->waitMutex);
+    this->waitCondition.notify_all();
+}
+
+// Wait for kernel edge events and decode until cancellation token
+void QuadratureDecoder::runLineEvents() {
+    GPIOLineEvent *lines[] = {this->eventsA, this->eventsB, this->eventsIndex};
+    const int lineCount = this->eventsIndex->isOpen() ? 3 : 2;
+
+    struct pollfd pollFileDescriptors[3];
+    for (int i = 0; i < lineCount; i++) {
+        pollFileDescriptors[i].fd = lines[i]->getFileDescriptor();
+        pollFileDescriptors[i].events = POLLIN;
+    }
+
+    struct timespec timeout;
+    timeout.tv_sec = 0;
+    timeout.tv_nsec = QUADRATURE_DECODER_WAIT_TIMEOUT_MS * 1000000L;
+
+    // Channel levels follow the events from the state at start
+    bool levelA = this->lastState == MMPEU::STATE::B || this->lastState == MMPEU::STATE::C;
+    bool levelB = this->lastState == MMPEU::STATE::C || this->lastState == MMPEU::STATE::D;
+
+    GPIOLineEventData events[3][QUADRATURE_DECODER_EVENT_BATCH_SIZE];
+    int eventCounts[3];
+    while (!this->decoderThreadShouldCancel) {
+        for (int i = 0; i < lineCount; i++) {
+            pollFileDescriptors[i].revents = 0;
+        }
+        int result = ::ppoll(pollFileDescriptors, lineCount, &timeout, nullptr);
+        if (result < 0 && errno != EINTR) {
+            std::cout << "QuadratureDecoder: Error waiting for encoder events" << std::endl;
+            break;
+        }
+        if (result <= 0) {
+            continue;
+        }
+
+        for (int i = 0; i < lineCount; i++) {
+            eventCounts[i] = pollFileDescriptors[i].revents != 0 ? lines[i]->read(events[i], QUADRATURE_DECODER_EVENT_BATCH_SIZE) : 0;
+            if (eventCounts[i] < 0) {
+                eventCounts[i] = 0;
+            }
+        }
+
+        // Apply events from every line in timestamp order
+        int next[3] = {0, 0, 0};
+        int64_t lastTimeNS = 0;
+        while (true) {
+            int line = -1;
+            for (int i = 0; i < lineCount; i++) {
+                if (next[i] < eventCounts[i] && (line < 0 || events[i][next[i]].timeNS < events[line][next[line]].timeNS)) {
+                    line = i;
+                }
+            }
+            if (line < 0) {
+                break;
+            }
+            const GPIOLineEventData &event = events[line][next[line]++];
+            lastTimeNS = event.timeNS;
+
+            if (line == 2) {
+                this->index(event.timeNS);
+                continue;
+            }
+
+            // An edge to the level the channel already has means the opposite edge was lost
+            bool &level = line == 0 ? levelA : levelB;
+            if (level == event.rising) {
+                this->illegalTransitionCount++;
+            }
+            level = event.rising;
+            MMPEU::STATE state = levelA ? (levelB ? MMPEU::STATE::C : MMPEU::STATE::B) : (levelB ? MMPEU::STATE::D : MMPEU::STATE::A);
+            this->decode(state, event.timeNS);
+        }
+        if (lastTimeNS != 0) {
+            this->publish(lastTimeNS);
+        }
+    }
+}
+
+// Wait for sysfs edge interrupts and decode until cancellation token
+void QuadratureDecoder::runEdges() {
+    GPIOEdge *edges[] = {this->edgeA, this->edgeB, this->edgeIndex};
+    const int edgeCount = this->edgeIndex->isOpen() ? 3 : 2;
+
+    struct pollfd pollFileDescriptors[3];
+    for (int i = 0; i < edgeCount; i++) {
+        pollFileDescriptors[i].fd = edges[i]->getFileDescriptor();
+        pollFileDescriptors[i].events = POLLPRI | POLLERR;
+    }
+
+    struct timespec timeout;
+    timeout.tv_sec = 0;
+    timeout.tv_nsec = QUADRATURE_DECODER_WAIT_TIMEOUT_MS * 1000000L;
+
+    while (!this->decoderThreadShouldCancel) {
+        for (int i = 0; i < edgeCount; i++) {
+            pollFileDescriptors[i].revents = 0;
+        }
+        int result = ::ppoll(pollFileDescriptors, edgeCount, &timeout, nullptr);
+        if (result < 0 && errno != EINTR) {
+            std::cout << "QuadratureDecoder: Error waiting for encoder edges" << std::endl;
+            break;
+        }
+        if (result <= 0) {
+            continue;
+        }
+        int64_t timeNS = Clock::monotonicNS();
+
+        // Acknowledge every pin that fired so the next wait blocks until a new edge
+        for (int i = 0; i < edgeCount; i++) {
+            if (pollFileDescriptors[i].revents != 0) {
+                edges[i]->readValue();
+            }
+        }
+
+        // Sample both channels together (one register read when memory mapped)
+        this->decode(this->encoder->getState(), timeNS);
+        if (edgeCount == 3 && pollFileDescriptors[2].revents != 0) {
+            this->index(timeNS);
+        } else {
+            this->publish(timeNS);
+        }
+    }
+}
+
+} /* namespace tids */
@@ -0,0 +1,170 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef QUADRATUREDECODER_H
+#define QUADRATUREDECODER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "GPIOEdge.h"
+#include "GPIOLineEvent.h"
+#include "MMPEU.h"
+#include "Seqlock.h"
+#include "SpeedEstimator.h"
+#include "SPSCRingBuffer.h"
+
+namespace tids {
+
+// Encoder position at the latest edge
+struct QuadratureState {
+    // Monotonic time of the latest edge in nanoseconds (0 before the first edge)
+    int64_t edgeTimeNS;
+    // Signed count of quadrature transitions since the decoder started (positive from state A to B)
+    int64_t position;
+    // Signed count of index pulses passed (0 before the first index)
+    int64_t revolutions;
+    // Count since the latest index pulse, within one revolution
+    int32_t angleCount;
+    // If an index pulse has been seen, so angleCount is absolute
+    bool indexed;
+};
+
+// Decodes both edges of both encoder channels (4x quadrature) on a background thread
+// Edges come from GPIO character device events with kernel timestamps where the lines can be requested,
+// otherwise from sysfs edge interrupts timestamped when the thread wakes
+class QuadratureDecoder {
+private:
+    MMPEU *encoder;
+    int countsPerRevolution;
+
+    // Kernel-timestamped edge events (used when channels A and B can both be requested)
+    GPIOLineEvent *eventsA;
+    GPIOLineEvent *eventsB;
+    GPIOLineEvent *eventsIndex;
+    std::atomic<bool> kernelTimestamps;
+
+    // Sysfs edge interrupts
+    GPIOEdge *edgeA;
+    GPIOEdge *edgeB;
+    GPIOEdge *edgeIndex;
+
+    std::thread decoderThread;
+    std::atomic<bool> decoderThreadShouldCancel;
+
+    // Timestamped position after every transition, for a single consumer
+    SPSCRingBuffer<EncoderEdge> *edges;
+
+    // Written only by the decoder thread
+    MMPEU::STATE lastState;
+    int64_t lastIndexPosition;
+    bool indexed;
+    std::atomic<int64_t> position;
+    std::atomic<int64_t> revolutions;
+    std::atomic<uint64_t> illegalTransitionCount;
+    std::atomic<uint64_t> indexErrorCount;
+    Seqlock<QuadratureState> state;
+
+    // Index pulses seen, and position at the latest one
+    std::atomic<uint64_t> indexCount;
+    std::atomic<int64_t> indexPosition;
+
+    // A waiter is woken when the position leaves (waitLowPosition, waitHighPosition) or an index pulse passes
+    std::mutex waitMutex;
+    std::condition_variable waitCondition;
+    std::atomic<int64_t> waitLowPosition;
+    std::atomic<int64_t> waitHighPosition;
+
+public:
+    QuadratureDecoder(MMPEU *encoder, int countsPerRevolution, size_t edgeCapacity=4096);
+    virtual ~QuadratureDecoder();
+
+    // Start decoding encoder edges
+    int start();
+
+    // Stop decoding encoder edges
+    int stop();
+
+    // If the decoder is running
+    bool isRunning();
+
+    // Get signed count of quadrature transitions since the decoder started
+    int64_t getPosition();
+
+    // Get signed count of index pulses passed
+    int64_t getRevolutions();
+
+    // Get position, revolutions and angle at the latest edge (returns -1 if no edge has been decoded)
+    int getState(QuadratureState *state);
+
+    // Get angle since the latest index pulse in degrees (from the start position before the first index)
+    float getAngleDegrees();
+
+    // Get counts per revolution
+    int getCountsPerRevolution();
+
+    // Get number of transitions that skipped a state, so their direction is unknown
+    uint64_t getIllegalTransitionCount();
+
+    // Get number of index pulses not a whole revolution from the previous one
+    uint64_t getIndexErrorCount();
+
+    // Get number of index pulses seen
+    uint64_t getIndexCount();
+
+    // Get position at the latest index pulse (returns -1 if no index pulse has been seen)
+    int getIndexPosition(int64_t *position);
+
+    // Wait until the position leaves (lowPosition, highPosition) or an index pulse passes (returns 0 when either happens, -1 on timeout; one waiter at a time)
+    int waitForPosition(int64_t lowPosition, int64_t highPosition, int64_t timeoutNS);
+
+    // Pop up to maxCount transitions, oldest first (single consumer only, returns number popped)
+    size_t readEdges(EncoderEdge *edges, size_t maxCount);
+
+    // Get number of transitions dropped because the consumer fell behind
+    uint64_t getEdgeOverflowCount();
+
+    // If edges are timestamped by the kernel rather than when the decoder thread wakes
+    bool hasKernelTimestamps();
+
+private:
+    // Decode a new channel state and record the transition at timeNS (decoder thread only)
+    void decode(MMPEU::STATE state, int64_t timeNS);
+
+    // Re-zero the angle at an index pulse (decoder thread only)
+    void index(int64_t timeNS);
+
+    // Publish the latest position (decoder thread only)
+    void publish(int64_t timeNS);
+
+    // Wake the waiter (decoder thread only)
+    void notifyWaiter();
+
+    // Wait for kernel edge events and decode until cancellation token
+    void runLineEvents();
+
+    // Wait for sysfs edge interrupts and decode until cancellation token
+    void runEdges();
+};
+
+} /* namespace tids */
+
+#endif /* QUADRATUREDECODER_H */
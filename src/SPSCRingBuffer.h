@@ -0,0 +1,124 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SPSCRINGBUFFER_H
+#define SPSCRINGBUFFER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace tids {
+
+// Size of a cache line, used to keep producer and consumer indices from false sharing
+#define SPSC_CACHE_LINE_SIZE 64
+
+// Preallocated lock-free ring buffer with a single producer thread and a single consumer thread
+template <typename T>
+class SPSCRingBuffer {
+private:
+    T *buffer;
+    size_t capacity;
+    size_t mask;
+
+    // Index of the next item to pop (written by consumer)
+    std::atomic<size_t> head;
+    // Consumer copy of tail, refreshed only when the buffer appears empty
+    size_t cachedTail;
+    char consumerPadding[SPSC_CACHE_LINE_SIZE];
+
+    // Index of the next item to push (written by producer)
+    std::atomic<size_t> tail;
+    // Producer copy of head, refreshed only when the buffer appears full
+    size_t cachedHead;
+    // Number of items dropped because the buffer was full
+    std::atomic<uint64_t> overflowCount;
+    char producerPadding[SPSC_CACHE_LINE_SIZE];
+
+public:
+    // Capacity is rounded up to a power of two
+    SPSCRingBuffer(size_t capacity) {
+        this->capacity = 1;
+        while (this->capacity < capacity) {
+            this->capacity <<= 1;
+        }
+        this->mask = this->capacity - 1;
+        this->buffer = new T[this->capacity];
+
+        this->head = 0;
+        this->cachedTail = 0;
+        this->tail = 0;
+        this->cachedHead = 0;
+        this->overflowCount = 0;
+    }
+
+    virtual ~SPSCRingBuffer() {
+        delete[] this->buffer;
+    }
+
+    // Push an item (producer only, returns -1 and counts an overflow if full)
+    int push(const T &item) {
+        size_t tail = this->tail.load(std::memory_order_relaxed);
+        if (tail - this->cachedHead >= this->capacity) {
+            this->cachedHead = this->head.load(std::memory_order_acquire);
+            if (tail - this->cachedHead >= this->capacity) {
+                this->overflowCount.fetch_add(1, std::memory_order_relaxed);
+                return -1;
+            }
+        }
+        this->buffer[tail & this->mask] = item;
+        this->tail.store(tail + 1, std::memory_order_release);
+        return 0;
+    }
+
+    // Pop up to maxCount items into items (consumer only, returns number of items popped)
+    size_t pop(T *items, size_t maxCount) {
+        size_t head = this->head.load(std::memory_order_relaxed);
+        if (this->cachedTail == head) {
+            this->cachedTail = this->tail.load(std::memory_order_acquire);
+        }
+        size_t count = this->cachedTail - head;
+        if (count > maxCount) {
+            count = maxCount;
+        }
+        for (size_t i = 0; i < count; i++) {
+            items[i] = this->buffer[(head + i) & this->mask];
+        }
+        this->head.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    // Get number of items waiting to be popped
+    size_t getSize() {
+        return this->tail.load(std::memory_order_acquire) - this->head.load(std::memory_order_acquire);
+    }
+
+    // Get maximum number of items
+    size_t getCapacity() {
+        return this->capacity;
+    }
+
+    // Get number of items dropped because the buffer was full
+    uint64_t getOverflowCount() {
+        return this->overflowCount.load(std::memory_order_relaxed);
+    }
+};
+
+} /* namespace tids */
+
+#endif /* SPSCRINGBUFFER_H */
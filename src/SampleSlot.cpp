@@ -0,0 +1,48 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "SampleSlot.h"
+
+namespace tids {
+
+SampleSlot::SampleSlot() {}
+
+SampleSlot::~SampleSlot() {}
+
+// Publish a new sample (must only be called from a single writer thread)
+void SampleSlot::publish(int64_t timeNS, float value) {
+    Sample sample;
+    sample.timeNS = timeNS;
+    sample.value = value;
+    this->seqlock.write(sample);
+}
+
+// Read the latest sample (returns -1 if nothing has been published)
+int SampleSlot::read(Sample *sample) {
+    if (this->seqlock.read(sample) == 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// Get number of samples published
+uint64_t SampleSlot::getCount() {
+    return this->seqlock.getSequence() / 2;
+}
+
+} /* namespace tids */
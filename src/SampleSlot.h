@@ -0,0 +1,57 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SAMPLESLOT_H
+#define SAMPLESLOT_H
+
+#include <cstdint>
+
+#include "Seqlock.h"
+
+namespace tids {
+
+// Sensor value stamped with its acquisition time
+struct Sample {
+    // Acquisition time in nanoseconds (monotonic clock)
+    int64_t timeNS;
+    // Sensor value
+    float value;
+};
+
+// Latest-value slot with a single writer and lock-free readers
+class SampleSlot {
+private:
+    Seqlock<Sample> seqlock;
+
+public:
+    SampleSlot();
+    virtual ~SampleSlot();
+
+    // Publish a new sample (must only be called from a single writer thread)
+    void publish(int64_t timeNS, float value);
+
+    // Read the latest sample (returns -1 if nothing has been published)
+    int read(Sample *sample);
+
+    // Get number of samples published
+    uint64_t getCount();
+};
+
+} /* namespace tids */
+
+#endif /* SAMPLESLOT_H */
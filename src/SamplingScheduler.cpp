@@ -0,0 +1,238 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "SamplingScheduler.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <ctime>
+#include <iostream>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "Clock.h"
+
+namespace tids {
+
+SamplingScheduler::SamplingScheduler() {
+    this->nextTaskId = 0;
+    this->timerFileDescriptor = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (this->timerFileDescriptor < 0) {
+        std::cout << "SamplingScheduler: Error creating timer." << std::endl;
+    }
+    this->schedulerThreadShouldCancel = true;
+}
+
+SamplingScheduler::~SamplingScheduler() {
+    this->stop();
+    if (this->timerFileDescriptor >= 0) {
+        close(this->timerFileDescriptor);
+    }
+}
+
+// Start running tasks
+int SamplingScheduler::start() {
+    // Return if the scheduler thread already exists or there is no timer
+    if (!this->schedulerThreadShouldCancel || this->timerFileDescriptor < 0) {
+        return -1;
+    }
+
+    // Reset cancellation token
+    this->schedulerThreadShouldCancel = false;
+
+    // Release every task one period from now
+    {
+        std::lock_guard<std::mutex> lock(this->tasksMutex);
+        int64_t nowNS = Clock::monotonicNS();
+        for (TaskEntry &entry : this->tasks) {
+            entry.nextReleaseNS = nowNS + entry.periodNS;
+        }
+        this->armTimer();
+    }
+
+    // Start scheduling on new thread
+    this->schedulerThread = std::thread(&SamplingScheduler::schedule, this);
+    return 0;
+}
+
+// Stop running tasks
+int SamplingScheduler::stop() {
+    // Set cancellation token and fire the timer immediately to wake the scheduler thread
+    this->schedulerThreadShouldCancel = true;
+    if (this->timerFileDescriptor >= 0) {
+        struct itimerspec wake = {};
+        wake.it_value.tv_nsec = 1;
+        timerfd_settime(this->timerFileDescriptor, 0, &wake, nullptr);
+    }
+
+    // Join scheduler thread
+    if (this->schedulerThread.joinable()) {
+        this->schedulerThread.join();
+    }
+    return 0;
+}
+
+// Add a periodic task first released one period from now (returns task id, or -1 on error)
+int SamplingScheduler::addTask(std::string name, int64_t periodNS, int64_t deadlineNS, Task task) {
+    if (periodNS <= 0 || deadlineNS <= 0 || !task) {
+        return -1;
+    }
+
+    TaskEntry entry;
+    entry.name = name;
+    entry.periodNS = periodNS;
+    entry.deadlineNS = deadlineNS;
+    entry.nextReleaseNS = Clock::monotonicNS() + periodNS;
+    entry.task = task;
+    entry.runCount = 0;
+    entry.deadlineMissCount = 0;
+    entry.skippedCount = 0;
+
+    std::lock_guard<std::mutex> lock(this->tasksMutex);
+    entry.id = this->nextTaskId++;
+
+    // Keep tasks ordered by deadline
+    std::vector<TaskEntry>::iterator position = std::upper_bound(this->tasks.begin(), this->tasks.end(), entry,
+        [](const TaskEntry &a, const TaskEntry &b) { return a.deadlineNS < b.deadlineNS; });
+    this->tasks.insert(position, entry);
+
+    // The new task may be released before the currently armed time
+    if (!this->schedulerThreadShouldCancel) {
+        this->armTimer();
+    }
+    return entry.id;
+}
+
+// Remove a task (must not be called from within a task)
+int SamplingScheduler::removeTask(int id) {
+    // Waits for the task to finish if it is running
+    std::lock_guard<std::mutex> lock(this->tasksMutex);
+    for (std::vector<TaskEntry>::iterator it = this->tasks.begin(); it != this->tasks.end(); ++it) {
+        if (it->id == id) {
+            this->tasks.erase(it);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Set a callback run after every pass that ran at least one task, passed the latest release time of the pass
+int SamplingScheduler::setPassCallback(Task callback) {
+    std::lock_guard<std::mutex> lock(this->tasksMutex);
+    this->passCallback = callback;
+    return 0;
+}
+
+// Get number of times a task has completed after its deadline
+uint64_t SamplingScheduler::getDeadlineMissCount(int id) {
+    std::lock_guard<std::mutex> lock(this->tasksMutex);
+    for (const TaskEntry &entry : this->tasks) {
+        if (entry.id == id) {
+            return entry.deadlineMissCount;
+        }
+    }
+    return 0;
+}
+
+// Get number of releases skipped for a task
+uint64_t SamplingScheduler::getSkippedCount(int id) {
+    std::lock_guard<std::mutex> lock(this->tasksMutex);
+    for (const TaskEntry &entry : this->tasks) {
+        if (entry.id == id) {
+            return entry.skippedCount;
+        }
+    }
+    return 0;
+}
+
+// Get number of times a task has run
+uint64_t SamplingScheduler::getRunCount(int id) {
+    std::lock_guard<std::mutex> lock(this->tasksMutex);
+    for (const TaskEntry &entry : this->tasks) {
+        if (entry.id == id) {
+            return entry.runCount;
+        }
+    }
+    return 0;
+}
+
+// Arm the timer for the earliest release (tasksMutex must be held)
+void SamplingScheduler::armTimer() {
+    struct itimerspec release = {};
+    if (!this->tasks.empty()) {
+        int64_t earliestReleaseNS = this->tasks.front().nextReleaseNS;
+        for (const TaskEntry &entry : this->tasks) {
+            earliestReleaseNS = std::min(earliestReleaseNS, entry.nextReleaseNS);
+        }
+        release.it_value.tv_sec = earliestReleaseNS / 1000000000;
+        release.it_value.tv_nsec = earliestReleaseNS % 1000000000;
+    }
+    // Absolute expiration so wake-ups never accumulate drift (an all-zero value disarms)
+    timerfd_settime(this->timerFileDescriptor, TFD_TIMER_ABSTIME, &release, nullptr);
+}
+
+// Wait for releases and run due tasks until cancellation token
+void SamplingScheduler::schedule() {
+    while (!this->schedulerThreadShouldCancel) {
+        // Block until the earliest release
+        uint64_t expirations;
+        ssize_t result = read(this->timerFileDescriptor, &expirations, sizeof(expirations));
+        if (result < 0 && errno != EINTR) {
+            std::cout << "SamplingScheduler: Error reading timer." << std::endl;
+            return;
+        }
+        if (this->schedulerThreadShouldCancel) {
+            break;
+        }
+
+        std::lock_guard<std::mutex> lock(this->tasksMutex);
+        bool ranTask = false;
+        int64_t passReleaseTimeNS = 0;
+        for (TaskEntry &entry : this->tasks) {
+            if (entry.nextReleaseNS > Clock::monotonicNS()) {
+                continue;
+            }
+
+            // Run task for its release time
+            entry.task(entry.nextReleaseNS);
+            entry.runCount++;
+            ranTask = true;
+            passReleaseTimeNS = std::max(passReleaseTimeNS, entry.nextReleaseNS);
+
+            int64_t completionTimeNS = Clock::monotonicNS();
+            if (completionTimeNS > entry.nextReleaseNS + entry.deadlineNS) {
+                entry.deadlineMissCount++;
+            }
+
+            // Advance by whole periods, skipping releases that have already passed
+            entry.nextReleaseNS += entry.periodNS;
+            if (entry.nextReleaseNS <= completionTimeNS) {
+                int64_t skipped = (completionTimeNS - entry.nextReleaseNS) / entry.periodNS + 1;
+                entry.nextReleaseNS += skipped * entry.periodNS;
+                entry.skippedCount += static_cast<uint64_t>(skipped);
+            }
+        }
+
+        if (ranTask && this->passCallback) {
+            this->passCallback(passReleaseTimeNS);
+        }
+        this->armTimer();
+    }
+}
+
+} /* namespace tids */
@@ -0,0 +1,105 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SAMPLINGSCHEDULER_H
+#define SAMPLINGSCHEDULER_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace tids {
+
+// Runs periodic tasks with individual periods and deadlines on a single timerfd-driven thread
+class SamplingScheduler {
+public:
+    // Task callback, passed the absolute release time it was scheduled for (monotonic, in nanoseconds)
+    typedef std::function<void(int64_t releaseTimeNS)> Task;
+
+private:
+    struct TaskEntry {
+        int id;
+        std::string name;
+        int64_t periodNS;
+        // Time after release by which the task must complete
+        int64_t deadlineNS;
+        // Next absolute release time (advanced by whole periods so it never drifts)
+        int64_t nextReleaseNS;
+        Task task;
+        uint64_t runCount;
+        uint64_t deadlineMissCount;
+        // Releases skipped because the task was still running past them
+        uint64_t skippedCount;
+    };
+
+    // Tasks ordered by deadline (shortest deadline runs first when releases coincide)
+    std::vector<TaskEntry> tasks;
+    std::mutex tasksMutex;
+    int nextTaskId;
+
+    // Called after every pass that ran at least one task
+    Task passCallback;
+
+    int timerFileDescriptor;
+
+    std::thread schedulerThread;
+    std::atomic<bool> schedulerThreadShouldCancel;
+
+public:
+    SamplingScheduler();
+    virtual ~SamplingScheduler();
+
+    // Start running tasks
+    int start();
+
+    // Stop running tasks
+    int stop();
+
+    // Add a periodic task first released one period from now (returns task id, or -1 on error)
+    int addTask(std::string name, int64_t periodNS, int64_t deadlineNS, Task task);
+
+    // Remove a task (must not be called from within a task)
+    int removeTask(int id);
+
+    // Set a callback run after every pass that ran at least one task, passed the latest release time of the pass
+    int setPassCallback(Task callback);
+
+    // Get number of times a task has completed after its deadline
+    uint64_t getDeadlineMissCount(int id);
+
+    // Get number of releases skipped for a task
+    uint64_t getSkippedCount(int id);
+
+    // Get number of times a task has run
+    uint64_t getRunCount(int id);
+
+private:
+    // Arm the timer for the earliest release (tasksMutex must be held)
+    void armTimer();
+
+    // Wait for releases and run due tasks until cancellation token
+    void schedule();
+};
+
+} /* namespace tids */
+
+#endif /* SAMPLINGSCHEDULER_H */
@@ -0,0 +1,98 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace tids {
+
+// Sequence lock publishing a trivially copyable value from a single writer to lock-free readers
+// The value is stored as atomic words so a concurrent read is never a data race, only retried
+template <typename T>
+class Seqlock {
+private:
+    static_assert(std::is_trivially_copyable<T>::value, "Seqlock value must be trivially copyable");
+
+    static const size_t WORD_COUNT = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    // Incremented before and after every write (odd while a write is in progress)
+    std::atomic<uint64_t> sequence;
+    std::atomic<uint64_t> words[WORD_COUNT];
+
+public:
+    Seqlock() {
+        this->sequence = 0;
+        for (size_t i = 0; i < WORD_COUNT; i++) {
+            this->words[i] = 0;
+        }
+    }
+
+    virtual ~Seqlock() {}
+
+    // Publish a new value (must only be called from a single writer thread)
+    void write(const T &value) {
+        uint64_t buffer[WORD_COUNT] = {0};
+        memcpy(buffer, &value, sizeof(T));
+
+        uint64_t sequence = this->sequence.load(std::memory_order_relaxed);
+
+        // Mark write in progress before touching the payload
+        this->sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (size_t i = 0; i < WORD_COUNT; i++) {
+            this->words[i].store(buffer[i], std::memory_order_relaxed);
+        }
+
+        // Mark write complete
+        this->sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    // Read a consistent copy of the latest value (returns the sequence it was read at, 0 if never written)
+    uint64_t read(T *value) {
+        uint64_t buffer[WORD_COUNT];
+        uint64_t sequenceBefore;
+        uint64_t sequenceAfter;
+        do {
+            sequenceBefore = this->sequence.load(std::memory_order_acquire);
+            for (size_t i = 0; i < WORD_COUNT; i++) {
+                buffer[i] = this->words[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            sequenceAfter = this->sequence.load(std::memory_order_relaxed);
+        // Retry if the writer was active during the read
+        } while ((sequenceBefore & 0x1) || sequenceBefore != sequenceAfter);
+
+        memcpy(value, buffer, sizeof(T));
+        return sequenceBefore;
+    }
+
+    // Get the current sequence (even when no write is in progress)
+    uint64_t getSequence() {
+        return this->sequence.load(std::memory_order_acquire);
+    }
+};
+
+} /* namespace tids */
+
+#endif /* SEQLOCK_H */
@@ -0,0 +1,162 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "SpeedEstimator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+// Error in the spacing of quadrature edges (from channel phase and duty cycle errors), in counts
+#define SPEEDESTIMATOR_EDGE_SPACING_ERROR_COUNTS 0.1
+
+// Smoothing factor of the acceleration low-pass filter
+#define SPEEDESTIMATOR_ACCELERATION_ALPHA 0.3f
+
+namespace tids {
+
+SpeedEstimator::SpeedEstimator(int countsPerRevolution, int64_t minimumWindowNS, int64_t maximumWindowNS, int minimumEdgeCount, size_t historyCapacity) {
+    this->countsPerRevolution = countsPerRevolution;
+    this->minimumWindowNS = minimumWindowNS;
+    this->maximumWindowNS = std::max(maximumWindowNS, minimumWindowNS);
+    this->minimumEdgeCount = std::max(minimumEdgeCount, 1);
+    this->timestampJitterNS = 0;
+    this->edges.resize(std::max<size_t>(historyCapacity, 2));
+    this->reset();
+}
+
+SpeedEstimator::~SpeedEstimator() {}
+
+// Set uncertainty of each edge timestamp in nanoseconds
+void SpeedEstimator::setTimestampJitterNS(int64_t timestampJitterNS) {
+    this->timestampJitterNS = timestampJitterNS;
+}
+
+// Add an edge, in time order (single updating thread only)
+void SpeedEstimator::addEdge(const EncoderEdge &edge) {
+    this->edges[this->nextEdgeIndex] = edge;
+    this->nextEdgeIndex = (this->nextEdgeIndex + 1) % this->edges.size();
+    if (this->edgeCount < this->edges.size()) {
+        this->edgeCount++;
+    }
+}
+
+// Estimate speed at timeNS from the edges added so far and publish it (single updating thread only)
+const SpeedEstimate &SpeedEstimator::update(int64_t timeNS) {
+    SpeedEstimate previous = this->estimate;
+    this->estimate = SpeedEstimate();
+    this->estimate.timeNS = timeNS;
+
+    // Stopped (or unknown) once no edge has arrived within the longest window
+    if (this->edgeCount == 0 || timeNS - this->getEdge(0).timeNS > this->maximumWindowNS) {
+        this->lastWindowMidpointNS = 0;
+        this->publishedEstimate.write(this->estimate);
+        return this->estimate;
+    }
+    const EncoderEdge &newest = this->getEdge(0);
+    int64_t sinceNewestNS = timeNS - newest.timeNS;
+
+    // Grow the window back from the newest edge until it is both long enough and holds enough edges
+    size_t windowEdges = 0;
+    while (windowEdges + 1 < this->edgeCount) {
+        int64_t spanNS = newest.timeNS - this->getEdge(windowEdges + 1).timeNS;
+        if (spanNS > this->maximumWindowNS) {
+            break;
+        }
+        windowEdges++;
+        if (spanNS >= this->minimumWindowNS && static_cast<int>(windowEdges) >= this->minimumEdgeCount) {
+            break;
+        }
+    }
+
+    if (windowEdges == 0) {
+        // A single edge gives no interval, but the speed can be no more than a count since that edge
+        if (sinceNewestNS > 0) {
+            float boundRPM = static_cast<float>(60e9 / (static_cast<double>(this->countsPerRevolution) * sinceNewestNS));
+            this->estimate.speedRPM = std::max(-boundRPM, std::min(previous.speedRPM, boundRPM));
+        }
+        this->estimate.edgeCount = 1;
+        this->publishedEstimate.write(this->estimate);
+        return this->estimate;
+    }
+
+    const EncoderEdge &first = this->getEdge(windowEdges);
+    int64_t counts = newest.position - first.position;
+    int64_t windowNS = newest.timeNS - first.timeNS;
+    this->estimate.edgeCount = static_cast<int32_t>(windowEdges + 1);
+    this->estimate.windowNS = windowNS;
+    if (counts == 0 || windowNS <= 0) {
+        // Reversed within the window, so the net speed is zero but not well resolved
+        this->publishedEstimate.write(this->estimate);
+        return this->estimate;
+    }
+
+    double speedRPM = static_cast<double>(counts) / this->countsPerRevolution / (windowNS / 1e9) * 60.0;
+
+    // Relative uncertainty from timestamp jitter at both ends and edge spacing errors at both ends
+    double uncertainty = 2.0 * this->timestampJitterNS / windowNS + 2.0 * SPEEDESTIMATOR_EDGE_SPACING_ERROR_COUNTS / std::llabs(counts);
+    double quality = std::max(0.0, 1.0 - uncertainty);
+
+    // Decelerating when the next edge is later than the window average, so the speed is at most a count since the newest edge
+    int64_t averageIntervalNS = windowNS / std::llabs(counts);
+    if (sinceNewestNS > averageIntervalNS) {
+        double boundRPM = 60e9 / (static_cast<double>(this->countsPerRevolution) * sinceNewestNS);
+        if (std::abs(speedRPM) > boundRPM) {
+            speedRPM = speedRPM > 0 ? boundRPM : -boundRPM;
+            quality *= 0.5;
+        }
+    }
+    this->estimate.speedRPM = static_cast<float>(speedRPM);
+    this->estimate.quality = static_cast<float>(quality);
+
+    // Acceleration between the midpoints of consecutive windows, low-pass filtered
+    int64_t windowMidpointNS = first.timeNS + windowNS / 2;
+    if (this->lastWindowMidpointNS != 0 && windowMidpointNS > this->lastWindowMidpointNS) {
+        float accelerationRPMPerS = static_cast<float>((speedRPM - previous.speedRPM) / ((windowMidpointNS - this->lastWindowMidpointNS) / 1e9));
+        this->estimate.accelerationRPMPerS = previous.accelerationRPMPerS + SPEEDESTIMATOR_ACCELERATION_ALPHA * (accelerationRPMPerS - previous.accelerationRPMPerS);
+    } else {
+        this->estimate.accelerationRPMPerS = previous.accelerationRPMPerS;
+    }
+    this->lastWindowMidpointNS = windowMidpointNS;
+
+    this->publishedEstimate.write(this->estimate);
+    return this->estimate;
+}
+
+// Clear every edge and estimate (single updating thread only)
+void SpeedEstimator::reset() {
+    this->edgeCount = 0;
+    this->nextEdgeIndex = 0;
+    this->estimate = SpeedEstimate();
+    this->lastWindowMidpointNS = 0;
+}
+
+// Get latest published estimate from any thread (returns -1 if none has been published)
+int SpeedEstimator::getEstimate(SpeedEstimate *estimate) {
+    if (this->publishedEstimate.read(estimate) == 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// Get an edge counted back from the newest (0 is the newest)
+const EncoderEdge &SpeedEstimator::getEdge(size_t age) {
+    return this->edges[(this->nextEdgeIndex + this->edges.size() - 1 - age) % this->edges.size()];
+}
+
+} /* namespace tids */
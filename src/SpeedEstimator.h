@@ -0,0 +1,103 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SPEEDESTIMATOR_H
+#define SPEEDESTIMATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Seqlock.h"
+
+namespace tids {
+
+// Encoder position after an edge
+struct EncoderEdge {
+    // Time of the edge in nanoseconds (monotonic clock)
+    int64_t timeNS;
+    // Signed count of transitions including this edge
+    int64_t position;
+};
+
+// Speed estimate at one update
+struct SpeedEstimate {
+    // Time of the update in nanoseconds (monotonic clock)
+    int64_t timeNS;
+    // Signed speed in revolutions per minute
+    float speedRPM;
+    // Signed acceleration in revolutions per minute per second
+    float accelerationRPMPerS;
+    // Confidence from 0 (no information) to 1 (edge count and timing both well resolved)
+    float quality;
+    // Edges and time spanned by the window the speed was measured over
+    int32_t edgeCount;
+    int64_t windowNS;
+};
+
+// Speed from encoder edges by the M/T method: net counts over the time between the first and last edge
+// of a window, so neither count quantization nor a single late edge dominates
+// The window spans at least minimumWindowNS, growing at low speed until it holds minimumEdgeCount edges
+// or reaches maximumWindowNS
+class SpeedEstimator {
+private:
+    int countsPerRevolution;
+    int64_t minimumWindowNS;
+    int64_t maximumWindowNS;
+    int minimumEdgeCount;
+    // Uncertainty of each edge timestamp, from the timestamp source
+    int64_t timestampJitterNS;
+
+    // Recent edges, oldest overwritten first
+    std::vector<EncoderEdge> edges;
+    size_t edgeCount;
+    size_t nextEdgeIndex;
+
+    // Previous estimate, for acceleration
+    SpeedEstimate estimate;
+    int64_t lastWindowMidpointNS;
+
+    Seqlock<SpeedEstimate> publishedEstimate;
+
+public:
+    SpeedEstimator(int countsPerRevolution, int64_t minimumWindowNS, int64_t maximumWindowNS, int minimumEdgeCount, size_t historyCapacity=4096);
+    virtual ~SpeedEstimator();
+
+    // Set uncertainty of each edge timestamp in nanoseconds
+    void setTimestampJitterNS(int64_t timestampJitterNS);
+
+    // Add an edge, in time order (single updating thread only)
+    void addEdge(const EncoderEdge &edge);
+
+    // Estimate speed at timeNS from the edges added so far and publish it (single updating thread only)
+    const SpeedEstimate &update(int64_t timeNS);
+
+    // Clear every edge and estimate (single updating thread only)
+    void reset();
+
+    // Get latest published estimate from any thread (returns -1 if none has been published)
+    int getEstimate(SpeedEstimate *estimate);
+
+private:
+    // Get an edge counted back from the newest (0 is the newest)
+    const EncoderEdge &getEdge(size_t age);
+};
+
+} /* namespace tids */
+
+#endif /* SPEEDESTIMATOR_H */
@@ -0,0 +1,211 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "StallDetector.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+
+// Samples the current slope is fitted over
+#define STALLDETECTOR_SLOPE_WINDOW 10
+
+namespace tids {
+
+// Get stall reason name
+const char *stallReasonName(int reason) {
+    switch (reason) {
+        case StallEvent::REASON::CURRENT:
+            return "current";
+        case StallEvent::REASON::TORQUE:
+            return "torque";
+        case StallEvent::REASON::PREDICTED_CURRENT:
+            return "predicted_current";
+        case StallEvent::REASON::DECELERATION:
+            return "deceleration";
+        default:
+            return "unknown";
+    }
+}
+
+StallDetector::StallDetector(StallThresholds thresholds, size_t historyCapacity, size_t postTriggerCount) {
+    this->thresholds = thresholds;
+    this->history.resize(std::max<size_t>(historyCapacity, postTriggerCount + STALLDETECTOR_SLOPE_WINDOW));
+    this->postTriggerCount = postTriggerCount;
+    this->tripCount = 0;
+    this->rearm(0, 0);
+}
+
+StallDetector::~StallDetector() {}
+
+// Set trip limits (only while no updates run)
+void StallDetector::setThresholds(StallThresholds thresholds) {
+    this->thresholds = thresholds;
+}
+
+// Get trip limits
+StallThresholds StallDetector::getThresholds() {
+    return this->thresholds;
+}
+
+// Clear any trip and ignore trips until blankingNS after timeNS (not concurrently with update)
+void StallDetector::rearm(int64_t timeNS, int64_t blankingNS) {
+    this->count = 0;
+    this->blankedUntilNS = timeNS + blankingNS;
+    this->tripped = false;
+    this->tripIndex = 0;
+    this->tripCaptured = false;
+}
+
+// Record a sample, filling in its current slope (returns 1 and fills event on a trip, 0 otherwise; single updating thread only)
+int StallDetector::update(StallSample *sample, StallEvent *event) {
+    // Keep the capture intact for the reader once it is complete
+    if (this->tripCaptured.load(std::memory_order_relaxed)) {
+        return 0;
+    }
+
+    this->history[this->count % this->history.size()] = *sample;
+    this->count++;
+    sample->currentSlopeAPerS = this->calculateCurrentSlope();
+    this->history[(this->count - 1) % this->history.size()].currentSlopeAPerS = sample->currentSlopeAPerS;
+
+    // Record post-trigger samples, then hand the capture to readers
+    if (this->tripped) {
+        if (this->count - this->tripIndex > this->postTriggerCount) {
+            this->tripCaptured.store(true, std::memory_order_release);
+        }
+        return 0;
+    }
+    if (sample->timeNS < this->blankedUntilNS) {
+        return 0;
+    }
+
+    const StallThresholds &thresholds = this->thresholds;
+    float current = std::fabs(sample->currentA);
+    float speed = std::fabs(sample->speedRPM);
+    // Deceleration is acceleration against the direction of rotation
+    float deceleration = (sample->speedRPM >= 0.0f) ? -sample->accelerationRPMPerS : sample->accelerationRPMPerS;
+
+    StallEvent trip;
+    trip.timeToStallS = 0.0f;
+    if (current >= thresholds.currentA) {
+        trip.reason = StallEvent::REASON::CURRENT;
+    } else if (sample->torqueNM >= thresholds.torqueNM) {
+        trip.reason = StallEvent::REASON::TORQUE;
+    } else if (sample->currentSlopeAPerS >= thresholds.currentSlopeAPerS &&
+               current + sample->currentSlopeAPerS * thresholds.predictionHorizonS >= thresholds.currentA) {
+        trip.reason = StallEvent::REASON::PREDICTED_CURRENT;
+        trip.timeToStallS = (thresholds.currentA - current) / sample->currentSlopeAPerS;
+    } else if (deceleration >= thresholds.decelerationRPMPerS && sample->weightOnBitKg >= thresholds.weightOnBitKg &&
+               speed <= deceleration * thresholds.predictionHorizonS) {
+        // A loaded bit slowing this hard is binding, not following a commanded slow-down
+        trip.reason = StallEvent::REASON::DECELERATION;
+        trip.timeToStallS = speed / deceleration;
+    } else {
+        return 0;
+    }
+
+    trip.sample = *sample;
+    this->tripped = true;
+    this->tripEvent = trip;
+    this->tripIndex = this->count - 1;
+    this->tripCount++;
+    *event = trip;
+    return 1;
+}
+
+// If a trip has been raised since the detector was armed
+bool StallDetector::isTripped() {
+    return this->tripCaptured || this->tripped;
+}
+
+// Copy a completed trip capture, oldest sample first (returns -1 until the post-trigger samples are recorded)
+int StallDetector::getTrip(StallEvent *event, std::vector<StallSample> *samples) {
+    if (!this->tripCaptured.load(std::memory_order_acquire)) {
+        return -1;
+    }
+    *event = this->tripEvent;
+    size_t available = static_cast<size_t>(std::min<uint64_t>(this->count, this->history.size()));
+    samples->clear();
+    for (size_t age = available; age > 0; age--) {
+        samples->push_back(this->getSample(age - 1));
+    }
+    return 0;
+}
+
+// Write a completed trip capture as CSV with time relative to the trip (returns -1 if none or on error)
+int StallDetector::writeTrip(std::string path) {
+    StallEvent event;
+    std::vector<StallSample> samples;
+    if (this->getTrip(&event, &samples) < 0) {
+        return -1;
+    }
+
+    FILE *file = fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        return -1;
+    }
+    fprintf(file, "# trip %s at %" PRId64 " ns, time to stall %.4f s\n", stallReasonName(event.reason), event.sample.timeNS, event.timeToStallS);
+    fprintf(file, "time_ms,current_a,current_slope_a_per_s,speed_rpm,acceleration_rpm_per_s,weight_on_bit_kg,torque_nm\n");
+    for (const StallSample &sample : samples) {
+        fprintf(file, "%.3f,%.3f,%.2f,%.2f,%.1f,%.3f,%.3f\n", (sample.timeNS - event.sample.timeNS) / 1e6,
+                sample.currentA, sample.currentSlopeAPerS, sample.speedRPM, sample.accelerationRPMPerS,
+                sample.weightOnBitKg, sample.torqueNM);
+    }
+    return fclose(file) == 0 ? 0 : -1;
+}
+
+// Get number of trips raised
+uint64_t StallDetector::getTripCount() {
+    return this->tripCount;
+}
+
+// Get a sample counted back from the newest (0 is the newest)
+const StallSample &StallDetector::getSample(size_t age) {
+    return this->history[(this->count - 1 - age) % this->history.size()];
+}
+
+// Least-squares slope of current over the most recent samples, in amps per second
+float StallDetector::calculateCurrentSlope() {
+    size_t window = static_cast<size_t>(std::min<uint64_t>(this->count, STALLDETECTOR_SLOPE_WINDOW));
+    if (window < 2) {
+        return 0.0f;
+    }
+
+    // Times relative to the newest sample keep the sums well conditioned
+    int64_t newestNS = this->getSample(0).timeNS;
+    double sumT = 0.0, sumI = 0.0, sumTT = 0.0, sumTI = 0.0;
+    for (size_t age = 0; age < window; age++) {
+        const StallSample &sample = this->getSample(age);
+        double t = (sample.timeNS - newestNS) / 1e9;
+        double i = std::fabs(sample.currentA);
+        sumT += t;
+        sumI += i;
+        sumTT += t * t;
+        sumTI += t * i;
+    }
+    double n = static_cast<double>(window);
+    double denominator = n * sumTT - sumT * sumT;
+    if (denominator <= 0.0) {
+        return 0.0f;
+    }
+    return static_cast<float>((n * sumTI - sumT * sumI) / denominator);
+}
+
+} /* namespace tids */
@@ -0,0 +1,145 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STALLDETECTOR_H
+#define STALLDETECTOR_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace tids {
+
+// Drill state at one control update
+struct StallSample {
+    // Time of the update in nanoseconds (monotonic clock)
+    int64_t timeNS;
+    // Drill current in amps, and its slope over the recent updates in amps per second (filled in by the detector)
+    float currentA;
+    float currentSlopeAPerS;
+    // Signed speed and acceleration from the encoder
+    float speedRPM;
+    float accelerationRPMPerS;
+    // Latest weight on bit in kg (negative if unknown)
+    float weightOnBitKg;
+    // Estimated load torque in Nm
+    float torqueNM;
+};
+
+// Limits at which the drill is tripped, before it stalls
+struct StallThresholds {
+    // Current and torque above which the drill trips at once
+    float currentA;
+    float torqueNM;
+    // Current slope above which the current is extrapolated, and how far ahead current and speed are extrapolated
+    float currentSlopeAPerS;
+    float predictionHorizonS;
+    // Deceleration above which speed is extrapolated to zero, while weight on bit shows the bit is loaded
+    float decelerationRPMPerS;
+    float weightOnBitKg;
+};
+
+// Drill trip raised by a stall detector
+struct StallEvent {
+    enum REASON {
+        // Current above its limit
+        CURRENT = 0,
+        // Torque above its limit
+        TORQUE = 1,
+        // Rising current reaches its limit within the prediction horizon
+        PREDICTED_CURRENT = 2,
+        // Loaded bit decelerates to a stop within the prediction horizon
+        DECELERATION = 3,
+    };
+
+    StallEvent::REASON reason;
+    // Sample that raised the trip
+    StallSample sample;
+    // Extrapolated time until the limit or stop is reached, in seconds (0 for an immediate trip)
+    float timeToStallS;
+};
+
+// Get stall reason name
+const char *stallReasonName(int reason);
+
+// Predicts drill stalls from current slope, deceleration and weight on bit, and captures the samples around each trip
+// Samples are recorded continuously; after a trip, recording continues for the post-trigger count, then the capture is
+// frozen for a reader until the detector is rearmed
+class StallDetector {
+private:
+    StallThresholds thresholds;
+
+    // Recent samples (circular) including the pre-trigger history of a trip
+    std::vector<StallSample> history;
+    uint64_t count;
+
+    // Samples to record after a trip
+    size_t postTriggerCount;
+
+    // Trips are not raised before this time, e.g. while the drill accelerates from a start
+    int64_t blankedUntilNS;
+
+    // Trip being captured, index of its sample, and if the capture is complete
+    std::atomic<bool> tripped;
+    StallEvent tripEvent;
+    uint64_t tripIndex;
+    std::atomic<bool> tripCaptured;
+
+    std::atomic<uint64_t> tripCount;
+
+public:
+    StallDetector(StallThresholds thresholds, size_t historyCapacity=1024, size_t postTriggerCount=256);
+    virtual ~StallDetector();
+
+    // Set trip limits (only while no updates run)
+    void setThresholds(StallThresholds thresholds);
+
+    // Get trip limits
+    StallThresholds getThresholds();
+
+    // Clear any trip and ignore trips until blankingNS after timeNS (not concurrently with update)
+    void rearm(int64_t timeNS, int64_t blankingNS);
+
+    // Record a sample, filling in its current slope (returns 1 and fills event on a trip, 0 otherwise; single updating thread only)
+    int update(StallSample *sample, StallEvent *event);
+
+    // If a trip has been raised since the detector was armed
+    bool isTripped();
+
+    // Copy a completed trip capture, oldest sample first (returns -1 until the post-trigger samples are recorded)
+    int getTrip(StallEvent *event, std::vector<StallSample> *samples);
+
+    // Write a completed trip capture as CSV with time relative to the trip (returns -1 if none or on error)
+    int writeTrip(std::string path);
+
+    // Get number of trips raised
+    uint64_t getTripCount();
+
+private:
+    // Get a sample counted back from the newest (0 is the newest)
+    const StallSample &getSample(size_t age);
+
+    // Least-squares slope of current over the most recent samples, in amps per second
+    float calculateCurrentSlope();
+};
+
+} /* namespace tids */
+
+#endif /* STALLDETECTOR_H */
@@ -0,0 +1,218 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "StepPulseEngine.h"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include "Clock.h"
+
+// Stack prefaulted by the engine thread so pulses never take a page fault, in bytes
+#define STEPPULSEENGINE_STACK_PREFAULT_BYTES (64 * 1024)
+
+namespace tids {
+
+StepPulseEngine::StepPulseEngine(PulseOutput output, int priority, int64_t pulseWidthNS, int64_t spinNS) {
+    this->output = output;
+    this->priority = priority;
+    this->pulseWidthNS = pulseWidthNS;
+    this->spinNS = spinNS;
+    this->engineThreadShouldCancel = false;
+    this->realTime = false;
+    this->pendingProfile = nullptr;
+    this->moveDone = false;
+    this->moveStepCount = 0;
+    this->abortRequested = false;
+    this->missedCount = 0;
+}
+
+StepPulseEngine::~StepPulseEngine() {
+    this->stop();
+}
+
+// Lock memory and start the engine thread (runs at normal priority if real-time scheduling is not permitted)
+int StepPulseEngine::start() {
+    if (this->engineThread.joinable()) {
+        return -1;
+    }
+
+    this->engineThreadShouldCancel = false;
+    this->engineThread = std::thread(&StepPulseEngine::engine, this);
+
+    struct sched_param parameters;
+    parameters.sched_priority = this->priority;
+    int error = pthread_setschedparam(this->engineThread.native_handle(), SCHED_FIFO, &parameters);
+    if (error != 0) {
+        std::cout << "StepPulseEngine: Error setting real-time priority: " << std::strerror(error) << std::endl;
+    }
+    this->realTime = (error == 0);
+    return 0;
+}
+
+// Stop the engine thread
+int StepPulseEngine::stop() {
+    {
+        std::lock_guard<std::mutex> lock(this->moveMutex);
+        this->engineThreadShouldCancel = true;
+        this->abortRequested = true;
+    }
+    this->moveCondition.notify_all();
+    if (this->engineThread.joinable()) {
+        this->engineThread.join();
+    }
+    return 0;
+}
+
+// Emit every step of profile until stopCondition (if any) is true, blocking until done
+// (returns number of steps emitted, or -1 if not started)
+int64_t StepPulseEngine::run(const MotionProfile *profile, StopCondition stopCondition) {
+    std::unique_lock<std::mutex> lock(this->moveMutex);
+    if (!this->engineThread.joinable() || this->engineThreadShouldCancel) {
+        return -1;
+    }
+    this->abortRequested = false;
+    this->moveDone = false;
+    this->pendingProfile = profile;
+    this->pendingStopCondition = stopCondition;
+    this->moveCondition.notify_all();
+    this->moveCondition.wait(lock, [this] { return this->moveDone || this->engineThreadShouldCancel; });
+    return this->moveDone ? this->moveStepCount : 0;
+}
+
+// Stop a running profile after its current step
+void StepPulseEngine::abort() {
+    this->abortRequested = true;
+}
+
+// If the engine thread runs with real-time scheduling
+bool StepPulseEngine::isRealTime() {
+    return this->realTime;
+}
+
+// Get pulse time after its release time
+LatencyHistogram *StepPulseEngine::getPulseLateness() {
+    return &this->pulseLateness;
+}
+
+// Get absolute error of each pulse interval against the profile
+LatencyHistogram *StepPulseEngine::getIntervalError() {
+    return &this->intervalError;
+}
+
+// Get number of pulses late by at least their own interval
+uint64_t StepPulseEngine::getMissedCount() {
+    return this->missedCount;
+}
+
+// Clear pulse statistics (not while a profile runs)
+void StepPulseEngine::resetStatistics() {
+    this->pulseLateness.reset();
+    this->intervalError.reset();
+    this->missedCount = 0;
+}
+
+// Wait for moves and emit them until cancellation token
+void StepPulseEngine::engine() {
+    // Touch the stack the pulse loop will use, then keep every current page resident (not future ones, which would pin
+    // every later allocation and thread stack of the whole process)
+    volatile unsigned char stack[STEPPULSEENGINE_STACK_PREFAULT_BYTES];
+    for (size_t i = 0; i < sizeof(stack); i += 4096) {
+        stack[i] = 0;
+    }
+    if (mlockall(MCL_CURRENT) != 0) {
+        std::cout << "StepPulseEngine: Error locking memory: " << std::strerror(errno) << std::endl;
+    }
+
+    std::unique_lock<std::mutex> lock(this->moveMutex);
+    while (!this->engineThreadShouldCancel) {
+        this->moveCondition.wait(lock, [this] { return this->pendingProfile != nullptr || this->engineThreadShouldCancel; });
+        if (this->pendingProfile == nullptr) {
+            continue;
+        }
+        const MotionProfile *profile = this->pendingProfile;
+        StopCondition stopCondition = this->pendingStopCondition;
+        this->pendingProfile = nullptr;
+
+        // Emit without holding the lock
+        lock.unlock();
+        int64_t stepCount = this->emit(profile, stopCondition);
+        lock.lock();
+
+        this->moveStepCount = stepCount;
+        this->moveDone = true;
+        this->moveCondition.notify_all();
+    }
+}
+
+// Emit steps of profile at their release times until stopCondition (if any) is true (engine thread only)
+int64_t StepPulseEngine::emit(const MotionProfile *profile, const StopCondition &stopCondition) {
+    int64_t stepCount = profile->getStepCount();
+    int64_t releaseTimeNS = Clock::monotonicNS();
+    int64_t previousPulseNS = 0;
+    int64_t step = 0;
+    for (; step < stepCount && !this->abortRequested; step++) {
+        uint32_t intervalNS = profile->getIntervalNS(step);
+        releaseTimeNS += intervalNS;
+        // After a late pulse, restart the schedule from it rather than bursting to catch up, which the motor cannot follow
+        if (step > 0 && releaseTimeNS < previousPulseNS + intervalNS) {
+            releaseTimeNS = previousPulseNS + intervalNS;
+        }
+
+        // Sleep to shortly before the release time, then spin the rest (which also absorbs wake-up latency)
+        int64_t wakeTimeNS = releaseTimeNS - this->spinNS;
+        struct timespec wake;
+        wake.tv_sec = wakeTimeNS / 1000000000;
+        wake.tv_nsec = wakeTimeNS % 1000000000;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, nullptr) == EINTR) {}
+        int64_t pulseNS = Clock::monotonicNS();
+        while (pulseNS < releaseTimeNS) {
+            pulseNS = Clock::monotonicNS();
+        }
+
+        // Checked at every step time, so the motion stops within one step of the condition
+        if (stopCondition && stopCondition()) {
+            break;
+        }
+
+        this->output(true);
+        int64_t pulseEndNS = pulseNS + this->pulseWidthNS;
+        while (Clock::monotonicNS() < pulseEndNS) {}
+        this->output(false);
+
+        // A pulse late by a whole interval or more counts as missed
+        int64_t latenessNS = pulseNS - releaseTimeNS;
+        this->pulseLateness.record(latenessNS);
+        if (latenessNS >= intervalNS) {
+            this->missedCount++;
+        }
+        if (step > 0) {
+            int64_t errorNS = (pulseNS - previousPulseNS) - intervalNS;
+            this->intervalError.record(errorNS < 0 ? -errorNS : errorNS);
+        }
+        previousPulseNS = pulseNS;
+    }
+    return step;
+}
+
+} /* namespace tids */
@@ -0,0 +1,113 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STEPPULSEENGINE_H
+#define STEPPULSEENGINE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "LatencyHistogram.h"
+#include "MotionProfile.h"
+
+namespace tids {
+
+// Issues step pulses from a motion profile on a dedicated real-time thread
+// The thread runs SCHED_FIFO with its stack prefaulted and current memory locked, and releases every pulse at an
+// absolute time with clock_nanosleep(TIMER_ABSTIME), so small wake-up delays do not accumulate; after a late pulse
+// the schedule restarts from it, so no two pulses are ever closer than the profile interval
+class StepPulseEngine {
+public:
+    // Drives the pulse line high or low, called only from the engine thread, must not block
+    typedef std::function<void(bool high)> PulseOutput;
+
+    // Checked on the engine thread before every pulse, stops the profile when true, must not block
+    typedef std::function<bool()> StopCondition;
+
+private:
+    PulseOutput output;
+    int priority;
+    int64_t pulseWidthNS;
+    int64_t spinNS;
+
+    std::thread engineThread;
+    std::atomic<bool> engineThreadShouldCancel;
+    std::atomic<bool> realTime;
+
+    // Move handed to the engine thread and its result
+    std::mutex moveMutex;
+    std::condition_variable moveCondition;
+    const MotionProfile *pendingProfile;
+    StopCondition pendingStopCondition;
+    bool moveDone;
+    int64_t moveStepCount;
+    std::atomic<bool> abortRequested;
+
+    // Pulse time after its release time, and pulse interval error against the profile
+    LatencyHistogram pulseLateness;
+    LatencyHistogram intervalError;
+    // Pulses late by at least their own interval
+    std::atomic<uint64_t> missedCount;
+
+public:
+    StepPulseEngine(PulseOutput output, int priority=80, int64_t pulseWidthNS=5000, int64_t spinNS=20000);
+    virtual ~StepPulseEngine();
+
+    // Lock memory and start the engine thread (runs at normal priority if real-time scheduling is not permitted)
+    int start();
+
+    // Stop the engine thread
+    int stop();
+
+    // Emit every step of profile until stopCondition (if any) is true, blocking until done
+    // (returns number of steps emitted, or -1 if not started)
+    int64_t run(const MotionProfile *profile, StopCondition stopCondition=nullptr);
+
+    // Stop a running profile after its current step
+    void abort();
+
+    // If the engine thread runs with real-time scheduling
+    bool isRealTime();
+
+    // Get pulse time after its release time
+    LatencyHistogram *getPulseLateness();
+
+    // Get absolute error of each pulse interval against the profile
+    LatencyHistogram *getIntervalError();
+
+    // Get number of pulses late by at least their own interval
+    uint64_t getMissedCount();
+
+    // Clear pulse statistics (not while a profile runs)
+    void resetStatistics();
+
+private:
+    // Wait for moves and emit them until cancellation token
+    void engine();
+
+    // Emit steps of profile at their release times until stopCondition (if any) is true (engine thread only)
+    int64_t emit(const MotionProfile *profile, const StopCondition &stopCondition);
+};
+
+} /* namespace tids */
+
+#endif /* STEPPULSEENGINE_H */
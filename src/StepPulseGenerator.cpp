@@ -0,0 +1,54 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "StepPulseGenerator.h"
+
+namespace tids {
+
+StepPulseGenerator::StepPulseGenerator(bbbkit::GPIO::PIN pinPulse, GPIOMemoryMap *gpioMemoryMap) {
+    this->gpioPulse = new FastGPIO(pinPulse, bbbkit::GPIO::DIRECTION::OUTPUT, bbbkit::GPIO::VALUE::LOW, gpioMemoryMap);
+
+    // Pulse the pin from the engine thread
+    FastGPIO *gpioPulse = this->gpioPulse;
+    this->engine = new StepPulseEngine([gpioPulse](bool high) {
+        gpioPulse->setValue(high ? bbbkit::GPIO::VALUE::HIGH : bbbkit::GPIO::VALUE::LOW);
+    });
+    this->engine->start();
+}
+
+StepPulseGenerator::~StepPulseGenerator() {
+    delete this->engine;
+    delete this->gpioPulse;
+}
+
+// Emit every step of profile until stopCondition (if any) is true, blocking until done (returns number of steps emitted)
+int64_t StepPulseGenerator::run(const MotionProfile &profile, StepPulseEngine::StopCondition stopCondition) {
+    return this->engine->run(&profile, stopCondition);
+}
+
+// Stop a running profile after its current step
+void StepPulseGenerator::stop() {
+    this->engine->abort();
+}
+
+// Get engine, for pulse timing statistics
+StepPulseEngine *StepPulseGenerator::getEngine() {
+    return this->engine;
+}
+
+} /* namespace tids */
@@ -0,0 +1,55 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STEPPULSEGENERATOR_H
+#define STEPPULSEGENERATOR_H
+
+#include <libbbbkit/GPIO.h>
+
+#include <cstdint>
+
+#include "FastGPIO.h"
+#include "GPIOMemoryMap.h"
+#include "MotionProfile.h"
+#include "StepPulseEngine.h"
+
+namespace tids {
+
+// Drives a stepper driver pulse input (CVD524K PLS, TB6600 PUL) through motion profiles on a real-time engine thread
+class StepPulseGenerator {
+private:
+    FastGPIO *gpioPulse;
+    StepPulseEngine *engine;
+
+public:
+    StepPulseGenerator(bbbkit::GPIO::PIN pinPulse, GPIOMemoryMap *gpioMemoryMap=nullptr);
+    virtual ~StepPulseGenerator();
+
+    // Emit every step of profile until stopCondition (if any) is true, blocking until done (returns number of steps emitted)
+    int64_t run(const MotionProfile &profile, StepPulseEngine::StopCondition stopCondition=nullptr);
+
+    // Stop a running profile after its current step
+    void stop();
+
+    // Get engine, for pulse timing statistics
+    StepPulseEngine *getEngine();
+};
+
+} /* namespace tids */
+
+#endif /* STEPPULSEGENERATOR_H */
@@ -21,11 +21,28 @@
 
 #include "SteppedLeadscrew.h"
 
+#include <cmath>
+
 namespace tids {
 
-SteppedLeadscrew::SteppedLeadscrew(bbbkit::StepperMotor *motor, float distancePerRevolution) {
+// Distance between stop condition checks when steps are not timed directly, in mm
+#define STOP_CHECK_MOVE_MM 0.1f
+
+// Default speed the motor starts and stops at without ramping, in mm/s
+#define START_SPEED_DEFAULT 1.0f
+
+SteppedLeadscrew::SteppedLeadscrew(bbbkit::StepperMotor *motor, float distancePerRevolution,
+                                   int stepsPerRevolution, StepPulseGenerator *pulseGenerator) {
     this->motor = motor;
     this->distancePerRevolution = distancePerRevolution;
+    this->speed = 0.0f;
+    this->stepsPerRevolution = stepsPerRevolution;
+    this->pulseGenerator = pulseGenerator;
+    this->acceleration = 0.0f;
+    this->jerk = 0.0f;
+    this->startSpeed = START_SPEED_DEFAULT;
+    this->stepRemainder = 0.0;
+    this->stepPosition = 0;
 }
 
 SteppedLeadscrew::~SteppedLeadscrew() {}
@@ -44,6 +61,7 @@ float SteppedLeadscrew::getSpeed() {
 int SteppedLeadscrew::setSpeed(float millimetersPerSecond) {
     float revolutionsPerSecond = millimetersPerSecond / this->distancePerRevolution;
     float revolutionsPerMinute = revolutionsPerSecond * 60.0f;
+    this->speed = millimetersPerSecond;
     return this->motor->setRevolutionsPerMinute(revolutionsPerMinute);
 }
 
@@ -58,8 +76,71 @@ int SteppedLeadscrew::setDistancePerRevolution(float distancePerRevolution) {
     return 0;
 }
 
-// Rotate leadscrew to translate by distance, in millimeters
-void SteppedLeadscrew::move(float distanceMM) {
+// Get acceleration in millimeters per second squared
+float SteppedLeadscrew::getAcceleration() {
+    return this->acceleration;
+}
+
+// Set acceleration in millimeters per second squared (0 for constant speed moves)
+int SteppedLeadscrew::setAcceleration(float millimetersPerSecondSquared) {
+    if (millimetersPerSecondSquared < 0.0f) {
+        return -1;
+    }
+    this->acceleration = millimetersPerSecondSquared;
+    return 0;
+}
+
+// Get jerk in millimeters per second cubed
+float SteppedLeadscrew::getJerk() {
+    return this->jerk;
+}
+
+// Set jerk in millimeters per second cubed (0 for trapezoidal profiles, S-curves otherwise)
+int SteppedLeadscrew::setJerk(float millimetersPerSecondCubed) {
+    if (millimetersPerSecondCubed < 0.0f) {
+        return -1;
+    }
+    this->jerk = millimetersPerSecondCubed;
+    return 0;
+}
+
+// Set speed the motor starts and stops at without ramping, in millimeters per second
+int SteppedLeadscrew::setStartSpeed(float millimetersPerSecond) {
+    if (millimetersPerSecond < 0.0f) {
+        return -1;
+    }
+    this->startSpeed = millimetersPerSecond;
+    return 0;
+}
+
+// Get profile of the latest profiled move
+const MotionProfile &SteppedLeadscrew::getProfile() {
+    return this->profile;
+}
+
+// Get net steps commanded since construction, positive clockwise (0 if steps per revolution is unknown)
+int64_t SteppedLeadscrew::getStepPosition() {
+    return this->stepPosition;
+}
+
+// Rotate leadscrew to translate by distance, in millimeters (returns distance moved, short of it if stopped)
+float SteppedLeadscrew::move(float distanceMM) {
+    return this->move(distanceMM, nullptr);
+}
+
+// Rotate leadscrew to translate by distance, in millimeters, stopping early once stopCondition (if any) is true
+// (returns distance moved)
+float SteppedLeadscrew::move(float distanceMM, StepPulseEngine::StopCondition stopCondition) {
+    // Ramp the step rate when steps can be timed directly
+    if (this->pulseGenerator != nullptr && this->stepsPerRevolution > 0 && this->acceleration > 0.0f) {
+        return this->moveProfiled(distanceMM, this->speed, this->startSpeed, stopCondition);
+    }
+
+    // Without timed steps the rotation cannot be interrupted, so the condition is only checked before it
+    if (stopCondition && stopCondition()) {
+        return 0.0f;
+    }
+
     // Set rotation direction on stepper motor
     bbbkit::StepperMotor::DIRECTION rotationDirection = bbbkit::StepperMotor::DIRECTION::CLOCKWISE;
     if (distanceMM < 0) {
@@ -70,6 +151,73 @@ void SteppedLeadscrew::move(float distanceMM) {
     float revolutions = distanceMM / this->distancePerRevolution;
     float angleDEG = revolutions * 360.0f;
     this->motor->rotate(angleDEG);
+    this->stepPosition += std::llround(revolutions * this->stepsPerRevolution);
+    return distanceMM;
+}
+
+// Translate by up to distance at a constant speed in millimeters per second, stopping within one step once
+// stopCondition is true (returns distance moved)
+float SteppedLeadscrew::moveUntil(float distanceMM, float millimetersPerSecond, StepPulseEngine::StopCondition stopCondition) {
+    if (this->pulseGenerator != nullptr && this->stepsPerRevolution > 0) {
+        return this->moveProfiled(distanceMM, millimetersPerSecond, millimetersPerSecond, stopCondition);
+    }
+
+    // Without timed steps, move in short hops and check between them
+    float cruiseSpeed = this->speed;
+    this->setSpeed(millimetersPerSecond);
+    float hopMM = (distanceMM < 0.0f) ? -STOP_CHECK_MOVE_MM : STOP_CHECK_MOVE_MM;
+    float movedMM = 0.0f;
+    while (std::fabs(movedMM) < std::fabs(distanceMM) && !(stopCondition && stopCondition())) {
+        movedMM += this->move(hopMM);
+    }
+    this->setSpeed(cruiseSpeed);
+    return movedMM;
+}
+
+// Stop a profiled move in progress without decelerating (from another thread)
+void SteppedLeadscrew::stop() {
+    if (this->pulseGenerator != nullptr) {
+        this->pulseGenerator->stop();
+    }
+}
+
+// Translate by distance with a precomputed acceleration, cruise and deceleration profile, ramping from
+// startSpeed up to speed, until stopCondition (if any) is true (returns distance moved)
+float SteppedLeadscrew::moveProfiled(float distanceMM, float speed, float startSpeed, StepPulseEngine::StopCondition stopCondition) {
+    float stepsPerMM = this->stepsPerRevolution / this->distancePerRevolution;
+
+    // Carry the fraction of a step over to the next move so repeated short moves do not drift
+    double steps = distanceMM * stepsPerMM + this->stepRemainder;
+    int64_t stepCount = std::llround(steps);
+    this->stepRemainder = steps - stepCount;
+
+    // Set rotation direction on stepper motor
+    bbbkit::StepperMotor::DIRECTION rotationDirection = bbbkit::StepperMotor::DIRECTION::CLOCKWISE;
+    float sign = 1.0f;
+    if (stepCount < 0) {
+        rotationDirection = bbbkit::StepperMotor::DIRECTION::COUNTERCLOCKWISE;
+        stepCount = -stepCount;
+        sign = -1.0f;
+    }
+    this->motor->setDirection(rotationDirection);
+
+    MotionLimits limits;
+    limits.maxVelocity = speed * stepsPerMM;
+    limits.maxAcceleration = this->acceleration * stepsPerMM;
+    limits.maxJerk = this->jerk * stepsPerMM;
+    limits.startVelocity = startSpeed * stepsPerMM;
+    if (this->profile.plan(stepCount, limits) < 0) {
+        this->stepRemainder = 0.0;
+        return 0.0f;
+    }
+    int64_t stepsMoved = this->pulseGenerator->run(this->profile, stopCondition);
+    this->stepPosition += (sign < 0.0f) ? -stepsMoved : stepsMoved;
+    if (stepsMoved < stepCount) {
+        // Stopped early: report what was moved, and drop the remainder of the requested distance
+        this->stepRemainder = 0.0;
+        return sign * stepsMoved / stepsPerMM;
+    }
+    return distanceMM;
 }
 
 } /* namespace tids */
@@ -24,6 +24,12 @@
 
 #include <libbbbkit/StepperMotor.h>
 
+#include <atomic>
+#include <cstdint>
+
+#include "MotionProfile.h"
+#include "StepPulseGenerator.h"
+
 namespace tids {
 
 class SteppedLeadscrew {
@@ -32,8 +38,23 @@ private:
     float distancePerRevolution;
     float speed;
 
+    // Profiled moves (when a pulse generator is set), in millimeters per second squared and cubed
+    int stepsPerRevolution;
+    StepPulseGenerator *pulseGenerator;
+    float acceleration;
+    float jerk;
+    float startSpeed;
+    MotionProfile profile;
+
+    // Fraction of a step not yet moved, in steps
+    double stepRemainder;
+
+    // Net steps commanded since construction (positive clockwise)
+    std::atomic<int64_t> stepPosition;
+
 public:
-    SteppedLeadscrew(bbbkit::StepperMotor *motor, float distancePerRevolutionMM);
+    SteppedLeadscrew(bbbkit::StepperMotor *motor, float distancePerRevolutionMM,
+                     int stepsPerRevolution=0, StepPulseGenerator *pulseGenerator=nullptr);
     virtual ~SteppedLeadscrew();
 
     // Get motor
@@ -51,8 +72,45 @@ public:
     // Set distance per revolution
     int setDistancePerRevolution(float distancePerRevolutionMM);
 
-    // Rotate leadscrew to translate by distance, in millimeters
-    void move(float distanceMM);
+    // Get acceleration in millimeters per second squared
+    float getAcceleration();
+
+    // Set acceleration in millimeters per second squared (0 for constant speed moves)
+    int setAcceleration(float millimetersPerSecondSquared);
+
+    // Get jerk in millimeters per second cubed
+    float getJerk();
+
+    // Set jerk in millimeters per second cubed (0 for trapezoidal profiles, S-curves otherwise)
+    int setJerk(float millimetersPerSecondCubed);
+
+    // Set speed the motor starts and stops at without ramping, in millimeters per second
+    int setStartSpeed(float millimetersPerSecond);
+
+    // Get profile of the latest profiled move
+    const MotionProfile &getProfile();
+
+    // Get net steps commanded since construction, positive clockwise (0 if steps per revolution is unknown)
+    int64_t getStepPosition();
+
+    // Rotate leadscrew to translate by distance, in millimeters (returns distance moved, short of it if stopped)
+    float move(float distanceMM);
+
+    // Rotate leadscrew to translate by distance, in millimeters, stopping early once stopCondition (if any) is true
+    // (returns distance moved)
+    float move(float distanceMM, StepPulseEngine::StopCondition stopCondition);
+
+    // Translate by up to distance at a constant speed in millimeters per second, stopping within one step once
+    // stopCondition is true (returns distance moved)
+    float moveUntil(float distanceMM, float millimetersPerSecond, StepPulseEngine::StopCondition stopCondition);
+
+    // Stop a profiled move in progress without decelerating (from another thread)
+    void stop();
+
+private:
+    // Translate by distance with a precomputed acceleration, cruise and deceleration profile, ramping from
+    // startSpeed up to speed, until stopCondition (if any) is true (returns distance moved)
+    float moveProfiled(float distanceMM, float speed, float startSpeed, StepPulseEngine::StopCondition stopCondition);
 };
 
 } /* namespace tids */
@@ -0,0 +1,166 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "StreamingStatistics.h"
+
+namespace tids {
+
+StreamingStatistics::StreamingStatistics(size_t windowSize, double ewmaAlpha)
+    : median(0.5), percentile90(0.9), percentile99(0.99) {
+    this->windowSize = windowSize > 0 ? windowSize : 1;
+    this->ewmaAlpha = ewmaAlpha;
+
+    this->window.resize(this->windowSize);
+    this->count = 0;
+
+    this->minimumQueue.resize(this->windowSize);
+    this->minimumQueueHead = 0;
+    this->minimumQueueTail = 0;
+    this->maximumQueue.resize(this->windowSize);
+    this->maximumQueueHead = 0;
+    this->maximumQueueTail = 0;
+
+    this->mean = 0.0;
+    this->squaredDeviation = 0.0;
+    this->ewma = 0.0;
+    this->ewmaVariance = 0.0;
+
+    this->completedMedian = 0.0f;
+    this->completedPercentile90 = 0.0f;
+    this->completedPercentile99 = 0.0f;
+    this->hasCompletedWindow = false;
+}
+
+StreamingStatistics::~StreamingStatistics() {}
+
+// Add a sample (must only be called from a single writer thread)
+void StreamingStatistics::add(float value) {
+    uint64_t index = this->count;
+    size_t slot = index % this->windowSize;
+    bool windowFull = this->count >= this->windowSize;
+    float evicted = this->window[slot];
+    this->window[slot] = value;
+    this->count++;
+
+    // Expire the evicted sample from the front of the monotonic queues
+    if (windowFull) {
+        uint64_t evictedIndex = index - this->windowSize;
+        if (this->minimumQueueHead != this->minimumQueueTail
+            && this->minimumQueue[this->minimumQueueHead % this->windowSize] == evictedIndex) {
+            this->minimumQueueHead++;
+        }
+        if (this->maximumQueueHead != this->maximumQueueTail
+            && this->maximumQueue[this->maximumQueueHead % this->windowSize] == evictedIndex) {
+            this->maximumQueueHead++;
+        }
+    }
+
+    // Drop candidates the new sample dominates (amortized O(1)), then append it
+    while (this->minimumQueueHead != this->minimumQueueTail
+           && this->window[this->minimumQueue[(this->minimumQueueTail - 1) % this->windowSize] % this->windowSize] >= value) {
+        this->minimumQueueTail--;
+    }
+    this->minimumQueue[this->minimumQueueTail++ % this->windowSize] = index;
+    while (this->maximumQueueHead != this->maximumQueueTail
+           && this->window[this->maximumQueue[(this->maximumQueueTail - 1) % this->windowSize] % this->windowSize] <= value) {
+        this->maximumQueueTail--;
+    }
+    this->maximumQueue[this->maximumQueueTail++ % this->windowSize] = index;
+
+    // Window mean and variance (Welford, replacing the evicted sample once the window is full)
+    if (windowFull) {
+        double previousMean = this->mean;
+        this->mean += (static_cast<double>(value) - evicted) / this->windowSize;
+        this->squaredDeviation += (static_cast<double>(value) - evicted) * (value - this->mean + evicted - previousMean);
+    } else {
+        double delta = value - this->mean;
+        this->mean += delta / this->count;
+        this->squaredDeviation += delta * (value - this->mean);
+    }
+    // Rounding can leave a slightly negative sum for a constant signal
+    if (this->squaredDeviation < 0.0) {
+        this->squaredDeviation = 0.0;
+    }
+
+    // Exponentially weighted mean and variance
+    if (index == 0) {
+        this->ewma = value;
+        this->ewmaVariance = 0.0;
+    } else {
+        double delta = value - this->ewma;
+        double step = this->ewmaAlpha * delta;
+        this->ewma += step;
+        this->ewmaVariance = (1.0 - this->ewmaAlpha) * (this->ewmaVariance + delta * step);
+    }
+
+    // Percentiles over tumbling windows
+    this->median.add(value);
+    this->percentile90.add(value);
+    this->percentile99.add(value);
+    if (this->median.getCount() >= this->windowSize) {
+        this->completedMedian = static_cast<float>(this->median.getEstimate());
+        this->completedPercentile90 = static_cast<float>(this->percentile90.getEstimate());
+        this->completedPercentile99 = static_cast<float>(this->percentile99.getEstimate());
+        this->hasCompletedWindow = true;
+        this->median.reset();
+        this->percentile90.reset();
+        this->percentile99.reset();
+    }
+
+    // Publish
+    StatisticsSummary summary;
+    uint64_t windowCount = windowFull ? this->windowSize : this->count;
+    summary.count = this->count;
+    summary.windowCount = static_cast<uint32_t>(windowCount);
+    summary.minimum = this->window[this->minimumQueue[this->minimumQueueHead % this->windowSize] % this->windowSize];
+    summary.maximum = this->window[this->maximumQueue[this->maximumQueueHead % this->windowSize] % this->windowSize];
+    summary.mean = static_cast<float>(this->mean);
+    summary.variance = windowCount > 1 ? static_cast<float>(this->squaredDeviation / (windowCount - 1)) : 0.0f;
+    summary.ewma = static_cast<float>(this->ewma);
+    summary.ewmaVariance = static_cast<float>(this->ewmaVariance);
+    if (this->hasCompletedWindow) {
+        summary.median = this->completedMedian;
+        summary.percentile90 = this->completedPercentile90;
+        summary.percentile99 = this->completedPercentile99;
+    } else {
+        summary.median = static_cast<float>(this->median.getEstimate());
+        summary.percentile90 = static_cast<float>(this->percentile90.getEstimate());
+        summary.percentile99 = static_cast<float>(this->percentile99.getEstimate());
+    }
+    this->summary.write(summary);
+}
+
+// Get aggregates as of the latest sample (returns -1 if no sample has been added)
+int StreamingStatistics::getSummary(StatisticsSummary *summary) {
+    if (this->summary.read(summary) == 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// Get window size in samples
+size_t StreamingStatistics::getWindowSize() {
+    return this->windowSize;
+}
+
+// Get smoothing factor of the exponentially weighted aggregates
+double StreamingStatistics::getEWMAAlpha() {
+    return this->ewmaAlpha;
+}
+
+} /* namespace tids */
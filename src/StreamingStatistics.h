@@ -0,0 +1,107 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STREAMINGSTATISTICS_H
+#define STREAMINGSTATISTICS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "P2Quantile.h"
+#include "Seqlock.h"
+
+namespace tids {
+
+// Aggregates of a channel, consistent with each other as of one sample
+struct StatisticsSummary {
+    // Total number of samples added
+    uint64_t count;
+    // Number of samples in the window
+    uint32_t windowCount;
+    // Window aggregates
+    float minimum;
+    float maximum;
+    float mean;
+    float variance;
+    // Exponentially weighted moving average and variance
+    float ewma;
+    float ewmaVariance;
+    // Approximate percentiles of the last complete window (of the current window until one completes)
+    float median;
+    float percentile90;
+    float percentile99;
+};
+
+// Incremental window and exponentially weighted aggregates, updated in O(1) per sample
+class StreamingStatistics {
+private:
+    size_t windowSize;
+    double ewmaAlpha;
+
+    // Last windowSize values (circular)
+    std::vector<float> window;
+    uint64_t count;
+
+    // Sample indices with increasing minimum and decreasing maximum candidates (circular monotonic queues)
+    std::vector<uint64_t> minimumQueue;
+    uint64_t minimumQueueHead;
+    uint64_t minimumQueueTail;
+    std::vector<uint64_t> maximumQueue;
+    uint64_t maximumQueueHead;
+    uint64_t maximumQueueTail;
+
+    // Window mean and sum of squared deviations
+    double mean;
+    double squaredDeviation;
+
+    double ewma;
+    double ewmaVariance;
+
+    // Percentile estimators over the current tumbling window, and the estimates of the last complete window
+    P2Quantile median;
+    P2Quantile percentile90;
+    P2Quantile percentile99;
+    float completedMedian;
+    float completedPercentile90;
+    float completedPercentile99;
+    bool hasCompletedWindow;
+
+    // Aggregates published to readers after every sample
+    Seqlock<StatisticsSummary> summary;
+
+public:
+    StreamingStatistics(size_t windowSize, double ewmaAlpha);
+    virtual ~StreamingStatistics();
+
+    // Add a sample (must only be called from a single writer thread)
+    void add(float value);
+
+    // Get aggregates as of the latest sample (returns -1 if no sample has been added)
+    int getSummary(StatisticsSummary *summary);
+
+    // Get window size in samples
+    size_t getWindowSize();
+
+    // Get smoothing factor of the exponentially weighted aggregates
+    double getEWMAAlpha();
+};
+
+} /* namespace tids */
+
+#endif /* STREAMINGSTATISTICS_H */
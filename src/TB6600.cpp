@@ -28,8 +28,23 @@ namespace tids {
 TB6600::TB6600(bbbkit::GPIO::PIN pinPUL, bbbkit::GPIO::PIN pinDIR, bbbkit::GPIO::PIN pinENA,
             bbbkit::StepperMotor::DIRECTION direction,
             int stepsPerRevolution, float revolutionsPerMinute, int stepFactor)
-            : bbbkit::StepperMotor(pinPUL, pinDIR, pinENA, direction, stepsPerRevolution, revolutionsPerMinute, stepFactor) {}
+            : bbbkit::StepperMotor(pinPUL, pinDIR, pinENA, direction, stepsPerRevolution, revolutionsPerMinute, stepFactor) {
+
+    this->pinPUL = pinPUL;
+    this->stepsPerRevolution = stepsPerRevolution;
+    this->stepFactor = stepFactor;
+}
 
 TB6600::~TB6600() {}
 
+// Get GPIO pin for step pulses
+bbbkit::GPIO::PIN TB6600::getPulsePin() {
+    return this->pinPUL;
+}
+
+// Get pulses per revolution (full steps times microstep factor)
+int TB6600::getStepsPerRevolution() {
+    return this->stepsPerRevolution * this->stepFactor;
+}
+
 } /* namespace tids */
@@ -29,11 +29,22 @@
 namespace tids {
 
 class TB6600: public bbbkit::StepperMotor {
+private:
+    // GPIO pin for step pulses (driven by bbbkit::StepperMotor or a StepPulseGenerator)
+    bbbkit::GPIO::PIN pinPUL;
+    int stepsPerRevolution;
+    int stepFactor;
 public:
     TB6600(bbbkit::GPIO::PIN pinPUL, bbbkit::GPIO::PIN pinDIR, bbbkit::GPIO::PIN pinENA,
             bbbkit::StepperMotor::DIRECTION direction=bbbkit::StepperMotor::DIRECTION::CLOCKWISE,
             int stepsPerRevolution=200, float revolutionsPerMinute=60.0f, int stepFactor=32);
     virtual ~TB6600();
+
+    // Get GPIO pin for step pulses
+    bbbkit::GPIO::PIN getPulsePin();
+
+    // Get pulses per revolution (full steps times microstep factor)
+    int getStepsPerRevolution();
 };
 
 } /* namespace tids */
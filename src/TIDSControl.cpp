@@ -19,6 +19,7 @@
 #include "TIDSControl.h"
 
 #include <chrono>
+#include <cstdio>
 #include <iostream>
 #include <thread>
 #include <unistd.h>
@@ -30,6 +31,9 @@ namespace tids {
 #define WEIGHT_ON_BIT_MIN_KG 0.5
 #define WEIGHT_ON_BIT_MAX_KG 10.0
 
+// Maximum age of a weight on bit sample before the z-axis feed is held
+#define WEIGHT_ON_BIT_MAX_AGE_MS 250
+
 #define HOLE_DIAMETER_MM 102.0
 #define HOLE_SEPARATION_MM 152.0
 
@@ -39,7 +43,29 @@ namespace tids {
 #define Z_AXIS_LENGTH_MM 2000.0
 #define Z_AXIS_PITCH 4.0
 
+// Drill torque controller gains, loaded over the defaults if present
+#define DRILL_TORQUE_GAINS_PATH "drill_torque_gains.conf"
+
+// Drill motor model written by calibration, loaded over the nominal model if present
+#define DRILL_MOTOR_MODEL_PATH "drill_motor_model.conf"
+
+// Longest wait for background moves of each axis and of the melting chamber cap
+#define X_AXIS_MOVE_TIMEOUT_S 120
+#define Z_AXIS_MOVE_TIMEOUT_S 300
+#define CAP_MOVE_TIMEOUT_S 5
+
+// Z-axis retract after a drill stall trip (longer than the post-trigger capture), and trips allowed per hole
+#define STALL_RETRACT_MS 500
+#define STALL_MAX_TRIPS_PER_HOLE 3
+
 TIDSControl::TIDSControl() {
+    // GPIO
+
+    this->gpioMemoryMap = new GPIOMemoryMap();
+    if (this->gpioMemoryMap->open() < 0) {
+        std::cout << "TIDSControl: Error mapping GPIO banks, using sysfs GPIO" << std::endl;
+    }
+
     // Power
 
     this->powerController = new PowerController(TIDS_POWERCONTROLLER_PIN_RELAYCHILLER_GPIO,
@@ -48,12 +74,14 @@ TIDSControl::TIDSControl() {
                                                 TIDS_POWERCONTROLLER_PIN_RELAYHEATER2_GPIO,
                                                 TIDS_POWERCONTROLLER_PIN_RELAYPROXIMITYSENSORS_GPIO,
                                                 TIDS_POWERCONTROLLER_PIN_RELAYMOTORX_GPIO,
-                                                TIDS_POWERCONTROLLER_PIN_RELAYMOTORZ_GPIO);
+                                                TIDS_POWERCONTROLLER_PIN_RELAYMOTORZ_GPIO,
+                                                TIDS_POWERCONTROLLER_PIN_RELAY24V_GPIO,
+                                                this->gpioMemoryMap);
     // Telemetry
 
     this->currentSensor = new ISNAILVC10(TIDS_CURRENTSENSOR_PIN_ADC);
 
-    this->loadCell = new HX711(TIDS_LOADCELL_PIN_DOUT_GPIO, TIDS_LOADCELL_PIN_PD_SCK_GPIO, WEIGHT_ON_BIT_CALIBRATION);
+    this->loadCell = new HX711(TIDS_LOADCELL_PIN_DOUT_GPIO, TIDS_LOADCELL_PIN_PD_SCK_GPIO, WEIGHT_ON_BIT_CALIBRATION, 0, HX711::GAIN::A_128, HX711::RATE::SPS_10, this->gpioMemoryMap);
 
     this->telemetrySystem = new TelemetrySystem(this->currentSensor, this->loadCell);
 
@@ -63,11 +91,18 @@ TIDSControl::TIDSControl() {
 
     this->drillEncoder = new MMPEU(TIDS_DRILLENCODER_PIN_A_GPIO,
                                     TIDS_DRILLENCODER_PIN_B_GPIO,
-                                    TIDS_DRILLENCODER_PIN_INDEX_GPIO);
+                                    TIDS_DRILLENCODER_PIN_INDEX_GPIO,
+                                    this->gpioMemoryMap);
 
     this->drillCurrentSensor = new LTS6NP(TIDS_DRILLCURRENTSENSOR_PIN_ADC);
 
-    this->drillingSystem = new DrillingSystem(this->drillMotor, this->drillEncoder, this->drillCurrentSensor);
+    this->drillingSystem = new DrillingSystem(this->drillMotor, this->drillEncoder, this->drillCurrentSensor, this->telemetrySystem);
+    if (access(DRILL_TORQUE_GAINS_PATH, F_OK) == 0) {
+        this->drillingSystem->getTorqueController()->loadGains(DRILL_TORQUE_GAINS_PATH);
+    }
+    if (access(DRILL_MOTOR_MODEL_PATH, F_OK) == 0) {
+        this->drillingSystem->getTorqueEstimator()->loadModel(DRILL_MOTOR_MODEL_PATH);
+    }
 
     // X-axis
 
@@ -78,9 +113,9 @@ TIDSControl::TIDSControl() {
                                     TIDS_MOTORX_PIN_ALM_GPIO,
                                     TIDS_MOTORX_PIN_TIM_GPIO);
 
-    this->proximitySensorXHome = new LJ12A34ZBY(TIDS_PROXIMITYSENSORXHOME_PIN_GPIO);
+    this->proximitySensorXHome = new LJ12A34ZBY(TIDS_PROXIMITYSENSORXHOME_PIN_GPIO, this->gpioMemoryMap);
 
-    this->xAxis = new XPositioningAxis(X_AXIS_LENGTH_MM, X_AXIS_PITCH, this->xAxisMotor, this->proximitySensorXHome);
+    this->xAxis = new XPositioningAxis(X_AXIS_LENGTH_MM, X_AXIS_PITCH, this->xAxisMotor, this->proximitySensorXHome, this->gpioMemoryMap);
 
     // Z-axis
 
@@ -88,22 +123,29 @@ TIDSControl::TIDSControl() {
                                     TIDS_MOTORZ_PIN_IN1_GPIO,
                                     TIDS_MOTORZ_PIN_IN2_GPIO);
 
-    this->proximitySensorZHome = new LJ12A34ZBY(TIDS_PROXIMITYSENSORZHOME_PIN_GPIO);
+    this->proximitySensorZHome = new LJ12A34ZBY(TIDS_PROXIMITYSENSORZHOME_PIN_GPIO, this->gpioMemoryMap);
 
-    this->proximitySensorZBottom = new LJ12A34ZBY(TIDS_PROXIMITYSENSORZBOTTOM_PIN_GPIO);
+    this->proximitySensorZBottom = new LJ12A34ZBY(TIDS_PROXIMITYSENSORZBOTTOM_PIN_GPIO, this->gpioMemoryMap);
 
     this->zAxis = new ZPositioningAxis(Z_AXIS_LENGTH_MM, Z_AXIS_PITCH, this->zAxisMotor, this->proximitySensorZHome, this->proximitySensorZBottom);
 
+    // Back the bit off the face as soon as the drill trips
+    ZPositioningAxis *zAxis = this->zAxis;
+    this->drillingSystem->setStallHandler([zAxis](const StallEvent &event) { (void)event; zAxis->startRetracting(); });
+
     // Melting
 
     this->heaterCapMotor = new DS3218(TIDS_HEATERCAPMOTOR_PIN_PWM);
 
     this->heaterThermometer = new MLX90614(TIDS_HEATERTHERMOMETER_BUS_I2C);
 
-    this->meltingSystem = new MeltingSystem(this->powerController, this->heaterCapMotor, this->heaterThermometer);
+    this->meltingSystem = new MeltingSystem(this->powerController, this->heaterCapMotor, this->heaterThermometer, this->telemetrySystem);
 }
 
 TIDSControl::~TIDSControl() {
+    // Stop scheduled sampling before the sensors it reads are deleted
+    this->telemetrySystem->stop();
+
     delete this->meltingSystem;
     delete this->heaterCapMotor;
     delete this->heaterThermometer;
@@ -128,6 +170,9 @@ TIDSControl::~TIDSControl() {
 
     this->powerController->turnOffAllRelays();
     delete this->powerController;
+
+    // Unmap GPIO banks once no driver uses them
+    delete this->gpioMemoryMap;
 }
 
 // Tartan Ice Drilling System
@@ -147,15 +192,22 @@ int TIDSControl::run() {
         this->powerController->setMotorXRelayState(PowerController::STATE::ON);
         this->powerController->setMotorZRelayState(PowerController::STATE::ON);
         
-        // Move z-axis and x-axis to home
-        this->zAxis->moveToHome();
-        this->xAxis->moveToHome();
+        // Close melting chamber cap while the z-axis retracts and the x-axis travels
+        MotionHandle capClose = this->meltingSystem->closeCapAsync();
 
-        // Close melting chamber cap
-        this->meltingSystem->closeCap();
+        // Move z-axis to home before the x-axis moves
+        if (this->waitForMotion({this->zAxis->moveToHomeAsync()}, Z_AXIS_MOVE_TIMEOUT_S, "z-axis home") < 0) {
+            break;
+        }
 
-        // Move to x-axis target location
-        this->xAxis->moveTo(targetXPosition);
+        // Home x-axis only if its position is no longer trusted, then move to target location
+        if (this->xAxis->isHomingRequired() &&
+            this->waitForMotion({this->xAxis->moveToHomeAsync()}, X_AXIS_MOVE_TIMEOUT_S, "x-axis home") < 0) {
+            break;
+        }
+        if (this->waitForMotion({this->xAxis->moveToAsync(targetXPosition), capClose}, X_AXIS_MOVE_TIMEOUT_S, "x-axis travel and cap close") < 0) {
+            break;
+        }
 
         // Turn on drill
         this->powerController->setDrillMotorRelayState(PowerController::STATE::ON);
@@ -165,36 +217,67 @@ int TIDSControl::run() {
 
         // Move the z-axis down until the bottom sensor is triggered
         int timeout = 0;
+        int stallTrips = 0;
         while (!this->zAxis->isAtEnd() && timeout < 30) {
-            // Keep weight on bit below WEIGHT_ON_BIT_MAX_KG
-            if (this->telemetrySystem->getWeightOnBit() < WEIGHT_ON_BIT_MAX_KG) {
+            // After a stall trip (drill cut and retract started on the control thread), finish the retract and restart
+            if (this->drillingSystem->isStalled()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(STALL_RETRACT_MS));
+                this->zAxis->stop();
+                char stallPath[32];
+                snprintf(stallPath, sizeof(stallPath), "stall.%06d.csv", static_cast<int>(this->drillingSystem->getStallDetector()->getTripCount()));
+                this->drillingSystem->writeStallTrip(stallPath);
+                this->drillingSystem->stop();
+                if (++stallTrips > STALL_MAX_TRIPS_PER_HOLE) {
+                    std::cout << "TIDSControl: Error drill stalled " << stallTrips << " times, abandoning hole" << std::endl;
+                    break;
+                }
+                this->zAxis->releaseFeed();
+                this->drillingSystem->start();
+                continue;
+            }
+
+            // Keep weight on bit below WEIGHT_ON_BIT_MAX_KG (hold feed if the reading is stale)
+            bool weightOnBitStale = this->telemetrySystem->isWeightOnBitStale(WEIGHT_ON_BIT_MAX_AGE_MS);
+            if (!weightOnBitStale && this->telemetrySystem->getWeightOnBit() < WEIGHT_ON_BIT_MAX_KG) {
                 this->zAxis->startMovingToEnd();
                 timeout = 0;
             } else {
-                this->zAxis->stop();
+                // A stall trip may have started a retract since the check above, which must keep running
+                this->zAxis->holdFeed();
                 timeout++;
             }
             std::this_thread::sleep_for(std::chrono::milliseconds(10));
         }
         this->zAxis->stop();
+        this->zAxis->releaseFeed();
 
         // Stop drill
         this->drillingSystem->stop();
 
         // Move z-axis to home
-        this->zAxis->moveToHome();
-
-        // Move x-axis to home
-        this->xAxis->moveToHome();
+        if (this->waitForMotion({this->zAxis->moveToHomeAsync()}, Z_AXIS_MOVE_TIMEOUT_S, "z-axis home") < 0) {
+            break;
+        }
 
-        // Rotate drill to be at index location, lined up for melting chamber
+        // Return x-axis to the melting chamber at position 0 (checking drift at the home sensor) and open melting chamber cap,
+        // while rotating the drill to be at index location (lined up for melting chamber)
+        MotionHandle xAxisHome = this->xAxis->isHomingRequired() ? this->xAxis->moveToHomeAsync() : this->xAxis->moveToAsync(0.0f);
+        MotionHandle capOpen = this->meltingSystem->openCapAsync();
         this->drillingSystem->rotateToIndex();
 
         // Turn off drill
         this->powerController->setDrillMotorRelayState(PowerController::STATE::OFF);
 
-        // Open melting chamber cap
-        this->meltingSystem->openCap();
+        // Cap must be open and the x-axis home before the z-axis moves down
+        if (this->waitForMotion({xAxisHome, capOpen}, X_AXIS_MOVE_TIMEOUT_S, "x-axis home and cap open") < 0) {
+            break;
+        }
+
+        // Home x-axis if the return found drift or a driver fault
+        if (this->xAxis->isHomingRequired() &&
+            this->waitForMotion({this->xAxis->moveToHomeAsync()}, X_AXIS_MOVE_TIMEOUT_S, "x-axis home") < 0) {
+            break;
+        }
 
         // Move z-axis down until weight on bit registers above threshold
         this->zAxis->startMovingToEnd();
@@ -207,7 +290,9 @@ int TIDSControl::run() {
         std::this_thread::sleep_for(std::chrono::seconds(5));
 
         // Move z-axis to home
-        this->zAxis->moveToHome();
+        if (this->waitForMotion({this->zAxis->moveToHomeAsync()}, Z_AXIS_MOVE_TIMEOUT_S, "z-axis home") < 0) {
+            break;
+        }
 
         // Turn off contact sensors, x-axis, z-axis
         this->powerController->setProximitySensorsRelayState(PowerController::STATE::OFF);
@@ -228,12 +313,36 @@ int TIDSControl::run() {
         this->powerController->turnOffAllRelays();
     }
 
+    // Turn off all relays (also after a move timed out)
+    this->powerController->turnOffAllRelays();
+
     // Stop telemetry and datalogging
     this->telemetrySystem->stop();
 
     return 0;
 }
 
+// Wait for background moves, cancelling all of them if any outlasts timeoutS seconds (returns -1 on timeout or if any failed)
+int TIDSControl::waitForMotion(std::vector<MotionHandle> handles, int timeoutS, const char *name) {
+    if (MotionHandle::waitAll(handles, static_cast<int64_t>(timeoutS) * 1000000000) < 0) {
+        std::cout << "TIDSControl: Error " << name << " timed out after " << timeoutS << " s" << std::endl;
+        for (MotionHandle &handle : handles) {
+            handle.cancel();
+        }
+        MotionHandle::waitAll(handles);
+        return -1;
+    }
+    // A failed move leaves the axis or cap out of place, so nothing that depends on it may proceed
+    int result = 0;
+    for (MotionHandle &handle : handles) {
+        if (handle.getStatus() != MotionHandle::STATUS::DONE || handle.getResult() < 0) {
+            std::cout << "TIDSControl: Error " << name << " failed" << std::endl;
+            result = -1;
+        }
+    }
+    return result;
+}
+
 // Tests
 
 int TIDSControl::testPowerController() {
@@ -255,6 +364,21 @@ int TIDSControl::testLoadCell() {
     return 0;
 }
 
+int TIDSControl::testLoadCellLatency() {
+    this->loadCell->setLatencyMeasurement(true);
+    if (this->loadCell->startAcquisition(1024) < 0) {
+        return -1;
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(60));
+    this->loadCell->stopAcquisition();
+    this->loadCell->setLatencyMeasurement(false);
+
+    this->loadCell->getReadLatency()->print(std::cout, "Load cell ready-to-read latency");
+    std::cout << "Load cell missed conversions: " << this->loadCell->getMissedConversionCount() << std::endl;
+    std::cout << "Load cell ready timeouts: " << this->loadCell->getReadyTimeoutCount() << std::endl;
+    return 0;
+}
+
 int TIDSControl::testDrillMotor() {
     return 0;
 }
@@ -267,6 +391,16 @@ int TIDSControl::testDrillCurrentSensor() {
     return 0;
 }
 
+int TIDSControl::calibrateDrillMotor() {
+    // Drill must turn freely, out of the hole
+    this->telemetrySystem->start();
+    this->powerController->setDrillMotorRelayState(PowerController::STATE::ON);
+    int result = this->drillingSystem->calibrateTorqueModel(DRILL_MOTOR_MODEL_PATH);
+    this->powerController->setDrillMotorRelayState(PowerController::STATE::OFF);
+    this->telemetrySystem->stop();
+    return result;
+}
+
 int TIDSControl::testAxisX() {
     return 0;
 }
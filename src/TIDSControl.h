@@ -21,9 +21,12 @@
 
 #include <libbbbkit/DCMotor.h>
 
+#include <vector>
+
 #include "CVD524K.h"
 #include "DrillingSystem.h"
 #include "DS3218.h"
+#include "GPIOMemoryMap.h"
 #include "HX711.h"
 #include "ISNAILVC10.h"
 #include "L298N.h"
@@ -32,6 +35,7 @@
 #include "MeltingSystem.h"
 #include "MLX90614.h"
 #include "MMPEU.h"
+#include "MotionHandle.h"
 #include "PowerController.h"
 #include "SteppedLeadscrew.h"
 #include "TelemetrySystem.h"
@@ -94,6 +98,9 @@ namespace tids {
 
 class TIDSControl {
 private:
+    // Memory-mapped GPIO banks for bit-banged drivers (drivers use sysfs if it cannot be opened)
+    GPIOMemoryMap *gpioMemoryMap;
+
     PowerController *powerController;
 
     ISNAILVC10 *currentSensor;
@@ -117,6 +124,9 @@ private:
     MeltingSystem *meltingSystem;
     DS3218 *heaterCapMotor;
     MLX90614 *heaterThermometer;
+
+    // Wait for background moves, cancelling all of them if any outlasts timeoutS seconds (returns -1 on timeout or if any failed)
+    int waitForMotion(std::vector<MotionHandle> handles, int timeoutS, const char *name);
 public:
     TIDSControl();
     virtual ~TIDSControl();
@@ -144,9 +154,11 @@ public:
     int testPowerController();
     int testCurrentSensor();
     int testLoadCell();
+    int testLoadCellLatency();
     int testDrillMotor();
     int testDrillMotorAndEncoder();
     int testDrillCurrentSensor();
+    int calibrateDrillMotor();
     int testAxisX();
     int testAxisZ();
     int testHeater();
@@ -0,0 +1,139 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "TelemetryChannel.h"
+
+namespace tids {
+
+TelemetryChannel::TelemetryChannel(TelemetryRecord::CHANNEL channel, size_t historyCapacity, size_t statisticsWindowSize, double statisticsEWMAAlpha) {
+    this->channel = channel;
+
+    // Round capacity up to a power of two
+    this->historyCapacity = 1;
+    while (this->historyCapacity < historyCapacity) {
+        this->historyCapacity <<= 1;
+    }
+    this->historyTimeNS = new std::atomic<int64_t>[this->historyCapacity];
+    this->historyValue = new std::atomic<float>[this->historyCapacity];
+    this->historyCount = 0;
+
+    this->statistics = new StreamingStatistics(statisticsWindowSize, statisticsEWMAAlpha);
+    this->anomalyDetector = nullptr;
+}
+
+TelemetryChannel::~TelemetryChannel() {
+    delete[] this->historyTimeNS;
+    delete[] this->historyValue;
+    delete this->statistics;
+    delete this->anomalyDetector;
+}
+
+// Get channel identifier
+TelemetryRecord::CHANNEL TelemetryChannel::getChannel() {
+    return this->channel;
+}
+
+// Publish a sample (must only be called from a single writer thread)
+void TelemetryChannel::publish(int64_t timeNS, float value) {
+    uint64_t count = this->historyCount.load(std::memory_order_relaxed);
+    size_t index = count & (this->historyCapacity - 1);
+    this->historyTimeNS[index].store(timeNS, std::memory_order_relaxed);
+    this->historyValue[index].store(value, std::memory_order_relaxed);
+    this->historyCount.store(count + 1, std::memory_order_release);
+
+    this->latest.publish(timeNS, value);
+
+    this->statistics->add(value);
+
+    // Raise anomalies within the sample that caused them
+    AnomalyEvent event;
+    if (this->anomalyDetector != nullptr && this->anomalyDetector->update(timeNS, value, &event) == 1 && this->anomalyHandler) {
+        this->anomalyHandler(event);
+    }
+}
+
+// Get latest sample (returns -1 if nothing has been published)
+int TelemetryChannel::getLatest(Sample *sample) {
+    return this->latest.read(sample);
+}
+
+// Copy up to maxCount of the most recent samples, oldest first (returns number copied)
+size_t TelemetryChannel::getHistory(Sample *samples, size_t maxCount) {
+    uint64_t endCount = this->historyCount.load(std::memory_order_acquire);
+
+    // Leave one slot of margin for a publish in progress
+    uint64_t available = endCount < this->historyCapacity - 1 ? endCount : this->historyCapacity - 1;
+    uint64_t copyCount = available < maxCount ? available : maxCount;
+    uint64_t startCount = endCount - copyCount;
+
+    for (uint64_t i = 0; i < copyCount; i++) {
+        size_t index = (startCount + i) & (this->historyCapacity - 1);
+        samples[i].timeNS = this->historyTimeNS[index].load(std::memory_order_relaxed);
+        samples[i].value = this->historyValue[index].load(std::memory_order_relaxed);
+    }
+
+    // Discard samples the writer overwrote while copying
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t latestCount = this->historyCount.load(std::memory_order_relaxed);
+    uint64_t overwrittenCount = 0;
+    if (latestCount + 1 > startCount + this->historyCapacity) {
+        overwrittenCount = latestCount + 1 - this->historyCapacity - startCount;
+    }
+    if (overwrittenCount >= copyCount) {
+        return 0;
+    }
+    if (overwrittenCount > 0) {
+        for (uint64_t i = overwrittenCount; i < copyCount; i++) {
+            samples[i - overwrittenCount] = samples[i];
+        }
+    }
+    return static_cast<size_t>(copyCount - overwrittenCount);
+}
+
+// Get history capacity
+size_t TelemetryChannel::getHistoryCapacity() {
+    return this->historyCapacity;
+}
+
+// Get total number of samples published
+uint64_t TelemetryChannel::getCount() {
+    return this->historyCount.load(std::memory_order_acquire);
+}
+
+// Get aggregates as of the latest sample (returns -1 if nothing has been published)
+int TelemetryChannel::getStatistics(StatisticsSummary *summary) {
+    return this->statistics->getSummary(summary);
+}
+
+// Detect anomalies on every sample, taking ownership of the detector (only before publishing starts)
+int TelemetryChannel::setAnomalyDetector(AnomalyDetector *anomalyDetector, AnomalyHandler anomalyHandler) {
+    if (this->getCount() > 0) {
+        return -1;
+    }
+    delete this->anomalyDetector;
+    this->anomalyDetector = anomalyDetector;
+    this->anomalyHandler = anomalyHandler;
+    return 0;
+}
+
+// Get anomaly detector (nullptr if none)
+AnomalyDetector *TelemetryChannel::getAnomalyDetector() {
+    return this->anomalyDetector;
+}
+
+} /* namespace tids */
@@ -0,0 +1,94 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TELEMETRYCHANNEL_H
+#define TELEMETRYCHANNEL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+#include "AnomalyDetector.h"
+#include "SampleSlot.h"
+#include "StreamingStatistics.h"
+#include "TelemetryRecord.h"
+
+namespace tids {
+
+// Single sensor channel with a lock-free latest-value slot and history buffer
+class TelemetryChannel {
+public:
+    // Called on the publishing thread as soon as an anomaly is detected, must not block
+    typedef std::function<void(const AnomalyEvent &)> AnomalyHandler;
+
+private:
+    TelemetryRecord::CHANNEL channel;
+
+    // Latest sample
+    SampleSlot latest;
+
+    // Recent samples (circular, capacity is a power of two)
+    std::atomic<int64_t> *historyTimeNS;
+    std::atomic<float> *historyValue;
+    size_t historyCapacity;
+    // Total number of samples published
+    std::atomic<uint64_t> historyCount;
+
+    // Aggregates updated with every sample
+    StreamingStatistics *statistics;
+
+    // Optional anomaly detection on every sample
+    AnomalyDetector *anomalyDetector;
+    AnomalyHandler anomalyHandler;
+
+public:
+    TelemetryChannel(TelemetryRecord::CHANNEL channel, size_t historyCapacity, size_t statisticsWindowSize, double statisticsEWMAAlpha);
+    virtual ~TelemetryChannel();
+
+    // Get channel identifier
+    TelemetryRecord::CHANNEL getChannel();
+
+    // Publish a sample (must only be called from a single writer thread)
+    void publish(int64_t timeNS, float value);
+
+    // Get latest sample (returns -1 if nothing has been published)
+    int getLatest(Sample *sample);
+
+    // Copy up to maxCount of the most recent samples, oldest first (returns number copied)
+    size_t getHistory(Sample *samples, size_t maxCount);
+
+    // Get history capacity
+    size_t getHistoryCapacity();
+
+    // Get total number of samples published
+    uint64_t getCount();
+
+    // Get aggregates as of the latest sample (returns -1 if nothing has been published)
+    int getStatistics(StatisticsSummary *summary);
+
+    // Detect anomalies on every sample, taking ownership of the detector (only before publishing starts)
+    int setAnomalyDetector(AnomalyDetector *anomalyDetector, AnomalyHandler anomalyHandler);
+
+    // Get anomaly detector (nullptr if none)
+    AnomalyDetector *getAnomalyDetector();
+};
+
+} /* namespace tids */
+
+#endif /* TELEMETRYCHANNEL_H */
@@ -0,0 +1,157 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "TelemetryExport.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace tids {
+
+TelemetryExport::TelemetryExport(std::string name, size_t historyCapacity) {
+    this->name = name;
+    this->historyCapacity = historyCapacity;
+    this->data = nullptr;
+    this->size = 0;
+    this->header = nullptr;
+    this->snapshotWords = nullptr;
+    this->historyWords = nullptr;
+}
+
+TelemetryExport::~TelemetryExport() {
+    this->close();
+}
+
+// Create (or reattach to) the shared-memory segment and initialize the layout
+int TelemetryExport::open(int64_t wallClockOffsetNS) {
+    if (this->data != nullptr || this->historyCapacity == 0) {
+        return -1;
+    }
+
+    // Compute layout
+    size_t channelsOffset = sizeof(TelemetryExportHeader);
+    size_t snapshotOffset = channelsOffset + TelemetryRecord::CHANNEL::CHANNEL_COUNT * sizeof(TelemetryExportChannel);
+    size_t historyOffset = snapshotOffset + TELEMETRY_EXPORT_SNAPSHOT_WORDS * sizeof(uint64_t);
+    this->size = historyOffset + this->historyCapacity * TELEMETRY_EXPORT_SNAPSHOT_WORDS * sizeof(uint64_t);
+
+    int fileDescriptor = shm_open(this->name.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fileDescriptor < 0) {
+        std::cout << "TelemetryExport: Error opening " << this->name << "." << std::endl;
+        return -1;
+    }
+    if (ftruncate(fileDescriptor, static_cast<off_t>(this->size)) < 0) {
+        ::close(fileDescriptor);
+        return -1;
+    }
+    void *mapping = mmap(nullptr, this->size, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0);
+    ::close(fileDescriptor);
+    if (mapping == MAP_FAILED) {
+        return -1;
+    }
+    this->data = static_cast<uint8_t *>(mapping);
+    this->header = reinterpret_cast<TelemetryExportHeader *>(this->data);
+    this->snapshotWords = reinterpret_cast<std::atomic<uint64_t> *>(this->data + snapshotOffset);
+    this->historyWords = reinterpret_cast<std::atomic<uint64_t> *>(this->data + historyOffset);
+
+    // Invalidate the magic while the layout is rewritten so readers do not attach mid-initialization
+    this->header->magic[0] = '\0';
+    std::atomic_thread_fence(std::memory_order_release);
+
+    uint64_t generation = this->header->generation.load(std::memory_order_relaxed);
+    this->header->version = TELEMETRY_EXPORT_VERSION;
+    this->header->headerSize = sizeof(TelemetryExportHeader);
+    this->header->channelCount = TelemetryRecord::CHANNEL::CHANNEL_COUNT;
+    this->header->snapshotSize = sizeof(TelemetrySnapshot);
+    this->header->snapshotWords = TELEMETRY_EXPORT_SNAPSHOT_WORDS;
+    this->header->historyCapacity = static_cast<uint32_t>(this->historyCapacity);
+    this->header->channelsOffset = channelsOffset;
+    this->header->snapshotOffset = snapshotOffset;
+    this->header->historyOffset = historyOffset;
+    this->header->totalSize = this->size;
+    this->header->wallClockOffsetNS = wallClockOffsetNS;
+    this->header->writerPID = static_cast<int32_t>(getpid());
+    this->header->sequence.store(0, std::memory_order_relaxed);
+    this->header->historyCount.store(0, std::memory_order_relaxed);
+
+    TelemetryExportChannel *channels = reinterpret_cast<TelemetryExportChannel *>(this->data + channelsOffset);
+    for (int channel = 0; channel < TelemetryRecord::CHANNEL::CHANNEL_COUNT; channel++) {
+        memset(&channels[channel], 0, sizeof(TelemetryExportChannel));
+        strncpy(channels[channel].name, telemetryChannelName(channel), sizeof(channels[channel].name) - 1);
+        strncpy(channels[channel].units, telemetryChannelUnits(channel), sizeof(channels[channel].units) - 1);
+        channels[channel].id = static_cast<uint32_t>(channel);
+    }
+
+    // Publish the new generation, then the magic that marks the layout valid
+    this->header->generation.store(generation + 1, std::memory_order_release);
+    memcpy(this->header->magic, TELEMETRY_EXPORT_MAGIC, sizeof(TELEMETRY_EXPORT_MAGIC));
+    std::atomic_thread_fence(std::memory_order_release);
+    return 0;
+}
+
+// Unmap the segment (the segment itself remains for readers until unlinked)
+void TelemetryExport::close() {
+    if (this->data != nullptr) {
+        munmap(this->data, this->size);
+        this->data = nullptr;
+        this->header = nullptr;
+        this->snapshotWords = nullptr;
+        this->historyWords = nullptr;
+    }
+}
+
+// Remove the segment name so no new readers can attach
+int TelemetryExport::unlink() {
+    return shm_unlink(this->name.c_str());
+}
+
+// Publish a snapshot as the live state and append it to the history (single writer only)
+void TelemetryExport::publish(const TelemetrySnapshot &snapshot) {
+    if (this->data == nullptr) {
+        return;
+    }
+
+    uint64_t buffer[TELEMETRY_EXPORT_SNAPSHOT_WORDS] = {0};
+    memcpy(buffer, &snapshot, sizeof(TelemetrySnapshot));
+
+    // Update live snapshot under the sequence counter
+    uint64_t sequence = this->header->sequence.load(std::memory_order_relaxed);
+    this->header->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < TELEMETRY_EXPORT_SNAPSHOT_WORDS; i++) {
+        this->snapshotWords[i].store(buffer[i], std::memory_order_relaxed);
+    }
+    this->header->sequence.store(sequence + 2, std::memory_order_release);
+
+    // Append to history, then publish the new count
+    uint64_t historyCount = this->header->historyCount.load(std::memory_order_relaxed);
+    std::atomic<uint64_t> *entry = &this->historyWords[(historyCount % this->historyCapacity) * TELEMETRY_EXPORT_SNAPSHOT_WORDS];
+    for (size_t i = 0; i < TELEMETRY_EXPORT_SNAPSHOT_WORDS; i++) {
+        entry[i].store(buffer[i], std::memory_order_relaxed);
+    }
+    this->header->historyCount.store(historyCount + 1, std::memory_order_release);
+}
+
+// If the segment is open
+bool TelemetryExport::isOpen() {
+    return this->data != nullptr;
+}
+
+} /* namespace tids */
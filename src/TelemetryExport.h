@@ -0,0 +1,67 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TELEMETRYEXPORT_H
+#define TELEMETRYEXPORT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "TelemetryExportLayout.h"
+#include "TelemetrySnapshot.h"
+
+namespace tids {
+
+// Publishes telemetry snapshots into a shared-memory segment for out-of-process readers
+class TelemetryExport {
+private:
+    std::string name;
+    size_t historyCapacity;
+
+    uint8_t *data;
+    size_t size;
+
+    TelemetryExportHeader *header;
+    std::atomic<uint64_t> *snapshotWords;
+    std::atomic<uint64_t> *historyWords;
+
+public:
+    TelemetryExport(std::string name=TELEMETRY_EXPORT_NAME, size_t historyCapacity=4096);
+    virtual ~TelemetryExport();
+
+    // Create (or reattach to) the shared-memory segment and initialize the layout
+    int open(int64_t wallClockOffsetNS);
+
+    // Unmap the segment (the segment itself remains for readers until unlinked)
+    void close();
+
+    // Remove the segment name so no new readers can attach
+    int unlink();
+
+    // Publish a snapshot as the live state and append it to the history (single writer only)
+    void publish(const TelemetrySnapshot &snapshot);
+
+    // If the segment is open
+    bool isOpen();
+};
+
+} /* namespace tids */
+
+#endif /* TELEMETRYEXPORT_H */
@@ -0,0 +1,90 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TELEMETRYEXPORTLAYOUT_H
+#define TELEMETRYEXPORTLAYOUT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "TelemetryRecord.h"
+#include "TelemetrySnapshot.h"
+
+namespace tids {
+
+// Shared-memory telemetry export layout (POSIX shared memory, /dev/shm/tids-telemetry by default)
+//
+//   TelemetryExportHeader                         at offset 0
+//   TelemetryExportChannel[header.channelCount]   at header.channelsOffset
+//   uint64_t snapshot[header.snapshotWords]       at header.snapshotOffset
+//   uint64_t history[header.historyCapacity][header.snapshotWords] at header.historyOffset
+//
+// Snapshots are TelemetrySnapshot structs stored as atomic 64-bit words. The live snapshot is
+// guarded by header.sequence (odd while the writer is updating it); readers copy the words and
+// retry if the sequence changed. History entry n is stored at index n % historyCapacity and is
+// valid once header.historyCount > n, until the writer wraps back around to it.
+// header.generation increments every time a writer attaches, so readers can detect restarts.
+
+#define TELEMETRY_EXPORT_NAME "/tids-telemetry"
+#define TELEMETRY_EXPORT_MAGIC "TIDSSHM"
+#define TELEMETRY_EXPORT_VERSION 1
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "Shared-memory export requires lock-free 64-bit atomics");
+
+struct TelemetryExportHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t channelCount;
+    uint32_t snapshotSize;
+    uint32_t snapshotWords;
+    uint32_t historyCapacity;
+    uint64_t channelsOffset;
+    uint64_t snapshotOffset;
+    uint64_t historyOffset;
+    uint64_t totalSize;
+    // Wall clock time minus monotonic time when the writer attached, in nanoseconds
+    int64_t wallClockOffsetNS;
+    int32_t writerPID;
+    uint32_t reserved;
+    // Incremented every time a writer attaches
+    std::atomic<uint64_t> generation;
+    // Live snapshot sequence, odd while the writer is updating it
+    std::atomic<uint64_t> sequence;
+    // Number of snapshots appended to the history
+    std::atomic<uint64_t> historyCount;
+    uint8_t padding[24];
+};
+
+struct TelemetryExportChannel {
+    char name[32];
+    char units[24];
+    uint32_t id;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(TelemetryExportHeader) == 128, "TelemetryExportHeader must be 128 bytes");
+static_assert(sizeof(TelemetryExportChannel) == 64, "TelemetryExportChannel must be 64 bytes");
+
+// Number of 64-bit words holding one TelemetrySnapshot
+#define TELEMETRY_EXPORT_SNAPSHOT_WORDS ((sizeof(TelemetrySnapshot) + sizeof(uint64_t) - 1) / sizeof(uint64_t))
+
+} /* namespace tids */
+
+#endif /* TELEMETRYEXPORTLAYOUT_H */
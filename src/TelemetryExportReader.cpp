@@ -0,0 +1,185 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "TelemetryExportReader.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace tids {
+
+TelemetryExportReader::TelemetryExportReader(std::string name) {
+    this->name = name;
+    this->data = nullptr;
+    this->size = 0;
+    this->header = nullptr;
+    this->channels = nullptr;
+    this->snapshotWords = nullptr;
+    this->historyWords = nullptr;
+    this->generation = 0;
+}
+
+TelemetryExportReader::~TelemetryExportReader() {
+    this->close();
+}
+
+// Attach read-only and validate the layout
+int TelemetryExportReader::open() {
+    if (this->data != nullptr) {
+        return -1;
+    }
+
+    int fileDescriptor = shm_open(this->name.c_str(), O_RDONLY, 0);
+    if (fileDescriptor < 0) {
+        return -1;
+    }
+    struct stat fileStat;
+    if (fstat(fileDescriptor, &fileStat) < 0 || fileStat.st_size < static_cast<off_t>(sizeof(TelemetryExportHeader))) {
+        ::close(fileDescriptor);
+        return -1;
+    }
+    this->size = static_cast<size_t>(fileStat.st_size);
+    void *mapping = mmap(nullptr, this->size, PROT_READ, MAP_SHARED, fileDescriptor, 0);
+    ::close(fileDescriptor);
+    if (mapping == MAP_FAILED) {
+        return -1;
+    }
+    this->data = static_cast<const uint8_t *>(mapping);
+    this->header = reinterpret_cast<const TelemetryExportHeader *>(this->data);
+
+    // Validate layout against this build
+    this->generation = this->header->generation.load(std::memory_order_acquire);
+    if (memcmp(this->header->magic, TELEMETRY_EXPORT_MAGIC, sizeof(TELEMETRY_EXPORT_MAGIC)) != 0
+        || this->header->version != TELEMETRY_EXPORT_VERSION
+        || this->header->headerSize != sizeof(TelemetryExportHeader)
+        || this->header->snapshotSize != sizeof(TelemetrySnapshot)
+        || this->header->snapshotWords != TELEMETRY_EXPORT_SNAPSHOT_WORDS
+        || this->header->historyCapacity == 0
+        || this->header->totalSize > this->size) {
+        this->close();
+        return -1;
+    }
+
+    this->channels = reinterpret_cast<const TelemetryExportChannel *>(this->data + this->header->channelsOffset);
+    this->snapshotWords = reinterpret_cast<const std::atomic<uint64_t> *>(this->data + this->header->snapshotOffset);
+    this->historyWords = reinterpret_cast<const std::atomic<uint64_t> *>(this->data + this->header->historyOffset);
+    return 0;
+}
+
+// Detach
+void TelemetryExportReader::close() {
+    if (this->data != nullptr) {
+        munmap(const_cast<uint8_t *>(this->data), this->size);
+        this->data = nullptr;
+    }
+    this->header = nullptr;
+    this->channels = nullptr;
+    this->snapshotWords = nullptr;
+    this->historyWords = nullptr;
+}
+
+// If the writer has restarted since attaching (reopen to follow it)
+bool TelemetryExportReader::isStale() {
+    if (this->header == nullptr) {
+        return true;
+    }
+    return this->header->generation.load(std::memory_order_acquire) != this->generation;
+}
+
+// Get layout header
+const TelemetryExportHeader *TelemetryExportReader::getHeader() {
+    return this->header;
+}
+
+// Get channel descriptor (returns nullptr if out of range)
+const TelemetryExportChannel *TelemetryExportReader::getChannel(int channel) {
+    if (this->header == nullptr || channel < 0 || channel >= static_cast<int>(this->header->channelCount)) {
+        return nullptr;
+    }
+    return &this->channels[channel];
+}
+
+// Read the live snapshot (returns -1 if nothing has been published)
+int TelemetryExportReader::readSnapshot(TelemetrySnapshot *snapshot) {
+    if (this->header == nullptr) {
+        return -1;
+    }
+
+    uint64_t buffer[TELEMETRY_EXPORT_SNAPSHOT_WORDS];
+    uint64_t sequenceBefore;
+    uint64_t sequenceAfter;
+    do {
+        sequenceBefore = this->header->sequence.load(std::memory_order_acquire);
+        for (size_t i = 0; i < TELEMETRY_EXPORT_SNAPSHOT_WORDS; i++) {
+            buffer[i] = this->snapshotWords[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        sequenceAfter = this->header->sequence.load(std::memory_order_relaxed);
+    // Retry if the writer was active during the read
+    } while ((sequenceBefore & 0x1) || sequenceBefore != sequenceAfter);
+
+    if (sequenceBefore == 0) {
+        return -1;
+    }
+    memcpy(snapshot, buffer, sizeof(TelemetrySnapshot));
+    return 0;
+}
+
+// Copy up to maxCount of the most recent snapshots, oldest first (returns number copied)
+size_t TelemetryExportReader::readHistory(TelemetrySnapshot *snapshots, size_t maxCount) {
+    if (this->header == nullptr) {
+        return 0;
+    }
+
+    uint64_t capacity = this->header->historyCapacity;
+    uint64_t endCount = this->header->historyCount.load(std::memory_order_acquire);
+
+    // Leave one entry of margin for an append in progress
+    uint64_t available = endCount < capacity - 1 ? endCount : capacity - 1;
+    uint64_t copyCount = available < maxCount ? available : maxCount;
+    uint64_t startCount = endCount - copyCount;
+
+    uint64_t buffer[TELEMETRY_EXPORT_SNAPSHOT_WORDS];
+    for (uint64_t i = 0; i < copyCount; i++) {
+        const std::atomic<uint64_t> *entry = &this->historyWords[((startCount + i) % capacity) * TELEMETRY_EXPORT_SNAPSHOT_WORDS];
+        for (size_t word = 0; word < TELEMETRY_EXPORT_SNAPSHOT_WORDS; word++) {
+            buffer[word] = entry[word].load(std::memory_order_relaxed);
+        }
+        memcpy(&snapshots[i], buffer, sizeof(TelemetrySnapshot));
+    }
+
+    // Discard entries the writer overwrote while copying
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t latestCount = this->header->historyCount.load(std::memory_order_relaxed);
+    uint64_t overwrittenCount = 0;
+    if (latestCount + 1 > startCount + capacity) {
+        overwrittenCount = latestCount + 1 - capacity - startCount;
+    }
+    if (overwrittenCount >= copyCount) {
+        return 0;
+    }
+    if (overwrittenCount > 0) {
+        memmove(snapshots, snapshots + overwrittenCount, (copyCount - overwrittenCount) * sizeof(TelemetrySnapshot));
+    }
+    return static_cast<size_t>(copyCount - overwrittenCount);
+}
+
+} /* namespace tids */
@@ -0,0 +1,76 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TELEMETRYEXPORTREADER_H
+#define TELEMETRYEXPORTREADER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "TelemetryExportLayout.h"
+#include "TelemetrySnapshot.h"
+
+namespace tids {
+
+// Read-only attachment to a shared-memory telemetry export (never writes to the segment)
+class TelemetryExportReader {
+private:
+    std::string name;
+
+    const uint8_t *data;
+    size_t size;
+
+    const TelemetryExportHeader *header;
+    const TelemetryExportChannel *channels;
+    const std::atomic<uint64_t> *snapshotWords;
+    const std::atomic<uint64_t> *historyWords;
+
+    // Writer generation at attach time
+    uint64_t generation;
+
+public:
+    TelemetryExportReader(std::string name=TELEMETRY_EXPORT_NAME);
+    virtual ~TelemetryExportReader();
+
+    // Attach read-only and validate the layout
+    int open();
+
+    // Detach
+    void close();
+
+    // If the writer has restarted since attaching (reopen to follow it)
+    bool isStale();
+
+    // Get layout header
+    const TelemetryExportHeader *getHeader();
+
+    // Get channel descriptor (returns nullptr if out of range)
+    const TelemetryExportChannel *getChannel(int channel);
+
+    // Read the live snapshot (returns -1 if nothing has been published)
+    int readSnapshot(TelemetrySnapshot *snapshot);
+
+    // Copy up to maxCount of the most recent snapshots, oldest first (returns number copied)
+    size_t readHistory(TelemetrySnapshot *snapshots, size_t maxCount);
+};
+
+} /* namespace tids */
+
+#endif /* TELEMETRYEXPORTREADER_H */
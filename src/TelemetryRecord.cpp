@@ -0,0 +1,62 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "TelemetryRecord.h"
+
+namespace tids {
+
+// Get channel name
+const char *telemetryChannelName(int channel) {
+    switch (channel) {
+        case TelemetryRecord::CHANNEL::MAIN_CURRENT:
+            return "main_current";
+        case TelemetryRecord::CHANNEL::WEIGHT_ON_BIT:
+            return "weight_on_bit";
+        case TelemetryRecord::CHANNEL::DRILL_CURRENT:
+            return "drill_current";
+        case TelemetryRecord::CHANNEL::DRILL_SPEED:
+            return "drill_speed";
+        case TelemetryRecord::CHANNEL::HEATER_OBJECT_TEMPERATURE:
+            return "heater_object_temperature";
+        case TelemetryRecord::CHANNEL::HEATER_AMBIENT_TEMPERATURE:
+            return "heater_ambient_temperature";
+        default:
+            return "unknown";
+    }
+}
+
+// Get channel units
+const char *telemetryChannelUnits(int channel) {
+    switch (channel) {
+        case TelemetryRecord::CHANNEL::MAIN_CURRENT:
+            return "A";
+        case TelemetryRecord::CHANNEL::WEIGHT_ON_BIT:
+            return "kg";
+        case TelemetryRecord::CHANNEL::DRILL_CURRENT:
+            return "A";
+        case TelemetryRecord::CHANNEL::DRILL_SPEED:
+            return "RPM";
+        case TelemetryRecord::CHANNEL::HEATER_OBJECT_TEMPERATURE:
+        case TelemetryRecord::CHANNEL::HEATER_AMBIENT_TEMPERATURE:
+            return "C";
+        default:
+            return "";
+    }
+}
+
+} /* namespace tids */
@@ -0,0 +1,55 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TELEMETRYRECORD_H
+#define TELEMETRYRECORD_H
+
+#include <cstdint>
+
+namespace tids {
+
+// Fixed-size binary telemetry record passed from sampling threads to the datalog
+struct TelemetryRecord {
+    enum CHANNEL {
+        MAIN_CURRENT = 0,
+        WEIGHT_ON_BIT = 1,
+        DRILL_CURRENT = 2,
+        DRILL_SPEED = 3,
+        HEATER_OBJECT_TEMPERATURE = 4,
+        HEATER_AMBIENT_TEMPERATURE = 5,
+        CHANNEL_COUNT = 6,
+    };
+
+    // Acquisition time in nanoseconds (monotonic clock)
+    int64_t timeNS;
+    // Channel the value was sampled from
+    uint16_t channel;
+    uint16_t reserved;
+    // Sampled value in channel units
+    float value;
+};
+
+// Get channel name
+const char *telemetryChannelName(int channel);
+
+// Get channel units
+const char *telemetryChannelUnits(int channel);
+
+} /* namespace tids */
+
+#endif /* TELEMETRYRECORD_H */
@@ -0,0 +1,42 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TELEMETRYSNAPSHOT_H
+#define TELEMETRYSNAPSHOT_H
+
+#include <cstdint>
+
+#include "TelemetryRecord.h"
+
+namespace tids {
+
+// Time-coherent view of every telemetry channel
+struct TelemetrySnapshot {
+    // Time the snapshot was taken (monotonic), in nanoseconds
+    int64_t timeNS;
+    // Number of snapshots published before this one
+    uint64_t index;
+    // Latest value of each channel at timeNS, indexed by TelemetryRecord::CHANNEL
+    float value[TelemetryRecord::CHANNEL::CHANNEL_COUNT];
+    // Bit set for each channel that has been sampled at least once
+    uint32_t validChannels;
+};
+
+} /* namespace tids */
+
+#endif /* TELEMETRYSNAPSHOT_H */
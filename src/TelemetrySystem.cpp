@@ -18,89 +18,340 @@
 
 #include "TelemetrySystem.h"
 
-#include <chrono>
-#include <ctime>
-#include <iomanip>
 #include <iostream>
 
+#include "Clock.h"
+
 namespace tids {
 
-#define DATALOG_FILENAME "datalog.txt"
+#define DATALOG_FILENAME "datalog.tlog"
+
+// Capacity of each producer ring buffer, in records (several seconds at full rate)
+#define DATALOG_PRODUCER_CAPACITY 4096
+
+// Capacity of the anomaly event ring buffer, in events
+#define ANOMALY_PRODUCER_CAPACITY 64
+
+// Interval between console echoes of each channel
+#define DATALOG_ECHO_INTERVAL_MS 10000
+
+// Number of recent samples kept per channel
+#define CHANNEL_HISTORY_CAPACITY 1024
+
+// Ground station address and bandwidth budget of the radio link
+#define DOWNLINK_ADDRESS "127.0.0.1"
+#define DOWNLINK_PORT 5700
+#define DOWNLINK_BYTES_PER_SECOND 2000
+
+// Window of the streaming statistics, in samples, and smoothing factor of their moving averages
+#define CHANNEL_STATISTICS_WINDOW 256
+#define CHANNEL_STATISTICS_EWMA_ALPHA 0.05
+
+// Anomaly detection baseline smoothing, spike z-score threshold, and CUSUM slack and threshold in standard deviations
+#define ANOMALY_ALPHA 0.02
+#define ANOMALY_SPIKE_THRESHOLD 6.0
+#define ANOMALY_CUSUM_SLACK 0.5
+#define ANOMALY_CUSUM_THRESHOLD 10.0
+
+// Smallest standard deviation used to score anomalies, about the sensor resolution
+#define ANOMALY_MINIMUM_DEVIATION_A 0.05
+#define ANOMALY_MINIMUM_DEVIATION_KG 0.02
+
+// Period of monotonic to wall clock mapping updates (follows NTP or GPS corrections)
+#define CLOCK_MAPPING_PERIOD_MS 10000
+#define CLOCK_MAPPING_DEADLINE_MS 100
+
+// Main current sampling period and deadline
+#define MAIN_CURRENT_PERIOD_MS 1000
+#define MAIN_CURRENT_DEADLINE_MS 100
+
+// Weight on bit is acquired by the HX711 engine and moved into its channel by a scheduler task
+// running faster than the 12.5 ms conversion period at 80 SPS, which bounds read latency
+#define WEIGHT_ON_BIT_DRAIN_PERIOD_MS 5
+#define WEIGHT_ON_BIT_DRAIN_DEADLINE_MS 2
+#define WEIGHT_ON_BIT_ACQUISITION_CAPACITY 1024
+#define WEIGHT_ON_BIT_DRAIN_BATCH_SIZE 64
+
+// Median length and IIR smoothing factor of the weight on bit filter (rejects single-conversion glitches)
+#define WEIGHT_ON_BIT_MEDIAN_LENGTH 3
+#define WEIGHT_ON_BIT_IIR_ALPHA 1.0f
 
 TelemetrySystem::TelemetrySystem(ISNAILVC10 *currentSensor, HX711 *weightOnBitSensor) {
     this->currentSensor = currentSensor;
     this->weightOnBitSensor = weightOnBitSensor;
-    
-    this->current = -1;
-    this->weightOnBit = -1;
+
+    // Create every channel so readers never see a missing channel
+    for (int channel = 0; channel < TelemetryRecord::CHANNEL::CHANNEL_COUNT; channel++) {
+        this->channels[channel] = new TelemetryChannel(static_cast<TelemetryRecord::CHANNEL>(channel), CHANNEL_HISTORY_CAPACITY,
+                                                       CHANNEL_STATISTICS_WINDOW, CHANNEL_STATISTICS_EWMA_ALPHA);
+    }
+
+    // Detect current spikes and weight on bit steps as they are sampled
+    TelemetryRecord::CHANNEL anomalyChannels[] = {TelemetryRecord::CHANNEL::MAIN_CURRENT,
+                                                  TelemetryRecord::CHANNEL::DRILL_CURRENT,
+                                                  TelemetryRecord::CHANNEL::WEIGHT_ON_BIT};
+    for (TelemetryRecord::CHANNEL channel : anomalyChannels) {
+        double minimumDeviation = channel == TelemetryRecord::CHANNEL::WEIGHT_ON_BIT ? ANOMALY_MINIMUM_DEVIATION_KG : ANOMALY_MINIMUM_DEVIATION_A;
+        AnomalyDetector *anomalyDetector = new AnomalyDetector(channel, ANOMALY_ALPHA, ANOMALY_SPIKE_THRESHOLD,
+                                                               ANOMALY_CUSUM_SLACK, ANOMALY_CUSUM_THRESHOLD, minimumDeviation);
+        this->channels[channel]->setAnomalyDetector(anomalyDetector, [this](const AnomalyEvent &event) { this->raiseAnomaly(event); });
+    }
+
+    this->scheduler = new SamplingScheduler();
+
+    // Publish a snapshot after every sampling pass
+    this->snapshotIndex = 0;
+    this->scheduler->setPassCallback([this](int64_t releaseTimeNS) { (void)releaseTimeNS; this->publishSnapshot(); });
+
+    this->telemetryExport = new TelemetryExport();
+
+    // Create datalog writer with one producer ring buffer per sampling thread
+    this->datalogWriter = new DatalogWriter(DATALOG_FILENAME, DatalogWriter::FORMAT::BINARY);
+    this->datalogWriter->setEchoInterval(DATALOG_ECHO_INTERVAL_MS);
+    this->schedulerProducer = this->datalogWriter->createProducer(DATALOG_PRODUCER_CAPACITY);
+    this->schedulerAnomalyProducer = this->datalogWriter->createAnomalyProducer(ANOMALY_PRODUCER_CAPACITY);
+
+    // Keep the wall clock mapping current for datalog, downlink and monitors
+    this->scheduler->addTask("clock_mapping",
+                             static_cast<int64_t>(CLOCK_MAPPING_PERIOD_MS) * 1000000,
+                             static_cast<int64_t>(CLOCK_MAPPING_DEADLINE_MS) * 1000000,
+                             [](int64_t releaseTimeNS) { (void)releaseTimeNS; Clock::updateMapping(); });
+
+    // Move acquired weight on bit samples into their channel with their conversion timestamps
+    this->weightOnBitSensor->setFilter(WEIGHT_ON_BIT_MEDIAN_LENGTH, WEIGHT_ON_BIT_IIR_ALPHA);
+    this->scheduler->addTask(telemetryChannelName(TelemetryRecord::CHANNEL::WEIGHT_ON_BIT),
+                             static_cast<int64_t>(WEIGHT_ON_BIT_DRAIN_PERIOD_MS) * 1000000,
+                             static_cast<int64_t>(WEIGHT_ON_BIT_DRAIN_DEADLINE_MS) * 1000000,
+                             [this](int64_t releaseTimeNS) { (void)releaseTimeNS; this->drainWeightOnBit(); });
+
+    // Register main current channel
+    ISNAILVC10 *mainCurrentSensor = this->currentSensor;
+    this->registerChannel(TelemetryRecord::CHANNEL::MAIN_CURRENT,
+                          static_cast<int64_t>(MAIN_CURRENT_PERIOD_MS) * 1000000,
+                          static_cast<int64_t>(MAIN_CURRENT_DEADLINE_MS) * 1000000,
+                          [mainCurrentSensor]() { return mainCurrentSensor->getCurrent(); });
+
+    // Downlink in priority order, decimating the fast channels to about 10 Hz
+    this->downlink = new Downlink(DOWNLINK_ADDRESS, DOWNLINK_PORT, DOWNLINK_BYTES_PER_SECOND);
+    this->downlink->addChannel(this->channels[TelemetryRecord::CHANNEL::WEIGHT_ON_BIT], 0, 8, 0.001f);
+    this->downlink->addChannel(this->channels[TelemetryRecord::CHANNEL::DRILL_CURRENT], 1, 10, 0.001f);
+    this->downlink->addChannel(this->channels[TelemetryRecord::CHANNEL::MAIN_CURRENT], 1, 1, 0.001f);
+    this->downlink->addChannel(this->channels[TelemetryRecord::CHANNEL::DRILL_SPEED], 2, 10, 0.1f);
+    this->downlink->addChannel(this->channels[TelemetryRecord::CHANNEL::HEATER_OBJECT_TEMPERATURE], 3, 1, 0.01f);
+    this->downlink->addChannel(this->channels[TelemetryRecord::CHANNEL::HEATER_AMBIENT_TEMPERATURE], 3, 1, 0.01f);
 
     this->telemetryThreadShouldCancel = true;
 }
 
 TelemetrySystem::~TelemetrySystem() {
     this->stop();
+    delete this->scheduler;
+    delete this->telemetryExport;
+    delete this->downlink;
+    delete this->datalogWriter;
+    for (int channel = 0; channel < TelemetryRecord::CHANNEL::CHANNEL_COUNT; channel++) {
+        delete this->channels[channel];
+    }
 }
 
 // Start updating telemetry
 int TelemetrySystem::start() {
-    // Return if the telemetry thread already exists
+    // Return if the telemetry threads already exist
     if (!this->telemetryThreadShouldCancel) {
         return -1;
     }
 
-    // Open datalog file
-    this->datalog.open(DATALOG_FILENAME, std::ofstream::out | std::ofstream::app);
+    // Record the wall clock mapping before anything is stamped (the scheduler thread updates it from here on)
+    Clock::updateMapping();
+
+    // Start datalog writer
+    if (this->datalogWriter->start() < 0) {
+        return -1;
+    }
+
+    // Export snapshots to shared memory (telemetry continues without monitors if this fails)
+    this->telemetryExport->open(Clock::getWallClockOffsetNS());
+
+    // Stream to the ground station (telemetry continues locally if this fails)
+    this->downlink->start();
+
+    // Start weight on bit acquisition at the HX711 output rate
+    if (this->weightOnBitSensor->startAcquisition(WEIGHT_ON_BIT_ACQUISITION_CAPACITY) < 0) {
+        std::cout << "TelemetrySystem: Error starting weight on bit acquisition." << std::endl;
+    }
 
     // Reset cancellation token
     this->telemetryThreadShouldCancel = false;
-    // Start temperature regulation on new thread
-    this->telemetryThread = std::thread(&TelemetrySystem::updateTelemetry, this);
+    // Start periodic channels
+    this->scheduler->start();
     return 0;
 }
 
 // Stop updating telemetry
 int TelemetrySystem::stop() {
-    // Cancel and join telemetry thread
+    // Stop periodic channels
+    this->scheduler->stop();
+
+    // Stop weight on bit acquisition
     this->telemetryThreadShouldCancel = true;
-    this->telemetryThread.join();
+    this->weightOnBitSensor->stopAcquisition();
+
+    // Stop streaming to the ground station
+    this->downlink->stop();
 
-    // Close datalog file
-    this->datalog.close();
+    // Persist remaining records and close datalog
+    this->datalogWriter->stop();
+
+    // Detach from shared memory (the last snapshot stays readable)
+    this->telemetryExport->close();
 
     return 0;
 }
 
+// Register a periodic channel sampled on the scheduler thread (returns task id, or -1 on error)
+int TelemetrySystem::registerChannel(TelemetryRecord::CHANNEL channel, int64_t periodNS, int64_t deadlineNS, Sampler sampler) {
+    if (channel < 0 || channel >= TelemetryRecord::CHANNEL::CHANNEL_COUNT || !sampler) {
+        return -1;
+    }
+
+    TelemetryChannel *telemetryChannel = this->channels[channel];
+    SPSCRingBuffer<TelemetryRecord> *producer = this->schedulerProducer;
+    return this->scheduler->addTask(telemetryChannelName(channel), periodNS, deadlineNS,
+        [this, telemetryChannel, producer, channel, sampler](int64_t releaseTimeNS) {
+            (void)releaseTimeNS;
+            // Stamp with the time the sensor was actually read
+            int64_t timeNS = Clock::monotonicNS();
+            float value = sampler();
+            telemetryChannel->publish(timeNS, value);
+            this->logRecord(producer, timeNS, channel, value);
+        });
+}
+
+// Get channel latest value and history
+TelemetryChannel *TelemetrySystem::getChannel(TelemetryRecord::CHANNEL channel) {
+    if (channel < 0 || channel >= TelemetryRecord::CHANNEL::CHANNEL_COUNT) {
+        return nullptr;
+    }
+    return this->channels[channel];
+}
+
+// Get scheduler that runs periodic channels and control tasks
+SamplingScheduler *TelemetrySystem::getScheduler() {
+    return this->scheduler;
+}
+
+// Get latest time-coherent snapshot of every channel (returns -1 if none has been published)
+int TelemetrySystem::getSnapshot(TelemetrySnapshot *snapshot) {
+    if (this->snapshot.read(snapshot) == 0) {
+        return -1;
+    }
+    return 0;
+}
+
 // Get current in amps
 float TelemetrySystem::getCurrent() {
-    return this->current;
+    Sample sample;
+    if (this->channels[TelemetryRecord::CHANNEL::MAIN_CURRENT]->getLatest(&sample) < 0) {
+        return -1;
+    }
+    return sample.value;
 }
 
 // Get weight on bit in kg
 float TelemetrySystem::getWeightOnBit() {
-    return this->weightOnBit;
+    Sample sample;
+    if (this->getWeightOnBitSample(&sample) < 0) {
+        return -1;
+    }
+    return sample.value;
 }
 
-// Update telemetry values
-void TelemetrySystem::updateTelemetry() {
-    // Run until cancellation token
-    while (!this->telemetryThreadShouldCancel) {
-        // Get current
-        this->current = this->currentSensor->getCurrent();
+// Get latest weight on bit sample in kg (returns -1 if none has been acquired)
+int TelemetrySystem::getWeightOnBitSample(Sample *sample) {
+    return this->channels[TelemetryRecord::CHANNEL::WEIGHT_ON_BIT]->getLatest(sample);
+}
 
-        // Get weight on bit
-        if (this->weightOnBitSensor->isReady()) {
-            this->weightOnBit = this->weightOnBitSensor->readWeight();
-        }
+// If the latest weight on bit sample is missing or older than maxAgeMS milliseconds
+bool TelemetrySystem::isWeightOnBitStale(int maxAgeMS) {
+    Sample sample;
+    if (this->getWeightOnBitSample(&sample) < 0) {
+        return true;
+    }
+    int64_t ageNS = Clock::monotonicNS() - sample.timeNS;
+    return ageNS > static_cast<int64_t>(maxAgeMS) * 1000000;
+}
 
-        std::time_t now_c = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+// Get number of datalog records dropped because the writer fell behind
+uint64_t TelemetrySystem::getDatalogOverflowCount() {
+    return this->datalogWriter->getOverflowCount();
+}
 
-        // Print telemetry data and write to datalog
-        std::cout << std::put_time(std::localtime(&now_c), "%F %T") << ", " << this->weightOnBit << " kg, " << this->current << " A," << std::endl;
-        this->datalog << std::put_time(std::localtime(&now_c), "%F %T") << ", " << this->weightOnBit << " kg, " << this->current << " A," << std::endl;
+// Get downlink to the ground station
+Downlink *TelemetrySystem::getDownlink() {
+    return this->downlink;
+}
+
+// Set handler for anomaly events on any channel (only before start)
+int TelemetrySystem::setAnomalyHandler(AnomalyHandler anomalyHandler) {
+    if (!this->telemetryThreadShouldCancel) {
+        return -1;
+    }
+    this->anomalyHandler = anomalyHandler;
+    return 0;
+}
 
-        // Repeat every 10 seconds
-        std::this_thread::sleep_for(std::chrono::seconds(10));
+// Queue an anomaly event for the console and pass it to the application handler (sampling thread, never blocks)
+void TelemetrySystem::raiseAnomaly(const AnomalyEvent &event) {
+    // Printed by the datalog writer thread, dropped if it has fallen behind
+    this->schedulerAnomalyProducer->push(event);
+    if (this->anomalyHandler) {
+        this->anomalyHandler(event);
     }
 }
 
+// Publish a snapshot of the latest value of every channel (scheduler thread only)
+void TelemetrySystem::publishSnapshot() {
+    TelemetrySnapshot snapshot;
+    snapshot.timeNS = Clock::monotonicNS();
+    snapshot.index = this->snapshotIndex++;
+    snapshot.validChannels = 0;
+    for (int channel = 0; channel < TelemetryRecord::CHANNEL::CHANNEL_COUNT; channel++) {
+        Sample sample;
+        if (this->channels[channel]->getLatest(&sample) == 0) {
+            snapshot.value[channel] = sample.value;
+            snapshot.validChannels |= (0x1 << channel);
+        } else {
+            snapshot.value[channel] = 0.0f;
+        }
+    }
+    this->snapshot.write(snapshot);
+    this->telemetryExport->publish(snapshot);
+}
+
+// Move weight on bit samples acquired since the last pass into the channel and datalog (scheduler thread only)
+void TelemetrySystem::drainWeightOnBit() {
+    TelemetryChannel *weightOnBitChannel = this->channels[TelemetryRecord::CHANNEL::WEIGHT_ON_BIT];
+    Sample samples[WEIGHT_ON_BIT_DRAIN_BATCH_SIZE];
+    size_t count;
+    do {
+        count = this->weightOnBitSensor->readSamples(samples, WEIGHT_ON_BIT_DRAIN_BATCH_SIZE);
+        for (size_t i = 0; i < count; i++) {
+            weightOnBitChannel->publish(samples[i].timeNS, samples[i].value);
+            this->logRecord(this->schedulerProducer, samples[i].timeNS, TelemetryRecord::CHANNEL::WEIGHT_ON_BIT, samples[i].value);
+        }
+    } while (count == WEIGHT_ON_BIT_DRAIN_BATCH_SIZE);
+}
+
+// Queue a record for the datalog writer without blocking
+void TelemetrySystem::logRecord(SPSCRingBuffer<TelemetryRecord> *producer, int64_t timeNS, TelemetryRecord::CHANNEL channel, float value) {
+    TelemetryRecord record;
+    record.timeNS = timeNS;
+    record.channel = static_cast<uint16_t>(channel);
+    record.reserved = 0;
+    record.value = value;
+
+    // Dropped records are counted by the ring buffer
+    producer->push(record);
+}
+
 } /* namespace tids */
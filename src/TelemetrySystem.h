@@ -20,25 +20,60 @@
 #define TELEMETRYSYSTEM_H
 
 #include <atomic>
-#include <fstream>
-#include <thread>
+#include <cstdint>
+#include <functional>
 
+#include "DatalogWriter.h"
+#include "Downlink.h"
 #include "HX711.h"
 #include "ISNAILVC10.h"
+#include "SamplingScheduler.h"
+#include "Seqlock.h"
+#include "SPSCRingBuffer.h"
+#include "TelemetryChannel.h"
+#include "TelemetryExport.h"
+#include "TelemetryRecord.h"
+#include "TelemetrySnapshot.h"
 
 namespace tids {
 
 class TelemetrySystem {
+public:
+    // Channel sampler, must not block for longer than the channel deadline
+    typedef std::function<float()> Sampler;
+
+    // Called on the sampling thread as soon as an anomaly is detected, must not block
+    typedef TelemetryChannel::AnomalyHandler AnomalyHandler;
+
 private:
     ISNAILVC10 *currentSensor;
     HX711 *weightOnBitSensor;
 
-    float current;
-    float weightOnBit;
+    // Latest value and history of every channel
+    TelemetryChannel *channels[TelemetryRecord::CHANNEL::CHANNEL_COUNT];
+
+    // Single acquisition thread for all periodic channels
+    SamplingScheduler *scheduler;
+
+    // Application handler for anomaly events
+    AnomalyHandler anomalyHandler;
 
-    std::ofstream datalog;
+    // Whole-system snapshot published by the scheduler thread after every sampling pass
+    Seqlock<TelemetrySnapshot> snapshot;
+    uint64_t snapshotIndex;
+
+    // Shared-memory export of snapshots for out-of-process monitors
+    TelemetryExport *telemetryExport;
+
+    // Bandwidth-limited telemetry stream to the ground station
+    Downlink *downlink;
+
+    // Asynchronous datalog persistence with one ring buffer per sampling thread
+    DatalogWriter *datalogWriter;
+    SPSCRingBuffer<TelemetryRecord> *schedulerProducer;
+    // Anomaly events raised on the scheduler thread, printed by the datalog writer
+    SPSCRingBuffer<AnomalyEvent> *schedulerAnomalyProducer;
 
-    std::thread telemetryThread;
     std::atomic<bool> telemetryThreadShouldCancel;
 
 public:
@@ -51,15 +86,51 @@ public:
     // Stop updating telemetry
     int stop();
 
+    // Register a periodic channel sampled on the scheduler thread (returns task id, or -1 on error)
+    int registerChannel(TelemetryRecord::CHANNEL channel, int64_t periodNS, int64_t deadlineNS, Sampler sampler);
+
+    // Get channel latest value and history
+    TelemetryChannel *getChannel(TelemetryRecord::CHANNEL channel);
+
+    // Get scheduler that runs periodic channels and control tasks
+    SamplingScheduler *getScheduler();
+
+    // Get latest time-coherent snapshot of every channel (returns -1 if none has been published)
+    int getSnapshot(TelemetrySnapshot *snapshot);
+
     // Get current in amps
     float getCurrent();
 
     // Get weight on bit in kg
     float getWeightOnBit();
 
+    // Get latest weight on bit sample in kg (returns -1 if none has been acquired)
+    int getWeightOnBitSample(Sample *sample);
+
+    // If the latest weight on bit sample is missing or older than maxAgeMS milliseconds
+    bool isWeightOnBitStale(int maxAgeMS);
+
+    // Get number of datalog records dropped because the writer fell behind
+    uint64_t getDatalogOverflowCount();
+
+    // Get downlink to the ground station
+    Downlink *getDownlink();
+
+    // Set handler for anomaly events on any channel (only before start)
+    int setAnomalyHandler(AnomalyHandler anomalyHandler);
+
 private:
-    // Update telemetry values
-    void updateTelemetry();
+    // Queue an anomaly event for the console and pass it to the application handler (sampling thread, never blocks)
+    void raiseAnomaly(const AnomalyEvent &event);
+
+    // Publish a snapshot of the latest value of every channel (scheduler thread only)
+    void publishSnapshot();
+
+    // Move weight on bit samples acquired since the last pass into the channel and datalog (scheduler thread only)
+    void drainWeightOnBit();
+
+    // Queue a record for the datalog writer without blocking
+    void logRecord(SPSCRingBuffer<TelemetryRecord> *producer, int64_t timeNS, TelemetryRecord::CHANNEL channel, float value);
 };
 
 } /* namespace tids */
@@ -0,0 +1,252 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "TorqueEstimator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// Speed below which power over speed has no weight in the observer, and above which it has full weight, in rad/s
+#define TORQUEESTIMATOR_POWER_SPEED_MIN_RAD_S 5.0f
+#define TORQUEESTIMATOR_POWER_SPEED_FULL_RAD_S 20.0f
+
+// Time constant of the bias correction at full weight, in seconds
+#define TORQUEESTIMATOR_BIAS_TIME_CONSTANT_S 2.0f
+
+// Largest bias correction, so a bad speed estimate cannot drag the model far, in Nm
+#define TORQUEESTIMATOR_BIAS_MAX_NM 2.0f
+
+// Fewest operating points for a fit
+#define TORQUEESTIMATOR_FIT_MIN_POINTS 3
+
+namespace tids {
+
+static const float RPM_TO_RAD_S = 3.14159265358979323846f / 30.0f;
+
+TorqueEstimator::TorqueEstimator(MotorModel model, float supplyVoltageV) {
+    this->supplyVoltageV = supplyVoltageV;
+    if (this->setModel(model) < 0) {
+        std::cout << "TorqueEstimator: Error invalid motor model" << std::endl;
+    }
+    this->reset();
+}
+
+TorqueEstimator::~TorqueEstimator() {}
+
+// Replace model from any thread (returns -1 if a constant is not physical), restarting the observer
+int TorqueEstimator::setModel(MotorModel model) {
+    if (!(model.resistanceOhm >= 0.0f) || !(model.backEMFConstant > 0.0f) ||
+        !(model.noLoadCurrentA >= 0.0f) || !(model.viscousCurrentAPerRadS >= 0.0f)) {
+        return -1;
+    }
+    std::lock_guard<std::mutex> lock(this->modelMutex);
+    this->model.write(model);
+    this->biasNM = 0.0f;
+    return 0;
+}
+
+// Get current model
+MotorModel TorqueEstimator::getModel() {
+    MotorModel model;
+    this->model.read(&model);
+    return model;
+}
+
+// Replace model from a file of "name value" lines (returns -1 on error)
+int TorqueEstimator::loadModel(std::string path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cout << "TorqueEstimator: Error opening model file " << path << std::endl;
+        return -1;
+    }
+
+    MotorModel model = this->getModel();
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+
+        // Skip blank lines and comments
+        line = line.substr(0, line.find('#'));
+        std::istringstream stream(line);
+        std::string name;
+        if (!(stream >> name)) {
+            continue;
+        }
+
+        float value;
+        if (!(stream >> value)) {
+            std::cout << "TorqueEstimator: Error reading value on line " << lineNumber << " of " << path << std::endl;
+            return -1;
+        }
+
+        if (name == "resistance_ohm") {
+            model.resistanceOhm = value;
+        } else if (name == "back_emf_constant") {
+            model.backEMFConstant = value;
+        } else if (name == "no_load_current_a") {
+            model.noLoadCurrentA = value;
+        } else if (name == "viscous_current_a_per_rad_s") {
+            model.viscousCurrentAPerRadS = value;
+        } else {
+            std::cout << "TorqueEstimator: Error unknown constant " << name << " on line " << lineNumber << " of " << path << std::endl;
+            return -1;
+        }
+    }
+
+    if (this->setModel(model) < 0) {
+        std::cout << "TorqueEstimator: Error invalid motor model in " << path << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+// Write model to a file of "name value" lines (returns -1 on error)
+int TorqueEstimator::saveModel(std::string path) {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        std::cout << "TorqueEstimator: Error opening model file " << path << std::endl;
+        return -1;
+    }
+
+    MotorModel model = this->getModel();
+    file << "resistance_ohm " << model.resistanceOhm << std::endl;
+    file << "back_emf_constant " << model.backEMFConstant << std::endl;
+    file << "no_load_current_a " << model.noLoadCurrentA << std::endl;
+    file << "viscous_current_a_per_rad_s " << model.viscousCurrentAPerRadS << std::endl;
+    return file.good() ? 0 : -1;
+}
+
+// Fit a model to unloaded operating points at three or more speeds (returns -1 if they do not determine one)
+int TorqueEstimator::fitModel(const std::vector<MotorCalibrationPoint> &points, MotorModel *model) {
+    if (points.size() < TORQUEESTIMATOR_FIT_MIN_POINTS) {
+        return -1;
+    }
+
+    // Least squares for V = R·I + Ke·ω (normal equations of the two-column system)
+    double ii = 0.0, iw = 0.0, ww = 0.0, vi = 0.0, vw = 0.0;
+    // Least squares for I = I₀ + B·ω
+    double sumW = 0.0, sumI = 0.0;
+    for (const MotorCalibrationPoint &point : points) {
+        double current = std::fabs(point.currentA);
+        double speed = std::fabs(point.speedRadS);
+        ii += current * current;
+        iw += current * speed;
+        ww += speed * speed;
+        vi += point.voltageV * current;
+        vw += point.voltageV * speed;
+        sumW += speed;
+        sumI += current;
+    }
+    double n = static_cast<double>(points.size());
+
+    double determinant = ii * ww - iw * iw;
+    double speedVariance = ww - sumW * sumW / n;
+    if (std::fabs(determinant) < 1e-9 * ii * ww || speedVariance <= 0.0) {
+        return -1;
+    }
+    double resistance = (vi * ww - vw * iw) / determinant;
+    double backEMFConstant = (ii * vw - iw * vi) / determinant;
+
+    double viscous = (iw - sumW * sumI / n) / speedVariance;
+    double noLoad = (sumI - viscous * sumW) / n;
+
+    // A small negative intercept or slope is noise; a negative motor constant means the points are not steady-state
+    if (backEMFConstant <= 0.0 || resistance < 0.0) {
+        return -1;
+    }
+    model->resistanceOhm = static_cast<float>(resistance);
+    model->backEMFConstant = static_cast<float>(backEMFConstant);
+    model->noLoadCurrentA = static_cast<float>(std::max(noLoad, 0.0));
+    model->viscousCurrentAPerRadS = static_cast<float>(std::max(viscous, 0.0));
+    return 0;
+}
+
+// Estimate load torque in Nm from current and speed with the model and bias, from any thread (cheap enough for every control update)
+float TorqueEstimator::estimate(float currentA, float speedRPM) {
+    MotorModel model;
+    this->model.read(&model);
+    float speedRadS = std::fabs(speedRPM) * RPM_TO_RAD_S;
+
+    // Torque constant times the current beyond what the unloaded motor draws at this speed
+    float noLoadCurrentA = model.noLoadCurrentA + model.viscousCurrentAPerRadS * speedRadS;
+    return model.backEMFConstant * (std::fabs(currentA) - noLoadCurrentA) + this->biasNM;
+}
+
+// Update the observer from a current, speed, speed quality (0 to 1) and duty cycle measured together, dtS seconds after the previous update (single updating thread only)
+float TorqueEstimator::update(float currentA, float speedRPM, float speedQuality, float dutyPercent, float dtS) {
+    MotorModel model;
+    this->model.read(&model);
+    float current = std::fabs(currentA);
+    float speedRadS = std::fabs(speedRPM) * RPM_TO_RAD_S;
+
+    // Weight of power over speed grows with speed and with confidence in the speed
+    float weight = (speedRadS - TORQUEESTIMATOR_POWER_SPEED_MIN_RAD_S) / (TORQUEESTIMATOR_POWER_SPEED_FULL_RAD_S - TORQUEESTIMATOR_POWER_SPEED_MIN_RAD_S);
+    weight = std::min(std::max(weight, 0.0f), 1.0f) * std::min(std::max(speedQuality, 0.0f), 1.0f);
+
+    float powerTorqueNM = 0.0f;
+    if (weight > 0.0f) {
+        // Mechanical power (electrical power less copper loss) over speed, less the unloaded motor torque
+        float voltageV = this->supplyVoltageV * dutyPercent / 100.0f;
+        float mechanicalPowerW = voltageV * current - model.resistanceOhm * current * current;
+        float noLoadCurrentA = model.noLoadCurrentA + model.viscousCurrentAPerRadS * speedRadS;
+        powerTorqueNM = mechanicalPowerW / speedRadS - model.backEMFConstant * noLoadCurrentA;
+
+        // Move the bias toward the difference between the methods, faster the more power over speed is trusted
+        float modelTorqueNM = model.backEMFConstant * (current - noLoadCurrentA);
+        float gain = std::min(weight * dtS / TORQUEESTIMATOR_BIAS_TIME_CONSTANT_S, 1.0f);
+        float bias = this->biasNM + gain * (powerTorqueNM - modelTorqueNM - this->biasNM);
+        this->biasNM = std::min(std::max(bias, -TORQUEESTIMATOR_BIAS_MAX_NM), TORQUEESTIMATOR_BIAS_MAX_NM);
+    }
+    this->powerTorqueNM = powerTorqueNM;
+    this->powerWeight = weight;
+
+    this->torqueNM = this->estimate(currentA, speedRPM);
+    return this->torqueNM;
+}
+
+// Get latest observer torque in Nm
+float TorqueEstimator::getTorque() {
+    return this->torqueNM;
+}
+
+// Get model bias correction in Nm
+float TorqueEstimator::getBias() {
+    return this->biasNM;
+}
+
+// Get latest torque from mechanical power over speed in Nm, and the weight it had in the observer (0 to 1)
+float TorqueEstimator::getPowerTorque(float *weight) {
+    if (weight != nullptr) {
+        *weight = this->powerWeight;
+    }
+    return this->powerTorqueNM;
+}
+
+// Clear the bias correction
+void TorqueEstimator::reset() {
+    this->biasNM = 0.0f;
+    this->torqueNM = 0.0f;
+    this->powerTorqueNM = 0.0f;
+    this->powerWeight = 0.0f;
+}
+
+} /* namespace tids */
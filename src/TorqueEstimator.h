@@ -0,0 +1,113 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TORQUEESTIMATOR_H
+#define TORQUEESTIMATOR_H
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Seqlock.h"
+
+namespace tids {
+
+// Brushed DC motor constants: applied voltage = resistance * current + backEMFConstant * speed
+struct MotorModel {
+    // Armature resistance in ohms
+    float resistanceOhm;
+    // Back-EMF constant in V·s/rad, equal to the torque constant in Nm/A
+    float backEMFConstant;
+    // Current drawn with no load, from friction independent of speed (A) and proportional to speed (A·s/rad)
+    float noLoadCurrentA;
+    float viscousCurrentAPerRadS;
+};
+
+// Steady-state operating point of the unloaded motor, for fitting a model
+struct MotorCalibrationPoint {
+    // Average applied voltage in volts
+    float voltageV;
+    // Average current in amps
+    float currentA;
+    // Average speed in rad/s
+    float speedRadS;
+};
+
+// Drill load torque from a DC motor model, Kt·(I − I₀), which stays finite and smooth at and near zero speed
+// An observer compares it with mechanical power over speed whenever speed is well resolved, and tracks the
+// difference as a slowly varying bias (e.g. resistance and magnet drift with temperature), so both methods
+// agree at speed while only the model is used at low speed and stall
+class TorqueEstimator {
+private:
+    // Model published to every estimating thread (writers are serialized by modelMutex)
+    Seqlock<MotorModel> model;
+    std::mutex modelMutex;
+
+    // Supply voltage, applied to the motor at the PWM duty cycle
+    float supplyVoltageV;
+
+    // Model bias correction in Nm, adapted by the observer
+    std::atomic<float> biasNM;
+
+    // Latest observer torque, and the power-based torque and its weight it was updated with
+    std::atomic<float> torqueNM;
+    std::atomic<float> powerTorqueNM;
+    std::atomic<float> powerWeight;
+
+public:
+    TorqueEstimator(MotorModel model, float supplyVoltageV);
+    virtual ~TorqueEstimator();
+
+    // Replace model from any thread (returns -1 if a constant is not physical), restarting the observer
+    int setModel(MotorModel model);
+
+    // Get current model
+    MotorModel getModel();
+
+    // Replace model from a file of "name value" lines (returns -1 on error)
+    int loadModel(std::string path);
+
+    // Write model to a file of "name value" lines (returns -1 on error)
+    int saveModel(std::string path);
+
+    // Fit a model to unloaded operating points at three or more speeds (returns -1 if they do not determine one)
+    static int fitModel(const std::vector<MotorCalibrationPoint> &points, MotorModel *model);
+
+    // Estimate load torque in Nm from current and speed with the model and bias, from any thread (cheap enough for every control update)
+    float estimate(float currentA, float speedRPM);
+
+    // Update the observer from a current, speed, speed quality (0 to 1) and duty cycle measured together, dtS seconds after the previous update (single updating thread only)
+    float update(float currentA, float speedRPM, float speedQuality, float dutyPercent, float dtS);
+
+    // Get latest observer torque in Nm
+    float getTorque();
+
+    // Get model bias correction in Nm
+    float getBias();
+
+    // Get latest torque from mechanical power over speed in Nm, and the weight it had in the observer (0 to 1)
+    float getPowerTorque(float *weight);
+
+    // Clear the bias correction
+    void reset();
+};
+
+} /* namespace tids */
+
+#endif /* TORQUEESTIMATOR_H */
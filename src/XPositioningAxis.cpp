@@ -18,35 +18,78 @@
 
 #include "XPositioningAxis.h"
 
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+#include "Clock.h"
+
 namespace tids {
 
-// Default leadscrew speed in mm/s
-#define SPEED_DEFAULT 10.0f
+// Default leadscrew cruise speed in mm/s
+#define SPEED_DEFAULT 40.0f
+
+// Default leadscrew acceleration in mm/s^2
+#define ACCELERATION_DEFAULT 200.0f
+
+// Default leadscrew jerk in mm/s^3 (S-curve profile)
+#define JERK_DEFAULT 4000.0f
+
+// Leadscrew speed in the sensor buffer in mm/s
+#define SENSOR_BUFFER_SPEED 10.0f
 
 // Sensor buffer area extending from the home location
 #define SENSOR_BUFFER_MM 30.0f
 
-// Distance to move by between home sensor checks in buffer
-#define SENSOR_BUFFER_MOVE_MM 3.0f
-
 // Additional distance to move after home sensor is triggered
 #define SENSOR_POSITION_OVERRIDE_MM 0.0f
 
-XPositioningAxis::XPositioningAxis(float lengthMM, float pitchMM, CVD524K *motor, LJ12A34ZBY *homeSensor) {
+// Travel allowed after homing before homing again, and largest drift at the home sensor, in mm
+#define POSITION_DISTANCE_BUDGET_MM 20000.0f
+#define POSITION_DRIFT_TOLERANCE_MM 0.5f
+
+// Sensor buffer while the position is trusted (cruise to just before the edge, then approach it slowly)
+#define SENSOR_BUFFER_TRUSTED_MM 2.0f
+
+// Homing: continuous approach, slow back-off past the sensor hysteresis, and slow precise re-approach (mm/s and mm)
+#define HOMING_APPROACH_SPEED 10.0f
+#define HOMING_BACK_OFF_SPEED 2.0f
+#define HOMING_BACK_OFF_MM 1.0f
+#define HOMING_PRECISE_SPEED 0.5f
+
+// Homing: travel past the expected edge before giving up, and longest move to clear the sensor, in mm
+#define HOMING_OVERTRAVEL_MM 5.0f
+#define HOMING_CLEAR_MAX_MM 10.0f
+
+XPositioningAxis::XPositioningAxis(float lengthMM, float pitchMM, CVD524K *motor, LJ12A34ZBY *homeSensor, GPIOMemoryMap *gpioMemoryMap) {
     // Mark position as uncalibrated
     this->positionMM = lengthMM + 1;
     // Set length
     this->lengthMM = lengthMM;
-    // Initialize stepped leadscrew
-    this->leadscrew = new SteppedLeadscrew(motor, pitchMM);
+    // Initialize stepped leadscrew with step pulses timed from a motion profile
+    this->pulseGenerator = new StepPulseGenerator(motor->getPulsePin(), gpioMemoryMap);
+    this->leadscrew = new SteppedLeadscrew(motor, pitchMM, motor->getStepsPerRevolution(), this->pulseGenerator);
+    this->motor = motor;
+    // Position is untrusted until homed
+    this->positionConfidence = new PositionConfidence(POSITION_DISTANCE_BUDGET_MM, POSITION_DRIFT_TOLERANCE_MM, motor->getTimingPeriodSteps());
     // Set proximity sensor
     this->homeSensor = homeSensor;
-    // Set speed on leadscrew
+    // No homing yet
+    this->homingResult = HomingResult();
+    this->homingResult.homeOffsetMM = std::numeric_limits<float>::quiet_NaN();
+    this->offsetSumMM = 0.0;
+    this->offsetSquaredSumMM = 0.0;
+    // Set speed and profile on leadscrew
     this->setSpeed(SPEED_DEFAULT);
+    this->setAcceleration(ACCELERATION_DEFAULT);
+    this->setJerk(JERK_DEFAULT);
 }
 
 XPositioningAxis::~XPositioningAxis() {
+    this->motionWorker.cancel();
     delete this->leadscrew;
+    delete this->pulseGenerator;
+    delete this->positionConfidence;
 }
 
 // Get current position in millimeters
@@ -64,14 +107,84 @@ int XPositioningAxis::setSpeed(float millimetersPerSecond) {
     return this->leadscrew->setSpeed(millimetersPerSecond);
 }
 
+// Set acceleration in millimeters per second squared (0 for constant speed moves)
+int XPositioningAxis::setAcceleration(float millimetersPerSecondSquared) {
+    return this->leadscrew->setAcceleration(millimetersPerSecondSquared);
+}
+
+// Set jerk in millimeters per second cubed (0 for trapezoidal profiles, S-curves otherwise)
+int XPositioningAxis::setJerk(float millimetersPerSecondCubed) {
+    return this->leadscrew->setJerk(millimetersPerSecondCubed);
+}
+
 // Move to position at positionMM millimeters
 int XPositioningAxis::moveTo(float positionMM) {
-    float homeBufferPositionMM = SENSOR_BUFFER_MM;
+    return this->moveTo(positionMM, nullptr);
+}
+
+// Move to home position (position 0) based on this->homeSensor, approaching its edge continuously,
+// then backing off and approaching again slowly for precision
+int XPositioningAxis::moveToHome() {
+    return this->moveToHome(nullptr);
+}
+
+// Get result of the latest homing (returns -1 if none has completed)
+int XPositioningAxis::getHomingResult(HomingResult *result) {
+    if (this->homingResult.durationNS == 0) {
+        return -1;
+    }
+    *result = this->homingResult;
+    return 0;
+}
+
+// If the position is no longer trusted (never homed, driver alarm or timing mismatch, drift at the home sensor,
+// or distance budget used) and the axis must home before moving to a target
+bool XPositioningAxis::isHomingRequired() {
+    return this->positionConfidence->isHomingRequired();
+}
+
+// Get position confidence, to configure the distance budget and drift tolerance
+PositionConfidence *XPositioningAxis::getPositionConfidence() {
+    return this->positionConfidence;
+}
+
+// Move by positionMM millimeters
+int XPositioningAxis::moveBy(float positionMM) {
+    return this->moveTo(this->getPosition() + positionMM);
+}
+
+// Start moving to position at positionMM millimeters in the background
+MotionHandle XPositioningAxis::moveToAsync(float positionMM) {
+    SteppedLeadscrew *leadscrew = this->leadscrew;
+    return this->motionWorker.start([this, positionMM](const std::atomic<bool> *cancelled) { return this->moveTo(positionMM, cancelled); },
+                                    [leadscrew]() { leadscrew->stop(); });
+}
+
+// Start moving to home position in the background
+MotionHandle XPositioningAxis::moveToHomeAsync() {
+    SteppedLeadscrew *leadscrew = this->leadscrew;
+    return this->motionWorker.start([this](const std::atomic<bool> *cancelled) { return this->moveToHome(cancelled); },
+                                    [leadscrew]() { leadscrew->stop(); });
+}
+
+// If this->homeSensor is active
+bool XPositioningAxis::isAtHome() {
+    return this->homeSensor->isTriggered();
+}
+
+// Move to position at positionMM millimeters, stopping early once *cancelled is set (if not null)
+int XPositioningAxis::moveTo(float positionMM, const std::atomic<bool> *cancelled) {
+    // A trusted position can cruise to just before the home sensor
+    bool trusted = !this->positionConfidence->isHomingRequired();
+    float homeBufferPositionMM = trusted ? SENSOR_BUFFER_TRUSTED_MM : SENSOR_BUFFER_MM;
 
     // Speed must be nonzero to move
     if (this->getSpeed() <= 0.0f) {
         return -1;
     }
+    int64_t startStepPosition = this->leadscrew->getStepPosition();
+    // Checked at every step, so a cancellation that lands between moves still stops the next one
+    auto isCancelled = [cancelled]() { return cancelled != nullptr && *cancelled; };
 
     // Target position is smaller and in home sensor buffer zone
     if (positionMM < this->positionMM && positionMM < homeBufferPositionMM) {
@@ -83,53 +196,186 @@ int XPositioningAxis::moveTo(float positionMM) {
         // Move to home sensor buffer start if necessary
         if (this->positionMM > homeBufferPositionMM) {
             // Move to the buffer position
-            this->leadscrew->move(homeBufferPositionMM - this->positionMM);
+            float movedMM = this->leadscrew->move(homeBufferPositionMM - this->positionMM, isCancelled);
             // Update current position
-            this->positionMM = homeBufferPositionMM;
+            this->positionMM = this->positionMM + movedMM;
         }
 
-        // Slowly move until the position is reached or sensor is activated
-        while (this->positionMM > positionMM) {
-            if (this->isAtHome()) {
-                // Move a little extra to compensate for sensor imperfection
-                this->leadscrew->move(-SENSOR_POSITION_OVERRIDE_MM);
-                // Reset current position
-                this->positionMM = 0.0f;
-                return 0;
-            } else {
-                // Move by a small amount and check again
-                this->leadscrew->move(-SENSOR_BUFFER_MOVE_MM);
-                // Update current position
-                this->positionMM -= SENSOR_BUFFER_MOVE_MM;
+        if (isCancelled()) {
+            this->trackMotion(startStepPosition);
+            return -1;
+        }
+
+        // Moving to home with a trusted position, look for the edge a little past it to check for drift
+        float approachPositionMM = positionMM;
+        bool checkDrift = trusted && positionMM <= 0.0f;
+        if (checkDrift) {
+            approachPositionMM = -2.0f * POSITION_DRIFT_TOLERANCE_MM;
+        }
+
+        // Slowly move until the position is reached or the sensor is activated (checked at every step)
+        LJ12A34ZBY *homeSensor = this->homeSensor;
+        float movedMM = this->leadscrew->moveUntil(approachPositionMM - this->positionMM, SENSOR_BUFFER_SPEED,
+                                                   [homeSensor, isCancelled]() { return isCancelled() || homeSensor->isTriggered(); });
+        this->positionMM = this->positionMM + movedMM;
+        if (this->isAtHome()) {
+            // The edge is position 0, so the dead-reckoned position there is the drift
+            if (trusted) {
+                this->positionConfidence->checkDrift(this->positionMM);
             }
+            // Move a little extra to compensate for sensor imperfection
+            this->leadscrew->move(-SENSOR_POSITION_OVERRIDE_MM);
+            // Reset current position
+            this->positionMM = 0.0f;
+        } else if (isCancelled()) {
+            this->trackMotion(startStepPosition);
+            return -1;
+        } else if (checkDrift) {
+            // No edge within twice the tolerance
+            this->positionConfidence->checkDrift(this->positionMM);
         }
+        this->trackMotion(startStepPosition);
     }
 
     // Target position does not enter sensor buffer zone
     else {
         // Move to target position
-        this->leadscrew->move(positionMM - this->positionMM);
+        float movedMM = this->leadscrew->move(positionMM - this->positionMM, isCancelled);
         // Update current position
-        this->positionMM = positionMM;
-        return 0;
+        this->positionMM = this->positionMM + movedMM;
+        this->trackMotion(startStepPosition);
+        return isCancelled() ? -1 : 0;
     }
 
     return 0;
 }
 
-// Move to home position (position 0) based on this->homeSensor
-int XPositioningAxis::moveToHome() {
-    return this->moveTo(0.0f);
+// Move to home position on the home sensor edge, stopping early once *cancelled is set (if not null)
+int XPositioningAxis::moveToHome(const std::atomic<bool> *cancelled) {
+    int64_t startNS = Clock::monotonicNS();
+    bool calibrated = (this->positionMM <= this->lengthMM);
+    LJ12A34ZBY *homeSensor = this->homeSensor;
+    // Cancellation is checked at every step alongside the sensor, so it cannot be lost between moves
+    auto isCancelled = [cancelled]() { return cancelled != nullptr && *cancelled; };
+    auto isTriggeredOrCancelled = [homeSensor, isCancelled]() { return isCancelled() || homeSensor->isTriggered(); };
+
+    // Already on the sensor: move off it so its edge can be approached
+    if (this->isAtHome()) {
+        float movedMM = this->backOffHome(HOMING_BACK_OFF_MM, cancelled);
+        if (std::isnan(movedMM)) {
+            if (!isCancelled()) {
+                std::cout << "XPositioningAxis: Error homing, home sensor does not clear" << std::endl;
+            }
+            return -1;
+        }
+        this->positionMM = this->positionMM + movedMM;
+    }
+
+    // Travel at cruise speed to the sensor buffer if the position is known to be beyond it
+    float homeBufferPositionMM = SENSOR_BUFFER_MM;
+    if (calibrated && this->positionMM > homeBufferPositionMM) {
+        float movedMM = this->leadscrew->move(homeBufferPositionMM - this->positionMM, isCancelled);
+        this->positionMM = this->positionMM + movedMM;
+    }
+    if (isCancelled()) {
+        return -1;
+    }
+
+    // Approach continuously until the sensor edge (anywhere on the axis if the position is unknown)
+    float seekMM = (calibrated ? this->positionMM.load() : this->lengthMM) + HOMING_OVERTRAVEL_MM;
+    float movedMM = this->leadscrew->moveUntil(-seekMM, HOMING_APPROACH_SPEED, isTriggeredOrCancelled);
+    this->positionMM = this->positionMM + movedMM;
+    if (!this->isAtHome()) {
+        if (!isCancelled()) {
+            std::cout << "XPositioningAxis: Error homing, no home sensor edge within " << seekMM << " mm" << std::endl;
+        }
+        return -1;
+    }
+    float approachEdgeMM = this->positionMM;
+
+    // Back off slowly past the sensor hysteresis
+    movedMM = this->backOffHome(HOMING_BACK_OFF_MM, cancelled);
+    if (std::isnan(movedMM)) {
+        if (!isCancelled()) {
+            std::cout << "XPositioningAxis: Error homing, home sensor does not clear" << std::endl;
+        }
+        return -1;
+    }
+    this->positionMM = this->positionMM + movedMM;
+    if (isCancelled()) {
+        return -1;
+    }
+
+    // Approach again slowly, stopping within one step of the edge
+    seekMM = movedMM + HOMING_OVERTRAVEL_MM;
+    movedMM = this->leadscrew->moveUntil(-seekMM, HOMING_PRECISE_SPEED, isTriggeredOrCancelled);
+    this->positionMM = this->positionMM + movedMM;
+    if (!this->isAtHome()) {
+        if (!isCancelled()) {
+            std::cout << "XPositioningAxis: Error homing, no home sensor edge on precise approach" << std::endl;
+        }
+        return -1;
+    }
+
+    // Report where the edge was found before resetting the position to it
+    HomingResult result = this->homingResult;
+    result.homeOffsetMM = calibrated ? this->positionMM.load() : std::numeric_limits<float>::quiet_NaN();
+    result.approachDifferenceMM = this->positionMM - approachEdgeMM;
+    if (calibrated) {
+        this->offsetSumMM += result.homeOffsetMM;
+        this->offsetSquaredSumMM += static_cast<double>(result.homeOffsetMM) * result.homeOffsetMM;
+        result.offsetCount++;
+        double mean = this->offsetSumMM / result.offsetCount;
+        double variance = this->offsetSquaredSumMM / result.offsetCount - mean * mean;
+        result.offsetMeanMM = static_cast<float>(mean);
+        result.offsetStandardDeviationMM = static_cast<float>(std::sqrt(variance > 0.0 ? variance : 0.0));
+    }
+    result.durationNS = Clock::monotonicNS() - startNS;
+    result.homed = true;
+    this->homingResult = result;
+    std::cout << "XPositioningAxis: Home offset " << result.homeOffsetMM << " mm (mean " << result.offsetMeanMM << " mm, standard deviation "
+              << result.offsetStandardDeviationMM << " mm over " << result.offsetCount << "), precise edge "
+              << result.approachDifferenceMM << " mm from approach edge, in " << result.durationNS / 1000000 << " ms" << std::endl;
+
+    // Move a little extra to compensate for sensor imperfection
+    this->leadscrew->move(-SENSOR_POSITION_OVERRIDE_MM);
+    // Reset current position and trust it
+    this->positionMM = 0.0f;
+    this->positionConfidence->markHomed();
+    this->checkDriver();
+    return 0;
 }
 
-// Move by positionMM millimeters
-int XPositioningAxis::moveBy(float positionMM) {
-    return this->moveTo(this->getPosition() + positionMM);
+// Move away from home until the sensor clears, then by backOffMM, stopping early once *cancelled is set (if not null)
+// (returns distance moved, or NaN if it never clears)
+float XPositioningAxis::backOffHome(float backOffMM, const std::atomic<bool> *cancelled) {
+    LJ12A34ZBY *homeSensor = this->homeSensor;
+    auto isCancelled = [cancelled]() { return cancelled != nullptr && *cancelled; };
+    float movedMM = this->leadscrew->moveUntil(HOMING_CLEAR_MAX_MM, HOMING_BACK_OFF_SPEED,
+                                               [homeSensor, isCancelled]() { return isCancelled() || !homeSensor->isTriggered(); });
+    if (this->isAtHome()) {
+        return std::numeric_limits<float>::quiet_NaN();
+    }
+    return movedMM + this->leadscrew->moveUntil(backOffMM, HOMING_BACK_OFF_SPEED, isCancelled);
 }
 
-// If this->homeSensor is active
-bool XPositioningAxis::isAtHome() {
-    return this->homeSensor->isTriggered();
+// Add travel since startStepPosition to the position confidence and check the driver outputs
+void XPositioningAxis::trackMotion(int64_t startStepPosition) {
+    int64_t steps = this->leadscrew->getStepPosition() - startStepPosition;
+    int stepsPerRevolution = this->motor->getStepsPerRevolution();
+    if (stepsPerRevolution > 0) {
+        this->positionConfidence->addTravel(static_cast<float>(steps) * this->leadscrew->getDistancePerRevolution() / stepsPerRevolution);
+    }
+    this->checkDriver();
+}
+
+// Check the driver alarm and timing outputs at rest
+void XPositioningAxis::checkDriver() {
+    if (this->motor->isAlarmActive()) {
+        std::cout << "XPositioningAxis: Error motor driver alarm" << std::endl;
+        this->positionConfidence->checkAlarm(true);
+    }
+    this->positionConfidence->checkTimingOutput(this->leadscrew->getStepPosition(), this->motor->isTimingOutputOn());
 }
 
 } /* namespace tids */
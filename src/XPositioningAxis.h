@@ -19,28 +19,66 @@
 #ifndef XPOSITIONINGAXIS_H
 #define XPOSITIONINGAXIS_H
 
+#include <atomic>
+#include <cstdint>
+
 #include "CVD524K.h"
+#include "GPIOMemoryMap.h"
 #include "LJ12A34ZBY.h"
+#include "MotionHandle.h"
+#include "PositionConfidence.h"
 #include "SteppedLeadscrew.h"
+#include "StepPulseGenerator.h"
 
 namespace tids {
 
+// Result of homing on the home sensor edge
+struct HomingResult {
+    // Dead-reckoned position at the precise home edge before it was reset to 0, in millimeters (NaN if uncalibrated)
+    float homeOffsetMM;
+    // Precise edge position minus the approach edge position, in millimeters
+    float approachDifferenceMM;
+    // Time from start to homed in nanoseconds
+    int64_t durationNS;
+    // Mean and standard deviation of homeOffsetMM over every homing from a calibrated position (repeatability)
+    uint32_t offsetCount;
+    float offsetMeanMM;
+    float offsetStandardDeviationMM;
+    // If both edges were found
+    bool homed;
+};
+
 class XPositioningAxis {
 private:
     // Length of the axis in millimeters
     float lengthMM;
 
     // Current position on the axis in millimeters
-    float positionMM;
+    std::atomic<float> positionMM;
 
     // Axis leadscrew with stepper motor
     SteppedLeadscrew *leadscrew;
+    CVD524K *motor;
+
+    // Whether the dead-reckoned position can be trusted without homing
+    PositionConfidence *positionConfidence;
+
+    // Step pulses for profiled moves
+    StepPulseGenerator *pulseGenerator;
 
     // Proximity sensor marking home location (position 0)
     LJ12A34ZBY *homeSensor;
 
+    // Background thread for asynchronous moves
+    MotionWorker motionWorker;
+
+    // Latest homing, and running sums of calibrated home offsets
+    HomingResult homingResult;
+    double offsetSumMM;
+    double offsetSquaredSumMM;
+
 public:
-    XPositioningAxis(float lengthMM, float pitchMM, CVD524K *motor, LJ12A34ZBY *homeSensor);
+    XPositioningAxis(float lengthMM, float pitchMM, CVD524K *motor, LJ12A34ZBY *homeSensor, GPIOMemoryMap *gpioMemoryMap=nullptr);
     virtual ~XPositioningAxis();
 
     // Get current position in millimeters
@@ -52,17 +90,57 @@ public:
     // Set speed in millimeters per second
     int setSpeed(float millimetersPerSecond);
 
+    // Set acceleration in millimeters per second squared (0 for constant speed moves)
+    int setAcceleration(float millimetersPerSecondSquared);
+
+    // Set jerk in millimeters per second cubed (0 for trapezoidal profiles, S-curves otherwise)
+    int setJerk(float millimetersPerSecondCubed);
+
     // Move to position at positionMM millimeters
     int moveTo(float positionMM);
 
-    // Move to home position (position 0) based on this->homeSensor
+    // Move to home position (position 0) based on this->homeSensor, approaching its edge continuously,
+    // then backing off and approaching again slowly for precision
     int moveToHome();
 
+    // Get result of the latest homing (returns -1 if none has completed)
+    int getHomingResult(HomingResult *result);
+
+    // If the position is no longer trusted (never homed, driver alarm or timing mismatch, drift at the home sensor,
+    // or distance budget used) and the axis must home before moving to a target
+    bool isHomingRequired();
+
+    // Get position confidence, to configure the distance budget and drift tolerance
+    PositionConfidence *getPositionConfidence();
+
     // Move by positionMM millimeters
     int moveBy(float positionMM);
 
+    // Start moving to position at positionMM millimeters in the background (blocking moves must not run meanwhile)
+    MotionHandle moveToAsync(float positionMM);
+
+    // Start moving to home position in the background (blocking moves must not run meanwhile)
+    MotionHandle moveToHomeAsync();
+
     // If this->homeSensor is active
     bool isAtHome();
+
+private:
+    // Move to position at positionMM millimeters, stopping early once *cancelled is set (if not null)
+    int moveTo(float positionMM, const std::atomic<bool> *cancelled);
+
+    // Move to home position on the home sensor edge, stopping early once *cancelled is set (if not null)
+    int moveToHome(const std::atomic<bool> *cancelled);
+
+    // Move away from home until the sensor clears, then by backOffMM, stopping early once *cancelled is set (if not null)
+    // (returns distance moved, or NaN if it never clears)
+    float backOffHome(float backOffMM, const std::atomic<bool> *cancelled);
+
+    // Add travel since startStepPosition to the position confidence and check the driver outputs
+    void trackMotion(int64_t startStepPosition);
+
+    // Check the driver alarm and timing outputs at rest
+    void checkDriver();
 };
 
 } /* namespace tids */
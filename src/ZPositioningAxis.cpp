@@ -37,9 +37,12 @@ ZPositioningAxis::ZPositioningAxis(float lengthMM, float pitchMM, L298N *motor,
     // Set proximity sensors
     this->homeSensor = homeSensor;
     this->endSensor = endSensor;
+    this->feedHeld = false;
 }
 
-ZPositioningAxis::~ZPositioningAxis() {}
+ZPositioningAxis::~ZPositioningAxis() {
+    this->motionWorker.cancel();
+}
 
 // Start moving to home position
 int ZPositioningAxis::startMovingToHome() {
@@ -49,6 +52,7 @@ int ZPositioningAxis::startMovingToHome() {
     }
 
     // Set motor direction to move to home
+    std::lock_guard<std::mutex> lock(this->motorMutex);
     this->motor->setDirection(MOTOR_ROTATION_DIRECTION_HOME);
 
     // Start moving
@@ -63,6 +67,12 @@ int ZPositioningAxis::startMovingToEnd() {
         return -1;
     }
 
+    // Return if feed is held after a retract (checked under the lock so a retract cannot be reversed)
+    std::lock_guard<std::mutex> lock(this->motorMutex);
+    if (this->feedHeld) {
+        return -1;
+    }
+
     // Set motor direction to move to end
     this->motor->setDirection(MOTOR_ROTATION_DIRECTION_END);
 
@@ -73,30 +83,67 @@ int ZPositioningAxis::startMovingToEnd() {
 
 // Stop moving
 int ZPositioningAxis::stop() {
+    std::lock_guard<std::mutex> lock(this->motorMutex);
     if (this->motor->isRunning()) {
         return this->motor->stop();
     }
     return -1;
 }
 
+// Stop feeding toward the end, leaving a retract running (safe from any thread)
+int ZPositioningAxis::holdFeed() {
+    // Checked under the lock, so a retract started by a stall trip is never stopped here
+    std::lock_guard<std::mutex> lock(this->motorMutex);
+    if (this->feedHeld) {
+        return 0;
+    }
+    if (this->motor->isRunning()) {
+        return this->motor->stop();
+    }
+    return -1;
+}
+
+// Stop and start moving toward home, holding feed toward the end until released (safe from any thread)
+int ZPositioningAxis::startRetracting() {
+    std::lock_guard<std::mutex> lock(this->motorMutex);
+    this->feedHeld = true;
+
+    // Reverse without a separate stop so the bit leaves the face as soon as possible
+    if (this->isAtHome()) {
+        return this->motor->isRunning() ? this->motor->stop() : 0;
+    }
+    this->motor->setDirection(MOTOR_ROTATION_DIRECTION_HOME);
+    return this->motor->start();
+}
+
+// Allow moving toward the end again after a retract
+void ZPositioningAxis::releaseFeed() {
+    this->feedHeld = false;
+}
+
+// If feed toward the end is held after a retract
+bool ZPositioningAxis::isFeedHeld() {
+    return this->feedHeld;
+}
+
 // Move to home position (position 0) based on this->homeSensor
 int ZPositioningAxis::moveToHome() {
-    this->startMovingToHome();
-    // Loop until home reached (check every 10 milliseconds)
-    while (!this->isAtHome()) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-    }
-    return this->stop();
+    return this->moveToHome(nullptr);
 }
 
 // Move to end position (position this->lengthMM) based on this->endSensor
 int ZPositioningAxis::moveToEnd() {
-    this->startMovingToEnd();
-    // Loop until end reached (check every 10 milliseconds)
-    while (!this->isAtEnd()) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-    }
-    return this->stop();
+    return this->moveToEnd(nullptr);
+}
+
+// Start moving to home position in the background
+MotionHandle ZPositioningAxis::moveToHomeAsync() {
+    return this->motionWorker.start([this](const std::atomic<bool> *cancelled) { return this->moveToHome(cancelled); });
+}
+
+// Start moving to end position in the background
+MotionHandle ZPositioningAxis::moveToEndAsync() {
+    return this->motionWorker.start([this](const std::atomic<bool> *cancelled) { return this->moveToEnd(cancelled); });
 }
 
 // If this->homeSensor is active
@@ -109,4 +156,34 @@ bool ZPositioningAxis::isAtEnd() {
     return this->endSensor->isTriggered();
 }
 
+// Move to home position, stopping early once *cancelled is set (if not null)
+int ZPositioningAxis::moveToHome(const std::atomic<bool> *cancelled) {
+    this->startMovingToHome();
+    // Loop until home reached (check every 10 milliseconds)
+    while (!this->isAtHome()) {
+        if (cancelled != nullptr && *cancelled) {
+            this->stop();
+            return -1;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    this->stop();
+    return 0;
+}
+
+// Move to end position, stopping early once *cancelled is set (if not null)
+int ZPositioningAxis::moveToEnd(const std::atomic<bool> *cancelled) {
+    this->startMovingToEnd();
+    // Loop until end reached (check every 10 milliseconds)
+    while (!this->isAtEnd()) {
+        if (cancelled != nullptr && *cancelled) {
+            this->stop();
+            return -1;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    this->stop();
+    return 0;
+}
+
 } /* namespace tids */
@@ -19,8 +19,12 @@
 #ifndef ZPOSITIONINGAXIS_H
 #define ZPOSITIONINGAXIS_H
 
+#include <atomic>
+#include <mutex>
+
 #include "L298N.h"
 #include "LJ12A34ZBY.h"
+#include "MotionHandle.h"
 
 namespace tids {
 
@@ -37,6 +41,15 @@ private:
 
     // Proximity sensor at end location (position this->lengthMM)
     LJ12A34ZBY *endSensor;
+
+    // Serializes motor commands from the caller and from a drill stall handler
+    std::mutex motorMutex;
+
+    // Moving toward the end is refused while held after a retract
+    std::atomic<bool> feedHeld;
+
+    // Background thread for asynchronous moves
+    MotionWorker motionWorker;
 public:
     ZPositioningAxis(float lengthMM, float pitchMM, L298N *motor, LJ12A34ZBY *homeSensor, LJ12A34ZBY *endSensor);
     virtual ~ZPositioningAxis();
@@ -50,17 +63,42 @@ public:
     // Stop moving
     int stop();
 
+    // Stop feeding toward the end, leaving a retract running (safe from any thread)
+    int holdFeed();
+
+    // Stop and start moving toward home, holding feed toward the end until released (safe from any thread)
+    int startRetracting();
+
+    // Allow moving toward the end again after a retract
+    void releaseFeed();
+
+    // If feed toward the end is held after a retract
+    bool isFeedHeld();
+
     // Move to home position (position 0) based on this->homeSensor
     int moveToHome();
 
     // Move to end position (position this->lengthMM) based on this->endSensor
     int moveToEnd();
 
+    // Start moving to home position in the background
+    MotionHandle moveToHomeAsync();
+
+    // Start moving to end position in the background
+    MotionHandle moveToEndAsync();
+
     // If this->homeSensor is active
     bool isAtHome();
 
     // If this->endSensor is active
     bool isAtEnd();
+
+private:
+    // Move to home position, stopping early once *cancelled is set (if not null)
+    int moveToHome(const std::atomic<bool> *cancelled);
+
+    // Move to end position, stopping early once *cancelled is set (if not null)
+    int moveToEnd(const std::atomic<bool> *cancelled);
 };
 
 } /* namespace tids */
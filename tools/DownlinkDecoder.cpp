@@ -0,0 +1,132 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// tids-downlink: receive downlink packets over UDP and reconstruct the channel streams
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+#include "DownlinkPacket.h"
+#include "TelemetryRecord.h"
+
+using namespace tids;
+
+// Largest datagram accepted
+#define RECEIVE_BUFFER_SIZE 65536
+
+static void printUsage() {
+    fprintf(stderr, "Usage: tids-downlink [-p port] [-c channel] [-n packet_count]\n"
+                    "  -p port          UDP port to receive on (default 5700)\n"
+                    "  -c channel       only print samples of the named channel\n"
+                    "  -n packet_count  exit after receiving this many packets\n");
+}
+
+int main(int argc, char *argv[]) {
+    int port = 5700;
+    int channelFilter = -1;
+    long packetLimit = -1;
+
+    int option;
+    while ((option = getopt(argc, argv, "p:c:n:h")) != -1) {
+        switch (option) {
+            case 'p':
+                port = atoi(optarg);
+                break;
+            case 'c':
+                for (int channel = 0; channel < TelemetryRecord::CHANNEL::CHANNEL_COUNT; channel++) {
+                    if (strcmp(optarg, telemetryChannelName(channel)) == 0) {
+                        channelFilter = channel;
+                    }
+                }
+                if (channelFilter < 0) {
+                    fprintf(stderr, "tids-downlink: unknown channel %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'n':
+                packetLimit = atol(optarg);
+                break;
+            default:
+                printUsage();
+                return 1;
+        }
+    }
+
+    int socketDescriptor = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in local = {};
+    local.sin_family = AF_INET;
+    local.sin_port = htons(static_cast<uint16_t>(port));
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (socketDescriptor < 0 || bind(socketDescriptor, reinterpret_cast<struct sockaddr *>(&local), sizeof(local)) < 0) {
+        fprintf(stderr, "tids-downlink: cannot receive on port %d\n", port);
+        return 1;
+    }
+
+    // Next expected sequence count per channel, to report lost packets
+    long expectedSequence[TelemetryRecord::CHANNEL::CHANNEL_COUNT];
+    for (int channel = 0; channel < TelemetryRecord::CHANNEL::CHANNEL_COUNT; channel++) {
+        expectedSequence[channel] = -1;
+    }
+
+    std::vector<uint8_t> buffer(RECEIVE_BUFFER_SIZE);
+    std::vector<Sample> samples;
+    printf("time_ns,channel,value,units\n");
+    for (long received = 0; packetLimit < 0 || received < packetLimit; received++) {
+        ssize_t length = recv(socketDescriptor, buffer.data(), buffer.size(), 0);
+        if (length < 0) {
+            perror("tids-downlink: recv");
+            return 1;
+        }
+
+        DownlinkPacketHeader header;
+        if (decodeDownlinkPacket(buffer.data(), static_cast<size_t>(length), &header, &samples) < 0) {
+            fprintf(stderr, "tids-downlink: malformed packet of %zd bytes\n", length);
+            continue;
+        }
+        int channel = header.apid - DOWNLINK_APID_BASE;
+        if (channel < 0 || channel >= TelemetryRecord::CHANNEL::CHANNEL_COUNT) {
+            fprintf(stderr, "tids-downlink: unknown APID 0x%03x\n", header.apid);
+            continue;
+        }
+
+        // Report gaps in the per-channel sequence count
+        if (expectedSequence[channel] >= 0 && header.sequenceCount != expectedSequence[channel]) {
+            long lost = (header.sequenceCount - expectedSequence[channel]) & DOWNLINK_SEQUENCE_COUNT_MAX;
+            fprintf(stderr, "tids-downlink: %ld %s packets lost\n", lost, telemetryChannelName(channel));
+        }
+        expectedSequence[channel] = (header.sequenceCount + 1) & DOWNLINK_SEQUENCE_COUNT_MAX;
+
+        if (channelFilter >= 0 && channel != channelFilter) {
+            continue;
+        }
+        for (const Sample &sample : samples) {
+            printf("%" PRId64 ",%s,%g,%s\n", sample.timeNS, telemetryChannelName(channel), sample.value, telemetryChannelUnits(channel));
+        }
+        fflush(stdout);
+    }
+
+    close(socketDescriptor);
+    return 0;
+}
@@ -0,0 +1,160 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// tids-gpiobench: compare GPIO toggle rates of memory-mapped registers and sysfs value files
+
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <string>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "GPIOMemoryMap.h"
+
+using namespace tids;
+
+// Size of a test register window file, with banks at 4 KiB intervals
+#define TEST_WINDOW_BANK_SIZE 0x1000
+
+// Sysfs toggles are this many times fewer than register toggles, since each costs a system call
+#define SYSFS_TOGGLE_DIVISOR 100
+
+static void printUsage() {
+    fprintf(stderr, "Usage: tids-gpiobench [-f path] [-w] [-g gpio] [-n toggles]\n"
+                    "  -f path     register window file (default /dev/mem)\n"
+                    "  -w          path is a plain test window with banks at 4 KiB intervals (created if missing)\n"
+                    "  -g gpio     GPIO number to toggle, must already be an exported output (required unless -w)\n"
+                    "  -n toggles  register toggles to time (default 1000000, sysfs runs 1/100 as many)\n");
+}
+
+static double elapsedSeconds(const struct timespec &start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+static void printRate(const char *name, long toggles, double seconds) {
+    printf("%-20s %10ld toggles in %8.3f s: %12.0f toggles/s, %8.3f us/toggle\n",
+           name, toggles, seconds, toggles / seconds, seconds * 1e6 / toggles);
+}
+
+int main(int argc, char *argv[]) {
+    std::string path = GPIO_MEMORY_MAP_PATH;
+    bool testWindow = false;
+    int gpio = -1;
+    long toggles = 1000000;
+
+    int option;
+    while ((option = getopt(argc, argv, "f:wg:n:h")) != -1) {
+        switch (option) {
+            case 'f':
+                path = optarg;
+                break;
+            case 'w':
+                testWindow = true;
+                break;
+            case 'g':
+                gpio = atoi(optarg);
+                break;
+            case 'n':
+                toggles = atol(optarg);
+                break;
+            default:
+                printUsage();
+                return 1;
+        }
+    }
+    if (toggles <= 0 || gpio >= GPIOMemoryMap::BANK_COUNT * GPIOMemoryMap::PINS_PER_BANK || (gpio < 0 && !testWindow)) {
+        printUsage();
+        return 1;
+    }
+    if (gpio < 0) {
+        gpio = 0;
+    }
+
+    // A test window is an ordinary file large enough for every bank
+    off_t testBankOffsets[GPIOMemoryMap::BANK_COUNT];
+    if (testWindow) {
+        for (int i = 0; i < GPIOMemoryMap::BANK_COUNT; i++) {
+            testBankOffsets[i] = static_cast<off_t>(i) * TEST_WINDOW_BANK_SIZE;
+        }
+        int fileDescriptor = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fileDescriptor < 0 || ftruncate(fileDescriptor, GPIOMemoryMap::BANK_COUNT * TEST_WINDOW_BANK_SIZE) < 0) {
+            fprintf(stderr, "tids-gpiobench: cannot create test window %s\n", path.c_str());
+            return 1;
+        }
+        close(fileDescriptor);
+    }
+
+    // Register toggles
+    GPIOMemoryMap gpioMemoryMap(path, testWindow ? testBankOffsets : nullptr);
+    if (gpioMemoryMap.open() < 0) {
+        return 1;
+    }
+    volatile uint32_t *setDataOut = gpioMemoryMap.getRegister(gpio, GPIOMemoryMap::REGISTER::SETDATAOUT);
+    volatile uint32_t *clearDataOut = gpioMemoryMap.getRegister(gpio, GPIOMemoryMap::REGISTER::CLEARDATAOUT);
+    volatile uint32_t *dataIn = gpioMemoryMap.getRegister(gpio, GPIOMemoryMap::REGISTER::DATAIN);
+    uint32_t mask = GPIOMemoryMap::getMask(gpio);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (long i = 0; i < toggles; i += 2) {
+        *setDataOut = mask;
+        *clearDataOut = mask;
+    }
+    printRate("register write", toggles, elapsedSeconds(start));
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (long i = 0; i < toggles; i++) {
+        (void) *dataIn;
+    }
+    printRate("register read", toggles, elapsedSeconds(start));
+    gpioMemoryMap.close();
+
+    if (testWindow) {
+        return 0;
+    }
+
+    // Sysfs toggles, opening the value file for every write as bbbkit::GPIO does, then keeping it open
+    std::string valuePath = "/sys/class/gpio/gpio" + std::to_string(gpio) + "/value";
+    long sysfsToggles = toggles / SYSFS_TOGGLE_DIVISOR > 0 ? toggles / SYSFS_TOGGLE_DIVISOR : 1;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (long i = 0; i < sysfsToggles; i++) {
+        int fileDescriptor = open(valuePath.c_str(), O_WRONLY);
+        if (fileDescriptor < 0 || write(fileDescriptor, (i & 1) ? "0" : "1", 1) != 1) {
+            fprintf(stderr, "tids-gpiobench: cannot write %s\n", valuePath.c_str());
+            return 1;
+        }
+        close(fileDescriptor);
+    }
+    printRate("sysfs open+write", sysfsToggles, elapsedSeconds(start));
+
+    int fileDescriptor = open(valuePath.c_str(), O_WRONLY);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (long i = 0; i < sysfsToggles; i++) {
+        if (fileDescriptor < 0 || pwrite(fileDescriptor, (i & 1) ? "0" : "1", 1, 0) != 1) {
+            fprintf(stderr, "tids-gpiobench: cannot write %s\n", valuePath.c_str());
+            return 1;
+        }
+    }
+    printRate("sysfs write", sysfsToggles, elapsedSeconds(start));
+    close(fileDescriptor);
+    return 0;
+}
@@ -0,0 +1,205 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// tids-logdump: inspect a binary datalog and export sample ranges as CSV
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+
+#include "BinaryDatalog.h"
+
+using namespace tids;
+
+static void printUsage() {
+    fprintf(stderr, "Usage: tids-logdump [-i] [-c channel] [-s start] [-e end] [-w] datalog.000000.tlog [datalog.000001.tlog ...]\n"
+                    "  -i          print header and channel summary instead of samples\n"
+                    "  -c channel  export only the named channel\n"
+                    "  -s start    export samples at or after start (UTC seconds since epoch)\n"
+                    "  -e end      export samples at or before end (UTC seconds since epoch)\n"
+                    "  -w          print UTC seconds since epoch instead of monotonic nanoseconds\n"
+                    "Segments are read in the order given; corrupt records are skipped to the next sync marker.\n");
+}
+
+// Print header and per-channel block, sample and time range summary
+static void printInfo(BinaryDatalogReader *reader) {
+    const BinaryDatalogHeader *header = reader->getHeader();
+    printf("version: %u\n", header->version);
+    printf("segment: %u\n", header->segmentIndex);
+    printf("channels: %u\n", header->channelCount);
+    printf("wall clock offset: %" PRId64 " ns\n", header->wallClockOffsetNS);
+
+    for (int index = 0; index < header->channelCount; index++) {
+        const BinaryDatalogChannel *channel = reader->getChannel(index);
+        uint64_t blockCount = 0;
+        uint64_t sampleCount = 0;
+        int64_t firstTimeNS = INT64_MAX;
+        int64_t lastTimeNS = INT64_MIN;
+
+        // Only block headers are touched, columns are never paged in
+        size_t offset = reader->getBlocksOffset();
+        BinaryDatalogReader::Block block;
+        while (reader->nextBlock(&offset, &block) == 0) {
+            if (block.header->channel != channel->id) {
+                continue;
+            }
+            blockCount++;
+            sampleCount += block.header->sampleCount;
+            if (block.header->firstTimeNS < firstTimeNS) {
+                firstTimeNS = block.header->firstTimeNS;
+            }
+            if (block.header->lastTimeNS > lastTimeNS) {
+                lastTimeNS = block.header->lastTimeNS;
+            }
+        }
+
+        printf("channel %u %s (%s): %" PRIu64 " blocks, %" PRIu64 " samples", channel->id, channel->name, channel->units, blockCount, sampleCount);
+        if (sampleCount > 0) {
+            printf(", %.3f s", static_cast<double>(lastTimeNS - firstTimeNS) / 1e9);
+        }
+        printf("\n");
+    }
+
+    // Checksums are not verified when only block headers are read
+    if (reader->getCorruptCount() > 0) {
+        printf("corrupt regions: %" PRIu64 "\n", reader->getCorruptCount());
+    }
+}
+
+// Print samples of a segment matching the channel and UTC time filters as CSV
+static void exportSamples(BinaryDatalogReader *reader, const std::string &channelName, bool hasStart, double startS,
+                          bool hasEnd, double endS, bool wallClock) {
+    // Resolve channel filter
+    int channelId = -1;
+    if (!channelName.empty()) {
+        int index = reader->findChannel(channelName);
+        if (index < 0) {
+            return;
+        }
+        channelId = reader->getChannel(index)->id;
+    }
+
+    size_t offset = reader->getBlocksOffset();
+    BinaryDatalogReader::Block block;
+    while (reader->nextBlock(&offset, &block) == 0) {
+        // Convert UTC range to monotonic time with the wall clock mapping recorded nearest the block
+        int64_t wallClockOffsetNS = reader->getWallClockOffsetNS();
+        int64_t startTimeNS = hasStart ? static_cast<int64_t>(startS * 1e9) - wallClockOffsetNS : INT64_MIN;
+        int64_t endTimeNS = hasEnd ? static_cast<int64_t>(endS * 1e9) - wallClockOffsetNS : INT64_MAX;
+
+        // Skip whole blocks outside the filter using the block header alone
+        if (channelId >= 0 && block.header->channel != channelId) {
+            continue;
+        }
+        if (block.header->lastTimeNS < startTimeNS || block.header->firstTimeNS > endTimeNS) {
+            continue;
+        }
+
+        const BinaryDatalogChannel *channel = reader->getChannel(block.header->channel);
+        const char *name = channel != nullptr ? channel->name : "unknown";
+        for (uint32_t i = 0; i < block.header->sampleCount; i++) {
+            int64_t timeNS = block.timeNS[i];
+            if (timeNS < startTimeNS || timeNS > endTimeNS) {
+                continue;
+            }
+            if (wallClock) {
+                printf("%.6f,%s,%g\n", static_cast<double>(timeNS + wallClockOffsetNS) / 1e9, name, block.value[i]);
+            } else {
+                printf("%" PRId64 ",%s,%g\n", timeNS, name, block.value[i]);
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    bool info = false;
+    bool wallClock = false;
+    std::string channelName;
+    bool hasStart = false;
+    bool hasEnd = false;
+    double startS = 0.0;
+    double endS = 0.0;
+
+    int option;
+    while ((option = getopt(argc, argv, "ic:s:e:wh")) != -1) {
+        switch (option) {
+            case 'i':
+                info = true;
+                break;
+            case 'c':
+                channelName = optarg;
+                break;
+            case 's':
+                hasStart = true;
+                startS = atof(optarg);
+                break;
+            case 'e':
+                hasEnd = true;
+                endS = atof(optarg);
+                break;
+            case 'w':
+                wallClock = true;
+                break;
+            default:
+                printUsage();
+                return 1;
+        }
+    }
+    if (optind >= argc) {
+        printUsage();
+        return 1;
+    }
+
+    if (!info) {
+        printf(wallClock ? "time_s,channel,value\n" : "time_ns,channel,value\n");
+    }
+
+    bool channelFound = channelName.empty();
+    for (int argument = optind; argument < argc; argument++) {
+        BinaryDatalogReader reader(argv[argument]);
+        if (reader.open() < 0) {
+            fprintf(stderr, "tids-logdump: %s is not a readable binary datalog\n", argv[argument]);
+            return 1;
+        }
+
+        if (info) {
+            if (argc - optind > 1) {
+                printf("%s\n", argv[argument]);
+            }
+            reader.setVerifyChecksums(false);
+            printInfo(&reader);
+            continue;
+        }
+
+        if (!channelName.empty() && reader.findChannel(channelName) >= 0) {
+            channelFound = true;
+        }
+        exportSamples(&reader, channelName, hasStart, startS, hasEnd, endS, wallClock);
+        if (reader.getCorruptCount() > 0) {
+            fprintf(stderr, "tids-logdump: skipped %" PRIu64 " corrupt regions in %s\n", reader.getCorruptCount(), argv[argument]);
+        }
+    }
+
+    if (!channelFound) {
+        fprintf(stderr, "tids-logdump: unknown channel %s\n", channelName.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,288 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// tids-speedbench: replay encoder edge streams through the drill speed estimators and compare them
+
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "SpeedEstimator.h"
+
+using namespace tids;
+
+// Drill encoder resolution and estimator settings (as in DrillingSystem)
+#define COUNTS_PER_REVOLUTION 1024
+#define SPEED_WINDOW_MIN_MS 10
+#define SPEED_WINDOW_MAX_MS 500
+#define SPEED_WINDOW_MIN_EDGES 16
+
+// Synthetic profile: ramp up, hold, ramp down, in seconds
+#define SYNTHETIC_RAMP_S 2.0
+#define SYNTHETIC_HOLD_S 4.0
+
+// Probability that a synthetic edge timestamp is delayed by scheduling, and the longest delay
+#define SYNTHETIC_DELAY_PROBABILITY 0.01
+#define SYNTHETIC_DELAY_MAX_US 2000.0
+
+static void printUsage() {
+    fprintf(stderr, "Usage: tids-speedbench [-f edges.csv | -s rpm] [-j jitter_us] [-d] [-p period_ms] [-w edges.csv] [-o estimates.csv]\n"
+                    "  -f edges.csv      replay a recorded edge stream (time_ns,position per line)\n"
+                    "  -s rpm            replay a synthetic ramp to rpm and back instead\n"
+                    "  -j jitter_us      synthetic timestamp jitter (default 5, as kernel timestamps)\n"
+                    "  -d                add occasional synthetic scheduling delays of up to 2 ms (as wake timestamps)\n"
+                    "  -p period_ms      estimate period (default 10)\n"
+                    "  -w edges.csv      write the synthetic edge stream\n"
+                    "  -o estimates.csv  write every estimate of both methods\n");
+}
+
+// Speed of the synthetic profile at timeS
+static double syntheticSpeedRPM(double peakRPM, double timeS) {
+    if (timeS < SYNTHETIC_RAMP_S) {
+        return peakRPM * timeS / SYNTHETIC_RAMP_S;
+    } else if (timeS < SYNTHETIC_RAMP_S + SYNTHETIC_HOLD_S) {
+        return peakRPM;
+    } else if (timeS < 2 * SYNTHETIC_RAMP_S + SYNTHETIC_HOLD_S) {
+        return peakRPM * (2 * SYNTHETIC_RAMP_S + SYNTHETIC_HOLD_S - timeS) / SYNTHETIC_RAMP_S;
+    }
+    return 0.0;
+}
+
+// Generate edges of the synthetic profile with noisy timestamps
+static void generateEdges(double peakRPM, double jitterUS, bool delays, std::vector<EncoderEdge> *edges) {
+    std::mt19937 random(1);
+    std::normal_distribution<double> jitter(0.0, jitterUS * 1000.0);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+    // Integrate the profile finely and emit an edge at every whole count
+    const double stepS = 1e-6;
+    double positionCounts = 0.0;
+    int64_t position = 0;
+    for (double timeS = 0.0; timeS < 2 * SYNTHETIC_RAMP_S + SYNTHETIC_HOLD_S; timeS += stepS) {
+        positionCounts += syntheticSpeedRPM(peakRPM, timeS) / 60.0 * COUNTS_PER_REVOLUTION * stepS;
+        while (positionCounts >= position + 1) {
+            position++;
+            double timeNS = timeS * 1e9 + jitter(random);
+            if (delays && uniform(random) < SYNTHETIC_DELAY_PROBABILITY) {
+                timeNS += uniform(random) * SYNTHETIC_DELAY_MAX_US * 1000.0;
+            }
+            // Timestamps are taken in order even when late
+            int64_t edgeTimeNS = static_cast<int64_t>(timeNS);
+            if (!edges->empty() && edgeTimeNS < edges->back().timeNS) {
+                edgeTimeNS = edges->back().timeNS;
+            }
+            edges->push_back({edgeTimeNS, position});
+        }
+    }
+}
+
+// Previous drill speed method: time between consecutive rising edges of channel A (every 4th count)
+class PulseIntervalEstimator {
+private:
+    int64_t lastPulseTimeNS;
+    int64_t previousPulseTimeNS;
+
+public:
+    PulseIntervalEstimator() : lastPulseTimeNS(0), previousPulseTimeNS(0) {}
+
+    void addEdge(const EncoderEdge &edge) {
+        if (edge.position % 4 == 0) {
+            this->previousPulseTimeNS = this->lastPulseTimeNS;
+            this->lastPulseTimeNS = edge.timeNS;
+        }
+    }
+
+    double getSpeedRPM() {
+        if (this->previousPulseTimeNS == 0 || this->lastPulseTimeNS <= this->previousPulseTimeNS) {
+            return 0.0;
+        }
+        double secondsPerRevolution = (this->lastPulseTimeNS - this->previousPulseTimeNS) / 1e9 * (COUNTS_PER_REVOLUTION / 4);
+        return 60.0 / secondsPerRevolution;
+    }
+};
+
+// Error and noise statistics of one method
+struct MethodStatistics {
+    double squaredErrorSum;
+    double maxError;
+    double squaredStepSum;
+    double previousSpeed;
+    long count;
+};
+
+static void accumulate(MethodStatistics *statistics, double speedRPM, double trueRPM, bool hasTruth) {
+    if (hasTruth) {
+        double error = speedRPM - trueRPM;
+        statistics->squaredErrorSum += error * error;
+        statistics->maxError = std::max(statistics->maxError, std::fabs(error));
+    }
+    if (statistics->count > 0) {
+        double step = speedRPM - statistics->previousSpeed;
+        statistics->squaredStepSum += step * step;
+    }
+    statistics->previousSpeed = speedRPM;
+    statistics->count++;
+}
+
+static void printStatistics(const char *name, const MethodStatistics &statistics, bool hasTruth, double updateNS) {
+    printf("%-16s", name);
+    if (hasTruth) {
+        printf(" rms error %9.3f rpm  max error %9.3f rpm ", sqrt(statistics.squaredErrorSum / statistics.count), statistics.maxError);
+    }
+    printf(" rms step %9.3f rpm  %8.1f ns/update\n", sqrt(statistics.squaredStepSum / std::max(statistics.count - 1, 1L)), updateNS);
+}
+
+int main(int argc, char *argv[]) {
+    std::string edgesPath;
+    double peakRPM = 0.0;
+    double jitterUS = 5.0;
+    bool delays = false;
+    int periodMS = 10;
+    std::string writePath;
+    std::string outputPath;
+
+    int option;
+    while ((option = getopt(argc, argv, "f:s:j:dp:w:o:h")) != -1) {
+        switch (option) {
+            case 'f':
+                edgesPath = optarg;
+                break;
+            case 's':
+                peakRPM = atof(optarg);
+                break;
+            case 'j':
+                jitterUS = atof(optarg);
+                break;
+            case 'd':
+                delays = true;
+                break;
+            case 'p':
+                periodMS = atoi(optarg);
+                break;
+            case 'w':
+                writePath = optarg;
+                break;
+            case 'o':
+                outputPath = optarg;
+                break;
+            default:
+                printUsage();
+                return 1;
+        }
+    }
+    if ((edgesPath.empty() == (peakRPM <= 0.0)) || periodMS <= 0) {
+        printUsage();
+        return 1;
+    }
+
+    // Load or generate the edge stream
+    std::vector<EncoderEdge> edges;
+    bool hasTruth = edgesPath.empty();
+    if (hasTruth) {
+        generateEdges(peakRPM, jitterUS, delays, &edges);
+    } else {
+        FILE *file = fopen(edgesPath.c_str(), "r");
+        if (file == nullptr) {
+            fprintf(stderr, "tids-speedbench: cannot open %s\n", edgesPath.c_str());
+            return 1;
+        }
+        EncoderEdge edge;
+        while (fscanf(file, "%" SCNd64 ",%" SCNd64, &edge.timeNS, &edge.position) == 2) {
+            edges.push_back(edge);
+        }
+        fclose(file);
+    }
+    if (edges.size() < 2) {
+        fprintf(stderr, "tids-speedbench: fewer than two edges\n");
+        return 1;
+    }
+
+    if (!writePath.empty()) {
+        FILE *file = fopen(writePath.c_str(), "w");
+        if (file == nullptr) {
+            fprintf(stderr, "tids-speedbench: cannot write %s\n", writePath.c_str());
+            return 1;
+        }
+        for (const EncoderEdge &edge : edges) {
+            fprintf(file, "%" PRId64 ",%" PRId64 "\n", edge.timeNS, edge.position);
+        }
+        fclose(file);
+    }
+
+    FILE *output = nullptr;
+    if (!outputPath.empty()) {
+        output = fopen(outputPath.c_str(), "w");
+        if (output == nullptr) {
+            fprintf(stderr, "tids-speedbench: cannot write %s\n", outputPath.c_str());
+            return 1;
+        }
+        fprintf(output, "time_ns,true_rpm,mt_rpm,mt_acceleration_rpm_per_s,mt_quality,mt_edges,pulse_interval_rpm\n");
+    }
+
+    SpeedEstimator estimator(COUNTS_PER_REVOLUTION,
+                             static_cast<int64_t>(SPEED_WINDOW_MIN_MS) * 1000000,
+                             static_cast<int64_t>(SPEED_WINDOW_MAX_MS) * 1000000,
+                             SPEED_WINDOW_MIN_EDGES);
+    estimator.setTimestampJitterNS(static_cast<int64_t>(jitterUS * 1000.0));
+    PulseIntervalEstimator pulseEstimator;
+
+    MethodStatistics mtStatistics = {};
+    MethodStatistics pulseStatistics = {};
+    double qualitySum = 0.0;
+    std::chrono::nanoseconds mtTime(0);
+
+    // Replay edges up to each estimate time, as the telemetry scheduler would see them
+    int64_t periodNS = static_cast<int64_t>(periodMS) * 1000000;
+    int64_t startNS = edges.front().timeNS;
+    size_t next = 0;
+    for (int64_t timeNS = startNS + periodNS; next < edges.size(); timeNS += periodNS) {
+        auto start = std::chrono::steady_clock::now();
+        while (next < edges.size() && edges[next].timeNS <= timeNS) {
+            estimator.addEdge(edges[next]);
+            pulseEstimator.addEdge(edges[next]);
+            next++;
+        }
+        const SpeedEstimate &estimate = estimator.update(timeNS);
+        mtTime += std::chrono::steady_clock::now() - start;
+
+        double trueRPM = hasTruth ? syntheticSpeedRPM(peakRPM, (timeNS - startNS) / 1e9) : 0.0;
+        double pulseRPM = pulseEstimator.getSpeedRPM();
+        accumulate(&mtStatistics, estimate.speedRPM, trueRPM, hasTruth);
+        accumulate(&pulseStatistics, pulseRPM, trueRPM, hasTruth);
+        qualitySum += estimate.quality;
+
+        if (output != nullptr) {
+            fprintf(output, "%" PRId64 ",%.3f,%.3f,%.3f,%.3f,%d,%.3f\n", timeNS, trueRPM, estimate.speedRPM,
+                    estimate.accelerationRPMPerS, estimate.quality, estimate.edgeCount, pulseRPM);
+        }
+    }
+    if (output != nullptr) {
+        fclose(output);
+    }
+
+    printf("%zu edges, %ld estimates every %d ms, mean quality %.3f\n", edges.size(), mtStatistics.count, periodMS, qualitySum / mtStatistics.count);
+    printStatistics("m/t window", mtStatistics, hasTruth, static_cast<double>(mtTime.count()) / mtStatistics.count);
+    printStatistics("pulse interval", pulseStatistics, hasTruth, 0.0);
+    return 0;
+}
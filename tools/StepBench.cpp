@@ -0,0 +1,136 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// tids-stepbench: measure step pulse timing of the real-time step pulse engine at increasing step rates
+
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <unistd.h>
+
+#include "MotionProfile.h"
+#include "StepPulseEngine.h"
+
+using namespace tids;
+
+// First step rate of the sweep in steps/s, and the factor between rates
+#define SWEEP_START_RATE 1000.0
+#define SWEEP_RATE_FACTOR 1.25
+
+static void printUsage() {
+    fprintf(stderr, "Usage: tids-stepbench [-r max_rate] [-t seconds] [-e p99_error_us] [-p priority] [-s spin_us] [-w width_us] [-v]\n"
+                    "  -r max_rate      highest step rate to try in steps/s (default 200000)\n"
+                    "  -t seconds       time to step at each rate (default 0.5)\n"
+                    "  -e p99_error_us  largest p99 pulse-interval error for a rate to pass (default 10)\n"
+                    "  -p priority      SCHED_FIFO priority of the engine thread (default 80)\n"
+                    "  -s spin_us       busy-wait before each release in microseconds (default 20)\n"
+                    "  -w width_us      pulse width in microseconds (default 5)\n"
+                    "  -v               print interval error and lateness histograms of the highest passing rate\n");
+}
+
+int main(int argc, char *argv[]) {
+    double maxRate = 200000.0;
+    double seconds = 0.5;
+    double errorLimitUS = 10.0;
+    int priority = 80;
+    double spinUS = 20.0;
+    double widthUS = 5.0;
+    bool verbose = false;
+
+    int option;
+    while ((option = getopt(argc, argv, "r:t:e:p:s:w:vh")) != -1) {
+        switch (option) {
+            case 'r':
+                maxRate = atof(optarg);
+                break;
+            case 't':
+                seconds = atof(optarg);
+                break;
+            case 'e':
+                errorLimitUS = atof(optarg);
+                break;
+            case 'p':
+                priority = atoi(optarg);
+                break;
+            case 's':
+                spinUS = atof(optarg);
+                break;
+            case 'w':
+                widthUS = atof(optarg);
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            default:
+                printUsage();
+                return (option == 'h') ? 0 : 1;
+        }
+    }
+    if (maxRate < SWEEP_START_RATE || seconds <= 0.0 || errorLimitUS < 0.0 || spinUS < 0.0 || widthUS < 0.0) {
+        printUsage();
+        return 1;
+    }
+
+    // Pulses go nowhere, so only timing is measured
+    volatile bool pin = false;
+    StepPulseEngine engine([&pin](bool high) { pin = high; }, priority,
+                           static_cast<int64_t>(widthUS * 1000.0), static_cast<int64_t>(spinUS * 1000.0));
+    if (engine.start() < 0) {
+        fprintf(stderr, "Error starting step pulse engine\n");
+        return 1;
+    }
+    printf("Engine thread: %s\n", engine.isRealTime() ? "SCHED_FIFO" : "normal priority (run as root for SCHED_FIFO)");
+    printf("%12s %10s %12s %12s %12s %8s\n", "rate/s", "steps", "p99 err us", "max err us", "p99 late us", "missed");
+
+    // Step at constant rates (start rate equal to cruise rate, so no ramps) until timing fails
+    double maxPassingRate = 0.0;
+    MotionProfile profile;
+    for (double rate = SWEEP_START_RATE; rate <= maxRate * 1.0001; rate *= SWEEP_RATE_FACTOR) {
+        MotionLimits limits;
+        limits.maxVelocity = static_cast<float>(rate);
+        limits.maxAcceleration = static_cast<float>(rate);
+        limits.maxJerk = 0.0f;
+        limits.startVelocity = static_cast<float>(rate);
+        profile.plan(static_cast<int64_t>(std::ceil(rate * seconds)), limits);
+
+        engine.resetStatistics();
+        int64_t steps = engine.run(&profile);
+
+        // Quantiles are bucket upper bounds (powers of two nanoseconds)
+        double p99ErrorUS = engine.getIntervalError()->getQuantileNS(0.99) / 1000.0;
+        double maxErrorUS = engine.getIntervalError()->getMaxNS() / 1000.0;
+        double p99LatenessUS = engine.getPulseLateness()->getQuantileNS(0.99) / 1000.0;
+        uint64_t missed = engine.getMissedCount();
+        printf("%12.0f %10" PRId64 " %12.3f %12.3f %12.3f %8" PRIu64 "\n", rate, steps, p99ErrorUS, maxErrorUS, p99LatenessUS, missed);
+
+        if (missed > 0 || p99ErrorUS > errorLimitUS) {
+            break;
+        }
+        maxPassingRate = rate;
+        if (verbose) {
+            engine.getIntervalError()->print(std::cout, "Interval error");
+            engine.getPulseLateness()->print(std::cout, "Pulse lateness");
+        }
+    }
+    engine.stop();
+
+    printf("Max step rate: %.0f steps/s (p99 interval error <= %.1f us, no missed pulses)\n", maxPassingRate, errorLimitUS);
+    return (maxPassingRate > 0.0) ? 0 : 1;
+}
@@ -0,0 +1,129 @@
+/*
+    Tartan Ice Drilling System (TIDS) for autonomous martian ice extraction.
+    Copyright (C) 2018 Devin Gund (https://dgund.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// tids-telemetry: attach read-only to the shared-memory telemetry export of a running CAPCOM
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "TelemetryExportReader.h"
+
+using namespace tids;
+
+static void printUsage() {
+    fprintf(stderr, "Usage: tids-telemetry [-n name] [-i interval_ms] [-c count] [-H history_count]\n"
+                    "  -n name           shared-memory segment name (default " TELEMETRY_EXPORT_NAME ")\n"
+                    "  -i interval_ms    interval between live snapshot prints (default 1000)\n"
+                    "  -c count          number of live snapshots to print (default unlimited)\n"
+                    "  -H history_count  print the most recent snapshots from history as CSV and exit\n");
+}
+
+// Print CSV header of channel names
+static void printHeader(TelemetryExportReader *reader) {
+    printf("time_ns,index");
+    for (uint32_t channel = 0; channel < reader->getHeader()->channelCount; channel++) {
+        const TelemetryExportChannel *descriptor = reader->getChannel(channel);
+        printf(",%s_%s", descriptor->name, descriptor->units);
+    }
+    printf("\n");
+}
+
+// Print a snapshot as a CSV row (channels without samples are left empty)
+static void printSnapshot(TelemetryExportReader *reader, const TelemetrySnapshot &snapshot) {
+    printf("%" PRId64 ",%" PRIu64, snapshot.timeNS, snapshot.index);
+    for (uint32_t channel = 0; channel < reader->getHeader()->channelCount; channel++) {
+        if (snapshot.validChannels & (0x1 << channel)) {
+            printf(",%g", snapshot.value[channel]);
+        } else {
+            printf(",");
+        }
+    }
+    printf("\n");
+}
+
+int main(int argc, char *argv[]) {
+    std::string name = TELEMETRY_EXPORT_NAME;
+    int intervalMS = 1000;
+    long count = -1;
+    long historyCount = -1;
+
+    int option;
+    while ((option = getopt(argc, argv, "n:i:c:H:h")) != -1) {
+        switch (option) {
+            case 'n':
+                name = optarg;
+                break;
+            case 'i':
+                intervalMS = atoi(optarg);
+                break;
+            case 'c':
+                count = atol(optarg);
+                break;
+            case 'H':
+                historyCount = atol(optarg);
+                break;
+            default:
+                printUsage();
+                return 1;
+        }
+    }
+
+    TelemetryExportReader reader(name);
+    if (reader.open() < 0) {
+        fprintf(stderr, "tids-telemetry: no telemetry export at %s\n", name.c_str());
+        return 1;
+    }
+
+    // Dump history
+    if (historyCount >= 0) {
+        std::vector<TelemetrySnapshot> snapshots(static_cast<size_t>(historyCount));
+        size_t copied = reader.readHistory(snapshots.data(), snapshots.size());
+        printHeader(&reader);
+        for (size_t i = 0; i < copied; i++) {
+            printSnapshot(&reader, snapshots[i]);
+        }
+        return 0;
+    }
+
+    // Follow live snapshots
+    printHeader(&reader);
+    for (long printed = 0; count < 0 || printed < count; printed++) {
+        // Reattach if CAPCOM restarted
+        if (reader.isStale()) {
+            reader.close();
+            if (reader.open() < 0) {
+                fprintf(stderr, "tids-telemetry: telemetry export at %s went away\n", name.c_str());
+                return 1;
+            }
+        }
+
+        TelemetrySnapshot snapshot;
+        if (reader.readSnapshot(&snapshot) == 0) {
+            printSnapshot(&reader, snapshot);
+            fflush(stdout);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(intervalMS));
+    }
+    return 0;
+}